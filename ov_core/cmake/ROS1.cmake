@@ -54,7 +54,13 @@ list(APPEND LIBRARY_SOURCES
         src/feat/Feature.cpp
         src/feat/FeatureDatabase.cpp
         src/feat/FeatureInitializer.cpp
+        src/feat/FeaturePool.cpp
+        src/feat/FeatureSnapshot.cpp
+        src/feat/LandmarkMap.cpp
         src/utils/print.cpp
+        src/utils/metrics.cpp
+        src/utils/image_pool.cpp
+        src/utils/trace.cpp
 )
 file(GLOB_RECURSE LIBRARY_HEADERS "src/*.h")
 add_library(ov_core_lib SHARED ${LIBRARY_SOURCES} ${LIBRARY_HEADERS})
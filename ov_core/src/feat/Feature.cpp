@@ -25,6 +25,9 @@ using namespace ov_core;
 
 void Feature::clean_old_measurements(const std::vector<double> &valid_times) {
 
+  // Any snapshot of our old measurements is no longer valid
+  version++;
+
   // Loop through each of the cameras we have
   for (auto const &pair : timestamps) {
 
@@ -54,6 +57,9 @@ void Feature::clean_old_measurements(const std::vector<double> &valid_times) {
 
 void Feature::clean_invalid_measurements(const std::vector<double> &invalid_times) {
 
+  // Any snapshot of our old measurements is no longer valid
+  version++;
+
   // Loop through each of the cameras we have
   for (auto const &pair : timestamps) {
 
@@ -83,6 +89,9 @@ void Feature::clean_invalid_measurements(const std::vector<double> &invalid_time
 
 void Feature::clean_older_measurements(double timestamp) {
 
+  // Any snapshot of our old measurements is no longer valid
+  version++;
+
   // Loop through each of the cameras we have
   for (auto const &pair : timestamps) {
 
@@ -23,12 +23,107 @@
 #define OV_CORE_FEATURE_H
 
 #include <Eigen/Eigen>
+#include <algorithm>
 #include <iostream>
-#include <unordered_map>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace ov_core {
 
+/**
+ * @brief Measurements of a feature in each camera (mapped by camera ID)
+ *
+ * A feature is only seen by a few cameras, thus we keep the cameras in a small array sorted by their ID.
+ * Each camera has a contiguous vector of its measurements, and finding a camera is a short search instead of a hash lookup.
+ * This has the interface of the std::unordered_map we used before (iterating gives pairs of camera ID and measurements).
+ * Cameras are iterated in order of their ID.
+ */
+template <typename T> class CameraMap {
+
+public:
+  typedef std::pair<size_t, std::vector<T>> value_type;
+  typedef typename std::vector<value_type>::iterator iterator;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+  iterator begin() { return cams.begin(); }
+  iterator end() { return cams.end(); }
+  const_iterator begin() const { return cams.begin(); }
+  const_iterator end() const { return cams.end(); }
+
+  /// Number of cameras
+  size_t size() const { return cams.size(); }
+  bool empty() const { return cams.empty(); }
+
+  /// Removes all cameras, their arrays are kept to be reused by cameras added later
+  void clear() {
+    for (auto &cam : cams) {
+      cam.second.clear();
+      spare.push_back(std::move(cam.second));
+    }
+    cams.clear();
+  }
+
+  /// Finds the measurements of a camera, end() if it has none
+  iterator find(size_t cam_id) {
+    iterator it = lower_bound(cam_id);
+    return (it != cams.end() && it->first == cam_id) ? it : cams.end();
+  }
+  const_iterator find(size_t cam_id) const {
+    const_iterator it = std::lower_bound(cams.begin(), cams.end(), cam_id, [](const value_type &cam, size_t id) { return cam.first < id; });
+    return (it != cams.end() && it->first == cam_id) ? it : cams.end();
+  }
+  size_t count(size_t cam_id) const { return (find(cam_id) != cams.end()) ? 1 : 0; }
+
+  /// Measurements of a camera, throws std::out_of_range if it has none
+  std::vector<T> &at(size_t cam_id) {
+    iterator it = find(cam_id);
+    if (it == cams.end())
+      throw std::out_of_range("CameraMap::at");
+    return it->second;
+  }
+  const std::vector<T> &at(size_t cam_id) const {
+    const_iterator it = find(cam_id);
+    if (it == cams.end())
+      throw std::out_of_range("CameraMap::at");
+    return it->second;
+  }
+
+  /// Measurements of a camera, adds the camera if it has none
+  std::vector<T> &operator[](size_t cam_id) {
+    iterator it = lower_bound(cam_id);
+    if (it == cams.end() || it->first != cam_id) {
+      it = cams.insert(it, value_type(cam_id, std::vector<T>()));
+      if (!spare.empty()) {
+        it->second.swap(spare.back());
+        spare.pop_back();
+      }
+    }
+    return it->second;
+  }
+
+  /// Removes a camera (returns if it was found)
+  size_t erase(size_t cam_id) {
+    iterator it = find(cam_id);
+    if (it == cams.end())
+      return 0;
+    cams.erase(it);
+    return 1;
+  }
+  iterator erase(iterator it) { return cams.erase(it); }
+
+private:
+  iterator lower_bound(size_t cam_id) {
+    return std::lower_bound(cams.begin(), cams.end(), cam_id, [](const value_type &cam, size_t id) { return cam.first < id; });
+  }
+
+  /// Each camera and its measurements, sorted by camera ID
+  std::vector<value_type> cams;
+
+  /// Empty arrays of removed cameras
+  std::vector<std::vector<T>> spare;
+};
+
 /**
  * @brief Sparse feature class used to collect measurements
  *
@@ -46,13 +141,13 @@ public:
   bool to_delete;
 
   /// UV coordinates that this feature has been seen from (mapped by camera ID)
-  std::unordered_map<size_t, std::vector<Eigen::VectorXf>> uvs;
+  CameraMap<Eigen::Vector2f> uvs;
 
   /// UV normalized coordinates that this feature has been seen from (mapped by camera ID)
-  std::unordered_map<size_t, std::vector<Eigen::VectorXf>> uvs_norm;
+  CameraMap<Eigen::Vector2f> uvs_norm;
 
   /// Timestamps of each UV measurement (mapped by camera ID)
-  std::unordered_map<size_t, std::vector<double>> timestamps;
+  CameraMap<double> timestamps;
 
   /// What camera ID our pose is anchored in!! By default the first measurement is the anchor.
   int anchor_cam_id = -1;
@@ -66,6 +161,21 @@ public:
   /// Triangulated position of this feature, in the global frame
   Eigen::Vector3d p_FinG;
 
+  /// If p_FinG is a previous estimate the triangulation can be warm started from (see FeatureInitializer::warm_start())
+  bool has_estimate = false;
+
+  /// Class this feature was given by the last FeatureDatabase::classify_for_update() (see FeatureDatabase::UpdateClass)
+  int update_class = 0;
+
+  /// Generation of the classification that gave this class (the class is only valid for that generation)
+  size_t update_generation = 0;
+
+  /// Increased each time the measurements change (thus a snapshot of this feature only needs to be copied again if this changed)
+  size_t version = 0;
+
+  /// Number of measurements the FeatureDatabase has accounted for this feature (see FeatureDatabase::get_usage())
+  size_t num_measurements_db = 0;
+
   /**
    * @brief Remove measurements that do not occur at passed timestamps.
    *
@@ -21,17 +21,58 @@
 
 #include "FeatureDatabase.h"
 
+#include <algorithm>
+#include <tuple>
+
 #include "Feature.h"
+#include "FeaturePool.h"
+#include "utils/binary_io.h"
+#include "utils/colors.h"
 #include "utils/print.h"
 
 using namespace ov_core;
 
+FeatureDatabase::FeatureDatabase() : feature_pool(std::make_shared<FeaturePool>()) {}
+
+void FeatureDatabase::set_limits(const Limits &new_limits) {
+  std::lock_guard<std::mutex> lck(mtx);
+  limits = new_limits;
+  enforce_limits();
+}
+
+FeatureDatabase::Usage FeatureDatabase::get_usage() {
+  std::lock_guard<std::mutex> lck(mtx);
+  Usage usage;
+  usage.num_features = features_idlookup.size();
+  usage.num_measurements = num_measurements;
+  usage.num_pooled = feature_pool->num_released();
+  usage.num_evicted_features = num_evicted_features;
+  usage.num_evicted_measurements = num_evicted_measurements;
+  usage.above_watermark = above_watermark;
+
+  // Each feature has its object, lookup entry and newest time entry, and the measurement arrays of about one camera
+  // Each measurement has its time, raw and normalized uv, and an entry in our time index
+  size_t bytes_feature = sizeof(Feature) + 3 * (sizeof(size_t) + 2 * sizeof(void *)) + 3 * (sizeof(std::vector<double>) + 4 * sizeof(void *));
+  size_t bytes_measurement = sizeof(double) + 2 * sizeof(Eigen::Vector2f) + sizeof(size_t) + 2 * sizeof(void *);
+  usage.bytes = usage.num_features * bytes_feature + usage.num_measurements * bytes_measurement + usage.num_pooled * sizeof(Feature);
+
+  // Our snapshot cache has an entry, the view we last gave out and the blocks of each camera of a feature
+  // Blocks only old snapshots still refer to are not counted (they are freed with the snapshots)
+  for (const auto &pair : snapshot_cache) {
+    usage.bytes += sizeof(size_t) + sizeof(SnapshotCache) + 2 * sizeof(void *) + sizeof(FeatureSnapshot);
+    for (const auto &log : pair.second.logs) {
+      usage.bytes += sizeof(log) + sizeof(std::pair<size_t, MeasurementTrack>) + log.second.num_blocks() * sizeof(MeasurementBlock);
+    }
+  }
+  return usage;
+}
+
 std::shared_ptr<Feature> FeatureDatabase::get_feature(size_t id, bool remove) {
   std::lock_guard<std::mutex> lck(mtx);
   if (features_idlookup.find(id) != features_idlookup.end()) {
     std::shared_ptr<Feature> temp = features_idlookup.at(id);
     if (remove)
-      features_idlookup.erase(id);
+      erase_feature(id);
     return temp;
   } else {
     return nullptr;
@@ -57,16 +98,40 @@ bool FeatureDatabase::get_feature_clone(size_t id, Feature &feat) {
 }
 
 void FeatureDatabase::update_feature(size_t id, double timestamp, size_t cam_id, float u, float v, float u_n, float v_n) {
+  std::lock_guard<std::mutex> lck(mtx);
+  index_measurement(id, timestamp);
+  append_measurement(id, timestamp, cam_id, Eigen::Vector2f(u, v), Eigen::Vector2f(u_n, v_n));
+  enforce_limits();
+}
 
-  // Find this feature using the ID lookup
+void FeatureDatabase::update_features(double timestamp, size_t cam_id, const std::vector<size_t> &ids, const std::vector<Eigen::Vector2f> &uvs,
+                                      const std::vector<Eigen::Vector2f> &uvs_norm) {
+  assert(ids.size() == uvs.size());
+  assert(ids.size() == uvs_norm.size());
+
+  // All measurements are at the same time, thus we only need to find it in our index once
   std::lock_guard<std::mutex> lck(mtx);
-  if (features_idlookup.find(id) != features_idlookup.end()) {
-    // Get our feature
-    std::shared_ptr<Feature> feat = features_idlookup.at(id);
+  std::unordered_set<size_t> &ids_at_time = features_at_time[timestamp];
+  ids_at_time.reserve(ids_at_time.size() + ids.size());
+  for (size_t i = 0; i < ids.size(); i++) {
+    ids_at_time.insert(ids.at(i));
+    index_newer_time(ids.at(i), timestamp);
+    append_measurement(ids.at(i), timestamp, cam_id, uvs.at(i), uvs_norm.at(i));
+  }
+  enforce_limits();
+}
+
+void FeatureDatabase::append_measurement(size_t id, double timestamp, size_t cam_id, const Eigen::Vector2f &uv, const Eigen::Vector2f &uv_norm) {
+
+  // Find this feature using the ID lookup
+  auto it = features_idlookup.find(id);
+  if (it != features_idlookup.end()) {
     // Append this new information to it!
-    feat->uvs[cam_id].push_back(Eigen::Vector2f(u, v));
-    feat->uvs_norm[cam_id].push_back(Eigen::Vector2f(u_n, v_n));
-    feat->timestamps[cam_id].push_back(timestamp);
+    it->second->version++;
+    it->second->uvs[cam_id].push_back(uv);
+    it->second->uvs_norm[cam_id].push_back(uv_norm);
+    it->second->timestamps[cam_id].push_back(timestamp);
+    account_measurements(*it->second, it->second->num_measurements_db + 1);
     return;
   }
 
@@ -74,11 +139,11 @@ void FeatureDatabase::update_feature(size_t id, double timestamp, size_t cam_id,
   // PRINT_DEBUG("featdb - adding new feature %d",(int)id);
 
   // Else we have not found the feature, so lets make it be a new one!
-  std::shared_ptr<Feature> feat = std::make_shared<Feature>();
-  feat->featid = id;
-  feat->uvs[cam_id].push_back(Eigen::Vector2f(u, v));
-  feat->uvs_norm[cam_id].push_back(Eigen::Vector2f(u_n, v_n));
+  std::shared_ptr<Feature> feat = feature_pool->acquire(id);
+  feat->uvs[cam_id].push_back(uv);
+  feat->uvs_norm[cam_id].push_back(uv_norm);
   feat->timestamps[cam_id].push_back(timestamp);
+  account_measurements(*feat, 1);
 
   // Append this new feature into our database
   features_idlookup[id] = feat;
@@ -89,33 +154,35 @@ std::vector<std::shared_ptr<Feature>> FeatureDatabase::features_not_containing_n
   // Our vector of features that do not have measurements after the specified time
   std::vector<std::shared_ptr<Feature>> feats_old;
 
-  // Now lets loop through all features, and just make sure they are not old
+  // Only features whose newest measurement is older can be returned, thus only check those
   std::lock_guard<std::mutex> lck(mtx);
-  for (auto it = features_idlookup.begin(); it != features_idlookup.end();) {
-    // Skip if already deleted
-    if (skip_deleted && (*it).second->to_delete) {
-      it++;
-      continue;
-    }
-    // Loop through each camera
-    // If we have a measurement greater-than or equal to the specified, this measurement is find
-    bool has_newer_measurement = false;
-    for (auto const &pair : (*it).second->timestamps) {
-      has_newer_measurement = (!pair.second.empty() && pair.second.at(pair.second.size() - 1) >= timestamp);
-      if (has_newer_measurement) {
-        break;
+  std::vector<size_t> ids_remove;
+  for (auto it_time = features_at_newest_time.begin(); it_time != features_at_newest_time.end() && it_time->first < timestamp; it_time++) {
+    for (const auto &id : it_time->second) {
+      std::shared_ptr<Feature> feat = features_idlookup.at(id);
+      // Skip if already deleted
+      if (skip_deleted && feat->to_delete) {
+        continue;
+      }
+      // Loop through each camera
+      // If we have a measurement greater-than or equal to the specified, this measurement is find
+      bool has_newer_measurement = false;
+      for (auto const &pair : feat->timestamps) {
+        has_newer_measurement = (!pair.second.empty() && pair.second.at(pair.second.size() - 1) >= timestamp);
+        if (has_newer_measurement) {
+          break;
+        }
+      }
+      // If it is not being actively tracked, then it is old
+      if (!has_newer_measurement) {
+        feats_old.push_back(feat);
+        if (remove)
+          ids_remove.push_back(id);
       }
     }
-    // If it is not being actively tracked, then it is old
-    if (!has_newer_measurement) {
-      feats_old.push_back((*it).second);
-      if (remove)
-        features_idlookup.erase(it++);
-      else
-        it++;
-    } else {
-      it++;
-    }
+  }
+  for (const auto &id : ids_remove) {
+    erase_feature(id);
   }
 
   // Debugging
@@ -130,32 +197,38 @@ std::vector<std::shared_ptr<Feature>> FeatureDatabase::features_containing_older
   // Our vector of old features
   std::vector<std::shared_ptr<Feature>> feats_old;
 
-  // Now lets loop through all features, and just make sure they are not old
+  // Only features with a measurement at an older time can be returned, thus only check those
+  // A feature can be at multiple older times, so we only return it the first time we see it
   std::lock_guard<std::mutex> lck(mtx);
-  for (auto it = features_idlookup.begin(); it != features_idlookup.end();) {
-    // Skip if already deleted
-    if (skip_deleted && (*it).second->to_delete) {
-      it++;
-      continue;
-    }
-    // Loop through each camera
-    // Check if we have at least one time older then the requested
-    bool found_containing_older = false;
-    for (auto const &pair : (*it).second->timestamps) {
-      found_containing_older = (!pair.second.empty() && pair.second.at(0) < timestamp);
+  std::unordered_set<size_t> ids_checked;
+  for (auto it_time = features_at_time.begin(); it_time != features_at_time.end() && it_time->first < timestamp; it_time++) {
+    for (const auto &id : it_time->second) {
+      auto it = features_idlookup.find(id);
+      if (it == features_idlookup.end() || !ids_checked.insert(id).second) {
+        continue;
+      }
+      // Skip if already deleted
+      if (skip_deleted && (*it).second->to_delete) {
+        continue;
+      }
+      // Loop through each camera
+      // Check if we have at least one time older then the requested
+      bool found_containing_older = false;
+      for (auto const &pair : (*it).second->timestamps) {
+        found_containing_older = (!pair.second.empty() && pair.second.at(0) < timestamp);
+        if (found_containing_older) {
+          break;
+        }
+      }
+      // If it has an older timestamp, then add it
       if (found_containing_older) {
-        break;
+        feats_old.push_back((*it).second);
       }
     }
-    // If it has an older timestamp, then add it
-    if (found_containing_older) {
-      feats_old.push_back((*it).second);
-      if (remove)
-        features_idlookup.erase(it++);
-      else
-        it++;
-    } else {
-      it++;
+  }
+  if (remove) {
+    for (const auto &feat : feats_old) {
+      erase_feature(feat->featid);
     }
   }
 
@@ -175,12 +248,19 @@ FeatureDatabase::features_containing(double timestamp, // 查找的时间戳
   // Our vector of old features
   std::vector<std::shared_ptr<Feature>> feats_has_timestamp;
 
-  // Now lets loop through all features, and just make sure they are not
+  // Only the features indexed at this time can have it, thus only check those
   std::lock_guard<std::mutex> lck(mtx);
-  for (auto it = features_idlookup.begin(); it != features_idlookup.end();) {
+  auto it_time = features_at_time.find(timestamp);
+  if (it_time == features_at_time.end()) {
+    return feats_has_timestamp;
+  }
+  for (const auto &id : it_time->second) {
+    auto it = features_idlookup.find(id);
+    if (it == features_idlookup.end()) {
+      continue;
+    }
     // Skip if already deleted
     if (skip_deleted && (*it).second->to_delete) {
-      it++;
       continue;
     }
     // Boolean if it has the timestamp
@@ -192,16 +272,16 @@ FeatureDatabase::features_containing(double timestamp, // 查找的时间戳
         break;
       }
     }
-    // note 会根据用户的选择，删除或者保留
-    // Remove this feature if it contains the specified timestamp
     if (has_timestamp) {
       feats_has_timestamp.push_back((*it).second);
-      if (remove)
-        features_idlookup.erase(it++);
-      else
-        it++;
-    } else {
-      it++;
+    }
+  }
+
+  // note 会根据用户的选择，删除或者保留
+  // Remove the features that contain the specified timestamp
+  if (remove) {
+    for (const auto &feat : feats_has_timestamp) {
+      erase_feature(feat->featid);
     }
   }
 
@@ -213,25 +293,141 @@ FeatureDatabase::features_containing(double timestamp, // 查找的时间戳
   return feats_has_timestamp;
 }
 
+size_t FeatureDatabase::classify_for_update(double timestamp, double timestamp_marg, const std::vector<int> &cam_ids, int max_track_length,
+                                            std::vector<std::shared_ptr<Feature>> &feats_lost,
+                                            std::vector<std::shared_ptr<Feature>> &feats_marg,
+                                            std::vector<std::shared_ptr<Feature>> &feats_maxtracks) {
+
+  // New generation, thus all previous classes are no longer valid
+  std::lock_guard<std::mutex> lck(mtx);
+  update_generation++;
+  feats_lost.clear();
+  feats_marg.clear();
+  feats_maxtracks.clear();
+
+  // Classifies a candidate using all its cameras (if we have not yet in this generation)
+  auto classify = [&](size_t id) {
+    auto it = features_idlookup.find(id);
+    if (it == features_idlookup.end() || it->second->update_generation == update_generation) {
+      return;
+    }
+    const std::shared_ptr<Feature> &feat = it->second;
+    feat->update_generation = update_generation;
+    feat->update_class = UPDATE_NONE;
+    if (feat->to_delete) {
+      return;
+    }
+    bool has_newer_measurement = false;
+    bool has_current_camid = false;
+    bool has_marg_timestamp = false;
+    bool reached_max = false;
+    for (auto const &camtimes : feat->timestamps) {
+      const std::vector<double> &times = camtimes.second;
+      has_newer_measurement = has_newer_measurement || (!times.empty() && times.back() >= timestamp);
+      has_current_camid = has_current_camid || (std::find(cam_ids.begin(), cam_ids.end(), (int)camtimes.first) != cam_ids.end());
+      if (timestamp_marg != -1 && !has_marg_timestamp) {
+        has_marg_timestamp = (std::find(times.begin(), times.end(), timestamp_marg) != times.end());
+      }
+      reached_max = reached_max || ((int)times.size() > max_track_length);
+    }
+
+    // Marg features which have reached max length can be made into SLAM features
+    // A lost feature could have a measurement at the marg time (if lost in the last frame), then it is only a marg feature
+    // Lost features from other image streams wait until that camera has processed its newest image
+    if (has_marg_timestamp && reached_max) {
+      feat->update_class = UPDATE_MAXTRACK;
+      feats_maxtracks.push_back(feat);
+    } else if (has_marg_timestamp) {
+      feat->update_class = UPDATE_MARG;
+      feats_marg.push_back(feat);
+    } else if (!has_newer_measurement && has_current_camid) {
+      feat->update_class = UPDATE_LOST;
+      feats_lost.push_back(feat);
+    }
+  };
+
+  // Candidates are the features at the marg time, and the ones whose newest measurement is older than the newest time
+  if (timestamp_marg != -1) {
+    auto it_time = features_at_time.find(timestamp_marg);
+    if (it_time != features_at_time.end()) {
+      for (const auto &id : it_time->second)
+        classify(id);
+    }
+  }
+  for (auto it_time = features_at_newest_time.begin(); it_time != features_at_newest_time.end() && it_time->first < timestamp; it_time++) {
+    for (const auto &id : it_time->second)
+      classify(id);
+  }
+  auto compare_id = [](const std::shared_ptr<Feature> &a, const std::shared_ptr<Feature> &b) { return a->featid < b->featid; };
+  std::sort(feats_lost.begin(), feats_lost.end(), compare_id);
+  std::sort(feats_marg.begin(), feats_marg.end(), compare_id);
+  std::sort(feats_maxtracks.begin(), feats_maxtracks.end(), compare_id);
+  return update_generation;
+}
+
+bool FeatureDatabase::has_update_class(const std::shared_ptr<Feature> &feat, size_t generation, UpdateClass update_class) {
+  return feat->update_generation == generation && feat->update_class == update_class;
+}
+
+void FeatureDatabase::set_update_class(const std::shared_ptr<Feature> &feat, size_t generation, UpdateClass update_class) {
+  feat->update_generation = generation;
+  feat->update_class = update_class;
+}
+
+void FeatureDatabase::reindex_features(const std::vector<std::shared_ptr<Feature>> &feats) {
+  std::lock_guard<std::mutex> lck(mtx);
+  for (const auto &feat : feats) {
+    auto it = features_idlookup.find(feat->featid);
+    if (feat->to_delete || it == features_idlookup.end() || it->second != feat)
+      continue;
+    size_t num_meas = 0;
+    for (const auto &times : feat->timestamps)
+      num_meas += times.second.size();
+    if (num_meas < 1) {
+      erase_feature(feat->featid);
+      continue;
+    }
+    account_measurements(*feat, num_meas);
+    index_newest_time(feat);
+  }
+}
+
 void FeatureDatabase::cleanup() {
   // Loop through all features
   // int sizebefore = (int)features_idlookup.size();
   std::lock_guard<std::mutex> lck(mtx);
-  for (auto it = features_idlookup.begin(); it != features_idlookup.end();) {
+  std::vector<size_t> ids_remove;
+  for (const auto &pair : features_idlookup) {
     // If delete flag is set, then delete it
-    if ((*it).second->to_delete) {
-      features_idlookup.erase(it++);
-    } else {
-      it++;
+    if (pair.second->to_delete) {
+      ids_remove.push_back(pair.first);
     }
   }
+  for (const auto &id : ids_remove) {
+    erase_feature(id);
+  }
   // PRINT_DEBUG("feat db = %d -> %d\n", sizebefore, (int)features_idlookup.size() << std::endl;
 }
 
 void FeatureDatabase::cleanup_measurements(double timestamp) {
   std::lock_guard<std::mutex> lck(mtx);
-  for (auto it = features_idlookup.begin(); it != features_idlookup.end();) {
-    // Remove the older measurements
+
+  // Only features with measurements at older times are affected
+  std::unordered_set<size_t> ids_affected;
+  auto it_end = features_at_time.lower_bound(timestamp);
+  for (auto it_time = features_at_time.begin(); it_time != it_end; it_time++) {
+    ids_affected.insert(it_time->second.begin(), it_time->second.end());
+  }
+
+  // All measurements older than this are removed, thus so are their times
+  features_at_time.erase(features_at_time.begin(), it_end);
+
+  // Remove the older measurements
+  for (const auto &id : ids_affected) {
+    auto it = features_idlookup.find(id);
+    if (it == features_idlookup.end()) {
+      continue;
+    }
     (*it).second->clean_older_measurements(timestamp);
     // Count how many measurements
     int ct_meas = 0;
@@ -240,9 +436,9 @@ void FeatureDatabase::cleanup_measurements(double timestamp) {
     }
     // If delete flag is set, then delete it
     if (ct_meas < 1) {
-      features_idlookup.erase(it++);
+      erase_feature(id);
     } else {
-      it++;
+      account_measurements(*(*it).second, (size_t)ct_meas);
     }
   }
 }
@@ -252,10 +448,22 @@ void FeatureDatabase::cleanup_measurements(double timestamp) {
 */
 void FeatureDatabase::cleanup_measurements_exact(double timestamp) {
   std::lock_guard<std::mutex> lck(mtx);
+
+  // Only features with a measurement at this time are affected
+  auto it_time = features_at_time.find(timestamp);
+  if (it_time == features_at_time.end()) {
+    return;
+  }
+  std::unordered_set<size_t> ids_affected = it_time->second;
+  features_at_time.erase(it_time);
+
+  // Remove the measurements at this time
   std::vector<double> timestamps = {timestamp};
-  for (auto it = features_idlookup.begin(); it != features_idlookup.end();) // todo 哪里维护features_idlookup？
-  {
-    // Remove the older measurements
+  for (const auto &id : ids_affected) {
+    auto it = features_idlookup.find(id);
+    if (it == features_idlookup.end()) {
+      continue;
+    }
     (*it).second->clean_invalid_measurements(timestamps);
     // Count how many measurements
     int ct_meas = 0;
@@ -263,25 +471,77 @@ void FeatureDatabase::cleanup_measurements_exact(double timestamp) {
       ct_meas += (int)(pair.second.size());
     }
     // If delete flag is set, then delete it
+    // Otherwise this could have been its newest measurement
     if (ct_meas < 1) {
-      features_idlookup.erase(it++);
+      erase_feature(id);
     } else {
-      it++;
+      account_measurements(*(*it).second, (size_t)ct_meas);
+      index_newest_time((*it).second);
     }
   }
 }
 
 double FeatureDatabase::get_oldest_timestamp() {
   std::lock_guard<std::mutex> lck(mtx);
-  double oldest_time = -1;
-  for (auto const &feat : features_idlookup) {
-    for (auto const &camtimepair : feat.second->timestamps) {
-      if (!camtimepair.second.empty() && (oldest_time == -1 || oldest_time > camtimepair.second.at(0))) {
-        oldest_time = camtimepair.second.at(0);
+
+  // The oldest indexed time that still has a feature with a measurement at it
+  for (const auto &time : features_at_time) {
+    for (const auto &id : time.second) {
+      auto it = features_idlookup.find(id);
+      if (it == features_idlookup.end()) {
+        continue;
+      }
+      for (auto const &camtimepair : (*it).second->timestamps) {
+        if (std::find(camtimepair.second.begin(), camtimepair.second.end(), time.first) != camtimepair.second.end()) {
+          return time.first;
+        }
+      }
+    }
+  }
+  return -1;
+}
+
+std::shared_ptr<const FeatureDatabase::Snapshot> FeatureDatabase::get_snapshot() {
+  std::lock_guard<std::mutex> lck(mtx);
+
+  // Give out the view of the last snapshot if the feature has not changed since
+  // The delete flag is set directly by the updaters, thus we also check it
+  // Otherwise we bring the blocks of each camera up to date (only new measurements are copied) and make a new view of them
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->reserve(features_idlookup.size());
+  for (const auto &pair : features_idlookup) {
+    const Feature &feat = *pair.second;
+    SnapshotCache &cache = snapshot_cache[pair.first];
+    if (cache.view == nullptr || cache.source != &feat || cache.version != feat.version || cache.view->to_delete != feat.to_delete) {
+      if (cache.source != &feat)
+        cache.logs.clear();
+      bool same_cams = (cache.logs.size() == feat.timestamps.size());
+      size_t idx = 0;
+      for (const auto &cam : feat.timestamps) {
+        same_cams = same_cams && cache.logs.at(idx++).first == cam.first;
       }
+      if (!same_cams) {
+        std::vector<std::pair<size_t, MeasurementLog>> logs;
+        for (const auto &cam : feat.timestamps) {
+          auto it = std::find_if(cache.logs.begin(), cache.logs.end(),
+                                 [&](const std::pair<size_t, MeasurementLog> &log) { return log.first == cam.first; });
+          logs.emplace_back(cam.first, (it != cache.logs.end()) ? std::move(it->second) : MeasurementLog());
+        }
+        cache.logs.swap(logs);
+      }
+      FeatureSnapshot::Tracks tracks;
+      tracks.reserve(cache.logs.size());
+      for (auto &log : cache.logs) {
+        log.second.sync(feat.timestamps.at(log.first), feat.uvs.at(log.first), feat.uvs_norm.at(log.first));
+        tracks.emplace_back(log.first, log.second.track());
+      }
+      cache.source = &feat;
+      cache.version = feat.version;
+      cache.view = std::make_shared<const FeatureSnapshot>(feat.featid, feat.to_delete, std::move(tracks));
     }
+    snapshot->insert({pair.first, cache.view});
   }
-  return oldest_time;
+  return snapshot;
 }
 
 void FeatureDatabase::append_new_measurements(const std::shared_ptr<FeatureDatabase> &database) {
@@ -294,22 +554,28 @@ void FeatureDatabase::append_new_measurements(const std::shared_ptr<FeatureDatab
 
       // For this feature, now try to append the new measurement data
       std::shared_ptr<Feature> temp = features_idlookup.at(feat.first);
+      temp->version++;
       for (const auto &times : feat.second->timestamps) {
         // Append the whole camera vector is not seen
         // Otherwise need to loop through each and append
         size_t cam_id = times.first;
         if (temp->timestamps.find(cam_id) == temp->timestamps.end()) {
+          for (const auto &time : times.second)
+            index_measurement(feat.first, time);
           temp->timestamps[cam_id] = feat.second->timestamps.at(cam_id);
           temp->uvs[cam_id] = feat.second->uvs.at(cam_id);
           temp->uvs_norm[cam_id] = feat.second->uvs_norm.at(cam_id);
+          account_measurements(*temp, temp->num_measurements_db + times.second.size());
         } else {
           auto temp_times = temp->timestamps.at(cam_id);
           for (size_t i = 0; i < feat.second->timestamps.at(cam_id).size(); i++) {
             double time_to_find = feat.second->timestamps.at(cam_id).at(i);
             if (std::find(temp_times.begin(), temp_times.end(), time_to_find) == temp_times.end()) {
+              index_measurement(feat.first, time_to_find);
               temp->timestamps.at(cam_id).push_back(feat.second->timestamps.at(cam_id).at(i));
               temp->uvs.at(cam_id).push_back(feat.second->uvs.at(cam_id).at(i));
               temp->uvs_norm.at(cam_id).push_back(feat.second->uvs_norm.at(cam_id).at(i));
+              account_measurements(*temp, temp->num_measurements_db + 1);
             }
           }
         }
@@ -318,13 +584,219 @@ void FeatureDatabase::append_new_measurements(const std::shared_ptr<FeatureDatab
     } else {
 
       // Else we have not found the feature, so lets make it be a new one!
-      std::shared_ptr<Feature> temp = std::make_shared<Feature>();
-      temp->featid = feat.second->featid;
+      std::shared_ptr<Feature> temp = feature_pool->acquire(feat.second->featid);
       temp->timestamps = feat.second->timestamps;
       temp->uvs = feat.second->uvs;
       temp->uvs_norm = feat.second->uvs_norm;
       features_idlookup[feat.first] = temp;
+      size_t num_meas = 0;
+      for (const auto &times : temp->timestamps) {
+        for (const auto &time : times.second)
+          index_measurement(feat.first, time);
+        num_meas += times.second.size();
+      }
+      account_measurements(*temp, num_meas);
     }
   }
+  enforce_limits();
   // PRINT_DEBUG("feat db = %d -> %d\n", sizebefore, (int)features_idlookup.size() << std::endl;
 }
+
+void FeatureDatabase::save_checkpoint(std::ostream &out) {
+  std::lock_guard<std::mutex> lck(mtx);
+
+  // Write in the order of the ids, so the same database always gives the same file
+  std::map<size_t, std::shared_ptr<Feature>> features_sorted(features_idlookup.begin(), features_idlookup.end());
+  binary_io::write(out, (uint64_t)features_sorted.size());
+  for (const auto &pair : features_sorted) {
+    const std::shared_ptr<Feature> &feat = pair.second;
+    binary_io::write(out, (uint64_t)feat->featid);
+    binary_io::write(out, feat->to_delete);
+    binary_io::write(out, (uint64_t)feat->timestamps.size());
+    for (const auto &cam : feat->timestamps) {
+      binary_io::write(out, (uint64_t)cam.first);
+      binary_io::write(out, (uint64_t)cam.second.size());
+      for (size_t i = 0; i < cam.second.size(); i++) {
+        binary_io::write(out, cam.second.at(i));
+        binary_io::write_matrix(out, feat->uvs.at(cam.first).at(i));
+        binary_io::write_matrix(out, feat->uvs_norm.at(cam.first).at(i));
+      }
+    }
+    binary_io::write(out, (int32_t)feat->anchor_cam_id);
+    binary_io::write(out, feat->anchor_clone_timestamp);
+    binary_io::write_matrix(out, feat->p_FinA);
+    binary_io::write_matrix(out, feat->p_FinG);
+  }
+}
+
+bool FeatureDatabase::load_checkpoint(std::istream &in) {
+  uint64_t num_feats;
+  if (!binary_io::read(in, num_feats))
+    return false;
+  std::vector<std::shared_ptr<Feature>> feats;
+  for (uint64_t f = 0; f < num_feats; f++) {
+    auto feat = feature_pool->acquire(0);
+    uint64_t featid, num_cams;
+    if (!binary_io::read(in, featid) || !binary_io::read(in, feat->to_delete) || !binary_io::read(in, num_cams))
+      return false;
+    feat->featid = (size_t)featid;
+    for (uint64_t c = 0; c < num_cams; c++) {
+      uint64_t cam_id, num_meas;
+      if (!binary_io::read(in, cam_id) || !binary_io::read(in, num_meas))
+        return false;
+      for (uint64_t i = 0; i < num_meas; i++) {
+        double timestamp;
+        Eigen::Vector2f uv, uv_n;
+        if (!binary_io::read(in, timestamp) || !binary_io::read_matrix(in, uv) || !binary_io::read_matrix(in, uv_n))
+          return false;
+        feat->timestamps[(size_t)cam_id].push_back(timestamp);
+        feat->uvs[(size_t)cam_id].push_back(uv);
+        feat->uvs_norm[(size_t)cam_id].push_back(uv_n);
+      }
+    }
+    int32_t anchor_cam_id;
+    if (!binary_io::read(in, anchor_cam_id) || !binary_io::read(in, feat->anchor_clone_timestamp) ||
+        !binary_io::read_matrix(in, feat->p_FinA) || !binary_io::read_matrix(in, feat->p_FinG))
+      return false;
+    feat->anchor_cam_id = anchor_cam_id;
+    feats.push_back(feat);
+  }
+
+  // Only insert once everything has been read, so a corrupt file does not leave us half loaded
+  std::lock_guard<std::mutex> lck(mtx);
+  for (const auto &feat : feats) {
+    erase_feature(feat->featid);
+    features_idlookup[feat->featid] = feat;
+    size_t num_meas = 0;
+    for (const auto &times : feat->timestamps) {
+      for (const auto &time : times.second)
+        index_measurement(feat->featid, time);
+      num_meas += times.second.size();
+    }
+    account_measurements(*feat, num_meas);
+  }
+  enforce_limits();
+  return true;
+}
+
+void FeatureDatabase::index_measurement(size_t id, double timestamp) {
+  features_at_time[timestamp].insert(id);
+  index_newer_time(id, timestamp);
+}
+
+void FeatureDatabase::index_newer_time(size_t id, double timestamp) {
+  auto it = feature_newest_time.find(id);
+  if (it == feature_newest_time.end()) {
+    feature_newest_time[id] = timestamp;
+    features_at_newest_time[timestamp].insert(id);
+  } else if (it->second < timestamp) {
+    remove_from_time(features_at_newest_time, it->second, id);
+    it->second = timestamp;
+    features_at_newest_time[timestamp].insert(id);
+  }
+}
+
+void FeatureDatabase::index_newest_time(const std::shared_ptr<Feature> &feat) {
+  bool has_measurement = false;
+  double timestamp = 0.0;
+  for (const auto &times : feat->timestamps) {
+    for (const auto &time : times.second) {
+      timestamp = (has_measurement) ? std::max(timestamp, time) : time;
+      has_measurement = true;
+    }
+  }
+  auto it = feature_newest_time.find(feat->featid);
+  if (it != feature_newest_time.end()) {
+    remove_from_time(features_at_newest_time, it->second, feat->featid);
+    feature_newest_time.erase(it);
+  }
+  if (has_measurement) {
+    feature_newest_time[feat->featid] = timestamp;
+    features_at_newest_time[timestamp].insert(feat->featid);
+  }
+}
+
+void FeatureDatabase::erase_feature(size_t id) {
+  auto it_feat = features_idlookup.find(id);
+  if (it_feat == features_idlookup.end()) {
+    return;
+  }
+  for (const auto &times : it_feat->second->timestamps) {
+    for (const auto &time : times.second)
+      remove_from_time(features_at_time, time, id);
+  }
+  auto it = feature_newest_time.find(id);
+  if (it != feature_newest_time.end()) {
+    remove_from_time(features_at_newest_time, it->second, id);
+    feature_newest_time.erase(it);
+  }
+  num_measurements -= std::min(num_measurements, it_feat->second->num_measurements_db);
+  snapshot_cache.erase(id);
+  feature_pool->release(it_feat->second);
+  features_idlookup.erase(it_feat);
+}
+
+void FeatureDatabase::account_measurements(Feature &feat, size_t num_meas) {
+  num_measurements = num_measurements - std::min(num_measurements, feat.num_measurements_db) + num_meas;
+  feat.num_measurements_db = num_meas;
+}
+
+void FeatureDatabase::enforce_limits() {
+
+  // Nothing to do if we are within our limits
+  bool over_features = (limits.max_features > 0 && features_idlookup.size() > limits.max_features);
+  bool over_measurements = (limits.max_measurements > 0 && num_measurements > limits.max_measurements);
+  if (over_features || over_measurements) {
+
+    // We evict a bit more than needed, so we do not need to do this on every new measurement
+    size_t target_features = (over_features) ? (size_t)(0.95 * (double)limits.max_features) : features_idlookup.size();
+    size_t target_measurements = (over_measurements) ? (size_t)(0.95 * (double)limits.max_measurements) : num_measurements;
+
+    // Order our features by the policy
+    // For the oldest, our newest time index is already in order, so we only need to go through the start of it
+    std::vector<size_t> ids_ordered;
+    size_t num_features_left = features_idlookup.size();
+    size_t num_meas_left = num_measurements;
+    auto add_evicted = [&](size_t id) {
+      ids_ordered.push_back(id);
+      num_features_left--;
+      num_meas_left -= std::min(num_meas_left, features_idlookup.at(id)->num_measurements_db);
+      return num_features_left <= target_features && num_meas_left <= target_measurements;
+    };
+    if (limits.policy == EVICT_OLDEST) {
+      bool done = false;
+      for (auto it_time = features_at_newest_time.begin(); it_time != features_at_newest_time.end() && !done; it_time++) {
+        for (auto it_id = it_time->second.begin(); it_id != it_time->second.end() && !done; it_id++)
+          done = add_evicted(*it_id);
+      }
+    } else {
+      std::vector<std::tuple<size_t, double, size_t>> candidates;
+      candidates.reserve(features_idlookup.size());
+      for (const auto &pair : feature_newest_time)
+        candidates.emplace_back(features_idlookup.at(pair.first)->num_measurements_db, pair.second, pair.first);
+      std::sort(candidates.begin(), candidates.end());
+      for (const auto &candidate : candidates) {
+        if (add_evicted(std::get<2>(candidate)))
+          break;
+      }
+    }
+
+    // Finally remove them
+    size_t num_meas_before = num_measurements;
+    for (const auto &id : ids_ordered)
+      erase_feature(id);
+    num_evicted_features += ids_ordered.size();
+    num_evicted_measurements += num_meas_before - num_measurements;
+    PRINT_DEBUG(YELLOW "[FEAT-DB]: evicted %zu tracks with %zu measurements (%zu tracks and %zu measurements left)\n" RESET, ids_ordered.size(),
+                num_meas_before - num_measurements, features_idlookup.size(), num_measurements);
+  }
+
+  // Warn once we cross our watermark, and again if we have dropped below it since
+  bool above = (limits.max_features > 0 && (double)features_idlookup.size() > limits.watermark * (double)limits.max_features) ||
+               (limits.max_measurements > 0 && (double)num_measurements > limits.watermark * (double)limits.max_measurements);
+  if (above && !above_watermark) {
+    PRINT_WARNING(YELLOW "[FEAT-DB]: %zu tracks and %zu measurements is above %.0f%% of the limit (%zu tracks, %zu measurements)\n" RESET,
+                  features_idlookup.size(), num_measurements, 100.0 * limits.watermark, limits.max_features, limits.max_measurements);
+  }
+  above_watermark = above;
+}
@@ -23,14 +23,21 @@
 #define OV_CORE_FEATURE_DATABASE_H
 
 #include <Eigen/Eigen>
+#include <istream>
 #include <memory>
 #include <mutex>
+#include <ostream>
+#include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "FeatureSnapshot.h"
+
 namespace ov_core {
 
 class Feature;
+class FeaturePool;
 
 /**
  * @brief Database containing features we are currently tracking.
@@ -50,14 +57,109 @@ class Feature;
  * For example, if you are asynchronous tracking cameras and you chose to update the state, then remove all features you will use in update.
  * The feature trackers will continue to add features while you update, whose measurements can be used in the next update step!
  *
+ * @m_class{m-note m-default}
+ *
+ * @par Time Indices
+ * Besides the lookup by id, we index the features by the times they have measurements at and by their newest measurement time.
+ * These are kept up to date as measurements are added and cleaned up through this database.
+ * Thus the time queries and the cleanup of old measurements only touch the features involved, not every feature we have.
+ * Measurements removed directly from a feature (e.g. Feature::clean_old_measurements()) leave stale entries behind.
+ * Thus features which are kept after this need to be re-indexed (see reindex_features()), otherwise the newest time can be too new.
+ * The stale entries of the removed times are filtered out by the queries (they still check the measurements).
+ * They are removed once their time is cleaned up.
+ *
+ * @m_class{m-note m-default}
+ *
+ * @par Feature Reuse
+ * New features come from a FeaturePool, and features removed from this database are given back to it.
+ * A removed feature is only reused once nobody else references it, thus the returned pointers stay valid as long as they are held.
+ *
+ * @m_class{m-note m-default}
+ *
+ * @par Memory Limits
+ * If the measurements are not cleaned up (e.g. while we wait for initialization) the database would grow without bound.
+ * Thus we can limit the number of features and measurements (see set_limits()).
+ * Once we are over a limit, whole tracks are evicted following the eviction policy until we are a bit below it again.
+ * If the usage goes above the watermark fraction of a limit we warn once, get_usage() can be polled to track this.
+ *
  */
 class FeatureDatabase {
 
 public:
+  /// Read-only view of all features (mapped by ID)
+  typedef std::unordered_map<size_t, std::shared_ptr<const FeatureSnapshot>> Snapshot;
+
+  /// Which tracks are evicted first once we are over one of our limits
+  enum EvictionPolicy {
+    /// Tracks whose newest measurement is the oldest (i.e. lost tracks go first)
+    EVICT_OLDEST = 0,
+    /// Tracks with the fewest measurements (ties are broken by the oldest newest measurement)
+    EVICT_SHORTEST = 1
+  };
+
+  /// Limits on the size of the database (zero is unlimited)
+  struct Limits {
+
+    /// Max number of features (tracks)
+    size_t max_features = 0;
+
+    /// Max number of measurements over all features
+    size_t max_measurements = 0;
+
+    /// Which tracks we evict first
+    EvictionPolicy policy = EVICT_OLDEST;
+
+    /// Fraction of a limit above which we warn
+    double watermark = 0.8;
+  };
+
+  /// Memory usage of the database
+  struct Usage {
+
+    /// Number of features (tracks) and measurements
+    size_t num_features = 0;
+    size_t num_measurements = 0;
+
+    /// Approximate bytes used by our features, measurements, indices and snapshot blocks (unused capacity is not counted)
+    size_t bytes = 0;
+
+    /// Number of removed features held by our pool for reuse (their measurements have been cleared)
+    size_t num_pooled = 0;
+
+    /// Total number of features and measurements we have evicted to stay within our limits
+    size_t num_evicted_features = 0;
+    size_t num_evicted_measurements = 0;
+
+    /// If we are above the watermark of one of our limits
+    bool above_watermark = false;
+  };
+
   /**
    * @brief Default constructor
    */
-  FeatureDatabase() {}
+  FeatureDatabase();
+
+  /**
+   * @brief Sets the limits on our size, we will evict tracks right away if we are over them
+   * @param new_limits New limits
+   */
+  void set_limits(const Limits &new_limits);
+
+  /// Gets the limits on our size
+  Limits get_limits() {
+    std::lock_guard<std::mutex> lck(mtx);
+    return limits;
+  }
+
+  /**
+   * @brief Gets the memory usage of this database
+   *
+   * Measurements removed directly from a feature (i.e. not through this database) are still counted until its time is cleaned up.
+   * Thus the usage can be a bit higher than the actual one, but never lower.
+   *
+   * @return Current usage
+   */
+  Usage get_usage();
 
   /**
    * @brief Get a specified feature
@@ -90,6 +192,19 @@ public:
    */
   void update_feature(size_t id, double timestamp, size_t cam_id, float u, float v, float u_n, float v_n);
 
+  /**
+   * @brief Update a set of features with their measurements from a single image
+   * @param timestamp time that these measurements occured at
+   * @param cam_id which camera these measurements were from
+   * @param ids IDs of the features we will update
+   * @param uvs raw uv coordinates of each feature
+   * @param uvs_norm undistorted/normalized uv coordinates of each feature
+   *
+   * Same as calling update_feature() for each feature, but we only lock the database and find the time in our index once.
+   */
+  void update_features(double timestamp, size_t cam_id, const std::vector<size_t> &ids, const std::vector<Eigen::Vector2f> &uvs,
+                       const std::vector<Eigen::Vector2f> &uvs_norm);
+
   /**
    * @brief Get features that do not have newer measurement then the specified time.
    *
@@ -118,6 +233,67 @@ public:
    */
   std::vector<std::shared_ptr<Feature>> features_containing(double timestamp, bool remove = false, bool skip_deleted = false);
 
+  /// Classes features are given by classify_for_update(), and the SLAM ones the estimator gives them afterwards (see set_update_class())
+  enum UpdateClass { UPDATE_NONE = 0, UPDATE_LOST = 1, UPDATE_MARG = 2, UPDATE_MAXTRACK = 3, UPDATE_SLAM = 4, UPDATE_SLAM_DELAYED = 5 };
+
+  /**
+   * @brief Classifies all features for an update in a single pass over the lost and marginalization candidates.
+   *
+   * This replaces getting the lost and marginalized features separately and then filtering them against each other.
+   * Only the features whose newest measurement is older than the newest time or which have one at the marginalization time are visited.
+   * Features flagged as deleted are skipped.
+   * - lost: has no measurement at or after the newest time, has been seen from one of the cameras of this frame, and is not marg
+   * - marg: has a measurement at the marginalization time
+   * - maxtrack: a marg feature which has more than the max track length measurements in one of its cameras
+   *
+   * Each classified feature is stamped with its class and the generation of this classification.
+   * Thus after this call, checking if a feature is in one of the sets is just a comparison (see has_update_class()).
+   * Each set is sorted by feature id, so its order does not depend on the history of our hash tables (e.g. after restoring a checkpoint).
+   *
+   * @param timestamp Newest time (features without measurements at or after this are lost)
+   * @param timestamp_marg Marginalization time (-1 if we should not get any marg features)
+   * @param cam_ids Cameras of the current frame
+   * @param max_track_length Max number of measurements in a camera before the feature is a maxtrack
+   * @param feats_lost Lost features
+   * @param feats_marg Features at the marginalization time
+   * @param feats_maxtracks Features at the marginalization time which have reached the max track length
+   * @return Generation of this classification
+   */
+  size_t classify_for_update(double timestamp, double timestamp_marg, const std::vector<int> &cam_ids, int max_track_length,
+                             std::vector<std::shared_ptr<Feature>> &feats_lost, std::vector<std::shared_ptr<Feature>> &feats_marg,
+                             std::vector<std::shared_ptr<Feature>> &feats_maxtracks);
+
+  /**
+   * @brief If the feature was given the class by the classification of the given generation
+   * @param feat Feature we want to check
+   * @param generation Generation returned by classify_for_update()
+   * @param update_class Class we want to check for
+   */
+  static bool has_update_class(const std::shared_ptr<Feature> &feat, size_t generation, UpdateClass update_class);
+
+  /**
+   * @brief Gives the feature a class in the classification of the given generation
+   *
+   * This is used by the estimator to re-classify features after classify_for_update() (e.g. a max track which is made into a SLAM feature).
+   * The feature can be from another database (e.g. an aruco tag), as long as the generation of this classification is used for it.
+   *
+   * @param feat Feature we want to classify
+   * @param generation Generation returned by classify_for_update()
+   * @param update_class Class the feature should have
+   */
+  static void set_update_class(const std::shared_ptr<Feature> &feat, size_t generation, UpdateClass update_class);
+
+  /**
+   * @brief Updates the newest time index and measurement count of features whose measurements were removed directly
+   *
+   * The updaters remove the measurements which are not at a clone time from the features they use (e.g. Feature::clean_old_measurements()).
+   * Features which keep living in the database after this (i.e. are not flagged as deleted) should be re-indexed with this.
+   * Features that are not in this database (or were replaced by a newer one with the same id) are skipped.
+   *
+   * @param feats Features which had measurements removed
+   */
+  void reindex_features(const std::vector<std::shared_ptr<Feature>> &feats);
+
   /**
    * @brief This function will delete all features that have been used up.
    *
@@ -144,6 +320,22 @@ public:
     return features_idlookup.size();
   }
 
+  /**
+   * @brief Gets a consistent read-only copy of all features in the database
+   *
+   * The features in the snapshot will not change, thus they can be used while the trackers append new measurements.
+   * Their measurements are in blocks that are shared with the database and other snapshots and are never changed (see MeasurementLog).
+   * Thus a snapshot only copies the pointers and lengths of the tracks, and only the measurements appended since the last snapshot.
+   * Features which have not changed since the last snapshot are given out again as they were.
+   * This should be used by anything that only reads the features (e.g. initializers and visualizations).
+   *
+   * @return Snapshot of all features at this time
+   */
+  std::shared_ptr<const Snapshot> get_snapshot();
+
+  /// Pool of our features (e.g. to get how many we had to allocate)
+  std::shared_ptr<FeaturePool> get_feature_pool() { return feature_pool; }
+
   /**
    * @brief Returns the internal data (should not normally be used)
    */
@@ -162,12 +354,93 @@ public:
    */
   void append_new_measurements(const std::shared_ptr<FeatureDatabase> &database);
 
+  /**
+   * @brief Writes all features and their measurements in binary to the stream
+   * @param out Stream we will write to
+   */
+  void save_checkpoint(std::ostream &out);
+
+  /**
+   * @brief Reads features written with save_checkpoint() into this database (replacing any with the same id)
+   * @param in Stream we will read from
+   * @return True if all features could be read
+   */
+  bool load_checkpoint(std::istream &in);
+
 protected:
   /// Mutex lock for our map
   std::mutex mtx;
 
+  /// Pool our new features come from and removed ones go back to
+  std::shared_ptr<FeaturePool> feature_pool;
+
+  /// Measurement blocks of a feature our snapshots share, and the view of it we last gave out
+  struct SnapshotCache {
+    const Feature *source = nullptr;
+    size_t version = 0;
+    std::vector<std::pair<size_t, MeasurementLog>> logs;
+    std::shared_ptr<const FeatureSnapshot> view;
+  };
+
+  /// Snapshot blocks of each feature in the database (mapped by ID, dropped with the feature thus at most one copy of our measurements)
+  std::unordered_map<size_t, SnapshotCache> snapshot_cache;
+
   /// Our lookup array that allow use to query based on ID
   std::unordered_map<size_t, std::shared_ptr<Feature>> features_idlookup;
+
+  /// Limits on our size
+  Limits limits;
+
+  /// Number of measurements over all features (sum of their Feature::num_measurements_db)
+  size_t num_measurements = 0;
+
+  /// Total number of evicted features and measurements
+  size_t num_evicted_features = 0;
+  size_t num_evicted_measurements = 0;
+
+  /// If we are above the watermark (we only warn when we cross it)
+  bool above_watermark = false;
+
+  /// Generation of the last update classification (0 if we never have classified)
+  size_t update_generation = 0;
+
+  /// Features which have a measurement at each time (can also have ones whose measurement has been removed since)
+  std::map<double, std::unordered_set<size_t>> features_at_time;
+
+  /// Newest measurement time of each feature, and the features at each newest time
+  std::unordered_map<size_t, double> feature_newest_time;
+  std::map<double, std::unordered_set<size_t>> features_at_newest_time;
+
+  /// Appends a measurement to a feature, creating it if we do not have it yet (the mutex should be locked)
+  void append_measurement(size_t id, double timestamp, size_t cam_id, const Eigen::Vector2f &uv, const Eigen::Vector2f &uv_norm);
+
+  /// Adds a measurement of a feature to our time indices (the mutex should be locked)
+  void index_measurement(size_t id, double timestamp);
+
+  /// Sets the newest time of a feature if this time is newer (the mutex should be locked)
+  void index_newer_time(size_t id, double timestamp);
+
+  /// Sets the newest time of a feature from its measurements (the mutex should be locked)
+  void index_newest_time(const std::shared_ptr<Feature> &feat);
+
+  /// Removes a feature from our lookup and its time indices (the mutex should be locked)
+  void erase_feature(size_t id);
+
+  /// Sets how many measurements a feature has, and updates our total (the mutex should be locked)
+  void account_measurements(Feature &feat, size_t num_meas);
+
+  /// Evicts tracks if we are over our limits, and checks our watermark (the mutex should be locked)
+  void enforce_limits();
+
+  /// Removes a feature from a time of an index, and that time if no feature is left
+  static void remove_from_time(std::map<double, std::unordered_set<size_t>> &index, double timestamp, size_t id) {
+    auto it = index.find(timestamp);
+    if (it == index.end())
+      return;
+    it->second.erase(id);
+    if (it->second.empty())
+      index.erase(it);
+  }
 };
 
 } // namespace ov_core
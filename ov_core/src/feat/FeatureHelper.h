@@ -134,8 +134,9 @@ public:
   {
     // Compute the disparity
     std::vector<double> disparities;
-    for (auto &feat : db->get_internal_data()) {       // std::unordered_map<size_t, std::shared_ptr<Feature>> 不同相机下对应的数据库
-      for (auto &campairs : feat.second->timestamps) { // std::unordered_map<size_t, std::vector<double>>      遍历数据库中的时间戳(相机id, 时间戳)
+    std::shared_ptr<const FeatureDatabase::Snapshot> snapshot = db->get_snapshot();
+    for (auto &feat : *snapshot) {           // std::unordered_map<size_t, std::shared_ptr<const FeatureSnapshot>> 不同相机下对应的数据库
+      for (auto const &campairs : feat.second->timestamps) { // SnapshotCameraMap<double> 遍历数据库中的时间戳(相机id, 时间戳)
 
         // Skip if only one observation
         if (campairs.second.size() < 2)
@@ -153,8 +154,8 @@ public:
         for (size_t idx = 0; idx < feat.second->timestamps.at(camid).size(); idx++) { // 遍历该数据库中该相机[id]下的时间戳
           double time = feat.second->timestamps.at(camid).at(idx); // 获取该数据库中该相机[id]下[idx]的时间戳
           if ((oldest_time == -1 || time > oldest_time) && !found0) {
-            // uvs := std::unordered_map<size_t, std::vector<Eigen::VectorXf>> 
-            // code at(idx)返回值元素类型为Eigen::VectorXf
+            // uvs := CameraMap<Eigen::Vector2f>
+            // code at(idx)返回值元素类型为Eigen::Vector2f
             uv0 = feat.second->uvs.at(camid).at(idx).block(0, 0, 2, 1); // 获取的第一个时间戳的uv坐标
             found0 = true;
             continue;
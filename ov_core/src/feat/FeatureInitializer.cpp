@@ -21,14 +21,37 @@
 
 #include "FeatureInitializer.h"
 
+#include <algorithm>
+
 #include "Feature.h"
 #include "utils/print.h"
 #include "utils/quat_ops.h"
 
 using namespace ov_core;
 
-bool FeatureInitializer::single_triangulation(std::shared_ptr<Feature> feat,
-                                              std::unordered_map<size_t, std::unordered_map<double, ClonePose>> &clonesCAM) {
+bool FeatureInitializer::ClonePoseTable::find(size_t cam_id, double timestamp, size_t &idx) const {
+  auto it_cam = std::find(_cam_ids.begin(), _cam_ids.end(), cam_id);
+  auto it_clone = std::lower_bound(_clone_times.begin(), _clone_times.end(), timestamp);
+  if (it_cam == _cam_ids.end() || it_clone == _clone_times.end() || *it_clone != timestamp)
+    return false;
+  idx = (size_t)(it_cam - _cam_ids.begin()) * _clone_times.size() + (size_t)(it_clone - _clone_times.begin());
+  return true;
+}
+
+bool FeatureInitializer::find_clones(const ClonePoseTable &clonesCAM, const std::shared_ptr<Feature> &feat, std::vector<size_t> &indices) {
+  indices.clear();
+  for (auto const &pair : feat->timestamps) {
+    for (const auto &timestamp : pair.second) {
+      size_t idx = 0;
+      if (!clonesCAM.find(pair.first, timestamp, idx))
+        return false;
+      indices.push_back(idx);
+    }
+  }
+  return true;
+}
+
+bool FeatureInitializer::single_triangulation(std::shared_ptr<Feature> feat, const ClonePoseTable &clonesCAM) {
 
   // Total number of measurements
   // Also set the first measurement to be the anchor frame
@@ -49,20 +72,28 @@ bool FeatureInitializer::single_triangulation(std::shared_ptr<Feature> feat,
   Eigen::Matrix3d A = Eigen::Matrix3d::Zero();
   Eigen::Vector3d b = Eigen::Vector3d::Zero();
 
+  // Get the pose of each measurement in our clone table
+  std::vector<size_t> clone_indices;
+  size_t anchor_idx = 0;
+  if (!find_clones(clonesCAM, feat, clone_indices) || !clonesCAM.find(feat->anchor_cam_id, feat->anchor_clone_timestamp, anchor_idx))
+    return false;
+
   // Get the position of the anchor pose
-  ClonePose anchorclone = clonesCAM.at(feat->anchor_cam_id).at(feat->anchor_clone_timestamp);
+  const ClonePose &anchorclone = clonesCAM.at(anchor_idx);
   const Eigen::Matrix<double, 3, 3> &R_GtoA = anchorclone.Rot();
   const Eigen::Matrix<double, 3, 1> &p_AinG = anchorclone.pos();
 
   // Loop through each camera for this feature
+  size_t k = 0;
   for (auto const &pair : feat->timestamps) {
 
     // Add CAM_I features
     for (size_t m = 0; m < feat->timestamps.at(pair.first).size(); m++) {
 
       // Get the position of this clone in the global
-      const Eigen::Matrix<double, 3, 3> &R_GtoCi = clonesCAM.at(pair.first).at(feat->timestamps.at(pair.first).at(m)).Rot();
-      const Eigen::Matrix<double, 3, 1> &p_CiinG = clonesCAM.at(pair.first).at(feat->timestamps.at(pair.first).at(m)).pos();
+      const ClonePose &clone_Ci = clonesCAM.at(clone_indices.at(k++));
+      const Eigen::Matrix<double, 3, 3> &R_GtoCi = clone_Ci.Rot();
+      const Eigen::Matrix<double, 3, 1> &p_CiinG = clone_Ci.pos();
 
       // Convert current position relative to anchor
       Eigen::Matrix<double, 3, 3> R_AtoCi;
@@ -111,8 +142,7 @@ bool FeatureInitializer::single_triangulation(std::shared_ptr<Feature> feat,
   return true;
 }
 
-bool FeatureInitializer::single_triangulation_1d(std::shared_ptr<Feature> feat,
-                                                 std::unordered_map<size_t, std::unordered_map<double, ClonePose>> &clonesCAM) {
+bool FeatureInitializer::single_triangulation_1d(std::shared_ptr<Feature> feat, const ClonePoseTable &clonesCAM) {
 
   // Total number of measurements
   // Also set the first measurement to be the anchor frame
@@ -134,8 +164,14 @@ bool FeatureInitializer::single_triangulation_1d(std::shared_ptr<Feature> feat,
   double A = 0.0;
   double b = 0.0;
 
+  // Get the pose of each measurement in our clone table
+  std::vector<size_t> clone_indices;
+  size_t anchor_idx = 0;
+  if (!find_clones(clonesCAM, feat, clone_indices) || !clonesCAM.find(feat->anchor_cam_id, feat->anchor_clone_timestamp, anchor_idx))
+    return false;
+
   // Get the position of the anchor pose
-  ClonePose anchorclone = clonesCAM.at(feat->anchor_cam_id).at(feat->anchor_clone_timestamp);
+  const ClonePose &anchorclone = clonesCAM.at(anchor_idx);
   const Eigen::Matrix<double, 3, 3> &R_GtoA = anchorclone.Rot();
   const Eigen::Matrix<double, 3, 1> &p_AinG = anchorclone.pos();
 
@@ -146,18 +182,20 @@ bool FeatureInitializer::single_triangulation_1d(std::shared_ptr<Feature> feat,
   bearing_inA = bearing_inA / bearing_inA.norm();
 
   // Loop through each camera for this feature
+  size_t k = 0;
   for (auto const &pair : feat->timestamps) {
 
     // Add CAM_I features
     for (size_t m = 0; m < feat->timestamps.at(pair.first).size(); m++) {
 
-      // Skip the anchor bearing
+      // Skip the anchor bearing (the clone index still needs to advance)
+      const ClonePose &clone_Ci = clonesCAM.at(clone_indices.at(k++));
       if ((int)pair.first == feat->anchor_cam_id && m == idx_anchor_bearing)
         continue;
 
       // Get the position of this clone in the global
-      const Eigen::Matrix<double, 3, 3> &R_GtoCi = clonesCAM.at(pair.first).at(feat->timestamps.at(pair.first).at(m)).Rot();
-      const Eigen::Matrix<double, 3, 1> &p_CiinG = clonesCAM.at(pair.first).at(feat->timestamps.at(pair.first).at(m)).pos();
+      const Eigen::Matrix<double, 3, 3> &R_GtoCi = clone_Ci.Rot();
+      const Eigen::Matrix<double, 3, 1> &p_CiinG = clone_Ci.pos();
 
       // Convert current position relative to anchor
       Eigen::Matrix<double, 3, 3> R_AtoCi;
@@ -194,8 +232,38 @@ bool FeatureInitializer::single_triangulation_1d(std::shared_ptr<Feature> feat,
   return true;
 }
 
-bool FeatureInitializer::single_gaussnewton(std::shared_ptr<Feature> feat,
-                                            std::unordered_map<size_t, std::unordered_map<double, ClonePose>> &clonesCAM) {
+bool FeatureInitializer::warm_start(std::shared_ptr<Feature> feat, const ClonePoseTable &clonesCAM) {
+
+  // We need a previous estimate, and the refinement to correct it
+  if (!_options.warm_start || !_options.refine_features || !feat->has_estimate)
+    return false;
+
+  // Set the anchor frame as in the linear triangulation
+  size_t anchor_most_meas = 0;
+  size_t most_meas = 0;
+  for (auto const &pair : feat->timestamps) {
+    if (pair.second.size() > most_meas) {
+      anchor_most_meas = pair.first;
+      most_meas = pair.second.size();
+    }
+  }
+  if (most_meas == 0)
+    return false;
+  feat->anchor_cam_id = anchor_most_meas;
+  feat->anchor_clone_timestamp = feat->timestamps.at(feat->anchor_cam_id).back();
+
+  // Previous estimate in the anchor frame, this needs to be in front of the anchor
+  size_t anchor_idx = 0;
+  if (!clonesCAM.find(feat->anchor_cam_id, feat->anchor_clone_timestamp, anchor_idx))
+    return false;
+  Eigen::Vector3d p_FinA = clonesCAM.at(anchor_idx).Rot() * (feat->p_FinG - clonesCAM.at(anchor_idx).pos());
+  if (p_FinA(2) < _options.min_dist || p_FinA(2) > _options.max_dist || std::isnan(p_FinA.norm()))
+    return false;
+  feat->p_FinA = p_FinA;
+  return true;
+}
+
+bool FeatureInitializer::single_gaussnewton(std::shared_ptr<Feature> feat, const ClonePoseTable &clonesCAM) {
 
   // Get into inverse depth
   double rho = 1 / feat->p_FinA(2);
@@ -212,12 +280,16 @@ bool FeatureInitializer::single_gaussnewton(std::shared_ptr<Feature> feat,
   Eigen::Matrix<double, 3, 3> Hess = Eigen::Matrix<double, 3, 3>::Zero();
   Eigen::Matrix<double, 3, 1> grad = Eigen::Matrix<double, 3, 1>::Zero();
 
-  // Cost at the last iteration
-  double cost_old = compute_error(clonesCAM, feat, alpha, beta, rho);
+  // Pose of the anchor in each measurement camera
+  // These do not change during the optimization, thus we only compute them once
+  std::vector<size_t> clone_indices;
+  size_t anchor_idx = 0;
+  std::vector<ClonePose> clones_AinCi;
+  if (!get_clones_in_anchor(clonesCAM, feat, clone_indices, anchor_idx, clones_AinCi))
+    return false;
 
-  // Get the position of the anchor pose
-  const Eigen::Matrix<double, 3, 3> &R_GtoA = clonesCAM.at(feat->anchor_cam_id).at(feat->anchor_clone_timestamp).Rot();
-  const Eigen::Matrix<double, 3, 1> &p_AinG = clonesCAM.at(feat->anchor_cam_id).at(feat->anchor_clone_timestamp).pos();
+  // Cost at the last iteration
+  double cost_old = compute_error(clones_AinCi, feat, alpha, beta, rho);
 
   // Loop till we have either
   // 1. Reached our max iteration count
@@ -234,6 +306,7 @@ bool FeatureInitializer::single_gaussnewton(std::shared_ptr<Feature> feat,
       double err = 0;
 
       // Loop through each camera for this feature
+      size_t k = 0;
       for (auto const &pair : feat->timestamps) {
 
         // Add CAM_I features
@@ -242,16 +315,10 @@ bool FeatureInitializer::single_gaussnewton(std::shared_ptr<Feature> feat,
           //=====================================================================================
           //=====================================================================================
 
-          // Get the position of this clone in the global
-          const Eigen::Matrix<double, 3, 3> &R_GtoCi = clonesCAM.at(pair.first).at(feat->timestamps[pair.first].at(m)).Rot();
-          const Eigen::Matrix<double, 3, 1> &p_CiinG = clonesCAM.at(pair.first).at(feat->timestamps[pair.first].at(m)).pos();
-          // Convert current position relative to anchor
-          Eigen::Matrix<double, 3, 3> R_AtoCi;
-          R_AtoCi.noalias() = R_GtoCi * R_GtoA.transpose();
-          Eigen::Matrix<double, 3, 1> p_CiinA;
-          p_CiinA.noalias() = R_GtoA * (p_CiinG - p_AinG);
-          Eigen::Matrix<double, 3, 1> p_AinCi;
-          p_AinCi.noalias() = -R_AtoCi * p_CiinA;
+          // Get the position of the anchor in this clone
+          const Eigen::Matrix<double, 3, 3> &R_AtoCi = clones_AinCi[k].Rot();
+          const Eigen::Matrix<double, 3, 1> &p_AinCi = clones_AinCi[k].pos();
+          k++;
 
           //=====================================================================================
           //=====================================================================================
@@ -295,7 +362,7 @@ bool FeatureInitializer::single_gaussnewton(std::shared_ptr<Feature> feat,
     // Eigen::Matrix<double,3,1> dx = (Hess+lam*Eigen::MatrixXd::Identity(Hess.rows(), Hess.rows())).colPivHouseholderQr().solve(grad);
 
     // Check if error has gone down
-    double cost = compute_error(clonesCAM, feat, alpha + dx(0, 0), beta + dx(1, 0), rho + dx(2, 0));
+    double cost = compute_error(clones_AinCi, feat, alpha + dx(0, 0), beta + dx(1, 0), rho + dx(2, 0));
 
     // Debug print
     // std::stringstream ss;
@@ -334,6 +401,44 @@ bool FeatureInitializer::single_gaussnewton(std::shared_ptr<Feature> feat,
   feat->p_FinA(1) = beta / rho;
   feat->p_FinA(2) = 1 / rho;
 
+  // Check the feature and get its global position
+  return check_refined(clonesCAM, feat, clone_indices, anchor_idx);
+}
+
+bool FeatureInitializer::get_clones_in_anchor(const ClonePoseTable &clonesCAM, const std::shared_ptr<Feature> &feat,
+                                              std::vector<size_t> &clone_indices, size_t &anchor_idx, std::vector<ClonePose> &clones_AinCi) {
+
+  // Get the pose of each measurement in our clone table
+  if (!find_clones(clonesCAM, feat, clone_indices) || !clonesCAM.find(feat->anchor_cam_id, feat->anchor_clone_timestamp, anchor_idx))
+    return false;
+
+  // Get the position of the anchor pose
+  const Eigen::Matrix<double, 3, 3> &R_GtoA = clonesCAM.at(anchor_idx).Rot();
+  const Eigen::Matrix<double, 3, 1> &p_AinG = clonesCAM.at(anchor_idx).pos();
+
+  // Pose of the anchor in each measurement camera
+  clones_AinCi.clear();
+  clones_AinCi.reserve(clone_indices.size());
+  for (const auto &idx : clone_indices) {
+    // Convert current position relative to anchor
+    Eigen::Matrix<double, 3, 3> R_AtoCi;
+    R_AtoCi.noalias() = clonesCAM.at(idx).Rot() * R_GtoA.transpose();
+    Eigen::Matrix<double, 3, 1> p_CiinA;
+    p_CiinA.noalias() = R_GtoA * (clonesCAM.at(idx).pos() - p_AinG);
+    Eigen::Matrix<double, 3, 1> p_AinCi;
+    p_AinCi.noalias() = -R_AtoCi * p_CiinA;
+    clones_AinCi.emplace_back(R_AtoCi, p_AinCi);
+  }
+  return true;
+}
+
+bool FeatureInitializer::check_refined(const ClonePoseTable &clonesCAM, std::shared_ptr<Feature> feat, const std::vector<size_t> &clone_indices,
+                                       size_t anchor_idx) {
+
+  // Get the position of the anchor pose
+  const Eigen::Matrix<double, 3, 3> &R_GtoA = clonesCAM.at(anchor_idx).Rot();
+  const Eigen::Matrix<double, 3, 1> &p_AinG = clonesCAM.at(anchor_idx).pos();
+
   // Get tangent plane to x_hat
   Eigen::HouseholderQR<Eigen::MatrixXd> qr(feat->p_FinA);
   Eigen::MatrixXd Q = qr.householderQ();
@@ -342,19 +447,16 @@ bool FeatureInitializer::single_gaussnewton(std::shared_ptr<Feature> feat,
   double base_line_max = 0.0;
 
   // Check maximum baseline
-  // Loop through each camera for this feature
-  for (auto const &pair : feat->timestamps) {
-    // Loop through the other clones to see what the max baseline is
-    for (size_t m = 0; m < feat->timestamps.at(pair.first).size(); m++) {
-      // Get the position of this clone in the global
-      const Eigen::Matrix<double, 3, 1> &p_CiinG = clonesCAM.at(pair.first).at(feat->timestamps.at(pair.first).at(m)).pos();
-      // Convert current position relative to anchor
-      Eigen::Matrix<double, 3, 1> p_CiinA = R_GtoA * (p_CiinG - p_AinG);
-      // Dot product camera pose and nullspace
-      double base_line = ((Q.block(0, 1, 3, 2)).transpose() * p_CiinA).norm();
-      if (base_line > base_line_max)
-        base_line_max = base_line;
-    }
+  // Loop through the clones of all measurements to see what the max baseline is
+  for (const auto &idx : clone_indices) {
+    // Get the position of this clone in the global
+    const Eigen::Matrix<double, 3, 1> &p_CiinG = clonesCAM.at(idx).pos();
+    // Convert current position relative to anchor
+    Eigen::Matrix<double, 3, 1> p_CiinA = R_GtoA * (p_CiinG - p_AinG);
+    // Dot product camera pose and nullspace
+    double base_line = ((Q.block(0, 1, 3, 2)).transpose() * p_CiinA).norm();
+    if (base_line > base_line_max)
+      base_line_max = base_line;
   }
   // std::stringstream ss;
   // ss << feat->featid << " - max base " << (feat->p_FinA.norm() / base_line_max) << " - z " << feat->p_FinA(2) << std::endl;
@@ -366,25 +468,24 @@ bool FeatureInitializer::single_gaussnewton(std::shared_ptr<Feature> feat,
   // 3. If the baseline ratio is large
   if (feat->p_FinA(2) < _options.min_dist || feat->p_FinA(2) > _options.max_dist ||
       (feat->p_FinA.norm() / base_line_max) > _options.max_baseline || std::isnan(feat->p_FinA.norm())) {
+    feat->has_estimate = false;
     return false;
   }
 
   // Finally get position in global frame
   feat->p_FinG = R_GtoA.transpose() * feat->p_FinA + p_AinG;
+  feat->has_estimate = true;
   return true;
 }
 
-double FeatureInitializer::compute_error(std::unordered_map<size_t, std::unordered_map<double, ClonePose>> &clonesCAM,
-                                         std::shared_ptr<Feature> feat, double alpha, double beta, double rho) {
+double FeatureInitializer::compute_error(const std::vector<ClonePose> &clones_AinCi, std::shared_ptr<Feature> feat, double alpha, double beta,
+                                         double rho) {
 
   // Total error
   double err = 0;
 
-  // Get the position of the anchor pose
-  const Eigen::Matrix<double, 3, 3> &R_GtoA = clonesCAM.at(feat->anchor_cam_id).at(feat->anchor_clone_timestamp).Rot();
-  const Eigen::Matrix<double, 3, 1> &p_AinG = clonesCAM.at(feat->anchor_cam_id).at(feat->anchor_clone_timestamp).pos();
-
   // Loop through each camera for this feature
+  size_t k = 0;
   for (auto const &pair : feat->timestamps) {
     // Add CAM_I features
     for (size_t m = 0; m < feat->timestamps.at(pair.first).size(); m++) {
@@ -392,16 +493,10 @@ double FeatureInitializer::compute_error(std::unordered_map<size_t, std::unorder
       //=====================================================================================
       //=====================================================================================
 
-      // Get the position of this clone in the global
-      const Eigen::Matrix<double, 3, 3> &R_GtoCi = clonesCAM.at(pair.first).at(feat->timestamps.at(pair.first).at(m)).Rot();
-      const Eigen::Matrix<double, 3, 1> &p_CiinG = clonesCAM.at(pair.first).at(feat->timestamps.at(pair.first).at(m)).pos();
-      // Convert current position relative to anchor
-      Eigen::Matrix<double, 3, 3> R_AtoCi;
-      R_AtoCi.noalias() = R_GtoCi * R_GtoA.transpose();
-      Eigen::Matrix<double, 3, 1> p_CiinA;
-      p_CiinA.noalias() = R_GtoA * (p_CiinG - p_AinG);
-      Eigen::Matrix<double, 3, 1> p_AinCi;
-      p_AinCi.noalias() = -R_AtoCi * p_CiinA;
+      // Get the position of the anchor in this clone
+      const Eigen::Matrix<double, 3, 3> &R_AtoCi = clones_AinCi[k].Rot();
+      const Eigen::Matrix<double, 3, 1> &p_AinCi = clones_AinCi[k].pos();
+      k++;
 
       //=====================================================================================
       //=====================================================================================
@@ -420,4 +515,200 @@ double FeatureInitializer::compute_error(std::unordered_map<size_t, std::unorder
   }
 
   return err;
-}
\ No newline at end of file
+}
+
+namespace {
+
+/// Number of features we refine together
+constexpr int BATCH_LANES = 4;
+
+/// Value of each feature in the batch
+typedef Eigen::Array<double, BATCH_LANES, 1> Lanes;
+
+/// Flag of each feature in the batch
+typedef Eigen::Array<bool, BATCH_LANES, 1> LaneMask;
+
+/// A measurement of each feature in the batch, features with fewer measurements are padded with zero weight
+struct BatchMeasurement {
+
+  /// Rotation from anchor to camera (row major)
+  Lanes R_AtoCi[9];
+
+  /// Position of anchor in camera
+  Lanes p_AinCi[3];
+
+  /// Normalized measurement
+  Lanes u, v;
+
+  /// One if the feature has this measurement, zero otherwise
+  Lanes w;
+};
+
+typedef std::vector<BatchMeasurement, Eigen::aligned_allocator<BatchMeasurement>> BatchMeasurements;
+
+/// Cost, gradient, and Hessian (upper triangle, row major) of all features at the given inverse depth estimates
+void batch_evaluate(const BatchMeasurements &meas, const Lanes &alpha, const Lanes &beta, const Lanes &rho, Lanes &cost, Lanes grad[3],
+                    Lanes hess[6]) {
+  cost.setZero();
+  for (int i = 0; i < 3; i++)
+    grad[i].setZero();
+  for (int i = 0; i < 6; i++)
+    hess[i].setZero();
+  for (const auto &m : meas) {
+
+    // Middle variables of the system
+    Lanes hi1 = m.R_AtoCi[0] * alpha + m.R_AtoCi[1] * beta + m.R_AtoCi[2] + rho * m.p_AinCi[0];
+    Lanes hi2 = m.R_AtoCi[3] * alpha + m.R_AtoCi[4] * beta + m.R_AtoCi[5] + rho * m.p_AinCi[1];
+    Lanes hi3 = m.R_AtoCi[6] * alpha + m.R_AtoCi[7] * beta + m.R_AtoCi[8] + rho * m.p_AinCi[2];
+    Lanes inv_hi3 = hi3.inverse();
+    Lanes z1 = hi1 * inv_hi3;
+    Lanes z2 = hi2 * inv_hi3;
+
+    // Calculate weighted jacobian and residual (both are zero for padded measurements)
+    Lanes w_hi3 = m.w * inv_hi3;
+    Lanes d_z1_d_alpha = w_hi3 * (m.R_AtoCi[0] - z1 * m.R_AtoCi[6]);
+    Lanes d_z1_d_beta = w_hi3 * (m.R_AtoCi[1] - z1 * m.R_AtoCi[7]);
+    Lanes d_z1_d_rho = w_hi3 * (m.p_AinCi[0] - z1 * m.p_AinCi[2]);
+    Lanes d_z2_d_alpha = w_hi3 * (m.R_AtoCi[3] - z2 * m.R_AtoCi[6]);
+    Lanes d_z2_d_beta = w_hi3 * (m.R_AtoCi[4] - z2 * m.R_AtoCi[7]);
+    Lanes d_z2_d_rho = w_hi3 * (m.p_AinCi[1] - z2 * m.p_AinCi[2]);
+    Lanes res1 = m.w * (m.u - z1);
+    Lanes res2 = m.w * (m.v - z2);
+
+    // Append to our summation variables
+    cost += res1 * res1 + res2 * res2;
+    grad[0] += d_z1_d_alpha * res1 + d_z2_d_alpha * res2;
+    grad[1] += d_z1_d_beta * res1 + d_z2_d_beta * res2;
+    grad[2] += d_z1_d_rho * res1 + d_z2_d_rho * res2;
+    hess[0] += d_z1_d_alpha * d_z1_d_alpha + d_z2_d_alpha * d_z2_d_alpha;
+    hess[1] += d_z1_d_alpha * d_z1_d_beta + d_z2_d_alpha * d_z2_d_beta;
+    hess[2] += d_z1_d_alpha * d_z1_d_rho + d_z2_d_alpha * d_z2_d_rho;
+    hess[3] += d_z1_d_beta * d_z1_d_beta + d_z2_d_beta * d_z2_d_beta;
+    hess[4] += d_z1_d_beta * d_z1_d_rho + d_z2_d_beta * d_z2_d_rho;
+    hess[5] += d_z1_d_rho * d_z1_d_rho + d_z2_d_rho * d_z2_d_rho;
+  }
+}
+
+} // namespace
+
+void FeatureInitializer::batch_triangulation(const std::vector<std::shared_ptr<Feature>> &feats, const ClonePoseTable &clonesCAM,
+                                             std::vector<bool> &success) {
+
+  // Warm start or linear triangulation of each feature, only the ones which succeed are refined
+  success.assign(feats.size(), false);
+  std::vector<size_t> to_refine;
+  for (size_t i = 0; i < feats.size(); i++) {
+    bool success_tri = warm_start(feats.at(i), clonesCAM);
+    if (!success_tri)
+      success_tri = (_options.triangulate_1d) ? single_triangulation_1d(feats.at(i), clonesCAM) : single_triangulation(feats.at(i), clonesCAM);
+    success.at(i) = success_tri;
+    if (success_tri && _options.refine_features)
+      to_refine.push_back(i);
+  }
+
+  // Refine the features in batches, each feature is a lane
+  std::vector<std::vector<size_t>> clone_indices(BATCH_LANES);
+  std::vector<size_t> anchor_idx(BATCH_LANES, 0);
+  std::vector<ClonePose> clones_AinCi;
+  BatchMeasurements meas;
+  for (size_t i0 = 0; i0 < to_refine.size(); i0 += BATCH_LANES) {
+
+    // Start from the linear estimate in inverse depth
+    // Unused lanes are masked out, and have a valid estimate so they do not produce nans
+    size_t num_lanes = std::min((size_t)BATCH_LANES, to_refine.size() - i0);
+    LaneMask active = LaneMask::Constant(false);
+    Lanes alpha = Lanes::Zero(), beta = Lanes::Zero(), rho = Lanes::Ones();
+    meas.clear();
+    for (size_t l = 0; l < num_lanes; l++) {
+      std::shared_ptr<Feature> feat = feats.at(to_refine.at(i0 + l));
+      if (!get_clones_in_anchor(clonesCAM, feat, clone_indices.at(l), anchor_idx.at(l), clones_AinCi)) {
+        success.at(to_refine.at(i0 + l)) = false;
+        continue;
+      }
+      active(l) = true;
+      rho(l) = 1 / feat->p_FinA(2);
+      alpha(l) = feat->p_FinA(0) / feat->p_FinA(2);
+      beta(l) = feat->p_FinA(1) / feat->p_FinA(2);
+
+      // Append the measurements of this lane, padded measurements see the feature in front of the camera
+      if (meas.size() < clones_AinCi.size()) {
+        BatchMeasurement pad;
+        for (int i = 0; i < 9; i++)
+          pad.R_AtoCi[i] = Lanes::Constant((i % 4 == 0) ? 1.0 : 0.0);
+        for (int i = 0; i < 3; i++)
+          pad.p_AinCi[i] = Lanes::Zero();
+        pad.u = Lanes::Zero();
+        pad.v = Lanes::Zero();
+        pad.w = Lanes::Zero();
+        meas.resize(clones_AinCi.size(), pad);
+      }
+      size_t k = 0;
+      for (auto const &pair : feat->uvs_norm) {
+        for (const auto &uv_norm : pair.second) {
+          BatchMeasurement &m = meas.at(k);
+          const ClonePose &clone = clones_AinCi.at(k);
+          for (int i = 0; i < 9; i++)
+            m.R_AtoCi[i](l) = clone.Rot()(i / 3, i % 3);
+          for (int i = 0; i < 3; i++)
+            m.p_AinCi[i](l) = clone.pos()(i);
+          m.u(l) = uv_norm(0);
+          m.v(l) = uv_norm(1);
+          m.w(l) = 1.0;
+          k++;
+        }
+      }
+    }
+
+    // Levenberg-Marquardt with a fixed max number of iterations
+    // Lanes stop once they converged, have done their max runs, or are unstable
+    Lanes lam = Lanes::Constant(_options.init_lamda);
+    Lanes runs = Lanes::Zero();
+    Lanes cost, grad[3], hess[6];
+    Lanes cost_new, grad_new[3], hess_new[6];
+    batch_evaluate(meas, alpha, beta, rho, cost, grad, hess);
+    for (int iter = 0; iter < 2 * _options.max_runs && active.any(); iter++) {
+
+      // Solve Levenberg iteration (closed form inverse of the symmetric 3x3)
+      Lanes h00 = hess[0] * (1.0 + lam), h01 = hess[1], h02 = hess[2];
+      Lanes h11 = hess[3] * (1.0 + lam), h12 = hess[4], h22 = hess[5] * (1.0 + lam);
+      Lanes c00 = h11 * h22 - h12 * h12, c01 = h02 * h12 - h01 * h22, c02 = h01 * h12 - h02 * h11;
+      Lanes c11 = h00 * h22 - h02 * h02, c12 = h01 * h02 - h00 * h12, c22 = h00 * h11 - h01 * h01;
+      Lanes inv_det = (h00 * c00 + h01 * c01 + h02 * c02).inverse();
+      Lanes dx0 = inv_det * (c00 * grad[0] + c01 * grad[1] + c02 * grad[2]);
+      Lanes dx1 = inv_det * (c01 * grad[0] + c11 * grad[1] + c12 * grad[2]);
+      Lanes dx2 = inv_det * (c02 * grad[0] + c12 * grad[1] + c22 * grad[2]);
+
+      // Check if error has gone down (nans are never accepted)
+      batch_evaluate(meas, alpha + dx0, beta + dx1, rho + dx2, cost_new, grad_new, hess_new);
+      LaneMask accept = active && (cost_new <= cost);
+      LaneMask converged = accept && ((cost - cost_new) / cost < _options.min_dcost);
+      Lanes eps = (dx0 * dx0 + dx1 * dx1 + dx2 * dx2).sqrt();
+
+      // If cost is lowered, accept step
+      // Else inflate lambda (try to make more stable)
+      alpha = accept.select(alpha + dx0, alpha);
+      beta = accept.select(beta + dx1, beta);
+      rho = accept.select(rho + dx2, rho);
+      cost = accept.select(cost_new, cost);
+      for (int i = 0; i < 3; i++)
+        grad[i] = accept.select(grad_new[i], grad[i]);
+      for (int i = 0; i < 6; i++)
+        hess[i] = accept.select(hess_new[i], hess[i]);
+      runs = accept.select(runs + 1.0, runs);
+      lam = accept.select(lam / _options.lam_mult, lam * _options.lam_mult);
+      active = active && !converged && !(accept && eps <= _options.min_dx) && (runs < (double)_options.max_runs) && (lam < _options.max_lamda);
+    }
+
+    // Revert to standard, lanes still running continue with the single feature refinement
+    for (size_t l = 0; l < num_lanes; l++) {
+      size_t i = to_refine.at(i0 + l);
+      if (!success.at(i))
+        continue;
+      std::shared_ptr<Feature> feat = feats.at(i);
+      feat->p_FinA(0) = alpha(l) / rho(l);
+      feat->p_FinA(1) = beta(l) / rho(l);
+      feat->p_FinA(2) = 1 / rho(l);
+      success.at(i) = (active(l)) ? single_gaussnewton(feat, clonesCAM) : check_refined(clonesCAM, feat, clone_indices.at(l), anchor_idx.at(l));
+    }
+  }
+}
@@ -22,7 +22,8 @@
 #ifndef OPEN_VINS_FEATUREINITIALIZER_H
 #define OPEN_VINS_FEATUREINITIALIZER_H
 
-#include <unordered_map>
+#include <memory>
+#include <vector>
 
 #include "FeatureInitializerOptions.h"
 
@@ -75,10 +76,64 @@ public:
     }
 
     /// Accessor for rotation
-    const Eigen::Matrix<double, 3, 3> &Rot() { return _Rot; }
+    const Eigen::Matrix<double, 3, 3> &Rot() const { return _Rot; }
 
     /// Accessor for position
-    const Eigen::Matrix<double, 3, 1> &pos() { return _pos; }
+    const Eigen::Matrix<double, 3, 1> &pos() const { return _pos; }
+  };
+
+  /**
+   * @brief Camera poses of all clones stored in one flat array
+   *
+   * This is built once per update for all cameras and clone times.
+   * The triangulation first gets the index of each measurement into this table (see find()).
+   * Afterwards the poses are accessed by index, thus we do not hash timestamps in the optimization loops.
+   */
+  class ClonePoseTable {
+
+  public:
+    /**
+     * @brief Sets the cameras and clone times of this table, all poses are reset to identity
+     * @param cam_ids Ids of the cameras
+     * @param clone_times Timestamps of the clones, these need to be in increasing order
+     */
+    void reset(const std::vector<size_t> &cam_ids, const std::vector<double> &clone_times) {
+      _cam_ids = cam_ids;
+      _clone_times = clone_times;
+      _poses.assign(cam_ids.size() * clone_times.size(), ClonePose());
+    }
+
+    /**
+     * @brief Gets the pose to be set for a camera at a clone
+     * @param cam_idx Index of the camera in the ids given to reset()
+     * @param clone_idx Index of the clone in the times given to reset()
+     */
+    ClonePose &at(size_t cam_idx, size_t clone_idx) { return _poses.at(cam_idx * _clone_times.size() + clone_idx); }
+
+    /// Gets the pose at an index returned by find()
+    const ClonePose &at(size_t idx) const { return _poses.at(idx); }
+
+    /**
+     * @brief Gets the index of the pose of a camera at a clone time
+     * @param cam_id Id of the camera
+     * @param timestamp Timestamp of the clone (needs to match exactly)
+     * @param idx Index of the pose in this table
+     * @return False if we do not have this camera or clone
+     */
+    bool find(size_t cam_id, double timestamp, size_t &idx) const;
+
+    /// Number of poses in this table
+    size_t size() const { return _poses.size(); }
+
+  private:
+    /// Camera ids we have poses for
+    std::vector<size_t> _cam_ids;
+
+    /// Clone timestamps (sorted) we have poses for
+    std::vector<double> _clone_times;
+
+    /// Poses, all clones of the first camera then all clones of the second and so on
+    std::vector<ClonePose> _poses;
   };
 
   /**
@@ -93,11 +148,10 @@ public:
    * The derivations for this method can be found in the @ref featinit-linear documentation page.
    *
    * @param feat Pointer to feature
-   * @param clonesCAM Map between camera ID to map of timestamp to camera pose estimate (rotation from global to camera, position of camera
-   * in global frame)
+   * @param clonesCAM Table of camera pose estimates at each clone (rotation from global to camera, position of camera in global frame)
    * @return Returns false if it fails to triangulate (based on the thresholds)
    */
-  bool single_triangulation(std::shared_ptr<Feature> feat, std::unordered_map<size_t, std::unordered_map<double, ClonePose>> &clonesCAM);
+  bool single_triangulation(std::shared_ptr<Feature> feat, const ClonePoseTable &clonesCAM);
 
   /**
    * @brief Uses a linear triangulation to get initial estimate for the feature, treating the anchor observation as a true bearing.
@@ -106,20 +160,46 @@ public:
    * This function should be used if you want speed, or know your anchor bearing is reasonably accurate.
    *
    * @param feat Pointer to feature
-   * @param clonesCAM Map between camera ID to map of timestamp to camera pose estimate (rotation from global to camera, position of camera
-   * in global frame)
+   * @param clonesCAM Table of camera pose estimates at each clone (rotation from global to camera, position of camera in global frame)
    * @return Returns false if it fails to triangulate (based on the thresholds)
    */
-  bool single_triangulation_1d(std::shared_ptr<Feature> feat, std::unordered_map<size_t, std::unordered_map<double, ClonePose>> &clonesCAM);
+  bool single_triangulation_1d(std::shared_ptr<Feature> feat, const ClonePoseTable &clonesCAM);
+
+  /**
+   * @brief Gets the initial estimate for the refinement from the previous estimate of the feature
+   *
+   * Features that are tracked for a while are often already estimated (e.g. by a previous update or the re-triangulation of the active
+   * tracks). Starting from this estimate we can skip the linear triangulation, and the refinement needs fewer iterations.
+   * Sets the same anchor as single_triangulation(), and then the estimate in the anchor frame.
+   *
+   * @param feat Pointer to feature
+   * @param clonesCAM Table of camera pose estimates at each clone (rotation from global to camera, position of camera in global frame)
+   * @return False if disabled, we have no previous estimate, or it is not in front of the anchor (then we triangulate as normal)
+   */
+  bool warm_start(std::shared_ptr<Feature> feat, const ClonePoseTable &clonesCAM);
 
   /**
    * @brief Uses a nonlinear triangulation to refine initial linear estimate of the feature
    * @param feat Pointer to feature
-   * @param clonesCAM Map between camera ID to map of timestamp to camera pose estimate (rotation from global to camera, position of camera
-   * in global frame)
+   * @param clonesCAM Table of camera pose estimates at each clone (rotation from global to camera, position of camera in global frame)
    * @return Returns false if it fails to be optimize (based on the thresholds)
    */
-  bool single_gaussnewton(std::shared_ptr<Feature> feat, std::unordered_map<size_t, std::unordered_map<double, ClonePose>> &clonesCAM);
+  bool single_gaussnewton(std::shared_ptr<Feature> feat, const ClonePoseTable &clonesCAM);
+
+  /**
+   * @brief Triangulates and refines many features together
+   *
+   * Each feature is first warm started or triangulated on its own (see warm_start(), single_triangulation() and single_triangulation_1d()).
+   * The Levenberg-Marquardt refinement is then done for four features at a time, where each feature is a lane of Eigen arrays.
+   * Thus all lanes run the same iterations (at most 2 * max_runs), and Eigen can vectorize them over the features.
+   * Features which have converged are masked out of the remaining iterations.
+   * If a feature did not converge within these, it is refined further with single_gaussnewton().
+   *
+   * @param feats Features to triangulate
+   * @param clonesCAM Table of camera pose estimates at each clone (rotation from global to camera, position of camera in global frame)
+   * @param success If each feature was successfully triangulated (same order as the features)
+   */
+  void batch_triangulation(const std::vector<std::shared_ptr<Feature>> &feats, const ClonePoseTable &clonesCAM, std::vector<bool> &success);
 
   /**
    * @brief Gets the current configuration of the feature initializer
@@ -131,16 +211,46 @@ protected:
   /// Contains options for the initializer process
   FeatureInitializerOptions _options;
 
+  /**
+   * @brief Helper function that gets the index of the clone pose of each measurement of the feature
+   * @param clonesCAM Table of camera pose estimates
+   * @param feat Pointer to the feature
+   * @param indices Index into the table for each measurement (in the order we loop through the measurements)
+   * @return False if the pose of a measurement is not in the table
+   */
+  static bool find_clones(const ClonePoseTable &clonesCAM, const std::shared_ptr<Feature> &feat, std::vector<size_t> &indices);
+
+  /**
+   * @brief Helper function that gets the pose of the anchor in each measurement camera
+   * @param clonesCAM Table of camera pose estimates
+   * @param feat Pointer to the feature (anchor needs to be set)
+   * @param clone_indices Index into the table for each measurement
+   * @param anchor_idx Index of the anchor pose into the table
+   * @param clones_AinCi Pose of the anchor in each measurement camera (rotation from anchor to camera, position of anchor in camera)
+   * @return False if the pose of a measurement is not in the table
+   */
+  static bool get_clones_in_anchor(const ClonePoseTable &clonesCAM, const std::shared_ptr<Feature> &feat, std::vector<size_t> &clone_indices,
+                                   size_t &anchor_idx, std::vector<ClonePose> &clones_AinCi);
+
+  /**
+   * @brief Helper function that checks a refined feature and then computes its global position
+   * @param clonesCAM Table of camera pose estimates
+   * @param feat Pointer to the feature with its refined anchor position
+   * @param clone_indices Index into the table for each measurement
+   * @param anchor_idx Index of the anchor pose into the table
+   * @return False if the feature is too close, too far, invalid, or has too small of a baseline
+   */
+  bool check_refined(const ClonePoseTable &clonesCAM, std::shared_ptr<Feature> feat, const std::vector<size_t> &clone_indices, size_t anchor_idx);
+
   /**
    * @brief Helper function for the gauss newton method that computes error of the given estimate
-   * @param clonesCAM Map between camera ID to map of timestamp to camera pose estimate
+   * @param clones_AinCi Pose of the anchor in each measurement camera (rotation from anchor to camera, position of anchor in camera)
    * @param feat Pointer to the feature
    * @param alpha x/z in anchor
    * @param beta y/z in anchor
    * @param rho 1/z inverse depth
    */
-  double compute_error(std::unordered_map<size_t, std::unordered_map<double, ClonePose>> &clonesCAM, std::shared_ptr<Feature> feat,
-                       double alpha, double beta, double rho);
+  double compute_error(const std::vector<ClonePose> &clones_AinCi, std::shared_ptr<Feature> feat, double alpha, double beta, double rho);
 };
 
 } // namespace ov_core
@@ -0,0 +1,70 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FeaturePool.h"
+
+#include "Feature.h"
+
+using namespace ov_core;
+
+std::shared_ptr<Feature> FeaturePool::acquire(size_t id) {
+  std::lock_guard<std::mutex> lck(mtx);
+  acquired++;
+
+  // Find a feature only we reference, nobody else can get a reference to it then
+  std::shared_ptr<Feature> feat;
+  for (size_t i = 0; i < released.size(); i++) {
+    if (released.at(i).use_count() == 1) {
+      feat = std::move(released.at(i));
+      released.at(i) = std::move(released.back());
+      released.pop_back();
+      break;
+    }
+  }
+  if (feat == nullptr) {
+    allocations++;
+    feat = std::make_shared<Feature>();
+  }
+
+  // Reset it to a new feature, clearing the measurements keeps the capacity of their arrays
+  feat->featid = id;
+  feat->to_delete = false;
+  feat->uvs.clear();
+  feat->uvs_norm.clear();
+  feat->timestamps.clear();
+  feat->anchor_cam_id = -1;
+  feat->anchor_clone_timestamp = -1;
+  feat->p_FinA.setZero();
+  feat->p_FinG.setZero();
+  feat->has_estimate = false;
+  feat->update_class = 0;
+  feat->update_generation = 0;
+  feat->num_measurements_db = 0;
+  feat->version++;
+  return feat;
+}
+
+void FeaturePool::release(std::shared_ptr<Feature> feat) {
+  std::lock_guard<std::mutex> lck(mtx);
+  if (feat == nullptr || released.size() >= max_features)
+    return;
+  released.push_back(std::move(feat));
+}
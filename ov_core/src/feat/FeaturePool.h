@@ -0,0 +1,93 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_CORE_FEATURE_POOL_H
+#define OV_CORE_FEATURE_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ov_core {
+
+class Feature;
+
+/**
+ * @brief Pool of features which are reused once nobody references them anymore
+ *
+ * The feature database gives the features it removes back to this pool.
+ * A removed feature can still be in use (e.g. by an update), thus it is only handed out again once the pool holds its only reference.
+ * Reused features keep the capacity of their measurement arrays, so after the first few seconds tracking does not allocate new features.
+ */
+class FeaturePool {
+
+public:
+  /**
+   * @brief Default constructor
+   * @param max_features Max number of removed features we hold on to (any more are freed)
+   */
+  explicit FeaturePool(size_t max_features = 10000) : max_features(max_features) {}
+
+  /**
+   * @brief Gets a feature that nobody else is using, allocating one if none is free
+   * @param id ID the feature should have
+   * @return Feature without any measurements
+   */
+  std::shared_ptr<Feature> acquire(size_t id);
+
+  /**
+   * @brief Gives a feature back, it will be reused once all other references to it are gone
+   * @param feat Feature that is no longer part of a database
+   */
+  void release(std::shared_ptr<Feature> feat);
+
+  /// Total number of features we have allocated
+  size_t num_allocations() const { return allocations.load(); }
+
+  /// Total number of features we have handed out
+  size_t num_acquired() const { return acquired.load(); }
+
+  /// Number of removed features we currently hold on to
+  size_t num_released() {
+    std::lock_guard<std::mutex> lck(mtx);
+    return released.size();
+  }
+
+private:
+  /// Mutex for our features
+  std::mutex mtx;
+
+  /// Features given back to us (some could still be referenced by others)
+  std::vector<std::shared_ptr<Feature>> released;
+
+  /// Max number of features we hold on to
+  size_t max_features;
+
+  /// Statistics of how often we had to allocate
+  std::atomic<size_t> allocations{0};
+  std::atomic<size_t> acquired{0};
+};
+
+} // namespace ov_core
+
+#endif // OV_CORE_FEATURE_POOL_H
@@ -0,0 +1,104 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FeatureSnapshot.h"
+
+using namespace ov_core;
+
+void MeasurementLog::sync(const std::vector<double> &timestamps, const std::vector<Eigen::Vector2f> &uvs,
+                          const std::vector<Eigen::Vector2f> &uvs_norm) {
+
+  // Skip our measurements older than the oldest of the feature
+  // The rest should then be the oldest ones of the feature
+  size_t num_old = 0;
+  bool valid = (length > 0 && !timestamps.empty());
+  if (valid) {
+    const MeasurementBlock *block = head.get();
+    size_t slot = offset;
+    size_t num_same = 0;
+    for (size_t i = 0; i < length && valid; i++) {
+      if (slot == MeasurementBlock::CAPACITY) {
+        block = block->next.get();
+        slot = 0;
+      }
+      double time = block->timestamps[slot++];
+      if (num_same == 0 && time < timestamps.at(0)) {
+        num_old++;
+      } else {
+        valid = (num_same < timestamps.size() && time == timestamps.at(num_same));
+        num_same++;
+      }
+    }
+    valid = valid && num_same > 0;
+  }
+
+  // Drop the old ones (or all if they do not match), and append the new ones
+  if (valid) {
+    pop_front(num_old);
+  } else {
+    clear();
+  }
+  for (size_t i = length; i < timestamps.size(); i++) {
+    push_back(timestamps.at(i), uvs.at(i), uvs_norm.at(i));
+  }
+}
+
+void MeasurementLog::clear() {
+  head = nullptr;
+  tail = nullptr;
+  offset = 0;
+  length = 0;
+  tail_size = 0;
+  blocks = 0;
+}
+
+void MeasurementLog::pop_front(size_t num) {
+  if (num >= length) {
+    clear();
+    return;
+  }
+  offset += num;
+  length -= num;
+  while (offset >= MeasurementBlock::CAPACITY) {
+    head = head->next;
+    offset -= MeasurementBlock::CAPACITY;
+    blocks--;
+  }
+}
+
+void MeasurementLog::push_back(double timestamp, const Eigen::Vector2f &uv, const Eigen::Vector2f &uv_norm) {
+  if (tail == nullptr || tail_size == MeasurementBlock::CAPACITY) {
+    auto block = std::make_shared<MeasurementBlock>();
+    if (tail == nullptr) {
+      head = block;
+    } else {
+      tail->next = block;
+    }
+    tail = block.get();
+    tail_size = 0;
+    blocks++;
+  }
+  tail->timestamps[tail_size] = timestamp;
+  tail->uvs[tail_size] = uv;
+  tail->uvs_norm[tail_size] = uv_norm;
+  tail_size++;
+  length++;
+}
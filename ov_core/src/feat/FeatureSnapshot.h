@@ -0,0 +1,308 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_CORE_FEATURE_SNAPSHOT_H
+#define OV_CORE_FEATURE_SNAPSHOT_H
+
+#include <Eigen/Eigen>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace ov_core {
+
+/**
+ * @brief Fixed size block of the measurements of a feature in one camera
+ *
+ * The blocks of a track are linked from old to new.
+ * A slot is only written once, thus a snapshot can keep reading the slots it was given while new ones are appended.
+ */
+struct MeasurementBlock {
+  enum { CAPACITY = 16 };
+  double timestamps[CAPACITY];
+  Eigen::Vector2f uvs[CAPACITY];
+  Eigen::Vector2f uvs_norm[CAPACITY];
+  std::shared_ptr<MeasurementBlock> next;
+};
+
+/// Measurements of a feature in one camera as seen by a snapshot (the first block, where in it we start, and how many we have)
+struct MeasurementTrack {
+  std::shared_ptr<const MeasurementBlock> first;
+  size_t offset = 0;
+  size_t length = 0;
+};
+
+/**
+ * @brief Read-only array of one field (time, raw or normalized uv) of a MeasurementTrack
+ *
+ * This has the read interface of the std::vector it replaces in a snapshot.
+ * It does not own the track, thus it is only valid while the FeatureSnapshot it came from is.
+ */
+template <typename T, T (MeasurementBlock::*Field)[MeasurementBlock::CAPACITY]> class MeasurementSpan {
+
+public:
+  /// Forward iterator over the measurements (only moves to the next block if there is a measurement in it)
+  class const_iterator {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T *pointer;
+    typedef const T &reference;
+
+    const_iterator(const MeasurementBlock *block, size_t slot, size_t index, size_t length)
+        : block(block), slot(slot), index(index), length(length) {}
+    reference operator*() const { return (block->*Field)[slot]; }
+    pointer operator->() const { return &(block->*Field)[slot]; }
+    const_iterator &operator++() {
+      index++;
+      slot++;
+      if (slot == MeasurementBlock::CAPACITY && index < length) {
+        block = block->next.get();
+        slot = 0;
+      }
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+    bool operator==(const const_iterator &other) const { return index == other.index; }
+    bool operator!=(const const_iterator &other) const { return index != other.index; }
+
+  private:
+    const MeasurementBlock *block;
+    size_t slot;
+    size_t index;
+    size_t length;
+  };
+  typedef const_iterator iterator;
+
+  explicit MeasurementSpan(const MeasurementTrack &track) : track(&track) {}
+
+  size_t size() const { return track->length; }
+  bool empty() const { return track->length == 0; }
+
+  const_iterator begin() const { return const_iterator(track->first.get(), track->offset, 0, track->length); }
+  const_iterator end() const { return const_iterator(nullptr, 0, track->length, track->length); }
+
+  /// Measurement at an index (walks the blocks before it)
+  const T &operator[](size_t i) const {
+    const MeasurementBlock *block = track->first.get();
+    size_t slot = track->offset + i;
+    while (slot >= MeasurementBlock::CAPACITY) {
+      block = block->next.get();
+      slot -= MeasurementBlock::CAPACITY;
+    }
+    return (block->*Field)[slot];
+  }
+  const T &at(size_t i) const {
+    if (i >= track->length)
+      throw std::out_of_range("MeasurementSpan::at");
+    return (*this)[i];
+  }
+  const T &front() const { return (*this)[0]; }
+  const T &back() const { return (*this)[track->length - 1]; }
+
+private:
+  const MeasurementTrack *track;
+};
+
+/**
+ * @brief Read-only map of one field of the tracks of a FeatureSnapshot (mapped by camera ID)
+ *
+ * This has the read interface of the CameraMap it replaces in a snapshot (iterating gives pairs of camera ID and measurements).
+ */
+template <typename T, T (MeasurementBlock::*Field)[MeasurementBlock::CAPACITY]> class SnapshotCameraMap {
+
+public:
+  typedef MeasurementSpan<T, Field> span_type;
+  typedef std::pair<size_t, span_type> value_type;
+  typedef std::vector<std::pair<size_t, MeasurementTrack>> Tracks;
+
+  /// Iterator over the cameras (dereferencing gives a pair by value)
+  class const_iterator {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef std::pair<size_t, span_type> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type *pointer;
+    typedef value_type reference;
+
+    explicit const_iterator(typename Tracks::const_iterator it) : it(it) {}
+    value_type operator*() const { return value_type(it->first, span_type(it->second)); }
+    const_iterator &operator++() {
+      ++it;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator tmp = *this;
+      ++it;
+      return tmp;
+    }
+    bool operator==(const const_iterator &other) const { return it == other.it; }
+    bool operator!=(const const_iterator &other) const { return it != other.it; }
+
+  private:
+    typename Tracks::const_iterator it;
+  };
+  typedef const_iterator iterator;
+
+  explicit SnapshotCameraMap(const Tracks *tracks) : tracks(tracks) {}
+
+  const_iterator begin() const { return const_iterator(tracks->begin()); }
+  const_iterator end() const { return const_iterator(tracks->end()); }
+
+  /// Number of cameras
+  size_t size() const { return tracks->size(); }
+  bool empty() const { return tracks->empty(); }
+
+  /// Finds the measurements of a camera, end() if it has none
+  const_iterator find(size_t cam_id) const {
+    for (auto it = tracks->begin(); it != tracks->end(); ++it) {
+      if (it->first == cam_id)
+        return const_iterator(it);
+    }
+    return end();
+  }
+  size_t count(size_t cam_id) const { return (find(cam_id) != end()) ? 1 : 0; }
+
+  /// Measurements of a camera, throws std::out_of_range if it has none
+  span_type at(size_t cam_id) const {
+    for (const auto &track : *tracks) {
+      if (track.first == cam_id)
+        return span_type(track.second);
+    }
+    throw std::out_of_range("SnapshotCameraMap::at");
+  }
+
+private:
+  const Tracks *tracks;
+};
+
+/**
+ * @brief Read-only feature given out in a FeatureDatabase snapshot
+ *
+ * This has the same measurement members as the Feature it was taken from, but they refer to immutable measurement blocks.
+ * The blocks are shared with the database and other snapshots, thus taking a snapshot of a feature only copies the pointers and lengths
+ * of its tracks. It can not be copied itself (its members refer to its own tracks), it is given out through a shared pointer.
+ */
+class FeatureSnapshot {
+
+public:
+  typedef std::vector<std::pair<size_t, MeasurementTrack>> Tracks;
+
+  FeatureSnapshot(size_t featid, bool to_delete, Tracks tracks_)
+      : featid(featid), to_delete(to_delete), uvs(&tracks), uvs_norm(&tracks), timestamps(&tracks), tracks(std::move(tracks_)) {}
+  FeatureSnapshot(const FeatureSnapshot &) = delete;
+  FeatureSnapshot &operator=(const FeatureSnapshot &) = delete;
+
+  /// Unique ID of this feature
+  const size_t featid;
+
+  /// If this feature should be deleted
+  const bool to_delete;
+
+  /// UV coordinates that this feature has been seen from (mapped by camera ID)
+  const SnapshotCameraMap<Eigen::Vector2f, &MeasurementBlock::uvs> uvs;
+
+  /// UV normalized coordinates that this feature has been seen from (mapped by camera ID)
+  const SnapshotCameraMap<Eigen::Vector2f, &MeasurementBlock::uvs_norm> uvs_norm;
+
+  /// Timestamps of each UV measurement (mapped by camera ID)
+  const SnapshotCameraMap<double, &MeasurementBlock::timestamps> timestamps;
+
+private:
+  /// Track of each camera, sorted by camera ID
+  const Tracks tracks;
+};
+
+/**
+ * @brief Measurements of a feature in one camera that the FeatureDatabase keeps for its snapshots
+ *
+ * Measurements are only appended to the newest block and removed from the front, thus the blocks a snapshot was given never change.
+ * Blocks whose measurements have all been removed are dropped (they stay alive as long as a snapshot still refers to them).
+ */
+class MeasurementLog {
+
+public:
+  /// Two logs can not share a newest block, thus we can only be moved
+  MeasurementLog() = default;
+  MeasurementLog(const MeasurementLog &) = delete;
+  MeasurementLog &operator=(const MeasurementLog &) = delete;
+  MeasurementLog(MeasurementLog &&) = default;
+  MeasurementLog &operator=(MeasurementLog &&) = default;
+
+  /// Number of measurements
+  size_t size() const { return length; }
+
+  /// Number of blocks we hold
+  size_t num_blocks() const { return blocks; }
+
+  /// Track of our current measurements to give out in a snapshot
+  MeasurementTrack track() const {
+    MeasurementTrack track;
+    track.first = head;
+    track.offset = offset;
+    track.length = length;
+    return track;
+  }
+
+  /**
+   * @brief Makes our measurements equal to the ones of a feature in this camera, reusing what we already have
+   *
+   * The database only removes the oldest measurements of a track and appends new ones (e.g. clean_older_measurements()).
+   * If our measurements that are still in the feature are the same as its oldest ones, we drop the older ones and append the rest.
+   * Otherwise (e.g. a measurement in the middle was removed) we copy all of them into new blocks.
+   *
+   * @param timestamps Timestamps of the feature in this camera
+   * @param uvs Raw uv measurements of the feature in this camera
+   * @param uvs_norm Normalized uv measurements of the feature in this camera
+   */
+  void sync(const std::vector<double> &timestamps, const std::vector<Eigen::Vector2f> &uvs, const std::vector<Eigen::Vector2f> &uvs_norm);
+
+private:
+  /// Removes all measurements and blocks
+  void clear();
+
+  /// Removes our oldest measurements (and the blocks that become empty)
+  void pop_front(size_t num);
+
+  /// Appends a measurement, starting a new block if the newest is full
+  void push_back(double timestamp, const Eigen::Vector2f &uv, const Eigen::Vector2f &uv_norm);
+
+  /// Oldest block we use, and the newest one we append to
+  std::shared_ptr<MeasurementBlock> head;
+  MeasurementBlock *tail = nullptr;
+
+  /// Index of our oldest measurement in the head, number of measurements, number of used slots of the tail, and number of blocks
+  size_t offset = 0;
+  size_t length = 0;
+  size_t tail_size = 0;
+  size_t blocks = 0;
+};
+
+} // namespace ov_core
+
+#endif /* OV_CORE_FEATURE_SNAPSHOT_H */
@@ -0,0 +1,184 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "LandmarkMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "cam/CamBase.h"
+
+using namespace ov_core;
+
+void LandmarkMap::update_landmark(size_t id, const Eigen::Vector3d &p_FinG, double sigma, double timestamp) {
+  std::lock_guard<std::mutex> lck(mtx);
+
+  // Move the landmark to its new voxel (if it changed)
+  auto it = landmarks.find(id);
+  if (it == landmarks.end()) {
+    it = landmarks.emplace(id, Landmark()).first;
+    it->second.id = id;
+  } else {
+    Eigen::Vector3i voxel_old = (it->second.p_FinG / voxel_size).array().floor().cast<int>();
+    Eigen::Vector3i voxel_new = (p_FinG / voxel_size).array().floor().cast<int>();
+    if (voxel_old == voxel_new) {
+      it->second.p_FinG = p_FinG;
+      it->second.sigma = sigma;
+      it->second.timestamp = timestamp;
+      return;
+    }
+    remove_from_voxel(it->second);
+  }
+  it->second.p_FinG = p_FinG;
+  it->second.sigma = sigma;
+  it->second.timestamp = timestamp;
+  Eigen::Vector3i voxel = (p_FinG / voxel_size).array().floor().cast<int>();
+  voxels[voxel_key(voxel(0), voxel(1), voxel(2))].push_back(id);
+
+  // If we have too many, remove the ones which were estimated the longest time ago
+  // We remove 10% at once so we do not need to sort on every new landmark
+  if (landmarks.size() <= max_landmarks)
+    return;
+  std::vector<std::pair<double, size_t>> times;
+  times.reserve(landmarks.size());
+  for (const auto &landmark : landmarks)
+    times.emplace_back(landmark.second.timestamp, landmark.first);
+  size_t num_remove = landmarks.size() - (size_t)(0.9 * (double)max_landmarks);
+  std::nth_element(times.begin(), times.begin() + (num_remove - 1), times.end());
+  for (size_t i = 0; i < num_remove; i++) {
+    auto it_rm = landmarks.find(times.at(i).second);
+    remove_from_voxel(it_rm->second);
+    landmarks.erase(it_rm);
+  }
+}
+
+void LandmarkMap::update_descriptors(const std::vector<size_t> &ids, const cv::Mat &desc) {
+  std::lock_guard<std::mutex> lck(mtx);
+  for (size_t i = 0; i < ids.size() && (int)i < desc.rows; i++) {
+    auto it = landmarks.find(ids.at(i));
+    if (it == landmarks.end())
+      continue;
+    desc.row((int)i).copyTo(it->second.descriptor);
+  }
+}
+
+bool LandmarkMap::get_landmark(size_t id, Landmark &landmark) {
+  std::lock_guard<std::mutex> lck(mtx);
+  auto it = landmarks.find(id);
+  if (it == landmarks.end())
+    return false;
+  landmark = it->second;
+  return true;
+}
+
+void LandmarkMap::get_in_frustum(const Eigen::Matrix3d &R_GtoC, const Eigen::Vector3d &p_CinG, const std::shared_ptr<CamBase> &camera,
+                                 double max_dist, std::vector<Visible> &visible) {
+  visible.clear();
+
+  // Bounding box of the frustum, which contains the camera center and the rays along the image border at the max depth
+  // We use the corners and the middle of the edges since distortion can bend the border outwards
+  int width = camera->w();
+  int height = camera->h();
+  Eigen::Vector3d box_min = p_CinG;
+  Eigen::Vector3d box_max = p_CinG;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      if (i == 1 && j == 1)
+        continue;
+      Eigen::Vector2d uv_norm = camera->undistort_d(Eigen::Vector2d(0.5 * i * width, 0.5 * j * height));
+      Eigen::Vector3d p_inG = p_CinG + R_GtoC.transpose() * (max_dist * Eigen::Vector3d(uv_norm(0), uv_norm(1), 1.0));
+      box_min = box_min.cwiseMin(p_inG);
+      box_max = box_max.cwiseMax(p_inG);
+    }
+  }
+  Eigen::Vector3i voxel_min = (box_min / voxel_size).array().floor().cast<int>();
+  Eigen::Vector3i voxel_max = (box_max / voxel_size).array().floor().cast<int>();
+
+  // Project a landmark into the image, and record it if it is in front of the camera and inside the image
+  auto check_landmark = [&](const Landmark &landmark) {
+    if (landmark.descriptor.empty())
+      return;
+    Eigen::Vector3d p_FinC = R_GtoC * (landmark.p_FinG - p_CinG);
+    if (p_FinC(2) <= 0 || p_FinC(2) > max_dist)
+      return;
+    Eigen::Vector2d uv_dist = camera->distort_d(p_FinC.head(2) / p_FinC(2));
+    if (uv_dist(0) < 0 || uv_dist(0) >= width || uv_dist(1) < 0 || uv_dist(1) >= height)
+      return;
+    Visible vis;
+    vis.id = landmark.id;
+    vis.uv = cv::Point2f((float)uv_dist(0), (float)uv_dist(1));
+    vis.descriptor = landmark.descriptor;
+    visible.push_back(vis);
+  };
+
+  // Go through the voxels of the box, or through all occupied voxels if there are fewer of those
+  std::lock_guard<std::mutex> lck(mtx);
+  Eigen::Vector3d num_box = (voxel_max - voxel_min).cast<double>().array() + 1.0;
+  if (num_box.prod() > (double)voxels.size()) {
+    for (const auto &voxel : voxels) {
+      for (const auto &id : voxel.second)
+        check_landmark(landmarks.at(id));
+    }
+    return;
+  }
+  for (int x = voxel_min(0); x <= voxel_max(0); x++) {
+    for (int y = voxel_min(1); y <= voxel_max(1); y++) {
+      for (int z = voxel_min(2); z <= voxel_max(2); z++) {
+        auto it = voxels.find(voxel_key(x, y, z));
+        if (it == voxels.end())
+          continue;
+        for (const auto &id : it->second)
+          check_landmark(landmarks.at(id));
+      }
+    }
+  }
+}
+
+void LandmarkMap::set_visible(size_t cam_id, const std::vector<Visible> &visible) {
+  std::lock_guard<std::mutex> lck(mtx);
+  visible_cams[cam_id] = visible;
+}
+
+void LandmarkMap::get_visible(size_t cam_id, std::vector<Visible> &visible) {
+  std::lock_guard<std::mutex> lck(mtx);
+  auto it = visible_cams.find(cam_id);
+  if (it == visible_cams.end()) {
+    visible.clear();
+    return;
+  }
+  visible = it->second;
+}
+
+int64_t LandmarkMap::voxel_key(int x, int y, int z) const {
+  // Each coordinate gets 21 bits, which is plenty for any reasonable voxel size
+  const int64_t mask = (1 << 21) - 1;
+  return (((int64_t)x & mask) << 42) | (((int64_t)y & mask) << 21) | ((int64_t)z & mask);
+}
+
+void LandmarkMap::remove_from_voxel(const Landmark &landmark) {
+  Eigen::Vector3i voxel = (landmark.p_FinG / voxel_size).array().floor().cast<int>();
+  auto it = voxels.find(voxel_key(voxel(0), voxel(1), voxel(2)));
+  if (it == voxels.end())
+    return;
+  it->second.erase(std::remove(it->second.begin(), it->second.end(), landmark.id), it->second.end());
+  if (it->second.empty())
+    voxels.erase(it);
+}
@@ -0,0 +1,173 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_CORE_LANDMARK_MAP_H
+#define OV_CORE_LANDMARK_MAP_H
+
+#include <Eigen/Eigen>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace ov_core {
+
+class CamBase;
+
+/**
+ * @brief Long-term map of landmarks which we keep after they leave the state
+ *
+ * The estimator records its SLAM landmarks here, and keeps them after they have been marginalized.
+ * The descriptor tracker stores the last descriptor of each tracked landmark.
+ * Landmarks are indexed by the voxel they are in, thus we can quickly get the ones in the view frustum of a camera.
+ * Once a landmark is predicted to be seen again, the tracker can give a matching new feature the id of the landmark.
+ * If we have more than the max number of landmarks, the ones which were estimated the longest time ago are removed.
+ */
+class LandmarkMap {
+
+public:
+  /// Landmark of our map
+  struct Landmark {
+
+    /// Id of the landmark (same as the feature it was estimated from)
+    size_t id = 0;
+
+    /// Last estimate of the position in the global frame
+    Eigen::Vector3d p_FinG = Eigen::Vector3d::Zero();
+
+    /// Standard deviation of the position estimate (square root of the mean variance of the landmark state)
+    /// A re-identified feature only warm starts its triangulation from estimates with a small enough sigma
+    double sigma = -1;
+
+    /// Last descriptor the tracker has seen this landmark with (empty if none)
+    cv::Mat descriptor;
+
+    /// Time of the last estimate
+    double timestamp = -1;
+  };
+
+  /// Landmark predicted to be seen by a camera
+  struct Visible {
+
+    /// Id of the landmark
+    size_t id = 0;
+
+    /// Predicted (distorted) pixel coordinate
+    cv::Point2f uv;
+
+    /// Descriptor of the landmark
+    cv::Mat descriptor;
+  };
+
+  /**
+   * @brief Default constructor
+   * @param voxel_size Side length of the voxels we index the landmarks in (meters)
+   * @param max_landmarks Max number of landmarks we keep
+   */
+  LandmarkMap(double voxel_size = 1.0, size_t max_landmarks = 10000) : voxel_size(voxel_size), max_landmarks(max_landmarks) {}
+
+  /**
+   * @brief Adds a landmark or updates its estimate
+   * @param id Id of the landmark
+   * @param p_FinG Position in the global frame
+   * @param sigma Standard deviation of the position
+   * @param timestamp Time of this estimate
+   */
+  void update_landmark(size_t id, const Eigen::Vector3d &p_FinG, double sigma, double timestamp);
+
+  /**
+   * @brief Stores the descriptors of the tracked features which are landmarks of our map (others are skipped)
+   * @param ids Ids of the tracked features
+   * @param desc Descriptors of the tracked features (one row for each)
+   */
+  void update_descriptors(const std::vector<size_t> &ids, const cv::Mat &desc);
+
+  /**
+   * @brief Gets a landmark
+   * @param id Id of the landmark
+   * @param landmark Copy of the landmark
+   * @return False if we do not have this landmark
+   */
+  bool get_landmark(size_t id, Landmark &landmark);
+
+  /**
+   * @brief Gets the landmarks with a descriptor in the view frustum of a camera
+   * @param R_GtoC Rotation from global to camera
+   * @param p_CinG Position of the camera in global
+   * @param camera Camera model used to project the landmarks
+   * @param max_dist Max depth of landmarks
+   * @param visible Landmarks which project into the image
+   */
+  void get_in_frustum(const Eigen::Matrix3d &R_GtoC, const Eigen::Vector3d &p_CinG, const std::shared_ptr<CamBase> &camera, double max_dist,
+                      std::vector<Visible> &visible);
+
+  /**
+   * @brief Sets the landmarks the next image of a camera is predicted to see (i.e. from get_in_frustum())
+   * @param cam_id Id of the camera
+   * @param visible Predicted landmarks
+   */
+  void set_visible(size_t cam_id, const std::vector<Visible> &visible);
+
+  /**
+   * @brief Gets the landmarks the next image of a camera is predicted to see (see set_visible())
+   * @param cam_id Id of the camera
+   * @param visible Predicted landmarks
+   */
+  void get_visible(size_t cam_id, std::vector<Visible> &visible);
+
+  /// Number of landmarks in our map
+  size_t size() {
+    std::lock_guard<std::mutex> lck(mtx);
+    return landmarks.size();
+  }
+
+private:
+  /// Key of the voxel a position is in
+  int64_t voxel_key(int x, int y, int z) const;
+
+  /// Removes the landmark from the ids of its voxel
+  void remove_from_voxel(const Landmark &landmark);
+
+  /// Mutex for our map
+  std::mutex mtx;
+
+  /// Side length of a voxel
+  double voxel_size;
+
+  /// Max number of landmarks we keep
+  size_t max_landmarks;
+
+  /// Landmarks by their id
+  std::unordered_map<size_t, Landmark> landmarks;
+
+  /// Ids of the landmarks in each voxel
+  std::unordered_map<int64_t, std::vector<size_t>> voxels;
+
+  /// Landmarks predicted to be seen by each camera
+  std::unordered_map<size_t, std::vector<Visible>> visible_cams;
+};
+
+} // namespace ov_core
+
+#endif // OV_CORE_LANDMARK_MAP_H
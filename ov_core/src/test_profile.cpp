@@ -19,6 +19,7 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cmath>
 #include <sstream>
 #include <unistd.h>
@@ -31,6 +32,14 @@
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include "cam/CamRadtan.h"
+#include "feat/Feature.h"
+#include "feat/FeatureDatabase.h"
+#include "feat/FeatureInitializer.h"
+#include "feat/FeaturePool.h"
+#include "feat/LandmarkMap.h"
+#include "utils/colors.h"
+#include "utils/opencv_lambda_body.h"
 #include "utils/print.h"
 
 // Define the function to be called when ctrl-c (SIGINT) is sent to process
@@ -94,6 +103,9 @@ int main(int argc, char **argv) {
   std::vector<double> times_ms;
   std::vector<int> extra_stats;
 
+  // If one of our consistency checks failed (we still run all benchmarks, but will return a failure)
+  bool checks_passed = true;
+
   // OPENCV: RANDOM BIG IMAGE
   times_ms.clear();
   for (int i = 0; i < num_trials; i++) {
@@ -327,6 +339,448 @@ int main(int argc, char **argv) {
   }
   print_stats("EIGEN3(float): HOUSEHOLDER QR CUSTOM", times_ms);
 
+  //=====================================================================================
+  //=====================================================================================
+  //=====================================================================================
+
+  // FEATURE DATABASE: MEASUREMENT INSERTION
+  // Each measurement is appended to the per camera arrays of its feature, thus this should not allocate per measurement
+  std::vector<int> cam_ids = {0, 1};
+  int num_clones = 11;
+  for (int num_feats : {250, 1000, 4000}) {
+    times_ms.clear();
+    extra_stats.clear();
+    for (int i = 0; i < num_trials; i++) {
+      ov_core::FeatureDatabase database;
+      auto rT1 = boost::posix_time::microsec_clock::local_time();
+      for (int k = 0; k < num_clones; k++) {
+        for (int id = 0; id < num_feats; id++) {
+          for (const auto &cam_id : cam_ids) {
+            database.update_feature(id, (double)k, cam_id, 0.0f, 0.0f, 0.0f, 0.0f);
+          }
+        }
+      }
+      auto rT2 = boost::posix_time::microsec_clock::local_time();
+      times_ms.push_back((rT2 - rT1).total_microseconds() * 1e-3);
+      extra_stats.push_back((int)database.size());
+    }
+    print_stats("FEATURE DATABASE: INSERT (" + std::to_string(num_feats) + " feats x " + std::to_string(num_clones) + " frames)", times_ms,
+                "feats", extra_stats);
+  }
+
+  // FEATURE DATABASE: PARALLEL CAMERA INSERTION
+  // Four cameras are tracked in parallel (as the trackers do with cv::parallel_for_), each inserting its tracks of a frame into one database
+  // The tracks are inserted one by one or as a single batch per camera, and the cameras run one after the other or in parallel
+  // All cameras take the same database lock, thus the time lost to contention is how much slower parallel is than one after the other
+  int num_parallel_cams = 4;
+  int num_tracks_per_cam = 250;
+  for (bool batched : {false, true}) {
+    std::vector<size_t> num_meas_mode;
+    for (bool parallel : {false, true}) {
+      ov_core::FeatureDatabase database;
+      times_ms.clear();
+      for (int k = 0; k < num_trials; k++) {
+        auto insert_camera = [&](int cam_id) {
+          std::vector<size_t> ids;
+          std::vector<Eigen::Vector2f> uvs;
+          for (int i = 0; i < num_tracks_per_cam; i++) {
+            ids.push_back((size_t)(cam_id * num_tracks_per_cam + i));
+            uvs.emplace_back((float)i, (float)k);
+          }
+          if (batched) {
+            database.update_features((double)k, cam_id, ids, uvs, uvs);
+          } else {
+            for (size_t i = 0; i < ids.size(); i++)
+              database.update_feature(ids.at(i), (double)k, cam_id, uvs.at(i)(0), uvs.at(i)(1), uvs.at(i)(0), uvs.at(i)(1));
+          }
+        };
+        auto rT1 = boost::posix_time::microsec_clock::local_time();
+        if (parallel) {
+          cv::parallel_for_(cv::Range(0, num_parallel_cams), ov_core::LambdaBody([&](const cv::Range &range) {
+                              for (int cam_id = range.start; cam_id < range.end; cam_id++)
+                                insert_camera(cam_id);
+                            }));
+        } else {
+          for (int cam_id = 0; cam_id < num_parallel_cams; cam_id++)
+            insert_camera(cam_id);
+        }
+        auto rT2 = boost::posix_time::microsec_clock::local_time();
+        times_ms.push_back((rT2 - rT1).total_microseconds() * 1e-3);
+        database.cleanup_measurements((double)(k - num_clones));
+      }
+      num_meas_mode.push_back(database.get_usage().num_measurements);
+      print_stats(std::string("FEATURE DATABASE: ") + (batched ? "BATCHED" : "PER TRACK") + " INSERT, " + (parallel ? "PARALLEL" : "SEQUENTIAL") +
+                      " (" + std::to_string(num_parallel_cams) + " cams x " + std::to_string(num_tracks_per_cam) + " tracks)",
+                  times_ms);
+    }
+    if (num_meas_mode.at(0) != num_meas_mode.at(1)) {
+      PRINT_ERROR(RED "FEATURE DATABASE: parallel insertion kept %zu measurements instead of %zu\n" RESET, num_meas_mode.at(1),
+                  num_meas_mode.at(0));
+      checks_passed = false;
+    }
+  }
+
+  // FEATURE DATABASE: READ-ONLY COPIES
+  // Compare copying all features (as the initializers did) to a snapshot, where all tracks got a new measurement and lost their oldest one
+  for (bool snapshot : {false, true}) {
+    ov_core::FeatureDatabase database;
+    for (int k = 0; k < num_clones; k++) {
+      for (int id = 0; id < 1000; id++) {
+        database.update_feature(id, (double)k, 0, 0.0f, 0.0f, 0.0f, 0.0f);
+      }
+    }
+    database.get_snapshot();
+    times_ms.clear();
+    for (int i = 0; i < num_trials; i++) {
+      for (int id = 0; id < 1000; id++) {
+        database.update_feature(id, (double)(num_clones + i), 0, 0.0f, 0.0f, 0.0f, 0.0f);
+      }
+      database.cleanup_measurements((double)(i + 1));
+      auto rT1 = boost::posix_time::microsec_clock::local_time();
+      if (snapshot) {
+        std::shared_ptr<const ov_core::FeatureDatabase::Snapshot> features = database.get_snapshot();
+      } else {
+        std::unordered_map<size_t, std::shared_ptr<ov_core::Feature>> features;
+        for (const auto &feat : database.get_internal_data()) {
+          features.insert({feat.first, std::make_shared<ov_core::Feature>(*feat.second)});
+        }
+      }
+      auto rT2 = boost::posix_time::microsec_clock::local_time();
+      times_ms.push_back((rT2 - rT1).total_microseconds() * 1e-3);
+    }
+    print_stats(std::string("FEATURE DATABASE: ") + (snapshot ? "SNAPSHOT" : "DEEP COPY") + " (1000 feats, all changed)", times_ms);
+  }
+
+  // FEATURE DATABASE: UPDATE CLASSIFICATION
+  // Compare getting the lost and marg features separately and filtering them against each other, to a single classification pass
+  // We simulate a stereo sliding window of 11 clones, where each feature is tracked over a random part of the window
+  for (int num_feats : {250, 1000, 4000}) {
+    ov_core::FeatureDatabase database;
+    std::srand(0);
+    for (int id = 0; id < num_feats; id++) {
+      int start = std::rand() % num_clones;
+      int end = start + std::rand() % (num_clones - start);
+      for (int k = start; k <= end; k++) {
+        for (const auto &cam_id : cam_ids) {
+          database.update_feature(id, (double)k, cam_id, 0.0f, 0.0f, 0.0f, 0.0f);
+        }
+      }
+    }
+    double time_newest = (double)(num_clones - 1);
+    double time_marg = 0.0;
+
+    // Separate queries then filtering
+    times_ms.clear();
+    extra_stats.clear();
+    for (int i = 0; i < num_trials; i++) {
+      auto rT1 = boost::posix_time::microsec_clock::local_time();
+      std::vector<std::shared_ptr<ov_core::Feature>> feats_lost = database.features_not_containing_newer(time_newest, false, true);
+      std::vector<std::shared_ptr<ov_core::Feature>> feats_marg = database.features_containing(time_marg, false, true);
+      auto it1 = feats_lost.begin();
+      while (it1 != feats_lost.end()) {
+        bool found_current_message_camid = false;
+        for (const auto &camuvpair : (*it1)->uvs) {
+          if (std::find(cam_ids.begin(), cam_ids.end(), camuvpair.first) != cam_ids.end()) {
+            found_current_message_camid = true;
+            break;
+          }
+        }
+        bool in_marg = (std::find(feats_marg.begin(), feats_marg.end(), (*it1)) != feats_marg.end());
+        if (found_current_message_camid && !in_marg) {
+          it1++;
+        } else {
+          it1 = feats_lost.erase(it1);
+        }
+      }
+      auto rT2 = boost::posix_time::microsec_clock::local_time();
+      times_ms.push_back((rT2 - rT1).total_microseconds() * 1e-3);
+      extra_stats.push_back((int)(feats_lost.size() + feats_marg.size()));
+    }
+    print_stats("FEATURE DATABASE: SEPARATE QUERIES (" + std::to_string(num_feats) + " feats)", times_ms, "classified", extra_stats);
+
+    // Single classification pass
+    times_ms.clear();
+    extra_stats.clear();
+    for (int i = 0; i < num_trials; i++) {
+      auto rT1 = boost::posix_time::microsec_clock::local_time();
+      std::vector<std::shared_ptr<ov_core::Feature>> feats_lost, feats_marg, feats_maxtracks;
+      database.classify_for_update(time_newest, time_marg, cam_ids, num_clones, feats_lost, feats_marg, feats_maxtracks);
+      auto rT2 = boost::posix_time::microsec_clock::local_time();
+      times_ms.push_back((rT2 - rT1).total_microseconds() * 1e-3);
+      extra_stats.push_back((int)(feats_lost.size() + feats_marg.size() + feats_maxtracks.size()));
+    }
+    print_stats("FEATURE DATABASE: SINGLE CLASSIFICATION (" + std::to_string(num_feats) + " feats)", times_ms, "classified", extra_stats);
+  }
+
+  // FEATURE DATABASE: TIME WINDOW QUERIES
+  // Simulate a sliding window where each frame some of the tracks are lost and replaced by new ones
+  // Each frame we get the lost and marg features, then remove the marg time (the cost should follow the returned features, not the database size)
+  for (int num_tracks : {200, 1000, 5000}) {
+    ov_core::FeatureDatabase database;
+    std::srand(0);
+    std::vector<size_t> tracks;
+    size_t id_next = 0;
+    times_ms.clear();
+    extra_stats.clear();
+    for (int k = 0; k < num_trials + num_clones; k++) {
+      std::vector<size_t> tracks_kept;
+      for (const auto &id : tracks) {
+        if (std::rand() % 10 != 0)
+          tracks_kept.push_back(id);
+      }
+      tracks = tracks_kept;
+      while ((int)tracks.size() < num_tracks)
+        tracks.push_back(id_next++);
+      for (const auto &id : tracks) {
+        for (const auto &cam_id : cam_ids) {
+          database.update_feature(id, (double)k, cam_id, 0.0f, 0.0f, 0.0f, 0.0f);
+        }
+      }
+      if (k < num_clones)
+        continue;
+      double time_marg = (double)(k - num_clones);
+      auto rT1 = boost::posix_time::microsec_clock::local_time();
+      std::vector<std::shared_ptr<ov_core::Feature>> feats_lost = database.features_not_containing_newer((double)k, false, true);
+      std::vector<std::shared_ptr<ov_core::Feature>> feats_marg = database.features_containing(time_marg, false, true);
+      for (const auto &feat : feats_lost)
+        feat->to_delete = true;
+      database.cleanup();
+      database.cleanup_measurements(time_marg + 1.0);
+      auto rT2 = boost::posix_time::microsec_clock::local_time();
+      times_ms.push_back((rT2 - rT1).total_microseconds() * 1e-3);
+      extra_stats.push_back((int)(feats_lost.size() + feats_marg.size()));
+    }
+    print_stats("FEATURE DATABASE: TIME WINDOW (" + std::to_string(num_tracks) + " tracks)", times_ms, "returned", extra_stats);
+    PRINT_INFO("FEATURE DATABASE: TIME WINDOW (%d tracks): %zu features allocated for %zu tracks\n", num_tracks,
+               database.get_feature_pool()->num_allocations(), database.get_feature_pool()->num_acquired());
+  }
+
+  // FEATURE DATABASE: MEMORY LIMITS
+  // Simulate waiting to initialize on a textured scene without motion, thus tracks are never lost and measurements are never cleaned up
+  // Without limits the database grows every frame, with them it should stay at its limit and evict the configured tracks
+  for (int max_measurements : {0, 100000}) {
+    ov_core::FeatureDatabase database;
+    ov_core::FeatureDatabase::Limits limits;
+    limits.max_measurements = (size_t)max_measurements;
+    database.set_limits(limits);
+    std::srand(0);
+    std::vector<size_t> tracks;
+    size_t id_next = 0;
+    times_ms.clear();
+    extra_stats.clear();
+    for (int k = 0; k < 5 * num_trials; k++) {
+      std::vector<size_t> tracks_kept;
+      for (const auto &id : tracks) {
+        if (std::rand() % 100 != 0)
+          tracks_kept.push_back(id);
+      }
+      tracks = tracks_kept;
+      while ((int)tracks.size() < max_features)
+        tracks.push_back(id_next++);
+      std::vector<Eigen::Vector2f> uvs(tracks.size(), Eigen::Vector2f::Zero());
+      auto rT1 = boost::posix_time::microsec_clock::local_time();
+      for (const auto &cam_id : cam_ids)
+        database.update_features((double)k, (size_t)cam_id, tracks, uvs, uvs);
+      auto rT2 = boost::posix_time::microsec_clock::local_time();
+      times_ms.push_back((rT2 - rT1).total_microseconds() * 1e-3);
+      extra_stats.push_back((int)database.size());
+    }
+    ov_core::FeatureDatabase::Usage usage = database.get_usage();
+    std::string title = "FEATURE DATABASE: MEMORY LIMITS (" + std::to_string(max_measurements) + " max measurements)";
+    print_stats(title, times_ms, "tracks", extra_stats);
+    PRINT_INFO("%s: %zu tracks, %zu measurements, %.2f MB, %zu tracks evicted\n", title.c_str(), usage.num_features, usage.num_measurements,
+               1e-6 * (double)usage.bytes, usage.num_evicted_features);
+  }
+
+  // FEATURE DATABASE: ACCOUNTING
+  // Tracks are lost, evicted, cleaned up and read through snapshots under both eviction policies
+  // We recount the measurements from the features and the snapshots, and these should match what the database accounted for
+  for (auto policy : {ov_core::FeatureDatabase::EVICT_OLDEST, ov_core::FeatureDatabase::EVICT_SHORTEST}) {
+    ov_core::FeatureDatabase database;
+    ov_core::FeatureDatabase::Limits limits;
+    limits.max_features = 2000;
+    limits.max_measurements = 20000;
+    limits.policy = policy;
+    database.set_limits(limits);
+    std::srand(0);
+    std::vector<size_t> tracks;
+    size_t id_next = 0;
+    int num_mismatched = 0;
+    size_t num_evicted = 0;
+    for (int k = 0; k < 5 * num_trials; k++) {
+      std::vector<size_t> tracks_kept;
+      for (const auto &id : tracks) {
+        if (std::rand() % 20 != 0)
+          tracks_kept.push_back(id);
+      }
+      tracks = tracks_kept;
+      while ((int)tracks.size() < 300)
+        tracks.push_back(id_next++);
+      std::vector<Eigen::Vector2f> uvs(tracks.size(), Eigen::Vector2f::Zero());
+      for (const auto &cam_id : cam_ids)
+        database.update_features((double)k, (size_t)cam_id, tracks, uvs, uvs);
+      if (k % 50 == 49)
+        database.cleanup_measurements((double)k - 40);
+      if (k % 25 != 0)
+        continue;
+      size_t num_recounted = 0;
+      for (const auto &feat : database.get_internal_data()) {
+        for (const auto &times : feat.second->timestamps)
+          num_recounted += times.second.size();
+      }
+      size_t num_snapshot = 0;
+      std::shared_ptr<const ov_core::FeatureDatabase::Snapshot> snapshot = database.get_snapshot();
+      for (const auto &feat : *snapshot) {
+        for (const auto &times : feat.second->timestamps)
+          num_snapshot += times.second.size();
+      }
+      ov_core::FeatureDatabase::Usage usage = database.get_usage();
+      num_evicted = usage.num_evicted_measurements;
+      if (num_recounted != usage.num_measurements || num_snapshot != num_recounted) {
+        PRINT_ERROR(RED "FEATURE DATABASE: ACCOUNTING (policy %d): frame %d has %zu measurements (%zu in snapshot) but accounted %zu\n" RESET,
+                    (int)policy, k, num_recounted, num_snapshot, usage.num_measurements);
+        num_mismatched++;
+      }
+    }
+    checks_passed = checks_passed && (num_mismatched == 0);
+    PRINT_INFO("FEATURE DATABASE: ACCOUNTING (policy %d): %d mismatched recounts, %zu measurements evicted\n", (int)policy, num_mismatched,
+               num_evicted);
+  }
+
+  // FEATURE INITIALIZER: TRIANGULATION
+  // Stereo sliding window of 11 clones moving sideways, each feature is seen by every camera of every clone with some noise
+  // We time the linear triangulation with the Levenberg-Marquardt refinement of all features (the camera poses are built once per update)
+  // Features are either refined one after the other, or together in a batch (which should accept the same features with the same estimates)
+  {
+    ov_core::FeatureInitializerOptions options;
+    ov_core::FeatureInitializer initializer(options);
+    std::vector<size_t> table_cams;
+    for (const auto &cam_id : cam_ids)
+      table_cams.push_back((size_t)cam_id);
+    std::vector<double> clone_times;
+    for (int k = 0; k < num_clones; k++)
+      clone_times.push_back((double)k);
+    ov_core::FeatureInitializer::ClonePoseTable clones_cam;
+    clones_cam.reset(table_cams, clone_times);
+    Eigen::Matrix3d R_GtoC = Eigen::Matrix3d::Identity();
+    for (size_t c = 0; c < table_cams.size(); c++) {
+      for (size_t k = 0; k < clone_times.size(); k++) {
+        Eigen::Vector3d p_CinG(0.2 * (double)k + 0.1 * (double)c, 0.02 * (double)k, 0.0);
+        clones_cam.at(c, k) = ov_core::FeatureInitializer::ClonePose(R_GtoC, p_CinG);
+      }
+    }
+    auto create_features = [&](int num_feats) {
+      std::vector<std::shared_ptr<ov_core::Feature>> feats;
+      for (int i = 0; i < num_feats; i++) {
+        auto feat = std::make_shared<ov_core::Feature>();
+        feat->featid = (size_t)i;
+        Eigen::Vector3d p_FinG = Eigen::Vector3d::Random();
+        p_FinG(2) = 5.0 + 4.0 * p_FinG(2);
+        for (size_t c = 0; c < table_cams.size(); c++) {
+          for (size_t k = 0; k < clone_times.size(); k++) {
+            Eigen::Vector3d p_FinC = p_FinG - clones_cam.at(c, k).pos();
+            Eigen::Vector2f uv_norm((float)(p_FinC(0) / p_FinC(2)), (float)(p_FinC(1) / p_FinC(2)));
+            uv_norm += 1e-3f * Eigen::Vector2f::Random();
+            feat->timestamps[table_cams.at(c)].push_back(clone_times.at(k));
+            feat->uvs[table_cams.at(c)].push_back(uv_norm);
+            feat->uvs_norm[table_cams.at(c)].push_back(uv_norm);
+          }
+        }
+        feats.push_back(feat);
+      }
+      return feats;
+    };
+    std::srand(0);
+    std::vector<std::shared_ptr<ov_core::Feature>> feats = create_features(max_features);
+    for (bool batch : {false, true}) {
+      times_ms.clear();
+      extra_stats.clear();
+      std::vector<bool> success;
+      for (int i = 0; i < num_trials; i++) {
+        int num_success = 0;
+        auto rT1 = boost::posix_time::microsec_clock::local_time();
+        if (batch) {
+          initializer.batch_triangulation(feats, clones_cam, success);
+          num_success = (int)std::count(success.begin(), success.end(), true);
+        } else {
+          for (const auto &feat : feats) {
+            if (initializer.single_triangulation(feat, clones_cam) && initializer.single_gaussnewton(feat, clones_cam))
+              num_success++;
+          }
+        }
+        auto rT2 = boost::posix_time::microsec_clock::local_time();
+        times_ms.push_back((rT2 - rT1).total_microseconds() * 1e-3);
+        extra_stats.push_back(num_success);
+      }
+      std::string title = "FEATURE INITIALIZER: " + std::string(batch ? "BATCH" : "SINGLE") + " TRIANGULATION (" + std::to_string(max_features) + " feats)";
+      print_stats(title, times_ms, "triangulated", extra_stats);
+      double time_mean = 0.0;
+      for (const auto &time : times_ms)
+        time_mean += time / (double)times_ms.size();
+      PRINT_INFO("%s: %.0f features/sec\n", title.c_str(), 1e3 * (double)max_features / time_mean);
+    }
+
+    // Check that the batch gives the same result as refining each feature on its own (on more features than we time)
+    // The order of the floating point operations differs, thus we allow a small relative difference of the positions
+    std::srand(1);
+    std::vector<std::shared_ptr<ov_core::Feature>> feats_single = create_features(2000);
+    std::vector<std::shared_ptr<ov_core::Feature>> feats_batch;
+    for (const auto &feat : feats_single)
+      feats_batch.push_back(std::make_shared<ov_core::Feature>(*feat));
+    std::vector<bool> success_batch;
+    initializer.batch_triangulation(feats_batch, clones_cam, success_batch);
+    int num_diff_success = 0;
+    double max_diff_rel = 0.0;
+    for (size_t i = 0; i < feats_single.size(); i++) {
+      bool success_single = initializer.single_triangulation(feats_single.at(i), clones_cam) &&
+                            initializer.single_gaussnewton(feats_single.at(i), clones_cam);
+      if (success_single != success_batch.at(i)) {
+        num_diff_success++;
+      } else if (success_single) {
+        const Eigen::Vector3d &p_single = feats_single.at(i)->p_FinG;
+        max_diff_rel = std::max(max_diff_rel, (feats_batch.at(i)->p_FinG - p_single).norm() / p_single.norm());
+      }
+    }
+    double max_diff_rel_allowed = 1e-3;
+    if (num_diff_success > 0 || !(max_diff_rel <= max_diff_rel_allowed)) {
+      PRINT_ERROR(RED "FEATURE INITIALIZER: BATCH PARITY: %d of %zu feats accepted differently, %.2e max relative difference (%.0e allowed)\n" RESET,
+                  num_diff_success, feats_single.size(), max_diff_rel, max_diff_rel_allowed);
+      checks_passed = false;
+    } else {
+      PRINT_INFO("FEATURE INITIALIZER: BATCH PARITY: same %zu feats accepted, %.2e max relative difference\n", feats_single.size(), max_diff_rel);
+    }
+  }
+
+  // LANDMARK MAP: FRUSTUM QUERIES
+  // Landmarks are spread over a 200 meter cube, and a camera moving forward queries the ones it could see (up to 20 meters)
+  // The cost should follow the size of the frustum, not the number of landmarks in the map
+  for (int num_landmarks : {1000, 10000, 50000}) {
+    auto camera = std::make_shared<ov_core::CamRadtan>(752, 480);
+    Eigen::Matrix<double, 8, 1> cam_calib;
+    cam_calib << 458.654, 457.296, 367.215, 248.375, -0.28340811, 0.07395907, 0.00019359, 1.76187114e-05;
+    camera->set_value(cam_calib);
+    ov_core::LandmarkMap map(1.0, (size_t)num_landmarks);
+    std::srand(0);
+    std::vector<size_t> ids;
+    for (int i = 0; i < num_landmarks; i++) {
+      map.update_landmark((size_t)i, 100.0 * Eigen::Vector3d::Random(), 0.1, 0.0);
+      ids.push_back((size_t)i);
+    }
+    map.update_descriptors(ids, cv::Mat::zeros(num_landmarks, 32, CV_8UC1));
+    times_ms.clear();
+    extra_stats.clear();
+    for (int i = 0; i < num_trials; i++) {
+      Eigen::Vector3d p_CinG(0.0, 0.0, -50.0 + 0.5 * (double)i);
+      std::vector<ov_core::LandmarkMap::Visible> visible;
+      auto rT1 = boost::posix_time::microsec_clock::local_time();
+      map.get_in_frustum(Eigen::Matrix3d::Identity(), p_CinG, camera, 20.0, visible);
+      auto rT2 = boost::posix_time::microsec_clock::local_time();
+      times_ms.push_back((rT2 - rT1).total_microseconds() * 1e-3);
+      extra_stats.push_back((int)visible.size());
+    }
+    print_stats("LANDMARK MAP: FRUSTUM QUERY (" + std::to_string(num_landmarks) + " landmarks)", times_ms, "visible", extra_stats);
+  }
+
   // Done!
-  return EXIT_SUCCESS;
+  return checks_passed ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -37,9 +37,11 @@
 #include "cam/CamRadtan.h"
 #include "feat/Feature.h"
 #include "feat/FeatureDatabase.h"
+#include "feat/FeaturePool.h"
 #include "track/TrackAruco.h"
 #include "track/TrackDescriptor.h"
 #include "track/TrackKLT.h"
+#include "utils/image_pool.h"
 #include "utils/opencv_yaml_parse.h"
 #include "utils/print.h"
 
@@ -285,7 +287,8 @@ void handle_stereo(double time0, double time1, cv::Mat img0, cv::Mat img1) {
 
   // Animate our dynamic mask moving
   // Very simple ball bounding around the screen example
-  cv::Mat mask = cv::Mat::zeros(cv::Size(img0.cols, img0.rows), CV_8UC1);
+  cv::Mat mask = extractor->get_image_pool()->acquire(img0.rows, img0.cols, CV_8UC1);
+  mask.setTo(0);
   static cv::Point2f ball_center;
   static cv::Point2f ball_velocity;
   if (ball_velocity.x == 0 || ball_velocity.y == 0) {
@@ -372,6 +375,10 @@ void handle_stereo(double time0, double time1, cv::Mat img0, cv::Mat img1) {
     double mpf = (double)num_margfeats / frames;
     // DEBUG PRINT OUT
     PRINT_DEBUG("fps = %.2f | lost_feats/frame = %.2f | track_length/lost_feat = %.2f | marg_tracks/frame = %.2f\n", fps, lpf, fpf, mpf);
+    PRINT_DEBUG("image buffers allocated = %zu | image buffers acquired = %zu\n", extractor->get_image_pool()->num_allocations(),
+                extractor->get_image_pool()->num_acquired());
+    PRINT_DEBUG("features allocated = %zu | features acquired = %zu\n", extractor->get_feature_database()->get_feature_pool()->num_allocations(),
+                extractor->get_feature_database()->get_feature_pool()->num_acquired());
     // Reset variables
     frames = 0;
     time_start = time_curr;
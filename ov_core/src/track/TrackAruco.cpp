@@ -25,11 +25,14 @@
 #include "feat/Feature.h"
 #include "feat/FeatureDatabase.h"
 #include "utils/opencv_lambda_body.h"
+#include "utils/trace.h"
 
 using namespace ov_core;
 
 void TrackAruco::feed_new_camera(const CameraData &message) {
 
+  OV_TRACE_SCOPE("track aruco");
+
   // Error check that we have all the data
   if (message.sensor_ids.empty() || message.sensor_ids.size() != message.images.size() || message.images.size() != message.masks.size()) {
     PRINT_ERROR(RED "[ERROR]: MESSAGE DATA SIZES DO NOT MATCH OR EMPTY!!!\n" RESET);
@@ -81,7 +84,9 @@ void TrackAruco::perform_tracking(double timestamp,
     clahe->apply(imgin, img);
   } 
   else {
-    img = imgin;
+    // The raw image could be borrowed from its message (e.g. ROS), thus copy it as we keep it after this frame
+    img = image_pool->acquire(imgin.rows, imgin.cols, imgin.type());
+    imgin.copyTo(img);
   }
 
   // Clear the old data from the last timestep
@@ -159,11 +164,8 @@ void TrackAruco::perform_tracking(double timestamp,
       // NOTE: mask has max value of 255 (white) if it should be
       if (maskin.at<uint8_t>((int)corners[cam_id].at(i).at(n).y, (int)corners[cam_id].at(i).at(n).x) > 127)
         continue;
-      // Try to undistort the point
-      cv::Point2f npt_l = camera_calib.at(cam_id)->undistort_cv(corners[cam_id].at(i).at(n));
-      // Append to the ids vector and database
+      // Append to the ids vector
       size_t tmp_id = (size_t)ids_aruco[cam_id].at(i) + n * max_tag_id;
-      database->update_feature(tmp_id, timestamp, cam_id, corners[cam_id].at(i).at(n).x, corners[cam_id].at(i).at(n).y, npt_l.x, npt_l.y);
       // Append to active tracked point list
       cv::KeyPoint kpt;
       kpt.pt = corners[cam_id].at(i).at(n);
@@ -171,6 +173,7 @@ void TrackAruco::perform_tracking(double timestamp,
       pts_new.push_back(kpt);
     }
   }
+  update_database(timestamp, cam_id, pts_new, ids_new);
 
   // Move forward in time
   {
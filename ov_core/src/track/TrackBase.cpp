@@ -32,7 +32,8 @@ TrackBase::TrackBase(std::unordered_map<size_t, std::shared_ptr<CamBase>> camera
                      int numaruco, 
                      bool stereo,
                      HistogramMethod histmethod)
-    : camera_calib(cameras), database(new FeatureDatabase()), num_features(numfeats), use_stereo(stereo), histogram_method(histmethod) {
+    : camera_calib(cameras), database(new FeatureDatabase()), num_features(numfeats), use_stereo(stereo), histogram_method(histmethod),
+      image_pool(new ImagePool()) {
   // Our current feature ID should be larger then the number of aruco tags we have (each has 4 corners)
   currid = 4 * (size_t)numaruco + 1;
   // note Create our mutex array based on the number of cameras we have
@@ -126,13 +127,16 @@ void TrackBase::display_history(cv::Mat &img_out, int r1, int g1, int b1, int r2
   std::map<size_t, cv::Mat> img_last_cache, img_mask_last_cache;
   std::unordered_map<size_t, std::vector<cv::KeyPoint>> pts_last_cache;
   std::unordered_map<size_t, std::vector<size_t>> ids_last_cache;
+  std::shared_ptr<FeatureDatabase> database_cache;
   {
     std::lock_guard<std::mutex> lckv(mtx_last_vars);
     img_last_cache = img_last;
     img_mask_last_cache = img_mask_last;
     pts_last_cache = pts_last;
     ids_last_cache = ids_last;
+    database_cache = database;
   }
+  std::shared_ptr<const FeatureDatabase::Snapshot> snapshot = database_cache->get_snapshot();
 
   // Get the largest width and height
   int max_width = -1;
@@ -181,32 +185,34 @@ void TrackBase::display_history(cv::Mat &img_out, int r1, int g1, int b1, int r2
         cv::rectangle(img_temp, pt_l_top, pt_l_bot, cv::Scalar(0, 255, 0), 1);
         cv::circle(img_temp, pt_c, (is_small) ? 1 : 2, cv::Scalar(0, 255, 0), cv::FILLED);
       }
-      // Get the feature from the database
-      Feature feat;
-      if (!database->get_feature_clone(ids_last_cache[pair.first].at(i), feat))
+      // Get the feature from the snapshot of the database
+      auto it_feat = snapshot->find(ids_last_cache[pair.first].at(i));
+      if (it_feat == snapshot->end())
         continue;
-      if (feat.uvs.empty() || feat.uvs[pair.first].empty() || feat.to_delete)
+      const FeatureSnapshot &feat = *it_feat->second;
+      if (feat.uvs.find(pair.first) == feat.uvs.end() || feat.uvs.at(pair.first).empty() || feat.to_delete)
         continue;
+      const auto uvs = feat.uvs.at(pair.first);
       // Draw the history of this point (start at the last inserted one)
-      for (size_t z = feat.uvs[pair.first].size() - 1; z > 0; z--) {
+      for (size_t z = uvs.size() - 1; z > 0; z--) {
         // Check if we have reached the max
-        if (feat.uvs[pair.first].size() - z > maxtracks)
+        if (uvs.size() - z > maxtracks)
           break;
         // Calculate what color we are drawing in
         bool is_stereo = (feat.uvs.size() > 1);
-        int color_r = (is_stereo ? b2 : r2) - (int)(1.0 * (is_stereo ? b1 : r1) / feat.uvs[pair.first].size() * z);
-        int color_g = (is_stereo ? r2 : g2) - (int)(1.0 * (is_stereo ? r1 : g1) / feat.uvs[pair.first].size() * z);
-        int color_b = (is_stereo ? g2 : b2) - (int)(1.0 * (is_stereo ? g1 : b1) / feat.uvs[pair.first].size() * z);
+        int color_r = (is_stereo ? b2 : r2) - (int)(1.0 * (is_stereo ? b1 : r1) / uvs.size() * z);
+        int color_g = (is_stereo ? r2 : g2) - (int)(1.0 * (is_stereo ? r1 : g1) / uvs.size() * z);
+        int color_b = (is_stereo ? g2 : b2) - (int)(1.0 * (is_stereo ? g1 : b1) / uvs.size() * z);
         // Draw current point
-        cv::Point2f pt_c(feat.uvs[pair.first].at(z)(0), feat.uvs[pair.first].at(z)(1));
+        cv::Point2f pt_c(uvs.at(z)(0), uvs.at(z)(1));
         cv::circle(img_temp, pt_c, (is_small) ? 1 : 2, cv::Scalar(color_r, color_g, color_b), cv::FILLED);
         // If there is a next point, then display the line from this point to the next
-        if (z + 1 < feat.uvs[pair.first].size()) {
-          cv::Point2f pt_n(feat.uvs[pair.first].at(z + 1)(0), feat.uvs[pair.first].at(z + 1)(1));
+        if (z + 1 < uvs.size()) {
+          cv::Point2f pt_n(uvs.at(z + 1)(0), uvs.at(z + 1)(1));
           cv::line(img_temp, pt_c, pt_n, cv::Scalar(color_r, color_g, color_b));
         }
         // If the first point, display the ID
-        if (z == feat.uvs[pair.first].size() - 1) {
+        if (z == uvs.size() - 1) {
           // cv::putText(img_out0, std::to_string(feat->featid), pt_c, cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 255), 1,
           // cv::LINE_AA); cv::circle(img_out0, pt_c, 2, cv::Scalar(color,color,255), CV_FILLED);
         }
@@ -230,6 +236,19 @@ void TrackBase::display_history(cv::Mat &img_out, int r1, int g1, int b1, int r2
   }
 }
 
+void TrackBase::update_database(double timestamp, size_t cam_id, const std::vector<cv::KeyPoint> &pts, const std::vector<size_t> &ids) {
+  assert(pts.size() == ids.size());
+  std::vector<Eigen::Vector2f> uvs, uvs_norm;
+  uvs.reserve(pts.size());
+  uvs_norm.reserve(pts.size());
+  for (const auto &pt : pts) {
+    cv::Point2f npt = camera_calib.at(cam_id)->undistort_cv(pt.pt);
+    uvs.emplace_back(pt.pt.x, pt.pt.y);
+    uvs_norm.emplace_back(npt.x, npt.y);
+  }
+  database->update_features(timestamp, cam_id, ids, uvs, uvs_norm);
+}
+
 void TrackBase::change_feat_id(size_t id_old, size_t id_new) {
 
   // If found in db then replace
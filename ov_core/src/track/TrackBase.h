@@ -34,6 +34,7 @@
 #include <opencv2/opencv.hpp>
 
 #include "utils/colors.h"
+#include "utils/image_pool.h"
 #include "utils/print.h"
 #include "utils/sensor_data.h"
 
@@ -123,7 +124,39 @@ public:
    * @brief Get the feature database with all the track information
    * @return FeatureDatabase pointer that one can query for features
    */
-  std::shared_ptr<FeatureDatabase> get_feature_database() { return database; }
+  std::shared_ptr<FeatureDatabase> get_feature_database() {
+    std::lock_guard<std::mutex> lckv(mtx_last_vars);
+    return database;
+  }
+
+  /**
+   * @brief Replaces the feature database new measurements will be appended into.
+   *
+   * This allows for the database to be handed off to another thread (e.g. the estimator) while we continue tracking.
+   * Should be called from the same thread which feeds the tracker new images.
+   *
+   * @param db New feature database
+   * @return The database that was used before
+   */
+  std::shared_ptr<FeatureDatabase> swap_feature_database(std::shared_ptr<FeatureDatabase> db) {
+    std::lock_guard<std::mutex> lckv(mtx_last_vars);
+    std::swap(database, db);
+    return db;
+  }
+
+  /**
+   * @brief Ensures that new features will get an id larger than the given one
+   *
+   * This should be used if the database has been restored with features from a previous run.
+   * Otherwise newly extracted features could be given the same id as one in the database.
+   *
+   * @param id Largest feature id which is in use
+   */
+  void reserve_feature_ids(size_t id) {
+    size_t id_curr = currid;
+    while (id_curr < id && !currid.compare_exchange_weak(id_curr, id)) {
+    }
+  }
 
   /**
    * @brief Changes the ID of an actively tracked feature to another one.
@@ -148,6 +181,9 @@ public:
     return ids_last;
   }
 
+  /// Pool the per frame images of this tracker are allocated from (e.g. to check how many allocations we do)
+  std::shared_ptr<ImagePool> get_image_pool() { return image_pool; }
+
   /// Getter method for number of active features
   int get_num_features() { return num_features; }
 
@@ -155,6 +191,15 @@ public:
   void set_num_features(int _num_features) { num_features = _num_features; }
 
 protected:
+  /**
+   * @brief Appends the tracked points of an image to our feature database (undistorting them)
+   * @param timestamp Time of the image
+   * @param cam_id Camera the image is from
+   * @param pts Raw tracked points
+   * @param ids ID of each tracked point
+   */
+  void update_database(double timestamp, size_t cam_id, const std::vector<cv::KeyPoint> &pts, const std::vector<size_t> &ids);
+
   /// Camera object which has all calibration in it
   std::unordered_map<size_t, std::shared_ptr<CamBase>> camera_calib;
 
@@ -194,6 +239,9 @@ protected:
   /// Master ID for this tracker (atomic to allow for multi-threading)
   std::atomic<size_t> currid;
 
+  /// Buffers for the images we create each frame (e.g. histogram equalized images and pyramids)
+  std::shared_ptr<ImagePool> image_pool;
+
   // Timing variables (most children use these...)
   boost::posix_time::ptime rT1, rT2, rT3, rT4, rT5, rT6, rT7;
 };
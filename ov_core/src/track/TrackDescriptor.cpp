@@ -21,17 +21,25 @@
 
 #include "TrackDescriptor.h"
 
+#include <algorithm>
+#include <tuple>
+#include <unordered_set>
+
 #include <opencv2/features2d.hpp>
 
 #include "Grider_FAST.h"
 #include "cam/CamBase.h"
 #include "feat/Feature.h"
 #include "feat/FeatureDatabase.h"
+#include "feat/LandmarkMap.h"
+#include "utils/trace.h"
 
 using namespace ov_core;
 
 void TrackDescriptor::feed_new_camera(const CameraData &message) {
 
+  OV_TRACE_SCOPE("track descriptor");
+
   // Error check that we have all the data
   if (message.sensor_ids.empty() || message.sensor_ids.size() != message.images.size() || message.images.size() != message.masks.size()) {
     PRINT_ERROR(RED "[ERROR]: MESSAGE DATA SIZES DO NOT MATCH OR EMPTY!!!\n" RESET);
@@ -84,7 +92,10 @@ void TrackDescriptor::feed_monocular(const CameraData &message, size_t msg_id) {
     clahe->apply(message.images.at(msg_id), img);
   }
   else {
-    img = message.images.at(msg_id);
+    // The raw image could be borrowed from its message (e.g. ROS), thus copy it as we keep it after this frame
+    const cv::Mat &img_raw = message.images.at(msg_id);
+    img = image_pool->acquire(img_raw.rows, img_raw.cols, img_raw.type());
+    img_raw.copyTo(img);
   }
   mask = message.masks.at(msg_id);
 
@@ -125,6 +136,7 @@ void TrackDescriptor::feed_monocular(const CameraData &message, size_t msg_id) {
   std::vector<cv::KeyPoint> good_left;
   std::vector<size_t> good_ids_left;
   cv::Mat good_desc_left;
+  std::vector<bool> good_tracked;
 
   // Count how many we have tracked from the last time
   int num_tracklast = 0;
@@ -146,6 +158,7 @@ void TrackDescriptor::feed_monocular(const CameraData &message, size_t msg_id) {
     // Else just append the current feature and its unique ID
     good_left.push_back(pts_new[i]);
     good_desc_left.push_back(desc_new.row((int)i));
+    good_tracked.push_back(idll != -1);
     if (idll != -1) {
       good_ids_left.push_back(ids_last[cam_id][idll]);
       num_tracklast++;
@@ -153,13 +166,16 @@ void TrackDescriptor::feed_monocular(const CameraData &message, size_t msg_id) {
       good_ids_left.push_back(ids_new[i]);
     }
   }
+
+  // Re-identify new features which are landmarks of our map
+  if (landmark_map != nullptr) {
+    match_landmarks(cam_id, good_left, good_desc_left, good_tracked, good_ids_left);
+    landmark_map->update_descriptors(good_ids_left, good_desc_left);
+  }
   rT4 = boost::posix_time::microsec_clock::local_time();
 
   // Update our feature database, with theses new observations
-  for (size_t i = 0; i < good_left.size(); i++) {
-    cv::Point2f npt_l = camera_calib.at(cam_id)->undistort_cv(good_left.at(i).pt);
-    database->update_feature(good_ids_left.at(i), message.timestamp, cam_id, good_left.at(i).pt.x, good_left.at(i).pt.y, npt_l.x, npt_l.y);
-  }
+  update_database(message.timestamp, cam_id, good_left, good_ids_left);
 
   // Debug info
   // PRINT_DEBUG("LtoL = %d | good = %d | fromlast = %d\n",(int)matches_ll.size(),(int)good_left.size(),num_tracklast);
@@ -207,8 +223,13 @@ void TrackDescriptor::feed_stereo(const CameraData &message, size_t msg_id_left,
     clahe->apply(message.images.at(msg_id_left), img_left);
     clahe->apply(message.images.at(msg_id_right), img_right);
   } else {
-    img_left = message.images.at(msg_id_left);
-    img_right = message.images.at(msg_id_right);
+    // The raw images could be borrowed from their message (e.g. ROS), thus copy them as we keep them after this frame
+    const cv::Mat &img_raw_left = message.images.at(msg_id_left);
+    const cv::Mat &img_raw_right = message.images.at(msg_id_right);
+    img_left = image_pool->acquire(img_raw_left.rows, img_raw_left.cols, img_raw_left.type());
+    img_right = image_pool->acquire(img_raw_right.rows, img_raw_right.cols, img_raw_right.type());
+    img_raw_left.copyTo(img_left);
+    img_raw_right.copyTo(img_right);
   }
   mask_left = message.masks.at(msg_id_left);
   mask_right = message.masks.at(msg_id_right);
@@ -261,6 +282,7 @@ void TrackDescriptor::feed_stereo(const CameraData &message, size_t msg_id_left,
   std::vector<cv::KeyPoint> good_left, good_right;
   std::vector<size_t> good_ids_left, good_ids_right;
   cv::Mat good_desc_left, good_desc_right;
+  std::vector<bool> good_tracked;
 
   // Points must be of equal size
   assert(pts_last[cam_id_left].size() == pts_last[cam_id_right].size());
@@ -300,6 +322,7 @@ void TrackDescriptor::feed_stereo(const CameraData &message, size_t msg_id_left,
       good_desc_right.push_back(desc_right_new.row((int)i));
       good_ids_left.push_back(ids_last[cam_id_left][idll]);
       good_ids_right.push_back(ids_last[cam_id_right][idrr]);
+      good_tracked.push_back(true);
       num_tracklast++;
     } else {
       // Else just append the current feature and its unique ID
@@ -309,26 +332,26 @@ void TrackDescriptor::feed_stereo(const CameraData &message, size_t msg_id_left,
       good_desc_right.push_back(desc_right_new.row((int)i));
       good_ids_left.push_back(ids_left_new[i]);
       good_ids_right.push_back(ids_left_new[i]);
+      good_tracked.push_back(false);
     }
   }
+
+  // Re-identify new features which are landmarks of our map (we match in the left image)
+  if (landmark_map != nullptr) {
+    match_landmarks(cam_id_left, good_left, good_desc_left, good_tracked, good_ids_left);
+    good_ids_right = good_ids_left;
+    landmark_map->update_descriptors(good_ids_left, good_desc_left);
+  }
   rT4 = boost::posix_time::microsec_clock::local_time();
 
   //===================================================================================
   //===================================================================================
 
   // Update our feature database, with theses new observations
-  for (size_t i = 0; i < good_left.size(); i++) {
-    // Assert that our IDs are the same
-    assert(good_ids_left.at(i) == good_ids_right.at(i));
-    // Try to undistort the point
-    cv::Point2f npt_l = camera_calib.at(cam_id_left)->undistort_cv(good_left.at(i).pt);
-    cv::Point2f npt_r = camera_calib.at(cam_id_right)->undistort_cv(good_right.at(i).pt);
-    // Append to the database
-    database->update_feature(good_ids_left.at(i), message.timestamp, cam_id_left, good_left.at(i).pt.x, good_left.at(i).pt.y, npt_l.x,
-                             npt_l.y);
-    database->update_feature(good_ids_left.at(i), message.timestamp, cam_id_right, good_right.at(i).pt.x, good_right.at(i).pt.y, npt_r.x,
-                             npt_r.y);
-  }
+  // Both cameras see each feature, thus the ids are the same
+  assert(good_ids_left == good_ids_right);
+  update_database(message.timestamp, cam_id_left, good_left, good_ids_left);
+  update_database(message.timestamp, cam_id_right, good_right, good_ids_left);
 
   // Debug info
   // PRINT_DEBUG("LtoL = %d | RtoR = %d | LtoR = %d | good = %d | fromlast = %d\n", (int)matches_ll.size(),
@@ -494,6 +517,54 @@ void TrackDescriptor::perform_detection_stereo(const cv::Mat &img0, const cv::Ma
   }
 }
 
+void TrackDescriptor::match_landmarks(size_t cam_id, const std::vector<cv::KeyPoint> &pts, const cv::Mat &desc,
+                                      const std::vector<bool> &tracked, std::vector<size_t> &ids) {
+
+  // Landmarks predicted to be seen, skip the ones we are already tracking
+  std::vector<LandmarkMap::Visible> visible;
+  landmark_map->get_visible(cam_id, visible);
+  if (visible.empty())
+    return;
+  std::unordered_set<size_t> ids_tracked;
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (tracked.at(i))
+      ids_tracked.insert(ids.at(i));
+  }
+
+  // Find all close new features with a small enough descriptor distance
+  // Each candidate is (distance, landmark index, feature index)
+  std::vector<std::tuple<int, size_t, size_t>> candidates;
+  double max_dist_sq = landmark_match_px * landmark_match_px;
+  for (size_t l = 0; l < visible.size(); l++) {
+    if (ids_tracked.find(visible.at(l).id) != ids_tracked.end() || visible.at(l).descriptor.cols != desc.cols)
+      continue;
+    for (size_t i = 0; i < pts.size(); i++) {
+      if (tracked.at(i))
+        continue;
+      cv::Point2f diff = pts.at(i).pt - visible.at(l).uv;
+      if (diff.x * diff.x + diff.y * diff.y > max_dist_sq)
+        continue;
+      int dist = (int)cv::norm(visible.at(l).descriptor, desc.row((int)i), cv::NORM_HAMMING);
+      if (dist < landmark_max_hamming)
+        candidates.emplace_back(dist, l, i);
+    }
+  }
+
+  // Assign the best matches first
+  std::sort(candidates.begin(), candidates.end());
+  std::vector<bool> used_landmark(visible.size(), false);
+  std::vector<bool> used_feature(pts.size(), false);
+  for (const auto &candidate : candidates) {
+    size_t l = std::get<1>(candidate);
+    size_t i = std::get<2>(candidate);
+    if (used_landmark.at(l) || used_feature.at(i))
+      continue;
+    used_landmark.at(l) = true;
+    used_feature.at(i) = true;
+    ids.at(i) = visible.at(l).id;
+  }
+}
+
 void TrackDescriptor::robust_match(const std::vector<cv::KeyPoint> &pts0, const std::vector<cv::KeyPoint> &pts1, const cv::Mat &desc0,
                                    const cv::Mat &desc1, size_t id0, size_t id1, std::vector<cv::DMatch> &matches) {
 
@@ -26,6 +26,8 @@
 
 namespace ov_core {
 
+class LandmarkMap;
+
 /**
  * @brief Descriptor-based visual tracking
  *
@@ -69,6 +71,22 @@ public:
    */
   void feed_new_camera(const CameraData &message) override;
 
+  /**
+   * @brief Sets the long-term map we re-identify new features with
+   *
+   * New features which match a landmark the map predicts to be seen (see LandmarkMap::get_visible()) take its id.
+   * We also store the descriptors of all tracked features in the map.
+   *
+   * @param map Landmark map (nullptr to disable)
+   * @param match_px Max pixel distance from the predicted location of a landmark
+   * @param max_hamming Max descriptor (hamming) distance to a landmark
+   */
+  void set_landmark_map(std::shared_ptr<LandmarkMap> map, double match_px, int max_hamming) {
+    landmark_map = map;
+    landmark_match_px = match_px;
+    landmark_max_hamming = max_hamming;
+  }
+
 protected:
   /**
    * @brief Process a new monocular image
@@ -146,6 +164,20 @@ protected:
   void robust_match(const std::vector<cv::KeyPoint> &pts0, const std::vector<cv::KeyPoint> &pts1, const cv::Mat &desc0,
                     const cv::Mat &desc1, size_t id0, size_t id1, std::vector<cv::DMatch> &matches);
 
+  /**
+   * @brief Gives new features the id of a landmark of our map they match
+   * @param cam_id id of the camera
+   * @param pts keypoints of the current image
+   * @param desc descriptors of the current image
+   * @param tracked if the feature was tracked from the last image (those keep their id)
+   * @param ids ids of the features, the ones of matched new features are replaced
+   *
+   * We compare each landmark predicted to be seen with the new features within landmark_match_px of its predicted location.
+   * The pairs with the smallest descriptor distance are then assigned first, so each landmark and feature is only used once.
+   */
+  void match_landmarks(size_t cam_id, const std::vector<cv::KeyPoint> &pts, const cv::Mat &desc, const std::vector<bool> &tracked,
+                       std::vector<size_t> &ids);
+
   // Helper functions for the robust_match function
   // Original code is from the "RobustMatcher" in the opencv examples
   // https://github.com/opencv/opencv/blob/master/samples/cpp/tutorial_code/calib3d/real_time_pose_estimation/src/RobustMatcher.cpp
@@ -178,6 +210,13 @@ protected:
 
   // Descriptor matrices
   std::unordered_map<size_t, cv::Mat> desc_last;
+
+  // Long-term map we re-identify new features with (nullptr if disabled)
+  std::shared_ptr<LandmarkMap> landmark_map;
+
+  // Max pixel distance and descriptor (hamming) distance of a new feature to match a landmark
+  double landmark_match_px = 20.0;
+  int landmark_max_hamming = 50;
 };
 
 } // namespace ov_core
@@ -28,11 +28,14 @@
 #include "feat/FeatureDatabase.h"
 #include "utils/opencv_lambda_body.h"
 #include "utils/print.h"
+#include "utils/trace.h"
 
 using namespace ov_core;
 
 void TrackKLT::feed_new_camera(const CameraData &message) {
 
+  OV_TRACE_SCOPE("track klt");
+
   // Error check that we have all the data
   if (message.sensor_ids.empty() || message.sensor_ids.size() != message.images.size() || message.images.size() != message.masks.size()) {
     PRINT_ERROR(RED "[ERROR]: MESSAGE DATA SIZES DO NOT MATCH OR EMPTY!!!\n" RESET);
@@ -54,21 +57,29 @@ void TrackKLT::feed_new_camera(const CameraData &message) {
     std::lock_guard<std::mutex> lck(mtx_feeds.at(cam_id));
 
     // Histogram equalize
+    // NOTE: the equalized image and pyramid are written into pooled buffers, so we do not allocate each frame
+    const cv::Mat &img_raw = message.images.at(msg_id);
     cv::Mat img;
     if (histogram_method == HistogramMethod::HISTOGRAM) {
-      cv::equalizeHist(message.images.at(msg_id), img);
+      img = image_pool->acquire(img_raw.rows, img_raw.cols, img_raw.type());
+      cv::equalizeHist(img_raw, img);
     } else if (histogram_method == HistogramMethod::CLAHE) {
-      double eq_clip_limit = 10.0;
-      cv::Size eq_win_size = cv::Size(8, 8);
-      cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(eq_clip_limit, eq_win_size);
-      clahe->apply(message.images.at(msg_id), img);
+      if (clahe == nullptr) {
+        double eq_clip_limit = 10.0;
+        cv::Size eq_win_size = cv::Size(8, 8);
+        clahe = cv::createCLAHE(eq_clip_limit, eq_win_size);
+      }
+      img = image_pool->acquire(img_raw.rows, img_raw.cols, img_raw.type());
+      clahe->apply(img_raw, img);
     } else {
-      img = message.images.at(msg_id);
+      // The raw image could be borrowed from its message (e.g. ROS), thus copy it as we keep it after this frame
+      img = image_pool->acquire(img_raw.rows, img_raw.cols, img_raw.type());
+      img_raw.copyTo(img);
     }
 
     // Extract image pyramid
     std::vector<cv::Mat> imgpyr;
-    cv::buildOpticalFlowPyramid(img, imgpyr, win_size, pyr_levels);
+    image_pool->build_pyramid(img, imgpyr, win_size, pyr_levels);
 
     // Save!
     img_curr[cam_id] = img;
@@ -173,10 +184,7 @@ void TrackKLT::feed_monocular(const CameraData &message, size_t msg_id) {
   }
 
   // Update our feature database, with theses new observations
-  for (size_t i = 0; i < good_left.size(); i++) {
-    cv::Point2f npt_l = camera_calib.at(cam_id)->undistort_cv(good_left.at(i).pt);
-    database->update_feature(good_ids_left.at(i), message.timestamp, cam_id, good_left.at(i).pt.x, good_left.at(i).pt.y, npt_l.x, npt_l.y);
-  }
+  update_database(message.timestamp, cam_id, good_left, good_ids_left);
 
   // Move forward in time
   {
@@ -354,16 +362,8 @@ void TrackKLT::feed_stereo(const CameraData &message, size_t msg_id_left, size_t
   }
 
   // Update our feature database, with theses new observations
-  for (size_t i = 0; i < good_left.size(); i++) {
-    cv::Point2f npt_l = camera_calib.at(cam_id_left)->undistort_cv(good_left.at(i).pt);
-    database->update_feature(good_ids_left.at(i), message.timestamp, cam_id_left, good_left.at(i).pt.x, good_left.at(i).pt.y, npt_l.x,
-                             npt_l.y);
-  }
-  for (size_t i = 0; i < good_right.size(); i++) {
-    cv::Point2f npt_r = camera_calib.at(cam_id_right)->undistort_cv(good_right.at(i).pt);
-    database->update_feature(good_ids_right.at(i), message.timestamp, cam_id_right, good_right.at(i).pt.x, good_right.at(i).pt.y, npt_r.x,
-                             npt_r.y);
-  }
+  update_database(message.timestamp, cam_id_left, good_left, good_ids_left);
+  update_database(message.timestamp, cam_id_right, good_right, good_ids_right);
 
   // Move forward in time
   {
@@ -402,12 +402,13 @@ void TrackKLT::perform_detection_monocular(const std::vector<cv::Mat> &img0pyr,
   // This means that we will reject points that less than grid_px_size points away then existing features
   cv::Size size_close((int)((float)img0pyr.at(0).cols / (float)min_px_dist),
                       (int)((float)img0pyr.at(0).rows / (float)min_px_dist)); // width x height
-  cv::Mat grid_2d_close = cv::Mat::zeros(size_close, CV_8UC1);
+  cv::Mat grid_2d_close = image_pool->acquire(size_close.height, size_close.width, CV_8UC1).setTo(0);
   float size_x = (float)img0pyr.at(0).cols / (float)grid_x;
   float size_y = (float)img0pyr.at(0).rows / (float)grid_y;
   cv::Size size_grid(grid_x, grid_y); // width x height
-  cv::Mat grid_2d_grid = cv::Mat::zeros(size_grid, CV_8UC1);
-  cv::Mat mask0_updated = mask0.clone();
+  cv::Mat grid_2d_grid = image_pool->acquire(size_grid.height, size_grid.width, CV_8UC1).setTo(0);
+  cv::Mat mask0_updated = image_pool->acquire(mask0.rows, mask0.cols, mask0.type());
+  mask0.copyTo(mask0_updated);
   auto it0 = pts0.begin();
   auto it1 = ids0.begin();
   while (it0 != pts0.end()) {
@@ -478,7 +479,7 @@ void TrackKLT::perform_detection_monocular(const std::vector<cv::Mat> &img0pyr,
   // Grider_FAST::perform_griding(img0pyr.at(0), mask0_updated, pts0_ext, num_features, grid_x, grid_y, threshold, true);
 
   // We also check a downsampled mask such that we don't extract in areas where it is all masked!
-  cv::Mat mask0_grid;
+  cv::Mat mask0_grid = image_pool->acquire(size_grid.height, size_grid.width, mask0.type());
   cv::resize(mask0, mask0_grid, size_grid, 0.0, 0.0, cv::INTER_NEAREST);
 
   // Create grids we need to extract from and then extract our features (use fast with griding)
@@ -538,12 +539,13 @@ void TrackKLT::perform_detection_stereo(const std::vector<cv::Mat> &img0pyr, con
   // This means that we will reject points that less then grid_px_size points away then existing features
   cv::Size size_close0((int)((float)img0pyr.at(0).cols / (float)min_px_dist),
                        (int)((float)img0pyr.at(0).rows / (float)min_px_dist)); // width x height
-  cv::Mat grid_2d_close0 = cv::Mat::zeros(size_close0, CV_8UC1);
+  cv::Mat grid_2d_close0 = image_pool->acquire(size_close0.height, size_close0.width, CV_8UC1).setTo(0);
   float size_x0 = (float)img0pyr.at(0).cols / (float)grid_x;
   float size_y0 = (float)img0pyr.at(0).rows / (float)grid_y;
   cv::Size size_grid0(grid_x, grid_y); // width x height
-  cv::Mat grid_2d_grid0 = cv::Mat::zeros(size_grid0, CV_8UC1);
-  cv::Mat mask0_updated = mask0.clone();
+  cv::Mat grid_2d_grid0 = image_pool->acquire(size_grid0.height, size_grid0.width, CV_8UC1).setTo(0);
+  cv::Mat mask0_updated = image_pool->acquire(mask0.rows, mask0.cols, mask0.type());
+  mask0.copyTo(mask0_updated);
   auto it0 = pts0.begin();
   auto it1 = ids0.begin();
   while (it0 != pts0.end()) {
@@ -616,7 +618,7 @@ void TrackKLT::perform_detection_stereo(const std::vector<cv::Mat> &img0pyr, con
     // Grider_FAST::perform_griding(img0pyr.at(0), mask0_updated, pts0_ext, num_features, grid_x, grid_y, threshold, true);
 
     // We also check a downsampled mask such that we don't extract in areas where it is all masked!
-    cv::Mat mask0_grid;
+    cv::Mat mask0_grid = image_pool->acquire(size_grid0.height, size_grid0.width, mask0.type());
     cv::resize(mask0, mask0_grid, size_grid0, 0.0, 0.0, cv::INTER_NEAREST);
 
     // Create grids we need to extract from and then extract our features (use fast with griding)
@@ -715,12 +717,13 @@ void TrackKLT::perform_detection_stereo(const std::vector<cv::Mat> &img0pyr, con
   // RIGHT: We will try to extract some monocular features if we have the room
   // RIGHT: This will also remove features if there are multiple in the same location
   cv::Size size_close1((int)((float)img1pyr.at(0).cols / (float)min_px_dist), (int)((float)img1pyr.at(0).rows / (float)min_px_dist));
-  cv::Mat grid_2d_close1 = cv::Mat::zeros(size_close1, CV_8UC1);
+  cv::Mat grid_2d_close1 = image_pool->acquire(size_close1.height, size_close1.width, CV_8UC1).setTo(0);
   float size_x1 = (float)img1pyr.at(0).cols / (float)grid_x;
   float size_y1 = (float)img1pyr.at(0).rows / (float)grid_y;
   cv::Size size_grid1(grid_x, grid_y); // width x height
-  cv::Mat grid_2d_grid1 = cv::Mat::zeros(size_grid1, CV_8UC1);
-  cv::Mat mask1_updated = mask0.clone();
+  cv::Mat grid_2d_grid1 = image_pool->acquire(size_grid1.height, size_grid1.width, CV_8UC1).setTo(0);
+  cv::Mat mask1_updated = image_pool->acquire(mask0.rows, mask0.cols, mask0.type());
+  mask0.copyTo(mask1_updated);
   it0 = pts1.begin();
   it1 = ids1.begin();
   while (it0 != pts1.end()) {
@@ -792,7 +795,7 @@ void TrackKLT::perform_detection_stereo(const std::vector<cv::Mat> &img0pyr, con
     // Grider_FAST::perform_griding(img1pyr.at(0), mask1_updated, pts1_ext, num_features, grid_x, grid_y, threshold, true);
 
     // We also check a downsampled mask such that we don't extract in areas where it is all masked!
-    cv::Mat mask1_grid;
+    cv::Mat mask1_grid = image_pool->acquire(size_grid1.height, size_grid1.width, mask1.type());
     cv::resize(mask1, mask1_grid, size_grid1, 0.0, 0.0, cv::INTER_NEAREST);
 
     // Create grids we need to extract from and then extract our features (use fast with griding)
@@ -155,6 +155,9 @@ protected:
   std::map<size_t, std::vector<cv::Mat>> img_pyramid_last;
   std::map<size_t, cv::Mat> img_curr;
   std::map<size_t, std::vector<cv::Mat>> img_pyramid_curr;
+
+  // Histogram equalizer (only created if we use CLAHE)
+  cv::Ptr<cv::CLAHE> clahe;
 };
 
 } // namespace ov_core
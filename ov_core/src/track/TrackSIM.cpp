@@ -24,12 +24,15 @@
 #include "cam/CamBase.h"
 #include "feat/Feature.h"
 #include "feat/FeatureDatabase.h"
+#include "utils/trace.h"
 
 using namespace ov_core;
 
 void TrackSIM::feed_measurement_simulation(double timestamp, const std::vector<int> &camids,
                                            const std::vector<std::vector<std::pair<size_t, Eigen::VectorXf>>> &feats) {
 
+  OV_TRACE_SCOPE("track simulation");
+
   // Assert our two vectors are equal
   assert(camids.size() == feats.size());
 
@@ -57,12 +60,11 @@ void TrackSIM::feed_measurement_simulation(double timestamp, const std::vector<i
       kpt.pt.y = feat.second(1);
       good_left.push_back(kpt);
       good_ids_left.push_back(id);
-
-      // Append to the database
-      cv::Point2f npt_l = camera_calib.at(cam_id)->undistort_cv(kpt.pt);
-      database->update_feature(id, timestamp, cam_id, kpt.pt.x, kpt.pt.y, npt_l.x, npt_l.y);
     }
 
+    // Append to the database
+    update_database(timestamp, cam_id, good_left, good_ids_left);
+
     // Get our width and height
     int width = camera_calib.at(cam_id)->w();
     int height = camera_calib.at(cam_id)->h();
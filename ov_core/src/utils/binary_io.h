@@ -0,0 +1,102 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_CORE_BINARY_IO_H
+#define OV_CORE_BINARY_IO_H
+
+#include <Eigen/Eigen>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+
+namespace ov_core {
+
+/**
+ * @brief Helper functions for writing and reading our checkpoint files
+ *
+ * Values are written in their native binary representation (we do not swap endianness).
+ * Thus a checkpoint can only be read on a machine with the same architecture as the one that wrote it.
+ * All read functions return false if the stream ran out of data (or failed), in which case the value should not be used.
+ */
+namespace binary_io {
+
+/**
+ * @brief Writes a plain value (e.g. int, double, bool)
+ * @param out Stream we will write to
+ * @param val Value to write
+ */
+template <typename T> inline void write(std::ostream &out, const T &val) {
+  static_assert(std::is_trivially_copyable<T>::value, "can only write plain values");
+  out.write(reinterpret_cast<const char *>(&val), sizeof(T));
+}
+
+/**
+ * @brief Reads a plain value (e.g. int, double, bool)
+ * @param in Stream we will read from
+ * @param val Value we read
+ * @return True if we were able to read it
+ */
+template <typename T> inline bool read(std::istream &in, T &val) {
+  static_assert(std::is_trivially_copyable<T>::value, "can only read plain values");
+  in.read(reinterpret_cast<char *>(&val), sizeof(T));
+  return in.good();
+}
+
+/**
+ * @brief Writes a matrix, its size followed by the column-major values
+ * @param out Stream we will write to
+ * @param mat Matrix to write
+ */
+template <typename Derived> inline void write_matrix(std::ostream &out, const Eigen::MatrixBase<Derived> &mat) {
+  typedef typename Derived::Scalar Scalar;
+  write(out, (int32_t)mat.rows());
+  write(out, (int32_t)mat.cols());
+  Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> tmp = mat;
+  out.write(reinterpret_cast<const char *>(tmp.data()), (std::streamsize)(sizeof(Scalar) * tmp.size()));
+}
+
+/**
+ * @brief Reads a matrix that was written with write_matrix()
+ * @param in Stream we will read from
+ * @param mat Matrix we read, fixed size matrices need to match the size that was written
+ * @return True if we were able to read it
+ */
+template <typename Scalar, int Rows, int Cols, int Options, int MaxRows, int MaxCols>
+inline bool read_matrix(std::istream &in, Eigen::Matrix<Scalar, Rows, Cols, Options, MaxRows, MaxCols> &mat) {
+  int32_t rows, cols;
+  if (!read(in, rows) || !read(in, cols) || rows < 0 || cols < 0)
+    return false;
+  if ((Rows != Eigen::Dynamic && rows != Rows) || (Cols != Eigen::Dynamic && cols != Cols))
+    return false;
+  Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> tmp(rows, cols);
+  in.read(reinterpret_cast<char *>(tmp.data()), (std::streamsize)(sizeof(Scalar) * tmp.size()));
+  if (!in.good())
+    return false;
+  mat = tmp;
+  return true;
+}
+
+} // namespace binary_io
+
+} // namespace ov_core
+
+#endif // OV_CORE_BINARY_IO_H
@@ -0,0 +1,74 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "image_pool.h"
+
+#include <algorithm>
+
+using namespace ov_core;
+
+cv::Mat ImagePool::acquire(int rows, int cols, int type) {
+  std::lock_guard<std::mutex> lck(mtx);
+  acquired++;
+  for (const auto &image : images) {
+    if (image.rows == rows && image.cols == cols && image.type() == type && is_free(image))
+      return image;
+  }
+
+  // Nothing free, so we need a new one
+  // If we have too many, then the unused ones are likely of a size that is no longer requested
+  if (images.size() >= max_buffers) {
+    images.erase(std::remove_if(images.begin(), images.end(), [](const cv::Mat &image) { return is_free(image); }), images.end());
+  }
+  images.push_back(cv::Mat(rows, cols, type));
+  allocations++;
+  return images.back();
+}
+
+void ImagePool::build_pyramid(const cv::Mat &img, std::vector<cv::Mat> &pyramid, const cv::Size &win_size, int max_level) {
+  std::lock_guard<std::mutex> lck(mtx);
+  acquired++;
+
+  // Find a pyramid where none of the levels are referenced anymore
+  size_t idx = 0;
+  for (; idx < pyramids.size(); idx++) {
+    if (std::all_of(pyramids.at(idx).begin(), pyramids.at(idx).end(), [](const cv::Mat &level) { return level.empty() || is_free(level); }))
+      break;
+  }
+  if (idx == pyramids.size()) {
+    if (pyramids.size() >= max_buffers)
+      pyramids.clear();
+    idx = pyramids.size();
+    pyramids.emplace_back();
+  }
+
+  // Build into it, any level OpenCV could not reuse is a new allocation
+  std::vector<cv::Mat> &levels = pyramids.at(idx);
+  std::vector<const cv::UMatData *> buffers_before;
+  for (const auto &level : levels)
+    buffers_before.push_back(level.u);
+  cv::buildOpticalFlowPyramid(img, levels, win_size, max_level);
+  for (size_t i = 0; i < levels.size(); i++) {
+    if (i >= buffers_before.size() || levels.at(i).u != buffers_before.at(i))
+      allocations++;
+  }
+  pyramid = levels;
+}
@@ -0,0 +1,107 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_CORE_IMAGE_POOL_H
+#define OV_CORE_IMAGE_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace ov_core {
+
+/**
+ * @brief Pool of image buffers which are reused once nobody references them anymore
+ *
+ * Images handed out are normal cv::Mat which share their buffer with the pool.
+ * Once all of these copies have been released (i.e. the pool holds the only reference), the buffer is handed out again.
+ * Thus we do not need to give images back, and after the first few frames tracking does not allocate any new images.
+ * The contents of a reused buffer are whatever was written last, so the caller should overwrite (or clear) them.
+ *
+ * @code{.cpp}
+ * cv::Mat img = pool->acquire(raw.rows, raw.cols, raw.type());
+ * cv::equalizeHist(raw, img); // writes into the pooled buffer since the size and type match
+ * @endcode
+ */
+class ImagePool {
+
+public:
+  /**
+   * @brief Default constructor
+   * @param max_buffers Number of buffers after which we free unused buffers of other sizes
+   */
+  explicit ImagePool(size_t max_buffers = 64) : max_buffers(max_buffers) {}
+
+  /**
+   * @brief Gets an image buffer that nobody else is using, allocating one if none is free
+   * @param rows Number of rows
+   * @param cols Number of columns
+   * @param type OpenCV type (e.g. CV_8UC1)
+   * @return Image of the given size and type, its contents are not cleared
+   */
+  cv::Mat acquire(int rows, int cols, int type);
+
+  /**
+   * @brief Builds the optical flow pyramid (see cv::buildOpticalFlowPyramid) into buffers of the pool
+   *
+   * OpenCV will reuse the levels of an existing pyramid if they have the right size.
+   * Thus we keep a few pyramids and build into one which is no longer referenced.
+   *
+   * @param img Image we want the pyramid of
+   * @param pyramid Output pyramid, shares its buffers with the pool
+   * @param win_size Window size of the optical flow (levels are padded by this)
+   * @param max_level Max zero-based pyramid level
+   */
+  void build_pyramid(const cv::Mat &img, std::vector<cv::Mat> &pyramid, const cv::Size &win_size, int max_level);
+
+  /// Total number of image buffers we have allocated (including pyramid levels)
+  size_t num_allocations() const { return allocations.load(); }
+
+  /// Total number of images and pyramids we have handed out
+  size_t num_acquired() const { return acquired.load(); }
+
+private:
+  /// If the pool holds the only reference to this buffer
+  static bool is_free(const cv::Mat &mat) { return mat.u != nullptr && mat.u->refcount == 1; }
+
+  /// Mutex for our buffers
+  std::mutex mtx;
+
+  /// Single image buffers
+  std::vector<cv::Mat> images;
+
+  /// Pyramid buffers (each is the output of a previous cv::buildOpticalFlowPyramid call)
+  std::vector<std::vector<cv::Mat>> pyramids;
+
+  /// Number of buffers after which we start to free unused ones
+  size_t max_buffers;
+
+  /// Statistics of how often we had to allocate
+  std::atomic<size_t> allocations{0};
+  std::atomic<size_t> acquired{0};
+};
+
+} // namespace ov_core
+
+#endif // OV_CORE_IMAGE_POOL_H
@@ -0,0 +1,177 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "metrics.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "utils/colors.h"
+#include "utils/print.h"
+
+using namespace ov_core;
+
+namespace {
+
+/// Key of a series in the Prometheus text format (e.g. `name{labels}`)
+std::string series_key(const std::string &name, const std::string &labels) {
+  return labels.empty() ? name : name + "{" + labels + "}";
+}
+
+/// Key of a histogram bucket series, the le label is placed after the user ones
+std::string bucket_key(const std::string &name, const std::string &labels, const std::string &le) {
+  return name + "_bucket{" + (labels.empty() ? "" : labels + ",") + "le=\"" + le + "\"}";
+}
+
+} // namespace
+
+MetricHistogram::MetricHistogram(const std::vector<double> &bounds_) : bounds(bounds_) {
+  counts.reset(new std::atomic<uint64_t>[bounds.size() + 1]);
+  for (size_t i = 0; i < bounds.size() + 1; i++) {
+    counts[i].store(0);
+  }
+}
+
+void MetricHistogram::observe(double val) {
+  size_t idx = 0;
+  while (idx < bounds.size() && val > bounds.at(idx))
+    idx++;
+  counts[idx].fetch_add(1, std::memory_order_relaxed);
+  // There is no atomic add for doubles, but there typically is only a single thread observing
+  double sum_old = sum.load(std::memory_order_relaxed);
+  while (!sum.compare_exchange_weak(sum_old, sum_old + val, std::memory_order_relaxed)) {
+  }
+}
+
+std::vector<uint64_t> MetricHistogram::get_counts() const {
+  std::vector<uint64_t> cumulative(bounds.size() + 1, 0);
+  uint64_t total = 0;
+  for (size_t i = 0; i < bounds.size() + 1; i++) {
+    total += counts[i].load(std::memory_order_relaxed);
+    cumulative.at(i) = total;
+  }
+  return cumulative;
+}
+
+MetricsRegistry::Family &MetricsRegistry::get_family(const std::string &name, const std::string &help, const std::string &type) {
+  auto it = families.find(name);
+  if (it == families.end()) {
+    Family family;
+    family.help = help;
+    family.type = type;
+    it = families.insert({name, family}).first;
+  }
+  if (it->second.type != type) {
+    PRINT_ERROR(RED "[METRICS]: metric %s is already registered as a %s (not %s)\n" RESET, name.c_str(), it->second.type.c_str(),
+                type.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+  return it->second;
+}
+
+std::shared_ptr<MetricCounter> MetricsRegistry::counter(const std::string &name, const std::string &help, const std::string &labels) {
+  std::lock_guard<std::mutex> lck(mtx);
+  Family &family = get_family(name, help, "counter");
+  if (family.counters.find(labels) == family.counters.end())
+    family.counters.insert({labels, std::make_shared<MetricCounter>()});
+  return family.counters.at(labels);
+}
+
+std::shared_ptr<MetricGauge> MetricsRegistry::gauge(const std::string &name, const std::string &help, const std::string &labels) {
+  std::lock_guard<std::mutex> lck(mtx);
+  Family &family = get_family(name, help, "gauge");
+  if (family.gauges.find(labels) == family.gauges.end())
+    family.gauges.insert({labels, std::make_shared<MetricGauge>()});
+  return family.gauges.at(labels);
+}
+
+std::shared_ptr<MetricHistogram> MetricsRegistry::histogram(const std::string &name, const std::string &help,
+                                                            const std::vector<double> &bounds, const std::string &labels) {
+  std::lock_guard<std::mutex> lck(mtx);
+  Family &family = get_family(name, help, "histogram");
+  if (family.histograms.find(labels) == family.histograms.end())
+    family.histograms.insert({labels, std::make_shared<MetricHistogram>(bounds)});
+  return family.histograms.at(labels);
+}
+
+void MetricsRegistry::for_each_series(const std::function<void(const std::string &, const Family &)> &on_family,
+                                      const std::function<void(const std::string &, double)> &on_series) const {
+  for (const auto &pair : families) {
+    const std::string &name = pair.first;
+    const Family &family = pair.second;
+    on_family(name, family);
+    for (const auto &counter : family.counters) {
+      on_series(series_key(name, counter.first), (double)counter.second->get());
+    }
+    for (const auto &gauge : family.gauges) {
+      on_series(series_key(name, gauge.first), gauge.second->get());
+    }
+    for (const auto &histogram : family.histograms) {
+      const std::string &labels = histogram.first;
+      const std::vector<double> &bounds = histogram.second->get_bounds();
+      std::vector<uint64_t> counts = histogram.second->get_counts();
+      for (size_t i = 0; i < bounds.size(); i++) {
+        std::ostringstream le;
+        le << bounds.at(i);
+        on_series(bucket_key(name, labels, le.str()), (double)counts.at(i));
+      }
+      on_series(bucket_key(name, labels, "+Inf"), (double)counts.back());
+      on_series(series_key(name + "_sum", labels), histogram.second->get_sum());
+      on_series(series_key(name + "_count", labels), (double)counts.back());
+    }
+  }
+}
+
+std::map<std::string, double> MetricsRegistry::snapshot() const {
+  std::lock_guard<std::mutex> lck(mtx);
+  std::map<std::string, double> values;
+  for_each_series([](const std::string &, const Family &) {}, [&](const std::string &key, double value) { values[key] = value; });
+  return values;
+}
+
+std::string MetricsRegistry::to_prometheus() const {
+  std::lock_guard<std::mutex> lck(mtx);
+  std::ostringstream ss;
+  ss.precision(10);
+  for_each_series(
+      [&](const std::string &name, const Family &family) {
+        ss << "# HELP " << name << " " << family.help << "\n";
+        ss << "# TYPE " << name << " " << family.type << "\n";
+      },
+      [&](const std::string &key, double value) { ss << key << " " << value << "\n"; });
+  return ss.str();
+}
+
+bool MetricsRegistry::write_prometheus(const std::string &path) const {
+  std::string text = to_prometheus();
+  std::string path_tmp = path + ".tmp";
+  {
+    std::ofstream file(path_tmp, std::ofstream::out | std::ofstream::trunc);
+    if (!file.is_open())
+      return false;
+    file << text;
+    if (!file.good())
+      return false;
+  }
+  return std::rename(path_tmp.c_str(), path.c_str()) == 0;
+}
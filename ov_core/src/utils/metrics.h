@@ -0,0 +1,206 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_CORE_METRICS_H
+#define OV_CORE_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ov_core {
+
+/**
+ * @brief Monotonically increasing count (e.g. number of features rejected)
+ */
+class MetricCounter {
+public:
+  /// Increments the counter
+  void add(uint64_t count = 1) { value.fetch_add(count, std::memory_order_relaxed); }
+
+  /// Current value of the counter
+  uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> value{0};
+};
+
+/**
+ * @brief Value which can go up and down (e.g. current state size)
+ */
+class MetricGauge {
+public:
+  /// Sets the current value
+  void set(double val) { value.store(val, std::memory_order_relaxed); }
+
+  /// Current value of the gauge
+  double get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<double> value{0.0};
+};
+
+/**
+ * @brief Distribution of observed values over fixed buckets (e.g. latency of a stage)
+ *
+ * We follow the Prometheus convention where each bucket counts the values which are less or equal to its upper bound.
+ * The counts are stored per bucket and made cumulative when read.
+ */
+class MetricHistogram {
+public:
+  /**
+   * @brief Creates the histogram
+   * @param bounds Upper bounds of the buckets (should be increasing), a +Inf bucket is always added
+   */
+  explicit MetricHistogram(const std::vector<double> &bounds);
+
+  /**
+   * @brief Adds a value to the histogram
+   * @param val Value which we have observed
+   */
+  void observe(double val);
+
+  /// Upper bounds of our buckets (without the +Inf one)
+  const std::vector<double> &get_bounds() const { return bounds; }
+
+  /// Cumulative count of each bucket (the last is the +Inf one, thus the total count)
+  std::vector<uint64_t> get_counts() const;
+
+  /// Sum of all observed values
+  double get_sum() const { return sum.load(std::memory_order_relaxed); }
+
+private:
+  std::vector<double> bounds;
+  std::unique_ptr<std::atomic<uint64_t>[]> counts;
+  std::atomic<double> sum{0.0};
+};
+
+/**
+ * @brief Registry of named counters, gauges and histograms which can be read as a snapshot or Prometheus text
+ *
+ * Metrics should be registered once and the returned handle kept by whoever updates it.
+ * Updating a handle is a single relaxed atomic operation, so this is cheap enough to do in the hot paths.
+ * Only registering and reading the metrics will lock, thus there is almost no overhead if nobody reads them.
+ * Registering the same name and labels again will return the existing metric.
+ *
+ * @code{.cpp}
+ * auto metrics = std::make_shared<ov_core::MetricsRegistry>();
+ * auto lost = metrics->counter("ov_features_lost_total", "Number of features lost", "cam=\"0\"");
+ * lost->add(5);
+ * metrics->write_prometheus("/tmp/ov.prom");
+ * @endcode
+ */
+class MetricsRegistry {
+public:
+  /**
+   * @brief Gets (or creates) a counter
+   * @param name Name of the metric (should follow the Prometheus naming, e.g. end in _total)
+   * @param help Description of the metric
+   * @param labels Labels of this series (e.g. `cam="0"`), can be empty
+   * @return Handle to the counter
+   */
+  std::shared_ptr<MetricCounter> counter(const std::string &name, const std::string &help, const std::string &labels = "");
+
+  /**
+   * @brief Gets (or creates) a gauge
+   * @param name Name of the metric
+   * @param help Description of the metric
+   * @param labels Labels of this series (e.g. `cam="0"`), can be empty
+   * @return Handle to the gauge
+   */
+  std::shared_ptr<MetricGauge> gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+
+  /**
+   * @brief Gets (or creates) a histogram
+   * @param name Name of the metric
+   * @param help Description of the metric
+   * @param bounds Upper bounds of the buckets (only used if the histogram is created)
+   * @param labels Labels of this series (e.g. `stage="tracking"`), can be empty
+   * @return Handle to the histogram
+   */
+  std::shared_ptr<MetricHistogram> histogram(const std::string &name, const std::string &help, const std::vector<double> &bounds,
+                                             const std::string &labels = "");
+
+  /**
+   * @brief Reads the current value of all series
+   *
+   * The keys are the series as they would appear in the Prometheus text (e.g. `name{labels}`).
+   * Histograms are expanded into their `_bucket`, `_sum` and `_count` series.
+   *
+   * @return Map between series and their current value
+   */
+  std::map<std::string, double> snapshot() const;
+
+  /// All metrics in the Prometheus text exposition format
+  std::string to_prometheus() const;
+
+  /**
+   * @brief Writes all metrics in the Prometheus text format to file
+   *
+   * We first write to a temporary file and then rename it, so a scraper (e.g. node_exporter textfile collector) never sees a partial file.
+   *
+   * @param path Path of the file (should end in .prom)
+   * @return True if the file was written
+   */
+  bool write_prometheus(const std::string &path) const;
+
+private:
+  /// All series which share a name
+  struct Family {
+    std::string help;
+    std::string type;
+    std::map<std::string, std::shared_ptr<MetricCounter>> counters;
+    std::map<std::string, std::shared_ptr<MetricGauge>> gauges;
+    std::map<std::string, std::shared_ptr<MetricHistogram>> histograms;
+  };
+
+  /**
+   * @brief Gets the family of the name, creating it if needed
+   * @param name Name of the metric
+   * @param help Description of the metric
+   * @param type Prometheus type of the metric
+   * @return Family of this name (we exit if it was registered with a different type)
+   */
+  Family &get_family(const std::string &name, const std::string &help, const std::string &type);
+
+  /**
+   * @brief Calls the function on each family and then each of its series (must be holding the mutex)
+   * @param on_family Called with the name of each family
+   * @param on_series Called with the series key and value
+   */
+  void for_each_series(const std::function<void(const std::string &, const Family &)> &on_family,
+                       const std::function<void(const std::string &, double)> &on_series) const;
+
+  /// Mutex for registering and reading
+  mutable std::mutex mtx;
+
+  /// Our metrics by name
+  std::map<std::string, Family> families;
+};
+
+} // namespace ov_core
+
+#endif // OV_CORE_METRICS_H
@@ -21,10 +21,19 @@
 
 #include "print.h"
 
+#include <cstdio>
+
 using namespace ov_core;
 
 // Need to define the static variable for everything to work
-Printer::PrintLevel Printer::current_print_level = PrintLevel::INFO;
+std::atomic<Printer::PrintLevel> Printer::current_print_level(PrintLevel::INFO);
+
+namespace {
+
+/// Print settings of the current thread
+thread_local Printer::ThreadContext thread_context;
+
+} // namespace
 
 void Printer::setPrintLevel(const std::string &level) {
   if (level == "ALL")
@@ -77,28 +86,45 @@ void Printer::setPrintLevel(PrintLevel level) {
   std::cout << std::endl;
 }
 
+void Printer::setThreadContext(const ThreadContext &context) { thread_context = context; }
+
+Printer::ThreadContext Printer::getThreadContext() { return thread_context; }
+
 void Printer::debugPrint(PrintLevel level, const char location[], const char line[], const char *format, ...) {
-  // Only print for the current debug level
-  if (static_cast<int>(level) < static_cast<int>(Printer::current_print_level)) {
+  // Only print for the current debug level (of this thread if it has one)
+  int print_level = (thread_context.level >= 0) ? thread_context.level : static_cast<int>(Printer::current_print_level.load());
+  if (static_cast<int>(level) < print_level) {
     return;
   }
 
+  // We build the whole line first and then print it at once
+  // This ensures that lines of different threads are not mixed together
+  std::string text = thread_context.prefix;
+
   // Print the location info first for our debug output
   // Truncate the filename to the max size for the filepath
-  if (static_cast<int>(Printer::current_print_level) <= static_cast<int>(Printer::PrintLevel::DEBUG)) {
+  if (print_level <= static_cast<int>(Printer::PrintLevel::DEBUG)) {
     std::string path(location);
     std::string base_filename = path.substr(path.find_last_of("/\\") + 1);
     if (base_filename.size() > MAX_FILE_PATH_LEGTH) {
-      printf("%s", base_filename.substr(base_filename.size() - MAX_FILE_PATH_LEGTH, base_filename.size()).c_str());
+      text += base_filename.substr(base_filename.size() - MAX_FILE_PATH_LEGTH, base_filename.size());
     } else {
-      printf("%s", base_filename.c_str());
+      text += base_filename;
     }
-    printf(":%s ", line);
+    text += ":" + std::string(line) + " ";
   }
 
   // Print the rest of the args
-  va_list args;
+  va_list args, args_size;
   va_start(args, format);
-  vprintf(format, args);
+  va_copy(args_size, args);
+  int size = vsnprintf(nullptr, 0, format, args_size);
+  va_end(args_size);
+  if (size > 0) {
+    std::string message((size_t)size + 1, '\0');
+    vsnprintf(&message[0], message.size(), format, args);
+    text.append(message.c_str(), (size_t)size);
+  }
   va_end(args);
+  fwrite(text.data(), 1, text.size(), stdout);
 }
@@ -22,6 +22,7 @@
 #ifndef OV_CORE_PRINT_H
 #define OV_CORE_PRINT_H
 
+#include <atomic>
 #include <cstdarg>
 #include <cstdint>
 #include <cstring>
@@ -38,6 +39,15 @@ namespace ov_core {
  * ov_core::Printer::setPrintLevel("WARNING");
  * ov_core::Printer::setPrintLevel(ov_core::Printer::PrintLevel::WARNING);
  * @endcode
+ *
+ * If multiple systems run in one process, each thread can override the global level and prefix its output.
+ * Threads started by a system should copy the context of the thread that created the system:
+ * @code{.cpp}
+ * ov_core::Printer::ThreadContext context;
+ * context.level = ov_core::Printer::PrintLevel::WARNING;
+ * context.prefix = "[euroc_v101] ";
+ * ov_core::Printer::setThreadContext(context);
+ * @endcode
  */
 class Printer {
 public:
@@ -53,6 +63,18 @@ public:
    */
   enum PrintLevel { ALL = 0, DEBUG = 1, INFO = 2, WARNING = 3, ERROR = 4, SILENT = 5 };
 
+  /**
+   * @brief Print settings of a single thread
+   */
+  struct ThreadContext {
+
+    /// Print level of this thread (negative to use the global one)
+    int level = -1;
+
+    /// Text printed before each line of this thread (e.g. the name of the dataset)
+    std::string prefix;
+  };
+
   /**
    * @brief Set the print level to use for all future printing to stdout.
    * @param level The debug level to use
@@ -65,6 +87,15 @@ public:
    */
   static void setPrintLevel(PrintLevel level);
 
+  /**
+   * @brief Set the print settings of the calling thread, these override the global print level
+   * @param context The settings to use
+   */
+  static void setThreadContext(const ThreadContext &context);
+
+  /// Get the print settings of the calling thread
+  static ThreadContext getThreadContext();
+
   /**
    * @brief The print function that prints to stdout.
    * @param level the print level for this print call
@@ -75,7 +106,7 @@ public:
   static void debugPrint(PrintLevel level, const char location[], const char line[], const char *format, ...);
 
   /// The current print level
-  static PrintLevel current_print_level;
+  static std::atomic<PrintLevel> current_print_level;
 
 private:
   /// The max length for the file path.  This is to avoid very long file paths from
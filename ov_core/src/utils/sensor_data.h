@@ -23,6 +23,7 @@
 #define OV_CORE_SENSOR_DATA_H
 
 #include <Eigen/Eigen>
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include <vector>
 
@@ -66,6 +67,14 @@ struct CameraData {
   /// Tracking masks for each camera we have
   std::vector<cv::Mat> masks;
 
+  /**
+   * @brief Owners of memory the images and masks point into (e.g. the ROS message we got the image from)
+   *
+   * This allows for images to be borrowed instead of copied, the memory is kept alive as long as this measurement is.
+   * Thus nobody should ever write into the images or masks of a measurement, they should be treated as read-only.
+   */
+  std::vector<std::shared_ptr<const void>> owners;
+
   /// Sort function to allow for using of STL containers
   bool operator<(const CameraData &other) const {
     if (timestamp == other.timestamp) {
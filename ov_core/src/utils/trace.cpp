@@ -0,0 +1,239 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+using namespace ov_core;
+
+namespace ov_core {
+
+/// Single producer (owning thread) single consumer (collector) ring buffer of events
+struct TraceBuffer {
+  std::vector<TraceEvent> events = std::vector<TraceEvent>(Trace::buffer_size);
+  std::atomic<size_t> head{0}, tail{0};
+  std::atomic<bool> owned{true};
+  uint32_t thread = 0;
+};
+
+} // namespace ov_core
+
+namespace {
+
+/// Context of threads which have not been given one
+/// NOTE: we leak this so it is still valid if other static objects record while being destroyed
+TraceContext *default_context() {
+  static TraceContext *context = new TraceContext();
+  return context;
+}
+
+/// Scope nesting, context and the ring buffer of each context the current thread has recorded into
+struct TraceThreadState {
+  std::shared_ptr<TraceContext> context;
+  std::vector<std::pair<uint64_t, std::shared_ptr<TraceBuffer>>> buffers;
+  uint32_t depth = 0;
+  double stamp = -1;
+  ~TraceThreadState() {
+    for (const auto &buffer : buffers)
+      buffer.second->owned = false;
+  }
+};
+thread_local TraceThreadState thread_state;
+
+/// Ring buffer of the calling thread for the given context (normally a thread only ever uses one)
+TraceBuffer &thread_buffer(TraceThreadState &state, TraceContext &context) {
+  for (const auto &buffer : state.buffers) {
+    if (buffer.first == context.id())
+      return *buffer.second;
+  }
+  // Forget the buffers of contexts which have been destroyed (we hold the last reference)
+  auto it = state.buffers.begin();
+  while (it != state.buffers.end()) {
+    it = (it->second.use_count() == 1) ? state.buffers.erase(it) : it + 1;
+  }
+  state.buffers.emplace_back(context.id(), context.acquire_buffer());
+  return *state.buffers.back().second;
+}
+
+} // namespace
+
+TraceContext::TraceContext() {
+  static std::atomic<uint64_t> next_id(0);
+  context_id = next_id++;
+}
+
+std::shared_ptr<TraceBuffer> TraceContext::acquire_buffer() {
+  std::lock_guard<std::mutex> lck(buffers_mtx);
+  for (const auto &buffer : buffers) {
+    if (!buffer->owned && buffer->head.load() == buffer->tail.load()) {
+      buffer->owned = true;
+      return buffer;
+    }
+  }
+  std::shared_ptr<TraceBuffer> buffer = std::make_shared<TraceBuffer>();
+  buffer->thread = (uint32_t)buffers.size();
+  buffers.push_back(buffer);
+  return buffer;
+}
+
+void TraceContext::collect(std::vector<TraceEvent> &events) {
+  std::lock_guard<std::mutex> lck(buffers_mtx);
+  for (const auto &buffer : buffers) {
+    size_t tail = buffer->tail.load(std::memory_order_relaxed);
+    size_t head = buffer->head.load(std::memory_order_acquire);
+    for (size_t i = tail; i < head; i++) {
+      events.push_back(buffer->events.at(i % Trace::buffer_size));
+    }
+    buffer->tail.store(head, std::memory_order_release);
+  }
+}
+
+void Trace::setThreadContext(const std::shared_ptr<TraceContext> &context) { thread_state.context = context; }
+
+std::shared_ptr<TraceContext> Trace::getThreadContext() { return thread_state.context; }
+
+TraceContext *Trace::context() {
+  TraceThreadState &state = thread_state;
+  return (state.context != nullptr) ? state.context.get() : default_context();
+}
+
+void Trace::record(const TraceEvent &event) {
+#if OV_ENABLE_TRACING
+  TraceContext &ctx = *context();
+  if (!ctx.enabled())
+    return;
+  TraceBuffer &buffer = thread_buffer(thread_state, ctx);
+
+  // Drop the event if the collector has not caught up
+  size_t head = buffer.head.load(std::memory_order_relaxed);
+  size_t tail = buffer.tail.load(std::memory_order_acquire);
+  if (head - tail >= buffer_size) {
+    ctx.count_dropped();
+    return;
+  }
+  TraceEvent &slot = buffer.events.at(head % buffer_size);
+  slot = event;
+  slot.thread = buffer.thread;
+  buffer.head.store(head + 1, std::memory_order_release);
+#endif
+}
+
+TraceScope::TraceScope(const char *name, double stamp) {
+  TraceThreadState &state = thread_state;
+  event.name = name;
+  event.stamp = (stamp >= 0) ? stamp : state.stamp;
+  event.depth = state.depth++;
+  stamp_parent = state.stamp;
+  state.stamp = event.stamp;
+  event.start_ns = Trace::now_ns();
+}
+
+double TraceScope::stop() {
+  if (running) {
+    event.duration_ns = Trace::now_ns() - event.start_ns;
+    running = false;
+    TraceThreadState &state = thread_state;
+    state.depth--;
+    state.stamp = stamp_parent;
+    Trace::record(event);
+  }
+  return 1e-9 * (double)event.duration_ns;
+}
+
+TraceChromeWriter::TraceChromeWriter(const std::string &path) {
+  file.open(path, std::ofstream::out | std::ofstream::trunc);
+  file << "[" << std::endl;
+}
+
+TraceChromeWriter::~TraceChromeWriter() {
+  if (file.is_open()) {
+    file << std::endl << "]" << std::endl;
+    file.close();
+  }
+}
+
+void TraceChromeWriter::append(const std::vector<TraceEvent> &events) {
+  if (!file.is_open())
+    return;
+  for (const auto &event : events) {
+    // Complete events ("X") have their start and duration in microseconds
+    file << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"ov\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread
+         << std::fixed << std::setprecision(3) << ",\"ts\":" << 1e-3 * (double)event.start_ns
+         << ",\"dur\":" << 1e-3 * (double)event.duration_ns << std::setprecision(6) << ",\"args\":{\"stamp\":" << event.stamp
+         << ",\"depth\":" << event.depth << "}}";
+    first = false;
+  }
+  file.flush();
+}
+
+TraceTimingWriter::TraceTimingWriter(const std::string &path, const std::vector<std::string> &stages_) : stages(stages_) {
+  file.open(path, std::ofstream::out | std::ofstream::trunc);
+  file << "# timestamp (sec),";
+  for (const auto &stage : stages) {
+    file << stage << ",";
+  }
+  file << "total" << std::endl;
+}
+
+void TraceTimingWriter::append(const std::vector<TraceEvent> &events) {
+  if (!file.is_open() || stages.empty())
+    return;
+
+  // Sum up the durations of our stages for each stamp
+  // The last element is the count of the last stage so we know which have finished
+  for (const auto &event : events) {
+    if (event.stamp < 0)
+      continue;
+    for (size_t i = 0; i < stages.size(); i++) {
+      if (stages.at(i) != event.name)
+        continue;
+      std::vector<double> &row = pending[event.stamp];
+      row.resize(stages.size() + 1, 0.0);
+      row.at(i) += 1e-9 * (double)event.duration_ns;
+      if (i + 1 == stages.size())
+        row.back() += 1.0;
+    }
+  }
+
+  // Write all finished rows, and drop the older ones which never finished
+  auto it = pending.begin();
+  double last_finished = -1;
+  for (const auto &row : pending) {
+    if (row.second.back() > 0.0)
+      last_finished = row.first;
+  }
+  while (it != pending.end() && it->first <= last_finished) {
+    if (it->second.back() > 0.0) {
+      double total = 0.0;
+      file << std::fixed << std::setprecision(15) << it->first << "," << std::fixed << std::setprecision(5);
+      for (size_t i = 0; i < stages.size(); i++) {
+        file << it->second.at(i) << ",";
+        total += it->second.at(i);
+      }
+      file << total << std::endl;
+    }
+    it = pending.erase(it);
+  }
+  file.flush();
+}
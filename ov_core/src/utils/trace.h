@@ -0,0 +1,332 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_CORE_TRACE_H
+#define OV_CORE_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Compile time kill switch, if zero the OV_TRACE_SCOPE macros are removed and nothing will be recorded
+// Note that the TraceScope objects will still time themselves since the estimator uses those timings
+#ifndef OV_ENABLE_TRACING
+#define OV_ENABLE_TRACING 1
+#endif
+
+namespace ov_core {
+
+/**
+ * @brief A single finished trace scope
+ */
+struct TraceEvent {
+
+  /// Name of the scope (needs to be a string literal since we only store the pointer)
+  const char *name = nullptr;
+
+  /// Timestamp of the data this scope worked on (e.g. camera time), inherited from the parent scope if not given
+  double stamp = -1;
+
+  /// Id of the trace buffer (thread) this was recorded on
+  uint32_t thread = 0;
+
+  /// How many scopes this was nested in
+  uint32_t depth = 0;
+
+  /// Steady clock time in nanoseconds that this scope started
+  int64_t start_ns = 0;
+
+  /// How long this scope was in nanoseconds
+  int64_t duration_ns = 0;
+};
+
+struct TraceBuffer;
+
+/**
+ * @brief Recording state of one system (e.g. one VioManager): its enable flag and the ring buffers of its threads
+ *
+ * Each thread records into the context it has been given with Trace::setThreadContext().
+ * Threads which have not been given one use a process wide default context.
+ * Thus multiple systems in one process can enable and collect their own events without seeing the ones of the others.
+ */
+class TraceContext {
+public:
+  /// Creates a new context, recording is off until enabled
+  TraceContext();
+
+  /**
+   * @brief Enable or disable recording of events
+   * @param enabled If finished scopes should be recorded
+   */
+  void set_enabled(bool enabled) { is_enabled.store(enabled, std::memory_order_relaxed); }
+
+  /// If we are currently recording events
+  bool enabled() const { return is_enabled.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Moves all recorded events of all threads of this context into the given vector
+   * @param events Vector we will append the events to
+   */
+  void collect(std::vector<TraceEvent> &events);
+
+  /// Number of events which have been dropped since the ring buffer of their thread was full
+  size_t num_dropped() const { return dropped.load(); }
+
+  /// Unique id of this context (we do not use the address since a new context could be allocated at the same one)
+  uint64_t id() const { return context_id; }
+
+  /// Gets an empty buffer which the calling thread will own (re-uses the ones of finished threads once collected)
+  std::shared_ptr<TraceBuffer> acquire_buffer();
+
+  /// Counts an event which did not fit into the buffer of its thread
+  void count_dropped() { dropped++; }
+
+private:
+  /// Our unique id
+  uint64_t context_id;
+
+  /// If we are recording
+  std::atomic<bool> is_enabled{false};
+
+  /// Number of events we have dropped
+  std::atomic<size_t> dropped{0};
+
+  /// All buffers that have been created for this context
+  std::mutex buffers_mtx;
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+};
+
+/**
+ * @brief Low overhead tracing of scoped code sections
+ *
+ * Each thread records its finished scopes into its own fixed size ring buffer.
+ * Only that thread writes into it and the collector reads from it, so no lock is needed while recording.
+ * If a ring buffer is full (i.e. it has not been collected in a while) new scopes are dropped and counted.
+ * Recording is off until enabled, one can then periodically collect the events and hand them to an exporter.
+ * The static functions act on the TraceContext of the calling thread.
+ *
+ * @code{.cpp}
+ * ov_core::Trace::set_enabled(true);
+ * {
+ *   OV_TRACE_SCOPE("my stage");
+ *   ...
+ * }
+ * std::vector<ov_core::TraceEvent> events;
+ * ov_core::Trace::collect(events);
+ * @endcode
+ *
+ * If multiple systems run in one process, each should have its own context which the threads working for it use:
+ * @code{.cpp}
+ * auto context = std::make_shared<ov_core::TraceContext>();
+ * context->set_enabled(true);
+ * ov_core::Trace::setThreadContext(context);
+ * @endcode
+ */
+class Trace {
+public:
+  /// Number of events each thread can store before they need to be collected
+  static const size_t buffer_size = 4096;
+
+  /**
+   * @brief Set the context the calling thread records into
+   * @param context The context to use (null to use the default one)
+   */
+  static void setThreadContext(const std::shared_ptr<TraceContext> &context);
+
+  /// Get the context the calling thread records into
+  static std::shared_ptr<TraceContext> getThreadContext();
+
+  /**
+   * @brief Enable or disable recording of events of the context of the calling thread
+   * @param enabled If finished scopes should be recorded
+   */
+  static void set_enabled(bool enabled) { context()->set_enabled(enabled); }
+
+  /// If the context of the calling thread is currently recording events
+  static bool enabled() { return context()->enabled(); }
+
+  /// Current steady clock time in nanoseconds
+  static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /**
+   * @brief Records a finished event into the ring buffer of the calling thread
+   * @param event Event we should record
+   */
+  static void record(const TraceEvent &event);
+
+  /**
+   * @brief Moves all recorded events of all threads of the calling thread's context into the given vector
+   * @param events Vector we will append the events to
+   */
+  static void collect(std::vector<TraceEvent> &events) { context()->collect(events); }
+
+  /// Number of events of the calling thread's context which have been dropped since the ring buffer of their thread was full
+  static size_t num_dropped() { return context()->num_dropped(); }
+
+private:
+  /// Context of the calling thread (the default one if none has been set)
+  static TraceContext *context();
+};
+
+/**
+ * @brief RAII helper which sets the trace context of the calling thread and restores the old one once it goes out of scope
+ *
+ * This is used by the functions of a system which are called from the thread of the user.
+ */
+class TraceContextGuard {
+public:
+  /**
+   * @brief Sets the context of the calling thread
+   * @param context The context to use
+   */
+  explicit TraceContextGuard(const std::shared_ptr<TraceContext> &context) : context_old(Trace::getThreadContext()) {
+    Trace::setThreadContext(context);
+  }
+
+  /// Restores the context the thread had before
+  ~TraceContextGuard() { Trace::setThreadContext(context_old); }
+
+private:
+  /// Context of the thread before us
+  std::shared_ptr<TraceContext> context_old;
+};
+
+/**
+ * @brief RAII timer of a code section which records a TraceEvent when it goes out of scope (or is stopped)
+ *
+ * Scopes should be stopped in the reverse order they were created in on each thread.
+ */
+class TraceScope {
+public:
+  /**
+   * @brief Starts the scope
+   * @param name Name of the scope (needs to be a string literal)
+   * @param stamp Timestamp of the data we are working on (if negative we use the one of our parent scope)
+   */
+  explicit TraceScope(const char *name, double stamp = -1);
+
+  /// Stops the scope if it has not been stopped already
+  ~TraceScope() { stop(); }
+
+  /**
+   * @brief Stops and records the scope, calling this again will just return the same duration
+   * @return How long this scope was in seconds
+   */
+  double stop();
+
+private:
+  /// Event we will record
+  TraceEvent event;
+
+  /// Stamp of our parent scope which we restore once stopped
+  double stamp_parent = -1;
+
+  /// If we have not been stopped yet
+  bool running = true;
+};
+
+/**
+ * @brief Writes events in the Chrome trace event format (can be loaded in chrome://tracing or Perfetto)
+ *
+ * We use the JSON array format which does not require the closing bracket.
+ * Thus we can append to the file as events get collected and a crash will still leave a valid trace.
+ */
+class TraceChromeWriter {
+public:
+  /**
+   * @brief Opens the file, if it exists it will be overwritten
+   * @param path Path to the json file
+   */
+  explicit TraceChromeWriter(const std::string &path);
+
+  /// Closes the array and the file
+  ~TraceChromeWriter();
+
+  /**
+   * @brief Appends the events to the file
+   * @param events Events we want to write
+   */
+  void append(const std::vector<TraceEvent> &events);
+
+private:
+  /// Our output file
+  std::ofstream file;
+
+  /// If we have not written an event yet (no leading comma)
+  bool first = true;
+};
+
+/**
+ * @brief Writes per-frame stage times in the csv format of the ov_eval timing scripts
+ *
+ * Each row is a stamp with the summed duration (seconds) of all events of each of the stage names, and their total.
+ * A row is only written once the last stage of that stamp has been collected.
+ * Stamps which will never finish (e.g. the frame was a zero velocity update) are dropped once a newer stamp finishes.
+ * This is the same as the header and values which `timing_flamegraph` and `timing_comparison` expect.
+ */
+class TraceTimingWriter {
+public:
+  /**
+   * @brief Opens the file and writes the header
+   * @param path Path to the csv file
+   * @param stages Names of the events which are our stages (in the order they are run)
+   */
+  TraceTimingWriter(const std::string &path, const std::vector<std::string> &stages);
+
+  /**
+   * @brief Adds the events to their stamps and writes all rows which have finished
+   * @param events Events we want to write
+   */
+  void append(const std::vector<TraceEvent> &events);
+
+private:
+  /// Our output file
+  std::ofstream file;
+
+  /// Names of our stages (columns)
+  std::vector<std::string> stages;
+
+  /// Summed stage durations of stamps we have not written yet
+  std::map<double, std::vector<double>> pending;
+};
+
+} // namespace ov_core
+
+// Helper macros to create a uniquely named scope object
+#define OV_TRACE_CONCAT_INNER(a, b) a##b
+#define OV_TRACE_CONCAT(a, b) OV_TRACE_CONCAT_INNER(a, b)
+#if OV_ENABLE_TRACING
+#define OV_TRACE_SCOPE(name) ov_core::TraceScope OV_TRACE_CONCAT(ov_trace_scope_, __LINE__)(name)
+#define OV_TRACE_SCOPE_STAMP(name, stamp) ov_core::TraceScope OV_TRACE_CONCAT(ov_trace_scope_, __LINE__)(name, stamp)
+#else
+#define OV_TRACE_SCOPE(name)
+#define OV_TRACE_SCOPE_STAMP(name, stamp)
+#endif
+
+#endif // OV_CORE_TRACE_H
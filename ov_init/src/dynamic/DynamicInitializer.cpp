@@ -48,7 +48,8 @@ bool DynamicInitializer::initialize(double &timestamp, Eigen::MatrixXd &covarian
   // Get the newest and oldest timestamps we will try to initialize between!
   auto rT1 = boost::posix_time::microsec_clock::local_time();
   double newest_cam_time = -1;
-  for (auto const &feat : _db->get_internal_data()) {
+  std::shared_ptr<const FeatureDatabase::Snapshot> snapshot_times = _db->get_snapshot();
+  for (auto const &feat : *snapshot_times) {
     for (auto const &camtimepair : feat.second->timestamps) {
       for (auto const &time : camtimepair.second) {
         newest_cam_time = std::max(newest_cam_time, time);
@@ -69,8 +70,8 @@ bool DynamicInitializer::initialize(double &timestamp, Eigen::MatrixXd &covarian
     have_old_imu_readings = true;
     it_imu = imu_data->erase(it_imu);
   }
-  if (_db->get_internal_data().size() < 0.75 * params.init_max_features) {
-    PRINT_WARNING(RED "[init-d]: only %zu valid features of required (%.0f thresh)!!\n" RESET, _db->get_internal_data().size(),
+  if (_db->size() < 0.75 * params.init_max_features) {
+    PRINT_WARNING(RED "[init-d]: only %zu valid features of required (%.0f thresh)!!\n" RESET, _db->size(),
                   0.95 * params.init_max_features);
     return false;
   }
@@ -79,19 +80,12 @@ bool DynamicInitializer::initialize(double &timestamp, Eigen::MatrixXd &covarian
     return false;
   }
 
-  // Now we will make a copy of our features here
+  // Now we will get a snapshot of our features here
   // We do this to ensure that the feature database can continue to have new
   // measurements appended to it in an async-manor so this initialization
   // can be performed in a secondary thread while feature tracking is still performed.
-  std::unordered_map<size_t, std::shared_ptr<Feature>> features;
-  for (const auto &feat : _db->get_internal_data()) {
-    auto feat_new = std::make_shared<Feature>();
-    feat_new->featid = feat.second->featid;
-    feat_new->uvs = feat.second->uvs;
-    feat_new->uvs_norm = feat.second->uvs_norm;
-    feat_new->timestamps = feat.second->timestamps;
-    features.insert({feat.first, feat_new});
-  }
+  std::shared_ptr<const FeatureDatabase::Snapshot> snapshot = _db->get_snapshot();
+  const FeatureDatabase::Snapshot &features = *snapshot;
 
   // ======================================================
   // ======================================================
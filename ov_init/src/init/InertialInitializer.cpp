@@ -79,9 +79,10 @@ bool InertialInitializer::initialize(double &timestamp,
 {
   // Get the newest and oldest timestamps we will try to initialize between!
   double newest_cam_time = -1;
-  for (auto const &feat : _db->get_internal_data()) {         // std::unordered_map<size_t, std::shared_ptr<Feature>>
-    for (auto const &camtimepair : feat.second->timestamps) { // std::unordered_map<size_t, std::vector<double>>
-      for (auto const &time : camtimepair.second) {           // std::vector<double>
+  std::shared_ptr<const FeatureDatabase::Snapshot> snapshot = _db->get_snapshot();
+  for (auto const &feat : *snapshot) {             // std::unordered_map<size_t, std::shared_ptr<const FeatureSnapshot>>
+    for (auto const &camtimepair : feat.second->timestamps) { // SnapshotCameraMap<double>
+      for (auto const &time : camtimepair.second) {           // MeasurementSpan
         newest_cam_time = std::max(newest_cam_time, time);    // code 取最大时间（很传统）
       }
     }
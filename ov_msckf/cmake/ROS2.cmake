@@ -61,6 +61,9 @@ list(APPEND LIBRARY_SOURCES
         src/state/Propagator.cpp
         src/core/VioManager.cpp
         src/core/VioManagerHelper.cpp
+        src/core/InputLog.cpp
+        src/core/OverloadController.cpp
+        src/update/FeatureSelector.cpp
         src/update/UpdaterHelper.cpp
         src/update/UpdaterMSCKF.cpp
         src/update/UpdaterSLAM.cpp
@@ -98,6 +101,16 @@ ament_target_dependencies(run_simulation ${ament_libraries})
 target_link_libraries(run_simulation ov_msckf_lib ${thirdparty_libraries})
 install(TARGETS run_simulation DESTINATION lib/${PROJECT_NAME})
 
+add_executable(replay_msckf src/replay_msckf.cpp)
+ament_target_dependencies(replay_msckf ${ament_libraries})
+target_link_libraries(replay_msckf ov_msckf_lib ${thirdparty_libraries})
+install(TARGETS replay_msckf DESTINATION lib/${PROJECT_NAME})
+
+add_executable(run_batch_msckf src/run_batch_msckf.cpp)
+ament_target_dependencies(run_batch_msckf ${ament_libraries})
+target_link_libraries(run_batch_msckf ov_msckf_lib ${thirdparty_libraries})
+install(TARGETS run_batch_msckf DESTINATION lib/${PROJECT_NAME})
+
 add_executable(test_sim_meas src/test_sim_meas.cpp)
 ament_target_dependencies(test_sim_meas ${ament_libraries})
 target_link_libraries(test_sim_meas ov_msckf_lib ${thirdparty_libraries})
@@ -0,0 +1,182 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "InputLog.h"
+
+#include <cstring>
+
+#include "utils/binary_io.h"
+
+using namespace ov_core;
+using namespace ov_msckf;
+
+namespace {
+
+/// Magic bytes and version at the start of our input logs (the version should be increased if the records change)
+const char input_log_magic[8] = {'O', 'V', 'I', 'N', 'P', 'U', 'T', '\0'};
+const uint32_t input_log_version = 1;
+
+/// Writes the size and type of the image, followed by its pixels row by row
+void write_mat(std::ostream &out, const cv::Mat &mat) {
+  binary_io::write(out, (int32_t)mat.rows);
+  binary_io::write(out, (int32_t)mat.cols);
+  binary_io::write(out, (int32_t)mat.type());
+  size_t row_bytes = mat.cols * mat.elemSize();
+  for (int r = 0; r < mat.rows; r++) {
+    out.write(reinterpret_cast<const char *>(mat.ptr(r)), (std::streamsize)row_bytes);
+  }
+}
+
+/// Reads an image written by write_mat()
+bool read_mat(std::istream &in, cv::Mat &mat) {
+  int32_t rows, cols, type;
+  if (!binary_io::read(in, rows) || !binary_io::read(in, cols) || !binary_io::read(in, type) || rows < 0 || cols < 0)
+    return false;
+  if (rows == 0 || cols == 0) {
+    mat = cv::Mat();
+    return true;
+  }
+  mat = cv::Mat(rows, cols, type);
+  in.read(reinterpret_cast<char *>(mat.ptr(0)), (std::streamsize)(mat.total() * mat.elemSize()));
+  return in.good();
+}
+
+} // namespace
+
+InputLogWriter::InputLogWriter(const std::string &path) {
+  file.open(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+  file.write(input_log_magic, sizeof(input_log_magic));
+  binary_io::write(file, input_log_version);
+}
+
+bool InputLogWriter::good() {
+  std::lock_guard<std::mutex> lck(mtx);
+  return file.is_open() && file.good();
+}
+
+void InputLogWriter::write_imu(const ImuData &message) {
+  std::lock_guard<std::mutex> lck(mtx);
+  binary_io::write(file, (uint8_t)InputLogEntry::IMU);
+  binary_io::write(file, message.timestamp);
+  binary_io::write_matrix(file, message.wm);
+  binary_io::write_matrix(file, message.am);
+}
+
+void InputLogWriter::write_camera(const CameraData &message) {
+  std::lock_guard<std::mutex> lck(mtx);
+  binary_io::write(file, (uint8_t)InputLogEntry::CAMERA);
+  binary_io::write(file, message.timestamp);
+  binary_io::write(file, (uint32_t)message.sensor_ids.size());
+  for (size_t i = 0; i < message.sensor_ids.size(); i++) {
+    binary_io::write(file, (int32_t)message.sensor_ids.at(i));
+    write_mat(file, message.images.at(i));
+    write_mat(file, (i < message.masks.size()) ? message.masks.at(i) : cv::Mat());
+  }
+}
+
+void InputLogWriter::write_simulation(double timestamp, const std::vector<int> &camids,
+                                      const std::vector<std::vector<std::pair<size_t, Eigen::VectorXf>>> &feats) {
+  std::lock_guard<std::mutex> lck(mtx);
+  binary_io::write(file, (uint8_t)InputLogEntry::SIMULATION);
+  binary_io::write(file, timestamp);
+  binary_io::write(file, (uint32_t)camids.size());
+  for (size_t i = 0; i < camids.size(); i++) {
+    binary_io::write(file, (int32_t)camids.at(i));
+    binary_io::write(file, (uint32_t)feats.at(i).size());
+    for (const auto &feat : feats.at(i)) {
+      binary_io::write(file, (uint64_t)feat.first);
+      binary_io::write(file, (float)feat.second(0));
+      binary_io::write(file, (float)feat.second(1));
+    }
+  }
+}
+
+void InputLogWriter::write_groundtruth(const Eigen::Matrix<double, 17, 1> &imustate) {
+  std::lock_guard<std::mutex> lck(mtx);
+  binary_io::write(file, (uint8_t)InputLogEntry::GROUNDTRUTH);
+  binary_io::write(file, imustate(0));
+  binary_io::write_matrix(file, imustate);
+}
+
+InputLogReader::InputLogReader(const std::string &path) {
+  file.open(path, std::ifstream::in | std::ifstream::binary);
+  char magic[sizeof(input_log_magic)];
+  uint32_t version;
+  file.read(magic, sizeof(magic));
+  valid = file.good() && std::memcmp(magic, input_log_magic, sizeof(magic)) == 0 && binary_io::read(file, version) &&
+          version == input_log_version;
+}
+
+bool InputLogReader::next(InputLogEntry &entry) {
+  if (!valid)
+    return false;
+  uint8_t type;
+  double timestamp;
+  if (!binary_io::read(file, type) || !binary_io::read(file, timestamp))
+    return false;
+  entry.type = (InputLogEntry::Type)type;
+  if (type == InputLogEntry::IMU) {
+    entry.imu.timestamp = timestamp;
+    return binary_io::read_matrix(file, entry.imu.wm) && binary_io::read_matrix(file, entry.imu.am);
+  } else if (type == InputLogEntry::CAMERA) {
+    uint32_t num_images;
+    if (!binary_io::read(file, num_images))
+      return false;
+    entry.camera.timestamp = timestamp;
+    entry.camera.sensor_ids.resize(num_images);
+    entry.camera.images.resize(num_images);
+    entry.camera.masks.resize(num_images);
+    for (size_t i = 0; i < num_images; i++) {
+      int32_t sensor_id;
+      if (!binary_io::read(file, sensor_id) || !read_mat(file, entry.camera.images.at(i)) || !read_mat(file, entry.camera.masks.at(i)))
+        return false;
+      entry.camera.sensor_ids.at(i) = sensor_id;
+    }
+    return true;
+  } else if (type == InputLogEntry::SIMULATION) {
+    uint32_t num_cameras;
+    if (!binary_io::read(file, num_cameras))
+      return false;
+    entry.sim_timestamp = timestamp;
+    entry.sim_camids.resize(num_cameras);
+    entry.sim_feats.resize(num_cameras);
+    for (size_t i = 0; i < num_cameras; i++) {
+      int32_t camid;
+      uint32_t num_feats;
+      if (!binary_io::read(file, camid) || !binary_io::read(file, num_feats))
+        return false;
+      entry.sim_camids.at(i) = camid;
+      entry.sim_feats.at(i).resize(num_feats);
+      for (auto &feat : entry.sim_feats.at(i)) {
+        uint64_t featid;
+        float u, v;
+        if (!binary_io::read(file, featid) || !binary_io::read(file, u) || !binary_io::read(file, v))
+          return false;
+        feat.first = (size_t)featid;
+        feat.second = Eigen::Vector2f(u, v);
+      }
+    }
+    return true;
+  } else if (type == InputLogEntry::GROUNDTRUTH) {
+    return binary_io::read_matrix(file, entry.imustate);
+  }
+  return false;
+}
@@ -0,0 +1,141 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_MSCKF_INPUT_LOG_H
+#define OV_MSCKF_INPUT_LOG_H
+
+#include <Eigen/Eigen>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utils/sensor_data.h"
+
+namespace ov_msckf {
+
+/**
+ * @brief A single input that was fed into VioManager
+ *
+ * Only the members of the given type are valid, the others are left empty.
+ */
+struct InputLogEntry {
+
+  /// What function of VioManager this input was fed to
+  enum Type : uint8_t { IMU = 0, CAMERA = 1, SIMULATION = 2, GROUNDTRUTH = 3 };
+
+  /// Type of this input
+  Type type = IMU;
+
+  /// Inertial reading (IMU)
+  ov_core::ImuData imu;
+
+  /// Images and masks (CAMERA)
+  ov_core::CameraData camera;
+
+  /// Time, camera ids and raw uv measurements of the simulated cameras (SIMULATION)
+  double sim_timestamp = -1;
+  std::vector<int> sim_camids;
+  std::vector<std::vector<std::pair<size_t, Eigen::VectorXf>>> sim_feats;
+
+  /// State we were initialized with, [time(sec),q_GtoI,p_IinG,v_IinG,b_gyro,b_accel] (GROUNDTRUTH)
+  Eigen::Matrix<double, 17, 1> imustate = Eigen::Matrix<double, 17, 1>::Zero();
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/**
+ * @brief Records every input fed into VioManager to a binary file
+ *
+ * The file starts with a magic string and version, followed by one record per input in the order they were fed.
+ * Each record is its type followed by its data, images are stored uncompressed (rows, cols, type, then the pixels).
+ * Values are written in their native binary representation, see ov_core::binary_io.
+ * This allows for replaying a run offline (e.g. with replay_msckf) without ROS or the original dataset.
+ * All write functions are thread safe, thus the IMU and camera can be fed from different threads.
+ */
+class InputLogWriter {
+
+public:
+  /**
+   * @brief Opens the file and writes the header (any existing file is replaced)
+   * @param path Path of the log file
+   */
+  explicit InputLogWriter(const std::string &path);
+
+  /// If the file is open and all records have been written successfully
+  bool good();
+
+  /// Records an inertial reading
+  void write_imu(const ov_core::ImuData &message);
+
+  /// Records a set of camera images
+  void write_camera(const ov_core::CameraData &message);
+
+  /// Records a set of simulated camera measurements
+  void write_simulation(double timestamp, const std::vector<int> &camids,
+                        const std::vector<std::vector<std::pair<size_t, Eigen::VectorXf>>> &feats);
+
+  /// Records the state we initialized with
+  void write_groundtruth(const Eigen::Matrix<double, 17, 1> &imustate);
+
+private:
+  /// Mutex for our file as we can be fed from multiple threads
+  std::mutex mtx;
+
+  /// File we write into
+  std::ofstream file;
+};
+
+/**
+ * @brief Reads the inputs which were recorded by InputLogWriter
+ */
+class InputLogReader {
+
+public:
+  /**
+   * @brief Opens the file and checks its header
+   * @param path Path of the log file
+   */
+  explicit InputLogReader(const std::string &path);
+
+  /// If the file was opened and has a valid header
+  bool is_open() const { return valid; }
+
+  /**
+   * @brief Reads the next recorded input
+   * @param entry Input we read
+   * @return False if we have reached the end of the file (or it is truncated / corrupt)
+   */
+  bool next(InputLogEntry &entry);
+
+private:
+  /// File we read from
+  std::ifstream file;
+
+  /// If the header was valid
+  bool valid = false;
+};
+
+} // namespace ov_msckf
+
+#endif // OV_MSCKF_INPUT_LOG_H
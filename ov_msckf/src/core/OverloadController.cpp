@@ -0,0 +1,93 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "OverloadController.h"
+
+#include "utils/colors.h"
+#include "utils/print.h"
+
+#include <algorithm>
+
+using namespace ov_msckf;
+
+OverloadController::OverloadController(const OverloadControllerOptions &options, double track_frequency) : _options(options), _level(NOMINAL) {
+  _deadline_ms = _options.deadline_ms;
+  if (_deadline_ms <= 0 && track_frequency > 0)
+    _deadline_ms = 1000.0 / track_frequency;
+}
+
+void OverloadController::feed_timings(double time_track, double time_prop, double time_msckf, double time_slam_update,
+                                      double time_slam_delay, double time_marg, double time_total) {
+
+  // Nothing to do if disabled or we have no deadline to hit
+  if (!_options.enabled || _deadline_ms <= 0)
+    return;
+
+  // Update our moving averages of each stage
+  double stages_ms[6] = {1e3 * time_track, 1e3 * time_prop,       1e3 * time_msckf,
+                         1e3 * time_slam_update, 1e3 * time_slam_delay, 1e3 * time_marg};
+  double alpha = std::min(std::max(_options.ema_alpha, 0.0), 1.0);
+  double predicted = 0.0;
+  for (size_t i = 0; i < 6; i++) {
+    _ema_ms[i] = (_has_timings) ? (1.0 - alpha) * _ema_ms[i] + alpha * stages_ms[i] : stages_ms[i];
+    predicted += _ema_ms[i];
+  }
+  _has_timings = true;
+  _predicted_ms = predicted;
+
+  // Escalate if we predict to miss the deadline, or if we have just missed it
+  // Otherwise we will recover a level after being well below the deadline for a while
+  int level = _level.load();
+  bool missed = (1e3 * time_total > _deadline_ms);
+  if ((predicted > _options.high_ratio * _deadline_ms || missed) && level < DEFER_SLAM_INIT) {
+    level++;
+    _frames_below_low = 0;
+    PRINT_INFO(YELLOW "[OVERLOAD]: predicted %.2f ms (last %.2f ms) for %.2f ms deadline, degrading to %s\n" RESET, predicted,
+               1e3 * time_total, _deadline_ms, as_string((Level)level).c_str());
+  } else if (predicted < _options.low_ratio * _deadline_ms && level > NOMINAL) {
+    _frames_below_low++;
+    if (_frames_below_low >= _options.recover_frames) {
+      level--;
+      _frames_below_low = 0;
+      PRINT_INFO(GREEN "[OVERLOAD]: predicted %.2f ms for %.2f ms deadline, recovering to %s\n" RESET, predicted, _deadline_ms,
+                 as_string((Level)level).c_str());
+    }
+  } else {
+    _frames_below_low = 0;
+  }
+  _level = level;
+}
+
+int OverloadController::max_msckf_features(int nominal) const {
+  if (!_options.enabled || _level < REDUCE_MSCKF)
+    return nominal;
+  return std::min(nominal, std::max(_options.min_msckf_features, nominal / 2));
+}
+
+double OverloadController::msckf_budget_ms(double nominal) const {
+  if (!_options.enabled || _level < REDUCE_MSCKF)
+    return nominal;
+
+  // The MSCKF update gets whatever is left of the deadline after all other stages
+  double budget = _options.high_ratio * _deadline_ms - (_predicted_ms - _ema_ms[2]);
+  budget = std::max(budget, 1e-3);
+  return (nominal > 0) ? std::min(nominal, budget) : budget;
+}
@@ -0,0 +1,140 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_MSCKF_OVERLOAD_CONTROLLER_H
+#define OV_MSCKF_OVERLOAD_CONTROLLER_H
+
+#include <atomic>
+#include <string>
+
+#include "OverloadControllerOptions.h"
+
+namespace ov_msckf {
+
+/**
+ * @brief Deadline-aware controller that degrades the estimator when frames take too long.
+ *
+ * We keep an exponential moving average of each stage timing of VioManager (tracking, propagation, MSCKF update,
+ * SLAM update, SLAM delayed initialization, and re-triangulation & marginalization). Their sum is used to predict
+ * the processing time of the next frame. If this is above the deadline, we escalate one level at a time:
+ *
+ * - Level::NOMINAL : nothing is changed
+ * - Level::REDUCE_MSCKF : fewer MSCKF features and a time budget for their selection
+ * - Level::SKIP_RETRIANGULATION : additionally skip active track re-triangulation and the history visualization
+ * - Level::DEFER_SLAM_INIT : additionally defer SLAM delayed initialization to a later frame
+ *
+ * Once the predicted time has been well below the deadline for a number of frames we recover one level.
+ */
+class OverloadController {
+
+public:
+  /// The different degradation levels, each level includes all degradations of the previous ones
+  enum Level { NOMINAL = 0, REDUCE_MSCKF = 1, SKIP_RETRIANGULATION = 2, DEFER_SLAM_INIT = 3 };
+
+  /**
+   * @brief Default constructor
+   * @param options Controller options
+   * @param track_frequency Frequency we process frames at, used if no deadline is specified
+   */
+  OverloadController(const OverloadControllerOptions &options, double track_frequency);
+
+  /**
+   * @brief Feed the stage timings (in seconds) of the frame we just processed and update our level
+   * @param time_track Feature tracking
+   * @param time_prop Propagation and cloning
+   * @param time_msckf MSCKF update
+   * @param time_slam_update SLAM update
+   * @param time_slam_delay SLAM delayed initialization
+   * @param time_marg Re-triangulation and marginalization
+   * @param time_total Total time of the frame
+   */
+  void feed_timings(double time_track, double time_prop, double time_msckf, double time_slam_update, double time_slam_delay,
+                    double time_marg, double time_total);
+
+  /**
+   * @brief Max number of MSCKF features we should update with
+   * @param nominal The max number of features when not overloaded
+   */
+  int max_msckf_features(int nominal) const;
+
+  /**
+   * @brief Time budget in milliseconds for the MSCKF update
+   * @param nominal The budget when not overloaded (non-positive means no budget)
+   */
+  double msckf_budget_ms(double nominal) const;
+
+  /// If we should defer SLAM delayed initialization this frame
+  bool defer_slam_delayed_init() const { return _options.enabled && _level >= DEFER_SLAM_INIT; }
+
+  /// If we should skip the re-triangulation of the active tracks this frame
+  bool skip_retriangulation() const { return _options.enabled && _level >= SKIP_RETRIANGULATION; }
+
+  /// If we should skip the creation of visualization images
+  bool skip_visualization() const { return _options.enabled && _level >= SKIP_RETRIANGULATION; }
+
+  /// Current degradation level
+  Level level() const { return (Level)_level.load(); }
+
+  /// Predicted processing time of the next frame in milliseconds
+  double predicted_ms() const { return _predicted_ms; }
+
+  /// Deadline of a single frame in milliseconds
+  double deadline_ms() const { return _deadline_ms; }
+
+  /// Returns a string representation of the level
+  static std::string as_string(Level level) {
+    if (level == NOMINAL)
+      return "NOMINAL";
+    if (level == REDUCE_MSCKF)
+      return "REDUCE_MSCKF";
+    if (level == SKIP_RETRIANGULATION)
+      return "SKIP_RETRIANGULATION";
+    if (level == DEFER_SLAM_INIT)
+      return "DEFER_SLAM_INIT";
+    return "UNKNOWN";
+  }
+
+protected:
+  /// Controller options
+  OverloadControllerOptions _options;
+
+  /// Deadline of a single frame in milliseconds
+  double _deadline_ms;
+
+  /// Moving average of each stage timing in milliseconds
+  double _ema_ms[6] = {0, 0, 0, 0, 0, 0};
+
+  /// If we have received any timings yet
+  bool _has_timings = false;
+
+  /// Predicted time of the next frame in milliseconds
+  double _predicted_ms = 0.0;
+
+  /// Number of consecutive frames we have been below the low watermark
+  int _frames_below_low = 0;
+
+  /// Current level (atomic since the visualization thread queries it)
+  std::atomic<int> _level;
+};
+
+} // namespace ov_msckf
+
+#endif // OV_MSCKF_OVERLOAD_CONTROLLER_H
@@ -0,0 +1,81 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_MSCKF_OVERLOAD_CONTROLLER_OPTIONS_H
+#define OV_MSCKF_OVERLOAD_CONTROLLER_OPTIONS_H
+
+#include <memory>
+
+#include "utils/opencv_yaml_parse.h"
+#include "utils/print.h"
+
+namespace ov_msckf {
+
+/**
+ * @brief Struct which stores options for the frame overload controller
+ */
+struct OverloadControllerOptions {
+
+  /// If we should degrade the estimator when we predict that a frame will miss its deadline
+  bool enabled = false;
+
+  /// Processing deadline of a single frame in milliseconds (non-positive will use the tracking frequency period)
+  double deadline_ms = -1.0;
+
+  /// Fraction of the deadline above which the predicted frame time will escalate the overload level
+  double high_ratio = 0.9;
+
+  /// Fraction of the deadline below which the predicted frame time counts towards recovering a level
+  double low_ratio = 0.6;
+
+  /// Number of consecutive frames below the low ratio before we recover one overload level
+  int recover_frames = 10;
+
+  /// Smoothing factor of the exponential moving average of the stage timings
+  double ema_alpha = 0.2;
+
+  /// Minimum number of MSCKF features we will still update with when degraded
+  int min_msckf_features = 10;
+
+  /// Nice print function of what parameters we have loaded
+  void print(const std::shared_ptr<ov_core::YamlParser> &parser = nullptr) {
+    if (parser != nullptr) {
+      parser->parse_config("overload_enabled", enabled, false);
+      parser->parse_config("overload_deadline_ms", deadline_ms, false);
+      parser->parse_config("overload_high_ratio", high_ratio, false);
+      parser->parse_config("overload_low_ratio", low_ratio, false);
+      parser->parse_config("overload_recover_frames", recover_frames, false);
+      parser->parse_config("overload_ema_alpha", ema_alpha, false);
+      parser->parse_config("overload_min_msckf_features", min_msckf_features, false);
+    }
+    PRINT_DEBUG("  - overload_enabled: %d\n", enabled);
+    PRINT_DEBUG("  - overload_deadline_ms: %.2f\n", deadline_ms);
+    PRINT_DEBUG("  - overload_high_ratio: %.2f\n", high_ratio);
+    PRINT_DEBUG("  - overload_low_ratio: %.2f\n", low_ratio);
+    PRINT_DEBUG("  - overload_recover_frames: %d\n", recover_frames);
+    PRINT_DEBUG("  - overload_ema_alpha: %.2f\n", ema_alpha);
+    PRINT_DEBUG("  - overload_min_msckf_features: %d\n", min_msckf_features);
+  }
+};
+
+} // namespace ov_msckf
+
+#endif // OV_MSCKF_OVERLOAD_CONTROLLER_OPTIONS_H
@@ -20,25 +20,32 @@
  */
 
 #include "VioManager.h"
+#include "InputLog.h"
+#include "OverloadController.h"
 
 #include "feat/Feature.h"
 #include "feat/FeatureDatabase.h"
 #include "feat/FeatureInitializer.h"
+#include "feat/LandmarkMap.h"
 #include "track/TrackAruco.h"
 #include "track/TrackDescriptor.h"
 #include "track/TrackKLT.h"
 #include "track/TrackSIM.h"
 #include "types/Landmark.h"
 #include "types/LandmarkRepresentation.h"
+#include "utils/image_pool.h"
+#include "utils/metrics.h"
 #include "utils/opencv_lambda_body.h"
 #include "utils/print.h"
 #include "utils/sensor_data.h"
+#include "utils/trace.h"
 
 #include "init/InertialInitializer.h"
 
 #include "state/Propagator.h"
 #include "state/State.h"
 #include "state/StateHelper.h"
+#include "update/FeatureSelector.h"
 #include "update/UpdaterMSCKF.h"
 #include "update/UpdaterSLAM.h"
 #include "update/UpdaterZeroVelocity.h"
@@ -47,8 +54,16 @@ using namespace ov_core;
 using namespace ov_type;
 using namespace ov_msckf;
 
+namespace {
+
+/// The OpenCV thread count is process wide, thus it is shared by all our instances (-2 if it has not been set yet)
+std::mutex opencv_threads_mtx;
+int opencv_threads = -2;
+
+} // namespace
+
 VioManager::VioManager(VioManagerOptions &params_)
-  : thread_init_running(false), thread_init_success(false) {
+  : thread_init_running(false), thread_init_cancel(false), pipeline_started(false), pipeline_state_time(-1), pipeline_marg_time(-1) {
 
   // Nice startup message
   PRINT_DEBUG("=======================================\n");
@@ -62,10 +77,26 @@ VioManager::VioManager(VioManagerOptions &params_)
   params.print_and_load_state();
   params.print_and_load_trackers();
 
+  // Threads we start should print the same way as the one that created us
+  print_context = Printer::getThreadContext();
+
+  // Our traced scopes are recorded separately from any other system in this process
+  trace_context = std::make_shared<TraceContext>();
+
   // This will globally set the thread count we will use
   // -1 will reset to the system default threading (usually the num of cores)
   // cv::setNumThreads是一个全局函数，它会影响OpenCV库中所有可以并行运算的函数。
-  cv::setNumThreads(params.num_opencv_threads);
+  // NOTE: only the first instance sets it, so instances in other threads are not changed while running
+  {
+    std::lock_guard<std::mutex> lck(opencv_threads_mtx);
+    if (opencv_threads == -2) {
+      cv::setNumThreads(params.num_opencv_threads);
+      opencv_threads = params.num_opencv_threads;
+    } else if (opencv_threads != params.num_opencv_threads) {
+      PRINT_WARNING(YELLOW "OpenCV already uses %d threads in this process, ignoring num_opencv_threads = %d\n" RESET, opencv_threads,
+                    params.num_opencv_threads);
+    }
+  }
   cv::setRNGSeed(0);
 
   // Create the state!!
@@ -113,14 +144,56 @@ VioManager::VioManager(VioManagerOptions &params_)
     // Create the directory that we will open the file in
     boost::filesystem::path p(params.record_timing_filepath);
     boost::filesystem::create_directories(p.parent_path());
-    // Open our statistics file!
-    of_statistics.open(params.record_timing_filepath, std::ofstream::out | std::ofstream::app);
-    // Write the header information into it
-    of_statistics << "# timestamp (sec),tracking,propagation,msckf update,";
+    // Open our statistics file, the rows are created from our traced stages
+    // A row is written once the last stage of a frame has been traced
+    std::vector<std::string> stages = {"tracking", "propagation", "msckf update"};
     if (state->_options.max_slam_features > 0) {
-      of_statistics << "slam update,slam delayed,";
+      stages.push_back("slam update");
+      stages.push_back("slam delayed");
+    }
+    stages.push_back("re-tri & marg");
+    trace_timing = std::make_shared<TraceTimingWriter>(params.record_timing_filepath, stages);
+    trace_context->set_enabled(true);
+    // The overload controller decisions are recorded next to the timing file
+    // This keeps the timing file format the same for the ov_eval timing scripts
+    if (params.overload_options.enabled) {
+      boost::filesystem::path p_overload = p.parent_path() / (p.stem().string() + "_overload" + p.extension().string());
+      if (boost::filesystem::exists(p_overload)) {
+        boost::filesystem::remove(p_overload);
+      }
+      of_overload.open(p_overload.string(), std::ofstream::out | std::ofstream::app);
+      of_overload << "# timestamp (sec),predicted (ms),deadline (ms),level,msckf max feats,msckf budget (ms),defer slam init,skip re-tri"
+                  << std::endl;
+    }
+  }
+
+  // If we are recording all traced scopes, then open our trace file
+  if (!params.record_trace_filepath.empty()) {
+    boost::filesystem::path p(params.record_trace_filepath);
+    boost::filesystem::create_directories(p.parent_path());
+    trace_chrome = std::make_shared<TraceChromeWriter>(params.record_trace_filepath);
+    trace_context->set_enabled(true);
+  }
+
+  // Buffers for the images we create each frame
+  image_pool = std::make_shared<ImagePool>();
+
+  // Our runtime metrics are always counted, but only dumped to file if requested
+  metrics = std::make_shared<MetricsRegistry>();
+  if (!params.record_metrics_filepath.empty()) {
+    boost::filesystem::path p(params.record_metrics_filepath);
+    boost::filesystem::create_directories(p.parent_path());
+  }
+
+  // If we are recording our inputs, then open the log (this replaces any old one)
+  if (!params.record_inputs_filepath.empty()) {
+    boost::filesystem::path p(params.record_inputs_filepath);
+    boost::filesystem::create_directories(p.parent_path());
+    input_log = std::make_shared<InputLogWriter>(params.record_inputs_filepath);
+    if (!input_log->good()) {
+      PRINT_ERROR(RED "[INPUTS]: unable to open %s for recording\n" RESET, params.record_inputs_filepath.c_str());
+      std::exit(EXIT_FAILURE);
     }
-    of_statistics << "re-tri & marg,total" << std::endl;
   }
 
   //===================================================================================
@@ -156,6 +229,18 @@ VioManager::VioManager(VioManagerOptions &params_)
                                                                 params.knn_ratio));
   }
 
+  // Bound the memory of our tracks (e.g. if we are waiting to initialize)
+  trackFEATS->get_feature_database()->set_limits(params.feat_db_limits);
+
+  // Our long-term landmark map, which needs descriptors to re-identify landmarks
+  if (params.use_landmark_map && params.use_klt) {
+    PRINT_WARNING(YELLOW "[VIO]: the landmark map needs descriptor tracking (use_klt: false), disabling it\n" RESET);
+  } else if (params.use_landmark_map) {
+    landmark_map = std::make_shared<LandmarkMap>(params.landmark_map_voxel_size, (size_t)params.landmark_map_max_landmarks);
+    std::dynamic_pointer_cast<TrackDescriptor>(trackFEATS)->set_landmark_map(landmark_map, params.landmark_map_match_px,
+                                                                             params.landmark_map_max_hamming);
+  }
+
   // Initialize our aruco tag extractor
   // todo aruco标签初始化
   if (params.use_aruco) {
@@ -174,7 +259,11 @@ VioManager::VioManager(VioManagerOptions &params_)
 
   // Make the updater!
   updaterMSCKF = std::make_shared<UpdaterMSCKF>(params.msckf_options, params.featinit_options);
+  selectorMSCKF = std::make_shared<FeatureSelector>(params.msckf_select_options);
+  overload = std::make_shared<OverloadController>(params.overload_options, params.track_frequency);
   updaterSLAM  = std::make_shared<UpdaterSLAM>(params.slam_options, params.aruco_options, params.featinit_options);
+  updaterMSCKF->set_metrics(metrics);
+  metrics_register();
 
   // If we are using zero velocity updates, then create the updater
   if (params.try_zupt) {
@@ -185,16 +274,54 @@ VioManager::VioManager(VioManagerOptions &params_)
                                                         params.gravity_mag,
                                                         params.zupt_max_velocity,
                                                         params.zupt_noise_multiplier,
-                                                        params.zupt_max_disparity);
+                                                        params.zupt_max_disparity,
+                                                        params.zupt_prefilter_multiplier,
+                                                        params.zupt_prefilter_window);
   }
 }
 
+VioManager::~VioManager() {
+
+  // Stop initializing (we wait for the running attempt since it uses our initializer)
+  cancel_initialization();
+
+  // Finish the queued frames and stop our estimator thread
+  {
+    std::lock_guard<std::mutex> lck(pipeline_mtx);
+    pipeline_stop = true;
+  }
+  pipeline_cv_pop.notify_all();
+  pipeline_cv_push.notify_all();
+  if (pipeline_thread.joinable()) {
+    pipeline_thread.join();
+  }
+
+  // Stop our re-triangulation thread (a snapshot it has not started on is dropped)
+  {
+    std::lock_guard<std::mutex> lck(retri_mtx);
+    retri_stop = true;
+  }
+  retri_cv.notify_all();
+  if (retri_thread.joinable()) {
+    retri_thread.join();
+  }
+
+  // Write out the last traced events
+  trace_flush();
+}
+
 void VioManager::feed_measurement_imu(const ov_core::ImuData &message) {
+  TraceContextGuard trace_guard(trace_context);
+
+  // Record it before anything else, so the log has the order we have been fed in
+  if (input_log != nullptr)
+    input_log->write_imu(message);
 
   // The oldest time we need IMU with is the last clone
   // We shouldn't really need the whole window, but if we go backwards in time we will
-  double oldest_time = state->margtimestep(); // 获取滑窗中最老时间戳
-  if (oldest_time > state->_timestamp) {
+  // NOTE: if pipelined the estimator thread could be changing the clones, so use the times it last published
+  double oldest_time = (pipeline_started) ? pipeline_marg_time.load() : state->margtimestep(); // 获取滑窗中最老时间戳
+  if (oldest_time > ((pipeline_started) ? pipeline_state_time.load() : state->_timestamp)) {
     oldest_time = -1;
   }
   if (!is_initialized_vio) { // 未初始化
@@ -224,30 +351,38 @@ void VioManager::feed_measurement_simulation(double timestamp,
                                              const std::vector<int> &camids,
                                              const std::vector<std::vector<std::pair<size_t, Eigen::VectorXf>>> &feats) 
 {
+  TraceContextGuard trace_guard(trace_context);
+
+  // Record the measurements
+  if (input_log != nullptr)
+    input_log->write_simulation(timestamp, camids, feats);
 
   // Start timing
-  rT1 = boost::posix_time::microsec_clock::local_time(); // code 获取当前的本地时间
+  TraceScope trace_track("tracking", timestamp);
 
   // Check if we actually have a simulated tracker
   // If not, recreate and re-cast the tracker to our simulation tracker
   std::shared_ptr<TrackSIM> trackSIM = std::dynamic_pointer_cast<TrackSIM>(trackFEATS);
   if (trackSIM == nullptr) {
     // Replace with the simulated tracker
+    // NOTE: we keep the database since it could have been restored from a checkpoint
+    // NOTE: thus the initializer and zv-upt still point to the right database and keep their (restored) IMU history
     trackSIM = std::make_shared<TrackSIM>(state->_cam_intrinsics_cameras, state->_options.max_aruco_features);
+    trackSIM->swap_feature_database(trackFEATS->get_feature_database());
     trackFEATS = trackSIM;
-    // Need to also replace it in init and zv-upt since it points to the trackFEATS db pointer
-    initializer = std::make_shared<ov_init::InertialInitializer>(params.init_options, trackFEATS->get_feature_database());
-    if (params.try_zupt) {
-      updaterZUPT = std::make_shared<UpdaterZeroVelocity>(params.zupt_options, params.imu_noises, trackFEATS->get_feature_database(),
-                                                          propagator, params.gravity_mag, params.zupt_max_velocity,
-                                                          params.zupt_noise_multiplier, params.zupt_max_disparity);
-    }
     PRINT_WARNING(RED "[SIM]: casting our tracker to a TrackSIM object!\n" RESET);
   }
 
   // Feed our simulation tracker
   trackSIM->feed_measurement_simulation(timestamp, camids, feats);
-  rT2 = boost::posix_time::microsec_clock::local_time();
+  if (is_initialized_vio && updaterZUPT != nullptr) {
+    updaterZUPT->feed_tracks(timestamp, trackSIM->get_last_obs(), trackSIM->get_last_ids());
+  }
+  time_track = trace_track.stop();
+  metrics_feed_tracks();
+
+  // From here on we change the state, thus readers on other threads have to wait
+  std::lock_guard<std::recursive_mutex> lck_state(state_mtx);
 
   // Check if we should do zero-velocity, if so update the state with it
   // Note that in the case that we only use in the beginning initialization phase
@@ -281,16 +416,25 @@ void VioManager::feed_measurement_simulation(double timestamp,
     int width = state->_cam_intrinsics_cameras.at(camid)->w();
     int height = state->_cam_intrinsics_cameras.at(camid)->h();
     message.sensor_ids.push_back(camid);
-    message.images.push_back(cv::Mat::zeros(cv::Size(width, height), CV_8UC1));
-    message.masks.push_back(cv::Mat::zeros(cv::Size(width, height), CV_8UC1));
+    message.images.push_back(image_pool->acquire(height, width, CV_8UC1).setTo(0));
+    message.masks.push_back(image_pool->acquire(height, width, CV_8UC1).setTo(0));
   }
   do_feature_propagate_update(message);
 }
 
+void VioManager::feed_measurement_camera(const ov_core::CameraData &message) {
+  TraceContextGuard trace_guard(trace_context);
+
+  // Record the images
+  if (input_log != nullptr)
+    input_log->write_camera(message);
+  track_image_and_update(message);
+}
+
 void VioManager::track_image_and_update(const ov_core::CameraData &message_const) {
 
   // Start timing
-  rT1 = boost::posix_time::microsec_clock::local_time();
+  TraceScope trace_track("tracking", message_const.timestamp);
 
   // Assert we have valid measurement data and ids
   assert(!message_const.sensor_ids.empty());
@@ -301,19 +445,50 @@ void VioManager::track_image_and_update(const ov_core::CameraData &message_const
 
   // Downsample if we are downsampling 
   // 降采样默认 false
-  ov_core::CameraData message = message_const;
-  for (size_t i = 0; i < message.sensor_ids.size() && params.downsample_cameras; i++) {
-    cv::Mat img = message.images.at(i);
-    cv::Mat mask = message.masks.at(i);
-    cv::Mat img_temp, mask_temp;
-    cv::pyrDown(img, img_temp, cv::Size(img.cols / 2.0, img.rows / 2.0)); // 输入图像进行高斯平滑和降采样
-    message.images.at(i) = img_temp;
-    cv::pyrDown(mask, mask_temp, cv::Size(mask.cols / 2.0, mask.rows / 2.0));
-    message.masks.at(i) = mask_temp;
+  // NOTE: we only copy the message if we change it, and the downsampled images are written into pooled buffers
+  ov_core::CameraData message_downsampled;
+  if (params.downsample_cameras) {
+    message_downsampled = message_const;
+  }
+  for (size_t i = 0; i < message_downsampled.sensor_ids.size(); i++) {
+    cv::Mat img = message_downsampled.images.at(i);
+    cv::Mat mask = message_downsampled.masks.at(i);
+    cv::Mat img_temp = image_pool->acquire(img.rows / 2, img.cols / 2, img.type());
+    cv::Mat mask_temp = image_pool->acquire(mask.rows / 2, mask.cols / 2, mask.type());
+    cv::pyrDown(img, img_temp, img_temp.size()); // 输入图像进行高斯平滑和降采样
+    message_downsampled.images.at(i) = img_temp;
+    cv::pyrDown(mask, mask_temp, mask_temp.size());
+    message_downsampled.masks.at(i) = mask_temp;
+  }
+  const ov_core::CameraData &message = (params.downsample_cameras) ? message_downsampled : message_const;
+
+  // If pipelined, we only track on this thread and the estimator thread will do the update
+  // We start this after initialization, from then on the estimator owns the databases with the tracks so far
+  // NOTE: we drop out of order messages here since the estimator would not be able to use them anyways
+  bool pipelined = (params.use_pipeline && is_initialized_vio);
+  if (pipelined && message.timestamp < pipeline_last_time) {
+    PRINT_WARNING(YELLOW "[PIPELINE]: image received out of order, dropping it (dt = %3f)\n" RESET, message.timestamp - pipeline_last_time);
+    return;
+  }
+  if (pipelined && !pipeline_started) {
+    auto db_tracker = std::make_shared<FeatureDatabase>();
+    db_tracker->set_limits(params.feat_db_limits);
+    pipeline_db_feats = trackFEATS->swap_feature_database(db_tracker);
+    if (trackARUCO != nullptr) {
+      pipeline_db_aruco = trackARUCO->swap_feature_database(std::make_shared<FeatureDatabase>());
+    }
+    pipeline_state_time = state->_timestamp;
+    pipeline_marg_time = state->margtimestep();
+    pipeline_started = true;
+    pipeline_thread = std::thread(&VioManager::pipeline_loop, this);
+    PRINT_INFO(GREEN "[PIPELINE]: tracking and estimator update are now running on separate threads\n" RESET);
   }
 
   // Perform our feature tracking!
   trackFEATS->feed_new_camera(message); // 提取 角点 + 描述子 + id
+  if (!pipelined && is_initialized_vio && updaterZUPT != nullptr) {
+    updaterZUPT->feed_tracks(message.timestamp, trackFEATS->get_last_obs(), trackFEATS->get_last_ids());
+  }
 
   // If the aruco tracker is available, the also pass to it
   // NOTE: binocular tracking for aruco doesn't make sense as we by default have the ids
@@ -321,7 +496,18 @@ void VioManager::track_image_and_update(const ov_core::CameraData &message_const
   if (is_initialized_vio && trackARUCO != nullptr) {
     trackARUCO->feed_new_camera(message); // todo aruco标签提取,如何作用？// lhq 二维码定位？
   }
-  rT2 = boost::posix_time::microsec_clock::local_time();
+  double time_track_frame = trace_track.stop();
+  metrics_feed_tracks();
+
+  // Hand-off to our estimator thread
+  if (pipelined) {
+    pipeline_push(message, time_track_frame);
+    return;
+  }
+  time_track = time_track_frame;
+
+  // From here on we change the state, thus readers on other threads (e.g. the IMU callback) have to wait
+  std::lock_guard<std::recursive_mutex> lck_state(state_mtx);
 
   // Check if we should do zero-velocity, if so update the state with it
   // Note that in the case that we only use in the beginning initialization phase
@@ -357,7 +543,6 @@ void VioManager::track_image_and_update(const ov_core::CameraData &message_const
   if (!is_initialized_vio) {
     is_initialized_vio = try_to_initialize(message);
     if (!is_initialized_vio) {
-      double time_track = (rT2 - rT1).total_microseconds() * 1e-6;
       PRINT_DEBUG(BLUE "[TIME]: %.4f seconds for tracking\n" RESET, time_track);
       return;
     }
@@ -369,6 +554,9 @@ void VioManager::track_image_and_update(const ov_core::CameraData &message_const
 
 void VioManager::do_feature_propagate_update(const ov_core::CameraData &message) {
 
+  // Start timing, all our stages are traced in this scope
+  TraceScope trace_update("update", message.timestamp);
+
   //===================================================================================
   // State propagation, and clone augmentation
   //===================================================================================
@@ -384,10 +572,12 @@ void VioManager::do_feature_propagate_update(const ov_core::CameraData &message)
   // Also augment it with a new clone!
   // NOTE: if the state is already at the given time (can happen in sim)
   // NOTE: then no need to prop since we already are at the desired timestep
+  TraceScope trace_prop("propagation");
   if (state->_timestamp != message.timestamp) {
     propagator->propagate_and_clone(state, message.timestamp);
   }
-  rT3 = boost::posix_time::microsec_clock::local_time();
+  double time_prop = trace_prop.stop();
+  TraceScope trace_msckf("msckf update");
 
   // If we have not reached max clones, we should just return...
   // This isn't super ideal, but it keeps the logic after this easier...
@@ -410,79 +600,61 @@ void VioManager::do_feature_propagate_update(const ov_core::CameraData &message)
   // MSCKF features and KLT tracks that are SLAM features
   //===================================================================================
 
-  // Now, lets get all features that should be used for an update that are lost in the newest frame
-  // We explicitly request features that have not been deleted (used) in another update step
-  std::vector<std::shared_ptr<Feature>> feats_lost, feats_marg, feats_slam;
-  feats_lost = trackFEATS->get_feature_database()->features_not_containing_newer(state->_timestamp, false, true);
-
-  // Don't need to get the oldest features until we reach our max number of clones
-  if ((int)state->_clones_IMU.size() > state->_options.max_clone_size || (int)state->_clones_IMU.size() > 5) {
-    feats_marg = trackFEATS->get_feature_database()->features_containing(state->margtimestep(), false, true);
-    if (trackARUCO != nullptr && message.timestamp - startup_time >= params.dt_slam_delay) {
-      feats_slam = trackARUCO->get_feature_database()->features_containing(state->margtimestep(), false, true);
-    }
-  }
-
-  // Remove any lost features that were from other image streams
-  // E.g: if we are cam1 and cam0 has not processed yet, we don't want to try to use those in the update yet
-  // E.g: thus we wait until cam0 process its newest image to remove features which were seen from that camera
-  auto it1 = feats_lost.begin();
-  while (it1 != feats_lost.end()) {
-    bool found_current_message_camid = false;
-    for (const auto &camuvpair : (*it1)->uvs) {
-      if (std::find(message.sensor_ids.begin(), message.sensor_ids.end(), camuvpair.first) != message.sensor_ids.end()) {
-        found_current_message_camid = true;
-        break;
-      }
-    }
-    if (found_current_message_camid) {
-      it1++;
-    } else {
-      it1 = feats_lost.erase(it1);
+  // Now, lets get all features that should be used for an update that are lost in the newest frame, or at the marg time
+  // We classify all features that have not been deleted (used) in another update step in a single pass
+  // NOTE: we don't need to get the oldest features until we reach our max number of clones
+  // NOTE: lost features from other image streams are not returned
+  // NOTE: e.g. if we are cam1 and cam0 has not processed yet, we don't want to try to use those in the update yet
+  // NOTE: thus we wait until cam0 process its newest image to remove features which were seen from that camera
+  // NOTE: max tracks can be made into SLAM features, and lost features also at the marg time are only returned as marg
+  // NOTE: features we use for SLAM are re-classified in this generation as SLAM updates or delayed initializations
+  std::vector<std::shared_ptr<Feature>> feats_lost, feats_marg, feats_maxtracks, feats_slam;
+  bool get_marg = ((int)state->_clones_IMU.size() > state->_options.max_clone_size || (int)state->_clones_IMU.size() > 5);
+  size_t update_generation =
+      feats_database()->classify_for_update(state->_timestamp, (get_marg) ? state->margtimestep() : -1, message.sensor_ids,
+                                            state->_options.max_clone_size, feats_lost, feats_marg, feats_maxtracks);
+  if (get_marg && trackARUCO != nullptr && message.timestamp - startup_time >= params.dt_slam_delay) {
+    feats_slam = aruco_database()->features_containing(state->margtimestep(), false, true);
+    for (const auto &feat : feats_slam) {
+      bool in_state = (state->_features_SLAM.find(feat->featid) != state->_features_SLAM.end());
+      FeatureDatabase::set_update_class(feat, update_generation,
+                                        (in_state) ? FeatureDatabase::UPDATE_SLAM : FeatureDatabase::UPDATE_SLAM_DELAYED);
     }
   }
 
-  // We also need to make sure that the max tracks does not contain any lost features
-  // This could happen if the feature was lost in the last frame, but has a measurement at the marg timestep
-  it1 = feats_lost.begin();
-  while (it1 != feats_lost.end()) {
-    if (std::find(feats_marg.begin(), feats_marg.end(), (*it1)) != feats_marg.end()) {
-      // PRINT_WARNING(YELLOW "FOUND FEATURE THAT WAS IN BOTH feats_lost and feats_marg!!!!!!\n" RESET);
-      it1 = feats_lost.erase(it1);
-    } else {
-      it1++;
-    }
-  }
-
-  // Find tracks that have reached max length, these can be made into SLAM features
-  std::vector<std::shared_ptr<Feature>> feats_maxtracks;
-  auto it2 = feats_marg.begin();
-  while (it2 != feats_marg.end()) {
-    // See if any of our camera's reached max track
-    bool reached_max = false;
-    for (const auto &cams : (*it2)->timestamps) {
-      if ((int)cams.second.size() > state->_options.max_clone_size) {
-        reached_max = true;
-        break;
-      }
-    }
-    // If max track, then add it to our possible slam feature list
-    if (reached_max) {
-      feats_maxtracks.push_back(*it2);
-      it2 = feats_marg.erase(it2);
-    } else {
-      it2++;
-    }
-  }
-
-  // Count how many aruco tags we have in our state
+  // Loop through current SLAM features, we have tracks of them, grab them for this update!
+  // Also count how many aruco tags we have in our state
+  // NOTE: if we have a slam feature that has lost tracking, then we should marginalize it out
+  // NOTE: we only enforce this if the current camera message is where the feature was seen from
+  // NOTE: if you do not use FEJ, these types of slam features *degrade* the estimator performance....
+  // NOTE: we will also marginalize SLAM features if they have failed their update a couple times in a row
   int curr_aruco_tags = 0;
-  auto it0 = state->_features_SLAM.begin();
-  while (it0 != state->_features_SLAM.end()) {
-    if ((int)(*it0).second->_featid <= 4 * state->_options.max_aruco_features)
+  std::vector<std::shared_ptr<Feature>> feats_slam_tracked;
+  for (std::pair<const size_t, std::shared_ptr<Landmark>> &landmark : state->_features_SLAM) {
+    if ((int)landmark.second->_featid <= 4 * state->_options.max_aruco_features)
       curr_aruco_tags++;
-    it0++;
+    std::shared_ptr<Feature> feat1 = (trackARUCO != nullptr) ? aruco_database()->get_feature(landmark.second->_featid) : nullptr;
+    std::shared_ptr<Feature> feat2 = feats_database()->get_feature(landmark.second->_featid);
+    assert(landmark.second->_unique_camera_id != -1);
+    bool current_unique_cam =
+        std::find(message.sensor_ids.begin(), message.sensor_ids.end(), landmark.second->_unique_camera_id) != message.sensor_ids.end();
+    if (feat2 == nullptr && current_unique_cam)
+      landmark.second->should_marg = true;
+    if (landmark.second->update_fail_count > 1)
+      landmark.second->should_marg = true;
+    // Tracks of landmarks which will be marginalized below (aruco tags never are) will be initialized again
+    bool will_marg = landmark.second->should_marg && (int)landmark.first > 4 * state->_options.max_aruco_features;
+    FeatureDatabase::UpdateClass update_class = (will_marg) ? FeatureDatabase::UPDATE_SLAM_DELAYED : FeatureDatabase::UPDATE_SLAM;
+    for (const auto &feat : {feat1, feat2}) {
+      if (feat == nullptr)
+        continue;
+      FeatureDatabase::set_update_class(feat, update_generation, update_class);
+      feats_slam_tracked.push_back(feat);
+    }
   }
+  // Sorted by id, so the update order does not depend on the history of our SLAM feature map (e.g. after restoring a checkpoint)
+  std::sort(feats_slam_tracked.begin(), feats_slam_tracked.end(),
+            [](const std::shared_ptr<Feature> &a, const std::shared_ptr<Feature> &b) { return a->featid < b->featid; });
 
   // Append a new SLAM feature if we have the room to do so
   // Also check that we have waited our delay amount (normally prevents bad first set of slam points)
@@ -494,43 +666,25 @@ void VioManager::do_feature_propagate_update(const ov_core::CameraData &message)
     // If we have at least 1 that we can add, lets add it!
     // Note: we remove them from the feat_marg array since we don't want to reuse information...
     if (valid_amount > 0) {
+      for (auto it = feats_maxtracks.end() - valid_amount; it != feats_maxtracks.end(); it++)
+        FeatureDatabase::set_update_class(*it, update_generation, FeatureDatabase::UPDATE_SLAM_DELAYED);
       feats_slam.insert(feats_slam.end(), feats_maxtracks.end() - valid_amount, feats_maxtracks.end());
       feats_maxtracks.erase(feats_maxtracks.end() - valid_amount, feats_maxtracks.end());
     }
   }
 
-  // Loop through current SLAM features, we have tracks of them, grab them for this update!
-  // NOTE: if we have a slam feature that has lost tracking, then we should marginalize it out
-  // NOTE: we only enforce this if the current camera message is where the feature was seen from
-  // NOTE: if you do not use FEJ, these types of slam features *degrade* the estimator performance....
-  // NOTE: we will also marginalize SLAM features if they have failed their update a couple times in a row
-  for (std::pair<const size_t, std::shared_ptr<Landmark>> &landmark : state->_features_SLAM) {
-    if (trackARUCO != nullptr) {
-      std::shared_ptr<Feature> feat1 = trackARUCO->get_feature_database()->get_feature(landmark.second->_featid);
-      if (feat1 != nullptr)
-        feats_slam.push_back(feat1);
-    }
-    std::shared_ptr<Feature> feat2 = trackFEATS->get_feature_database()->get_feature(landmark.second->_featid);
-    if (feat2 != nullptr)
-      feats_slam.push_back(feat2);
-    assert(landmark.second->_unique_camera_id != -1);
-    bool current_unique_cam =
-        std::find(message.sensor_ids.begin(), message.sensor_ids.end(), landmark.second->_unique_camera_id) != message.sensor_ids.end();
-    if (feat2 == nullptr && current_unique_cam)
-      landmark.second->should_marg = true;
-    if (landmark.second->update_fail_count > 1)
-      landmark.second->should_marg = true;
-  }
+  // Append the tracked SLAM features after the new ones
+  feats_slam.insert(feats_slam.end(), feats_slam_tracked.begin(), feats_slam_tracked.end());
 
   // Lets marginalize out all old SLAM features here
   // These are ones that where not successfully tracked into the current frame
   // We do *NOT* marginalize out our aruco tags landmarks
   StateHelper::marginalize_slam(state);
 
-  // Separate our SLAM features into new ones, and old ones
+  // Separate our SLAM features into new ones, and old ones (using the class we gave them above)
   std::vector<std::shared_ptr<Feature>> feats_slam_DELAYED, feats_slam_UPDATE;
   for (size_t i = 0; i < feats_slam.size(); i++) {
-    if (state->_features_SLAM.find(feats_slam.at(i)->featid) != state->_features_SLAM.end()) {
+    if (FeatureDatabase::has_update_class(feats_slam.at(i), update_generation, FeatureDatabase::UPDATE_SLAM)) {
       feats_slam_UPDATE.push_back(feats_slam.at(i));
       // PRINT_DEBUG("[UPDATE-SLAM]: found old feature %d (%d
       // measurements)\n",(int)feats_slam.at(i)->featid,(int)feats_slam.at(i)->timestamps_left.size());
@@ -542,40 +696,67 @@ void VioManager::do_feature_propagate_update(const ov_core::CameraData &message)
   }
 
   // Concatenate our MSCKF feature arrays (i.e., ones not being used for slam updates)
-  std::vector<std::shared_ptr<Feature>> featsup_MSCKF = feats_lost;
-  featsup_MSCKF.insert(featsup_MSCKF.end(), feats_marg.begin(), feats_marg.end());
-  featsup_MSCKF.insert(featsup_MSCKF.end(), feats_maxtracks.begin(), feats_maxtracks.end());
+  // NOTE: a track of a SLAM feature can also have been classified (e.g. as lost), it has been re-classified and is only used for SLAM
+  std::vector<std::shared_ptr<Feature>> featsup_MSCKF;
+  featsup_MSCKF.reserve(feats_lost.size() + feats_marg.size() + feats_maxtracks.size());
+  for (const auto &feats : {std::make_pair(&feats_lost, FeatureDatabase::UPDATE_LOST), std::make_pair(&feats_marg, FeatureDatabase::UPDATE_MARG),
+                            std::make_pair(&feats_maxtracks, FeatureDatabase::UPDATE_MAXTRACK)}) {
+    for (const auto &feat : *feats.first) {
+      if (FeatureDatabase::has_update_class(feat, update_generation, feats.second))
+        featsup_MSCKF.push_back(feat);
+    }
+  }
+
+  // Features without an estimate can warm start their triangulation from a previous estimate
+  // Re-identified SLAM features use the estimate of their landmark in the long-term map, if its sigma is small enough
+  // Otherwise we use the last re-triangulation of the active tracks
+  // NOTE: the re-triangulation keeps a linear system for each track, which it updates with every new measurement
+  if (params.featinit_options.warm_start) {
+    if (landmark_map != nullptr) {
+      for (const auto &feat : feats_slam_DELAYED) {
+        LandmarkMap::Landmark landmark;
+        if (!feat->has_estimate && landmark_map->get_landmark(feat->featid, landmark) && landmark.sigma >= 0 &&
+            landmark.sigma <= params.landmark_map_max_sigma) {
+          feat->p_FinG = landmark.p_FinG;
+          feat->has_estimate = true;
+        }
+      }
+    }
+    std::lock_guard<std::mutex> lck(active_tracks_mtx);
+    const std::unordered_map<size_t, Eigen::Vector3d> &posinG = active_tracks[active_tracks_front].posinG;
+    for (const auto &feats : {&featsup_MSCKF, &feats_slam_DELAYED}) {
+      for (const auto &feat : *feats) {
+        auto it = posinG.find(feat->featid);
+        if (!feat->has_estimate && it != posinG.end()) {
+          feat->p_FinG = it->second;
+          feat->has_estimate = true;
+        }
+      }
+    }
+  }
 
   //===================================================================================
   // Now that we have a list of features, lets do the EKF update for MSCKF and SLAM!
   //===================================================================================
 
-  // Sort based on track length
-  // TODO: we should have better selection logic here (i.e. even feature distribution in the FOV etc..)
-  // TODO: right now features that are "lost" are at the front of this vector, while ones at the end are long-tracks
-  auto compare_feat = [](const std::shared_ptr<Feature> &a, const std::shared_ptr<Feature> &b) -> bool {
-    size_t asize = 0;
-    size_t bsize = 0;
-    for (const auto &pair : a->timestamps)
-      asize += pair.second.size();
-    for (const auto &pair : b->timestamps)
-      bsize += pair.second.size();
-    return asize < bsize;
-  };
-  std::sort(featsup_MSCKF.begin(), featsup_MSCKF.end(), compare_feat);
-
-  // Pass them to our MSCKF updater
-  // NOTE: if we have more then the max, we select the "best" ones (i.e. max tracks) for this update
-  // NOTE: this should only really be used if you want to track a lot of features, or have limited computational resources
-  if ((int)featsup_MSCKF.size() > state->_options.max_msckf_in_update)
-    featsup_MSCKF.erase(featsup_MSCKF.begin(), featsup_MSCKF.end() - state->_options.max_msckf_in_update);
+  // Select the subset of features we will update with
+  // NOTE: features are scored by their information and parallax while being spread out over the image grid
+  // NOTE: if a time budget is set, we stop adding features once the predicted update time would exceed it
+  // NOTE: features not selected are kept in the database and might be used at a later time
+  // NOTE: if we are overloaded, the overload controller will reduce the max number of features and the budget
+  int max_MSCKF = overload->max_msckf_features(state->_options.max_msckf_in_update);
+  selectorMSCKF->set_budget_ms(overload->msckf_budget_ms(params.msckf_select_options.budget_ms));
+  size_t rows_MSCKF = selectorMSCKF->select(state, featsup_MSCKF, max_MSCKF);
+  TraceScope trace_msckf_ekf("msckf ekf update");
   updaterMSCKF->update(state, featsup_MSCKF);
   propagator->invalidate_cache();
-  rT4 = boost::posix_time::microsec_clock::local_time();
+  selectorMSCKF->update_latency_model(rows_MSCKF, 1e3 * trace_msckf_ekf.stop());
+  double time_msckf = trace_msckf.stop();
 
   // Perform SLAM delay init and update
   // NOTE: that we provide the option here to do a *sequential* update
   // NOTE: this will be a lot faster but won't be as accurate.
+  TraceScope trace_slam_update("slam update");
   std::vector<std::shared_ptr<Feature>> feats_slam_UPDATE_TEMP;
   while (!feats_slam_UPDATE.empty()) {
     // Get sub vector of the features we will update with
@@ -590,9 +771,23 @@ void VioManager::do_feature_propagate_update(const ov_core::CameraData &message)
     propagator->invalidate_cache();
   }
   feats_slam_UPDATE = feats_slam_UPDATE_TEMP;
-  rT5 = boost::posix_time::microsec_clock::local_time();
-  updaterSLAM->delayed_init(state, feats_slam_DELAYED);
-  rT6 = boost::posix_time::microsec_clock::local_time();
+  double time_slam_update = trace_slam_update.stop();
+  TraceScope trace_slam_delay("slam delayed");
+  // NOTE: if overloaded we defer initialization, the features will still be in the database next frame
+  bool defer_slam_init = overload->defer_slam_delayed_init();
+  if (!defer_slam_init) {
+    updaterSLAM->delayed_init(state, feats_slam_DELAYED);
+  } else if (!feats_slam_DELAYED.empty()) {
+    PRINT_DEBUG(YELLOW "[OVERLOAD]: deferring delayed init of %d SLAM features\n" RESET, (int)feats_slam_DELAYED.size());
+  }
+  double time_slam_delay = trace_slam_delay.stop();
+
+  // Keep our SLAM landmarks in the long-term map so the tracker can re-identify them once they are marginalized
+  if (landmark_map != nullptr) {
+    OV_TRACE_SCOPE("landmark map");
+    update_landmark_map(message);
+  }
+  TraceScope trace_marg("re-tri & marg");
 
   //===================================================================================
   // Update our visualization feature set, and clean up the old features
@@ -601,8 +796,10 @@ void VioManager::do_feature_propagate_update(const ov_core::CameraData &message)
   // Re-triangulate all current tracks in the current frame
   if (message.sensor_ids.at(0) == 0) {
 
-    // Re-triangulate features
-    retriangulate_active_tracks(message);
+    // Re-triangulate features (skipped if we are overloaded)
+    if (!overload->skip_retriangulation()) {
+      retriangulate_active_tracks(message);
+    }
 
     // Clear the MSCKF features only on the base camera
     // Thus we should be able to visualize the other unique camera stream
@@ -620,12 +817,22 @@ void VioManager::do_feature_propagate_update(const ov_core::CameraData &message)
   // Cleanup, marginalize out what we don't need any more...
   //===================================================================================
 
+  // The updaters have removed the measurements not at clone times from the features they used
+  // Those which are kept (i.e. failed to be used) need their newest time re-indexed, so they are found once they are lost
+  std::vector<std::shared_ptr<Feature>> feats_updated = featsup_MSCKF;
+  feats_updated.insert(feats_updated.end(), feats_slam_UPDATE.begin(), feats_slam_UPDATE.end());
+  feats_updated.insert(feats_updated.end(), feats_slam_DELAYED.begin(), feats_slam_DELAYED.end());
+  feats_database()->reindex_features(feats_updated);
+  if (trackARUCO != nullptr) {
+    aruco_database()->reindex_features(feats_updated);
+  }
+
   // Remove features that where used for the update from our extractors at the last timestep
   // This allows for measurements to be used in the future if they failed to be used this time
   // Note we need to do this before we feed a new image, as we want all new measurements to NOT be deleted
-  trackFEATS->get_feature_database()->cleanup();
+  feats_database()->cleanup();
   if (trackARUCO != nullptr) {
-    trackARUCO->get_feature_database()->cleanup();
+    aruco_database()->cleanup();
   }
 
   // First do anchor change if we are about to lose an anchor pose
@@ -633,28 +840,27 @@ void VioManager::do_feature_propagate_update(const ov_core::CameraData &message)
 
   // Cleanup any features older than the marginalization time
   if ((int)state->_clones_IMU.size() > state->_options.max_clone_size) {
-    trackFEATS->get_feature_database()->cleanup_measurements(state->margtimestep());
+    feats_database()->cleanup_measurements(state->margtimestep());
     if (trackARUCO != nullptr) {
-      trackARUCO->get_feature_database()->cleanup_measurements(state->margtimestep());
+      aruco_database()->cleanup_measurements(state->margtimestep());
     }
   }
 
   // Finally marginalize the oldest clone if needed
   StateHelper::marginalize_old_clone(state);
-  rT7 = boost::posix_time::microsec_clock::local_time();
+  double time_marg = trace_marg.stop();
 
   //===================================================================================
   // Debug info, and stats tracking
   //===================================================================================
 
   // Get timing statitics information
-  double time_track = (rT2 - rT1).total_microseconds() * 1e-6;
-  double time_prop = (rT3 - rT2).total_microseconds() * 1e-6;
-  double time_msckf = (rT4 - rT3).total_microseconds() * 1e-6;
-  double time_slam_update = (rT5 - rT4).total_microseconds() * 1e-6;
-  double time_slam_delay = (rT6 - rT5).total_microseconds() * 1e-6;
-  double time_marg = (rT7 - rT6).total_microseconds() * 1e-6;
-  double time_total = (rT7 - rT1).total_microseconds() * 1e-6;
+  // NOTE: the total also includes the time between our stages (e.g. zupt check)
+  double time_total = time_track + trace_update.stop();
+  metrics_feed_update({time_track, time_prop, time_msckf, time_slam_update, time_slam_delay, time_marg, time_total});
+
+  // Let our overload controller know how long this frame took
+  overload->feed_timings(time_track, time_prop, time_msckf, time_slam_update, time_slam_delay, time_marg, time_total);
 
   // Timing information
   PRINT_DEBUG(BLUE "[TIME]: %.4f seconds for tracking\n" RESET, time_track);
@@ -665,6 +871,12 @@ void VioManager::do_feature_propagate_update(const ov_core::CameraData &message)
     PRINT_DEBUG(BLUE "[TIME]: %.4f seconds for SLAM delayed init (%d feats)\n" RESET, time_slam_delay, (int)feats_slam_DELAYED.size());
   }
   PRINT_DEBUG(BLUE "[TIME]: %.4f seconds for re-tri & marg (%d clones in state)\n" RESET, time_marg, (int)state->_clones_IMU.size());
+  if (updaterZUPT != nullptr) {
+    int zupt_rejected, zupt_checked, zupt_accepted;
+    updaterZUPT->get_decision_counts(zupt_rejected, zupt_checked, zupt_accepted);
+    PRINT_DEBUG(BLUE "[TIME]: zupt decisions (%d pre-filter rejected, %d full checks, %d accepted)\n" RESET, zupt_rejected, zupt_checked,
+                zupt_accepted);
+  }
 
   std::stringstream ss;
   ss << "[TIME]: " << std::setprecision(4) << time_total << " seconds for total (camera";
@@ -674,20 +886,25 @@ void VioManager::do_feature_propagate_update(const ov_core::CameraData &message)
   ss << ")" << std::endl;
   PRINT_DEBUG(BLUE "%s" RESET, ss.str().c_str());
 
-  // Finally if we are saving stats to file, lets save it to file
-  if (params.record_timing_information && of_statistics.is_open()) {
+  // Finally if we are saving stats to file, lets collect our traced stages and save them
+  // NOTE: we only do this every couple of frames to not have to write to the files every frame
+  if ((trace_timing != nullptr || trace_chrome != nullptr) && ++trace_frames % 20 == 0) {
+    trace_flush();
+  }
+  if (params.record_timing_information) {
     // We want to publish in the IMU clock frame
     // The timestamp in the state will be the last camera time
     double t_ItoC = state->_calib_dt_CAMtoIMU->value()(0);
     double timestamp_inI = state->_timestamp + t_ItoC;
-    // Append to the file
-    of_statistics << std::fixed << std::setprecision(15) << timestamp_inI << "," << std::fixed << std::setprecision(5) << time_track << ","
-                  << time_prop << "," << time_msckf << ",";
-    if (state->_options.max_slam_features > 0) {
-      of_statistics << time_slam_update << "," << time_slam_delay << ",";
+    // Record what our overload controller has decided for the next frame
+    if (of_overload.is_open()) {
+      of_overload << std::fixed << std::setprecision(15) << timestamp_inI << "," << std::fixed << std::setprecision(5)
+                  << overload->predicted_ms() << "," << overload->deadline_ms() << "," << (int)overload->level() << ","
+                  << overload->max_msckf_features(state->_options.max_msckf_in_update) << ","
+                  << overload->msckf_budget_ms(params.msckf_select_options.budget_ms) << "," << (int)overload->defer_slam_delayed_init()
+                  << "," << (int)overload->skip_retriangulation() << std::endl;
+      of_overload.flush();
     }
-    of_statistics << time_marg << "," << time_total << std::endl;
-    of_statistics.flush();
   }
 
   // Update our distance traveled
@@ -26,27 +26,45 @@
 #include <algorithm>
 #include <atomic>
 #include <boost/filesystem.hpp>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 
 #include "VioManagerOptions.h"
 
 namespace ov_core {
+class CamBase;
 struct ImuData;
 struct CameraData;
 class TrackBase;
+class FeatureDatabase;
 class FeatureInitializer;
+class ImagePool;
+class LandmarkMap;
+class TraceContext;
+class TraceTimingWriter;
+class TraceChromeWriter;
+class MetricsRegistry;
 } // namespace ov_core
 namespace ov_init {
 class InertialInitializer;
 } // namespace ov_init
+namespace ov_type {
+class Landmark;
+} // namespace ov_type
 
 namespace ov_msckf {
 
 class State;
 class StateHelper;
+class FeatureSelector;
+class InputLogWriter;
+class OverloadController;
 class UpdaterMSCKF;
 class UpdaterSLAM;
 class UpdaterZeroVelocity;
@@ -70,6 +88,11 @@ public:
    */
   VioManager(VioManagerOptions &params_);
 
+  /**
+   * @brief Destructor, will finish updating with any queued frames and stop the estimator thread if pipelined
+   */
+  ~VioManager();
+
   /**
    * @brief Feed function for inertial data
    * @param message Contains our timestamp and inertial information
@@ -80,7 +103,7 @@ public:
    * @brief Feed function for camera measurements
    * @param message Contains our timestamp, images, and camera ids
    */
-  void feed_measurement_camera(const ov_core::CameraData &message) { track_image_and_update(message); }
+  void feed_measurement_camera(const ov_core::CameraData &message);
 
   /**
    * @brief Feed function for a synchronized simulated cameras
@@ -97,6 +120,49 @@ public:
    */
   void initialize_with_gt(Eigen::Matrix<double, 17, 1> imustate);
 
+  /**
+   * @brief Saves everything needed to resume estimation into a binary checkpoint file
+   *
+   * This has the state (covariance, clones, SLAM features and calibration), the IMU history and cache of the propagator,
+   * the IMU history of the zero velocity updater, and all feature tracks which have not been used yet.
+   * The state of the visual trackers (last images, active points and their descriptors) is not saved.
+   * Thus a restored system will extract new features on its first image, and old tracks are not continued.
+   * This should be called from the thread that feeds the camera measurements.
+   * If pipelined, we will first wait for the estimator to finish updating with all queued frames.
+   *
+   * @param path Path to the checkpoint file
+   * @return True if the checkpoint was saved
+   */
+  bool save_checkpoint(const std::string &path);
+
+  /**
+   * @brief Restores a checkpoint so we can continue estimating without having to initialize again
+   *
+   * This should be called right after construction, before any measurements are fed.
+   * The config should be the same as the one used when the checkpoint was saved.
+   *
+   * @param path Path to the checkpoint file
+   * @return True if the checkpoint was loaded (otherwise we remain uninitialized)
+   */
+  bool load_checkpoint(const std::string &path);
+
+  /**
+   * @brief Stops the initialization that is running (if any) and discards its result
+   *
+   * The initializer itself can not be interrupted, thus this will block until the running attempt has finished.
+   * Initialization will be attempted again on the next camera frame.
+   */
+  void cancel_initialization();
+
+  /**
+   * @brief Progress of our initialization
+   * @param running If an initialization attempt is currently running
+   * @param attempts Number of initialization attempts so far
+   * @param running_sec How long the current attempt has been running (seconds)
+   * @param frames_queued Number of frames that came in during the current attempt which we will need to catch up with
+   */
+  void get_init_stats(bool &running, int &attempts, double &running_sec, int &frames_queued);
+
   /// If we are initialized or not
   bool initialized() { return is_initialized_vio && timelastupdate != -1; }
 
@@ -106,9 +172,21 @@ public:
   /// Accessor for current system parameters
   VioManagerOptions get_params() { return params; }
 
-  /// Accessor to get the current state
+  /**
+   * @brief Accessor to get the current state
+   *
+   * If use_pipeline is enabled, the estimator thread keeps changing the state after feed_measurement_camera() has returned.
+   * Thus anything reading the state from another thread (e.g. the visualizers) should hold lock_state() while doing so.
+   */
   std::shared_ptr<State> get_state() { return state; }
 
+  /**
+   * @brief Locks our state, the estimator holds this while it changes the state (see get_state())
+   *
+   * This is recursive, thus a reader can hold it and still call the feature accessors below (which lock it themselves).
+   */
+  std::unique_lock<std::recursive_mutex> lock_state() { return std::unique_lock<std::recursive_mutex>(state_mtx); }
+
   /// Accessor to get the current propagator
   std::shared_ptr<Propagator> get_propagator() { return propagator; }
 
@@ -122,22 +200,53 @@ public:
   std::vector<Eigen::Vector3d> get_features_ARUCO();
 
   /// Returns 3d features used in the last update in global frame
-  std::vector<Eigen::Vector3d> get_good_features_MSCKF() { return good_features_MSCKF; }
+  std::vector<Eigen::Vector3d> get_good_features_MSCKF() {
+    std::lock_guard<std::recursive_mutex> lck(state_mtx);
+    return good_features_MSCKF;
+  }
 
   /// Return the image used when projecting the active tracks
   void get_active_image(double &timestamp, cv::Mat &image) {
-    timestamp = active_tracks_time;
-    image = active_image;
+    std::lock_guard<std::mutex> lck(active_tracks_mtx);
+    timestamp = active_tracks[active_tracks_front].time;
+    image = active_tracks[active_tracks_front].image;
   }
 
   /// Returns active tracked features in the current frame
   void get_active_tracks(double &timestamp, std::unordered_map<size_t, Eigen::Vector3d> &feat_posinG,
                          std::unordered_map<size_t, Eigen::Vector3d> &feat_tracks_uvd) {
-    timestamp = active_tracks_time;
-    feat_posinG = active_tracks_posinG;
-    feat_tracks_uvd = active_tracks_uvd;
+    std::lock_guard<std::mutex> lck(active_tracks_mtx);
+    timestamp = active_tracks[active_tracks_front].time;
+    feat_posinG = active_tracks[active_tracks_front].posinG;
+    feat_tracks_uvd = active_tracks[active_tracks_front].uvd;
   }
 
+  /**
+   * @brief Statistics of our tracking to estimator pipeline (only non-zero if use_pipeline is enabled)
+   * @param queue_depth Number of tracked frames currently waiting for the estimator
+   * @param queue_depth_max Max number of tracked frames that have been waiting at once
+   * @param track_ms Moving average of the time (ms) to track a frame
+   * @param wait_ms Moving average of the time (ms) a tracked frame waited before the estimator started on it
+   * @param update_ms Moving average of the time (ms) the estimator took to update with a frame
+   */
+  void get_pipeline_stats(int &queue_depth, int &queue_depth_max, double &track_ms, double &wait_ms, double &update_ms);
+
+  /**
+   * @brief Snapshot of our runtime metrics (tracking, update, state size and stage latencies)
+   *
+   * The keys are the series names as they appear in the Prometheus text file (e.g. `ov_msckf_features_lost_total{cam="0"}`).
+   * This can be called from any thread.
+   *
+   * @return Map between each series and its current value
+   */
+  std::map<std::string, double> get_metrics();
+
+  /// Registry that holds our runtime metrics (can be used to register and dump additional ones)
+  std::shared_ptr<ov_core::MetricsRegistry> get_metrics_registry() { return metrics; }
+
+  /// Context our threads trace into (can be enabled and collected if we are not writing the events ourselves)
+  std::shared_ptr<ov_core::TraceContext> get_trace_context() { return trace_context; }
+
 protected:
   /**
    * @brief Given a new set of camera images, this will track them.
@@ -167,6 +276,19 @@ protected:
    */
   bool try_to_initialize(const ov_core::CameraData &message);
 
+  /// Result of a successful initialization attempt which we still need to apply to our state
+  struct InitResult;
+
+  /// Runs one initialization attempt on the initialization thread (the state is not changed by this)
+  void initialize_task();
+
+  /**
+   * @brief Applies a successful initialization and then moves the state forward to the current frame
+   * @param result Result of the initialization attempt
+   * @param message Current camera frame (which we will update with next)
+   */
+  void initialize_apply(const std::shared_ptr<InitResult> &result, const ov_core::CameraData &message);
+
   /**
    * @brief This function will will re-triangulate all features in the current frame
    *
@@ -174,10 +296,85 @@ protected:
    * This is useful for downstream applications which need the current pointcloud of points (e.g. loop closure).
    * This will try to triangulate *all* points, not just ones that have been used in the update.
    *
+   * Here we only snapshot the clone pose, calibration and active tracks of this frame.
+   * If we thread our publishing, the triangulation is done by a background thread so the update does not wait on it.
+   *
    * @param message Contains our timestamp, images, and camera ids
    */
   void retriangulate_active_tracks(const ov_core::CameraData &message);
 
+  /// Snapshot of what the re-triangulation needs from the state and tracker at one frame
+  struct RetriFrame;
+
+  /**
+   * @brief Triangulates the active tracks of a snapshot and swaps the result in as the front active tracks
+   * @param frame Snapshot of the frame we want the active tracks of
+   */
+  void retriangulate_frame(const std::shared_ptr<RetriFrame> &frame);
+
+  /// Re-triangulation thread loop, will process the newest snapshot (older ones which have not been started are dropped)
+  void retriangulate_loop();
+
+  /// Tracked camera message and its new feature measurements which the estimator thread will update with
+  struct PipelineFrame;
+
+  /**
+   * @brief Will hand-off the newest tracked frame to the estimator thread (blocks if the queue is full)
+   *
+   * We only copy the measurements at this frame's time out of the tracker databases.
+   * Thus the estimator is the only one which will touch the features in its databases.
+   *
+   * @param message Contains our timestamp, images, and camera ids
+   * @param time_track_frame How long it took to track this message in seconds
+   */
+  void pipeline_push(const ov_core::CameraData &message, double time_track_frame);
+
+  /// Estimator thread loop, will update with the tracked frames in the order they where pushed
+  void pipeline_loop();
+
+  /**
+   * @brief Appends the frame's measurements into our estimator databases, then does the zupt or propagate and update
+   * @param frame Tracked frame we should update with
+   */
+  void pipeline_update(const std::shared_ptr<PipelineFrame> &frame);
+
+  /// Position of a landmark of our state in the global frame
+  Eigen::Vector3d get_feature_in_global(const std::shared_ptr<ov_type::Landmark> &landmark);
+
+  /**
+   * @brief Records our current SLAM landmarks in the landmark map, and predicts which landmarks the next images will see
+   *
+   * We use the current camera poses as the prediction, thus a landmark can be re-identified as long as
+   * the motion until the next image is within the match radius of the tracker.
+   *
+   * @param message Contains our timestamp and camera ids
+   */
+  void update_landmark_map(const ov_core::CameraData &message);
+
+  /// Feature database the estimator should use (the tracker one, or the one handed-off to the estimator thread if pipelined)
+  std::shared_ptr<ov_core::FeatureDatabase> feats_database();
+
+  /// Aruco database the estimator should use (the tracker one, or the one handed-off to the estimator thread if pipelined)
+  std::shared_ptr<ov_core::FeatureDatabase> aruco_database();
+
+  /// Collects all traced events and appends them to our timing and trace files
+  void trace_flush();
+
+  /// Handles of the metrics which we update every frame
+  struct MetricsHandles;
+
+  /// Registers all our metrics and gets their handles
+  void metrics_register();
+
+  /// Updates the tracking metrics with the ids tracked in the newest frame
+  void metrics_feed_tracks();
+
+  /**
+   * @brief Updates the state metrics and stage latencies after an update, and dumps the metrics file if it is time
+   * @param stage_times Time (sec) of each of the stages (same order as the timing file) and the total
+   */
+  void metrics_feed_update(const std::vector<double> &stage_times);
+
   /// Manager parameters
   VioManagerOptions params;
 
@@ -202,6 +399,12 @@ protected:
   /// Our MSCKF feature updater
   std::shared_ptr<UpdaterMSCKF> updaterMSCKF;
 
+  /// Selects which MSCKF features we update with
+  std::shared_ptr<FeatureSelector> selectorMSCKF;
+
+  /// Degrades what we process if we are falling behind
+  std::shared_ptr<OverloadController> overload;
+
   /// Our SLAM/ARUCO feature updater
   std::shared_ptr<UpdaterSLAM> updaterSLAM;
 
@@ -210,12 +413,37 @@ protected:
 
   /// This is the queue of measurement times that have come in since we starting doing initialization
   /// After we initialize, we will want to prop & update to the latest timestamp quickly
+  /// The mutex also protects the result of the initialization thread, which we apply on the next frame
   std::vector<double> camera_queue_init;
   std::mutex camera_queue_init_mtx;
+  std::shared_ptr<InitResult> init_result;
+
+  // Timing statistic files and variables
+  // NOTE: time_track is how long the frame we are updating with took to track (in seconds)
+  std::shared_ptr<ov_core::TraceTimingWriter> trace_timing;
+  std::shared_ptr<ov_core::TraceChromeWriter> trace_chrome;
+  std::ofstream of_overload;
+  int trace_frames = 0;
+  double time_track = 0.0;
+
+  // Runtime metrics and the handles we update
+  std::shared_ptr<ov_core::MetricsRegistry> metrics;
+  std::shared_ptr<MetricsHandles> metrics_handles;
 
-  // Timing statistic file and variables
-  std::ofstream of_statistics;
-  boost::posix_time::ptime rT1, rT2, rT3, rT4, rT5, rT6, rT7;
+  /// Log of all inputs we have been fed (null if not recording)
+  std::shared_ptr<InputLogWriter> input_log;
+
+  /// Buffers for the images we create each frame (simulated and downsampled images)
+  std::shared_ptr<ov_core::ImagePool> image_pool;
+
+  /// Long-term map of our SLAM landmarks (null if disabled)
+  std::shared_ptr<ov_core::LandmarkMap> landmark_map;
+
+  /// Print settings of the thread that created us, used by the threads we start
+  ov_core::Printer::ThreadContext print_context;
+
+  /// Trace recording of this system, used by the threads we start and set while in our feed functions
+  std::shared_ptr<ov_core::TraceContext> trace_context;
 
   // Track how much distance we have traveled
   double timelastupdate = -1;
@@ -224,25 +452,74 @@ protected:
   // Startup time of the filter
   double startup_time = -1;
 
-  // Threads and their atomics
-  std::atomic<bool> thread_init_running, thread_init_success;
+  // Initialization thread and its atomics
+  std::thread thread_init;
+  std::atomic<bool> thread_init_running, thread_init_cancel;
+  int init_attempts = 0;
+  int64_t init_start_ns = 0;
 
   // If we did a zero velocity update
-  bool did_zupt_update = false;
-  bool has_moved_since_zupt = false;
+  std::atomic<bool> did_zupt_update{false};
+  std::atomic<bool> has_moved_since_zupt{false};
+
+  // Held while the state and the features of the last update are changed (by the estimator thread if pipelined)
+  std::recursive_mutex state_mtx;
 
   // Good features that where used in the last update (used in visualization)
   std::vector<Eigen::Vector3d> good_features_MSCKF;
 
   // Re-triangulated features 3d positions seen from the current frame (used in visualization)
-  // For each feature we have a linear system A * p_FinG = b we create and increment their costs
-  double active_tracks_time = -1;
-  std::unordered_map<size_t, Eigen::Vector3d> active_tracks_posinG;
-  std::unordered_map<size_t, Eigen::Vector3d> active_tracks_uvd;
-  cv::Mat active_image;
-  std::map<size_t, Eigen::Matrix3d> active_feat_linsys_A;
-  std::map<size_t, Eigen::Vector3d> active_feat_linsys_b;
-  std::map<size_t, int> active_feat_linsys_count;
+  // These are double buffered, the re-triangulation writes the back one and then swaps it to the front which the getters read
+  struct ActiveTracks {
+    double time = -1;
+    std::unordered_map<size_t, Eigen::Vector3d> posinG;
+    std::unordered_map<size_t, Eigen::Vector3d> uvd;
+    cv::Mat image;
+  };
+  ActiveTracks active_tracks[2];
+  int active_tracks_front = 0;
+  std::mutex active_tracks_mtx;
+
+  // For each feature we have a linear system A * p_FinG = b we create and increment their costs (only used by the re-triangulation)
+  struct ActiveFeatLinsys {
+    Eigen::Matrix3d A;
+    Eigen::Vector3d b;
+    int count;
+  };
+  std::unordered_map<size_t, ActiveFeatLinsys> active_feat_linsys;
+
+  // Camera models the re-triangulation undistorts with, set to the calibration of each snapshot (only used by the re-triangulation)
+  std::unordered_map<size_t, std::shared_ptr<ov_core::CamBase>> retri_cameras;
+
+  // Re-triangulation thread and the newest snapshot it has not started on yet
+  std::thread retri_thread;
+  std::mutex retri_mtx;
+  std::condition_variable retri_cv;
+  std::shared_ptr<RetriFrame> retri_pending;
+  bool retri_stop = false;
+
+  // Tracking to estimator pipeline
+  // Once started the tracker appends into new databases and the estimator owns the ones from before
+  std::atomic<bool> pipeline_started;
+  std::thread pipeline_thread;
+  std::mutex pipeline_mtx;
+  std::condition_variable pipeline_cv_push, pipeline_cv_pop;
+  std::deque<std::shared_ptr<PipelineFrame>> pipeline_queue;
+  bool pipeline_stop = false;
+  bool pipeline_busy = false;
+  double pipeline_last_time = -1;
+  std::shared_ptr<ov_core::FeatureDatabase> pipeline_db_feats, pipeline_db_aruco;
+  std::unordered_map<size_t, std::vector<cv::KeyPoint>> pipeline_last_obs;
+  std::unordered_map<size_t, std::vector<size_t>> pipeline_last_ids;
+
+  // Times of the estimator state the tracker and imu feed can read while the estimator is updating
+  std::atomic<double> pipeline_state_time, pipeline_marg_time;
+
+  // Pipeline statistics (protected by the pipeline mutex)
+  int pipeline_depth_max = 0;
+  double pipeline_track_ms = 0.0;
+  double pipeline_wait_ms = 0.0;
+  double pipeline_update_ms = 0.0;
 };
 
 } // namespace ov_msckf
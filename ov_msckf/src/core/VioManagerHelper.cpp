@@ -20,25 +20,51 @@
  */
 
 #include "VioManager.h"
+#include "InputLog.h"
+#include "OverloadController.h"
 
+#include "cam/CamEqui.h"
+#include "cam/CamRadtan.h"
 #include "feat/Feature.h"
 #include "feat/FeatureDatabase.h"
 #include "feat/FeatureInitializer.h"
+#include "feat/LandmarkMap.h"
+#include "track/TrackBase.h"
 #include "types/LandmarkRepresentation.h"
+#include "utils/binary_io.h"
+#include "utils/metrics.h"
 #include "utils/print.h"
+#include "utils/sensor_data.h"
+#include "utils/trace.h"
 
 #include "init/InertialInitializer.h"
 
 #include "state/Propagator.h"
 #include "state/State.h"
 #include "state/StateHelper.h"
+#include "update/UpdaterZeroVelocity.h"
+
+#include <cstring>
+#include <unordered_set>
 
 using namespace ov_core;
 using namespace ov_type;
 using namespace ov_msckf;
 
+namespace {
+
+/// Magic bytes and version at the start of our checkpoint files (the version should be increased if what we save changes)
+const char checkpoint_magic[8] = {'O', 'V', 'C', 'K', 'P', 'T', '\0', '\0'};
+const uint32_t checkpoint_version = 2;
+
+} // namespace
+
 void VioManager::initialize_with_gt(Eigen::Matrix<double, 17, 1> imustate) {
 
+  // Record the state so a replay starts from the same one
+  if (input_log != nullptr)
+    input_log->write_groundtruth(imustate);
+
   // Initialize the system
   state->_imu->set_value(imustate.block(1, 0, 16, 1));
   state->_imu->set_fej(imustate.block(1, 0, 16, 1));
@@ -75,289 +101,549 @@ void VioManager::initialize_with_gt(Eigen::Matrix<double, 17, 1> imustate) {
   PRINT_DEBUG(GREEN "[INIT]: position = %.4f, %.4f, %.4f\n" RESET, state->_imu->pos()(0), state->_imu->pos()(1), state->_imu->pos()(2));
 }
 
+struct VioManager::InitResult {
+
+  /// Timestamp the state was initialized at
+  double timestamp;
+
+  /// Covariance of the initialized variables (in the order of order)
+  Eigen::MatrixXd covariance;
+  std::vector<std::shared_ptr<ov_type::Type>> order;
+
+  /// Initialized IMU state (has the same ids as the IMU in our state)
+  std::shared_ptr<ov_type::IMU> imu;
+
+  /// How long the initialization took (seconds)
+  double time_init;
+};
+
 bool VioManager::try_to_initialize(const ov_core::CameraData &message) {
 
   // Directly return if the initialization thread is running
-  // Note that we lock on the queue since we could have finished an update
-  // And are using this queue to propagate the state forward. We should wait in this case
-  if (thread_init_running) { // 原子布尔值
+  // We record this frame time so we can move the state forward to it once initialized
+  // Otherwise grab the result of the last attempt, which we apply here so nothing else touches the state meanwhile
+  std::shared_ptr<InitResult> result;
+  {
     std::lock_guard<std::mutex> lck(camera_queue_init_mtx);
-    camera_queue_init.push_back(message.timestamp);
-    return false;
+    if (thread_init_running) {
+      camera_queue_init.push_back(message.timestamp);
+      return false;
+    }
+    result = init_result;
+    init_result = nullptr;
+  }
+  if (thread_init.joinable()) {
+    thread_init.join();
   }
 
-  // If the thread was a success, then return success!
-  if (thread_init_success) {
+  // If the last attempt was a success, then apply it and return success!
+  if (result != nullptr) {
+    initialize_apply(result, message);
     return true;
   }
 
   // Run the initialization in a second thread so it can go as slow as it desires
-  thread_init_running = true;
-  std::thread thread([&] { // code lambda可以没有'()'
-    // Returns from our initializer
-    double timestamp;
-    Eigen::MatrixXd covariance;
-    std::vector<std::shared_ptr<ov_type::Type>> order;
-    auto init_rT1 = boost::posix_time::microsec_clock::local_time();
-
-    // Try to initialize the system
-    // We will wait for a jerk if we do not have the zero velocity update enabled
-    // Otherwise we can initialize right away as the zero velocity will handle the stationary case
-    bool wait_for_jerk = (updaterZUPT == nullptr); // todo 什么意思 // code 根据是否存在零速检测判断是否需要等待加速度突变
-    bool success = initializer->initialize(timestamp, covariance, order, state->_imu, wait_for_jerk);
-
-    // If we have initialized successfully we will set the covariance and state elements as needed
-    // TODO: set the clones and SLAM features here so we can start updating right away...
-    if (success) {
-
-      // Set our covariance (state should already be set in the initializer)
-      StateHelper::set_initial_covariance(state, covariance, order);
-
-      // Set the state time
-      state->_timestamp = timestamp;
-      startup_time = timestamp;
-
-      // Cleanup any features older than the initialization time
-      // Also increase the number of features to the desired amount during estimation
-      // NOTE: we will split the total number of features over all cameras uniformly
-      trackFEATS->get_feature_database()->cleanup_measurements(state->_timestamp);
-      trackFEATS->set_num_features(std::floor((double)params.num_pts / (double)params.state_options.num_cameras));
-      if (trackARUCO != nullptr) {
-        trackARUCO->get_feature_database()->cleanup_measurements(state->_timestamp);
-      }
+  // If we are single threaded, then wait for it (its result will be applied on the next frame)
+  {
+    std::lock_guard<std::mutex> lck(camera_queue_init_mtx);
+    init_attempts++;
+    init_start_ns = Trace::now_ns();
+    thread_init_cancel = false;
+    thread_init_running = true;
+  }
+  thread_init = std::thread(&VioManager::initialize_task, this);
+  if (!params.use_multi_threading_subs) {
+    thread_init.join();
+  }
+  return false;
+}
 
-      // If we are moving then don't do zero velocity update4
-      if (state->_imu->vel().norm() > params.zupt_max_velocity) {
-        has_moved_since_zupt = true;
-      }
+void VioManager::initialize_task() {
+  Printer::setThreadContext(print_context);
+  Trace::setThreadContext(trace_context);
+
+  // We initialize a copy of our IMU, thus the state is only changed once the result is applied
+  // It has the same ids, so the covariance order can be directly used for our state
+  auto result = std::make_shared<InitResult>();
+  result->imu = std::make_shared<ov_type::IMU>();
+  result->imu->set_local_id(state->_imu->id());
+  result->imu->set_value(state->_imu->value());
+  result->imu->set_fej(state->_imu->fej());
+
+  // Try to initialize the system
+  // We will wait for a jerk if we do not have the zero velocity update enabled
+  // Otherwise we can initialize right away as the zero velocity will handle the stationary case
+  bool wait_for_jerk = (updaterZUPT == nullptr);
+  bool success = initializer->initialize(result->timestamp, result->covariance, result->order, result->imu, wait_for_jerk);
+  result->time_init = 1e-9 * (double)(Trace::now_ns() - init_start_ns);
+
+  // Hand the result to the next frame (unless we have been cancelled)
+  // On failure we drop the queued frame times since the next attempt will start fresh
+  std::lock_guard<std::mutex> lck(camera_queue_init_mtx);
+  if (success && !thread_init_cancel) {
+    init_result = result;
+  } else {
+    if (!thread_init_cancel) {
+      PRINT_DEBUG(YELLOW "[init]: failed initialization in %.4f seconds\n" RESET, result->time_init);
+    }
+    camera_queue_init.clear();
+  }
 
-      // Else we are good to go, print out our stats
-      auto init_rT2 = boost::posix_time::microsec_clock::local_time();
-      PRINT_INFO(GREEN "[init]: successful initialization in %.4f seconds\n" RESET, (init_rT2 - init_rT1).total_microseconds() * 1e-6);
-      PRINT_INFO(GREEN "[init]: orientation = %.4f, %.4f, %.4f, %.4f\n" RESET, state->_imu->quat()(0), state->_imu->quat()(1),
-                 state->_imu->quat()(2), state->_imu->quat()(3));
-      PRINT_INFO(GREEN "[init]: bias gyro = %.4f, %.4f, %.4f\n" RESET, state->_imu->bias_g()(0), state->_imu->bias_g()(1),
-                 state->_imu->bias_g()(2));
-      PRINT_INFO(GREEN "[init]: velocity = %.4f, %.4f, %.4f\n" RESET, state->_imu->vel()(0), state->_imu->vel()(1), state->_imu->vel()(2));
-      PRINT_INFO(GREEN "[init]: bias accel = %.4f, %.4f, %.4f\n" RESET, state->_imu->bias_a()(0), state->_imu->bias_a()(1),
-                 state->_imu->bias_a()(2));
-      PRINT_INFO(GREEN "[init]: position = %.4f, %.4f, %.4f\n" RESET, state->_imu->pos()(0), state->_imu->pos()(1), state->_imu->pos()(2));
-
-      // Remove any camera times that are order then the initialized time
-      // This can happen if the initialization has taken a while to perform
-      std::lock_guard<std::mutex> lck(camera_queue_init_mtx);
-      std::vector<double> camera_timestamps_to_init;
-      for (size_t i = 0; i < camera_queue_init.size(); i++) {
-        if (camera_queue_init.at(i) > timestamp) {
-          camera_timestamps_to_init.push_back(camera_queue_init.at(i));
-        }
-      }
+  // Finally, mark that the thread has finished running
+  thread_init_running = false;
+}
+
+void VioManager::initialize_apply(const std::shared_ptr<InitResult> &result, const ov_core::CameraData &message) {
+
+  // Set our state and covariance
+  state->_imu->set_value(result->imu->value());
+  state->_imu->set_fej(result->imu->fej());
+  std::vector<std::shared_ptr<ov_type::Type>> order;
+  for (const auto &type : result->order) {
+    order.push_back((type == result->imu) ? std::static_pointer_cast<ov_type::Type>(state->_imu) : type);
+  }
+  StateHelper::set_initial_covariance(state, result->covariance, order);
 
-      // Now we have initialized we will propagate the state to the current timestep
-      // In general this should be ok as long as the initialization didn't take too long to perform
-      // Propagating over multiple seconds will become an issue if the initial biases are bad
-      size_t clone_rate = (size_t)((double)camera_timestamps_to_init.size() / (double)params.state_options.max_clone_size) + 1;
-      for (size_t i = 0; i < camera_timestamps_to_init.size(); i += clone_rate) {
-        propagator->propagate_and_clone(state, camera_timestamps_to_init.at(i));
-        StateHelper::marginalize_old_clone(state);
+  // Set the state time
+  state->_timestamp = result->timestamp;
+  startup_time = result->timestamp;
+
+  // Cleanup any features older than the initialization time
+  // Also increase the number of features to the desired amount during estimation
+  // NOTE: we will split the total number of features over all cameras uniformly
+  trackFEATS->get_feature_database()->cleanup_measurements(state->_timestamp);
+  trackFEATS->set_num_features(std::floor((double)params.num_pts / (double)params.state_options.num_cameras));
+  if (trackARUCO != nullptr) {
+    trackARUCO->get_feature_database()->cleanup_measurements(state->_timestamp);
+  }
+
+  // If we are moving then don't do zero velocity update4
+  if (state->_imu->vel().norm() > params.zupt_max_velocity) {
+    has_moved_since_zupt = true;
+  }
+
+  // Else we are good to go, print out our stats
+  PRINT_INFO(GREEN "[init]: successful initialization in %.4f seconds (attempt %d)\n" RESET, result->time_init, init_attempts);
+  PRINT_INFO(GREEN "[init]: orientation = %.4f, %.4f, %.4f, %.4f\n" RESET, state->_imu->quat()(0), state->_imu->quat()(1),
+             state->_imu->quat()(2), state->_imu->quat()(3));
+  PRINT_INFO(GREEN "[init]: bias gyro = %.4f, %.4f, %.4f\n" RESET, state->_imu->bias_g()(0), state->_imu->bias_g()(1),
+             state->_imu->bias_g()(2));
+  PRINT_INFO(GREEN "[init]: velocity = %.4f, %.4f, %.4f\n" RESET, state->_imu->vel()(0), state->_imu->vel()(1), state->_imu->vel()(2));
+  PRINT_INFO(GREEN "[init]: bias accel = %.4f, %.4f, %.4f\n" RESET, state->_imu->bias_a()(0), state->_imu->bias_a()(1),
+             state->_imu->bias_a()(2));
+  PRINT_INFO(GREEN "[init]: position = %.4f, %.4f, %.4f\n" RESET, state->_imu->pos()(0), state->_imu->pos()(1), state->_imu->pos()(2));
+
+  // Camera times after the initialized time which came in while initializing (this frame is updated with after this)
+  std::vector<double> camera_timestamps_to_init;
+  {
+    std::lock_guard<std::mutex> lck(camera_queue_init_mtx);
+    for (size_t i = 0; i < camera_queue_init.size(); i++) {
+      if (camera_queue_init.at(i) > result->timestamp && camera_queue_init.at(i) < message.timestamp) {
+        camera_timestamps_to_init.push_back(camera_queue_init.at(i));
       }
-      PRINT_DEBUG(YELLOW "[init]: moved the state forward %.2f seconds\n" RESET, state->_timestamp - timestamp);
-      thread_init_success = true;
-      camera_queue_init.clear();
-
-    } else {
-      auto init_rT2 = boost::posix_time::microsec_clock::local_time();
-      PRINT_DEBUG(YELLOW "[init]: failed initialization in %.4f seconds\n" RESET, (init_rT2 - init_rT1).total_microseconds() * 1e-6);
-      thread_init_success = false;
-      std::lock_guard<std::mutex> lck(camera_queue_init_mtx);
-      camera_queue_init.clear();
     }
+    camera_queue_init.clear();
+  }
 
-    // Finally, mark that the thread has finished running
-    thread_init_running = false;
-  });
+  // Now we have initialized we will catch up to the current frame in one batch
+  // Only the newest frames can still be clones once we have cloned the current one, thus we skip cloning the older ones
+  // The first propagation then directly integrates across the older frames
+  // In general this should be ok as long as the initialization didn't take too long to perform
+  // Propagating over multiple seconds will become an issue if the initial biases are bad
+  std::sort(camera_timestamps_to_init.begin(), camera_timestamps_to_init.end());
+  size_t num_clones = std::min(camera_timestamps_to_init.size(), (size_t)std::max(params.state_options.max_clone_size - 1, 0));
+  for (size_t i = camera_timestamps_to_init.size() - num_clones; i < camera_timestamps_to_init.size(); i++) {
+    propagator->propagate_and_clone(state, camera_timestamps_to_init.at(i));
+    StateHelper::marginalize_old_clone(state);
+  }
+  PRINT_DEBUG(YELLOW "[init]: moved the state forward %.2f seconds (%zu of %zu queued frames cloned)\n" RESET,
+              state->_timestamp - result->timestamp, num_clones, camera_timestamps_to_init.size());
+}
 
-  // If we are single threaded, then run single threaded
-  // Otherwise detach this thread so it runs in the background!
-  if (!params.use_multi_threading_subs) {
-    thread.join();
-  } else {
-    thread.detach();
+void VioManager::cancel_initialization() {
+  thread_init_cancel = true;
+  if (thread_init.joinable()) {
+    thread_init.join();
   }
-  return false;
+  std::lock_guard<std::mutex> lck(camera_queue_init_mtx);
+  init_result = nullptr;
+  camera_queue_init.clear();
+}
+
+void VioManager::get_init_stats(bool &running, int &attempts, double &running_sec, int &frames_queued) {
+  std::lock_guard<std::mutex> lck(camera_queue_init_mtx);
+  running = thread_init_running;
+  attempts = init_attempts;
+  running_sec = (running) ? 1e-9 * (double)(Trace::now_ns() - init_start_ns) : 0.0;
+  frames_queued = (int)camera_queue_init.size();
+}
+
+bool VioManager::save_checkpoint(const std::string &path) {
+
+  // We can't save while the initializer or estimator thread is changing the state
+  if (thread_init_running) {
+    PRINT_WARNING(YELLOW "[CHECKPOINT]: initialization is running, unable to save a checkpoint\n" RESET);
+    return false;
+  }
+  if (pipeline_started) {
+    std::unique_lock<std::mutex> lck(pipeline_mtx);
+    pipeline_cv_push.wait(lck, [&] { return (pipeline_queue.empty() && !pipeline_busy) || pipeline_stop; });
+  }
+
+  // Write to a temporary file first, so we never leave a partial checkpoint behind
+  boost::filesystem::path p(path);
+  if (p.has_parent_path())
+    boost::filesystem::create_directories(p.parent_path());
+  std::string path_tmp = path + ".tmp";
+  std::ofstream out(path_tmp, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+  if (!out.is_open()) {
+    PRINT_ERROR(RED "[CHECKPOINT]: unable to open %s\n" RESET, path_tmp.c_str());
+    return false;
+  }
+
+  // Header, then our manager, state, propagator, and feature tracks
+  out.write(checkpoint_magic, sizeof(checkpoint_magic));
+  binary_io::write(out, checkpoint_version);
+  binary_io::write(out, (int32_t)state->_options.num_cameras);
+  binary_io::write(out, (bool)is_initialized_vio);
+  binary_io::write(out, startup_time);
+  binary_io::write(out, timelastupdate);
+  binary_io::write(out, distance);
+  binary_io::write(out, did_zupt_update.load());
+  binary_io::write(out, has_moved_since_zupt.load());
+  StateHelper::save_checkpoint(state, out);
+  propagator->save_checkpoint(out);
+  binary_io::write(out, (bool)(updaterZUPT != nullptr));
+  if (updaterZUPT != nullptr)
+    updaterZUPT->save_checkpoint(out);
+  feats_database()->save_checkpoint(out);
+  binary_io::write(out, (bool)(trackARUCO != nullptr));
+  if (trackARUCO != nullptr)
+    aruco_database()->save_checkpoint(out);
+  out.close();
+  if (out.fail() || std::rename(path_tmp.c_str(), path.c_str()) != 0) {
+    PRINT_ERROR(RED "[CHECKPOINT]: unable to write %s\n" RESET, path.c_str());
+    return false;
+  }
+  PRINT_INFO(GREEN "[CHECKPOINT]: saved state at %.4f with %zu clones and %zu SLAM features\n" RESET, state->_timestamp,
+             state->_clones_IMU.size(), state->_features_SLAM.size());
+  return true;
 }
 
+bool VioManager::load_checkpoint(const std::string &path) {
+
+  // We can only restore if we have not started yet
+  if (is_initialized_vio || thread_init_running || pipeline_started || timelastupdate != -1) {
+    PRINT_ERROR(RED "[CHECKPOINT]: can only load a checkpoint before any measurements are processed\n" RESET);
+    return false;
+  }
+  std::ifstream in(path, std::ifstream::in | std::ifstream::binary);
+  if (!in.is_open()) {
+    PRINT_ERROR(RED "[CHECKPOINT]: unable to open %s\n" RESET, path.c_str());
+    return false;
+  }
+
+  // Check that this is a checkpoint we can read
+  char magic[sizeof(checkpoint_magic)];
+  uint32_t version;
+  int32_t num_cameras;
+  in.read(magic, sizeof(magic));
+  if (!in.good() || std::memcmp(magic, checkpoint_magic, sizeof(magic)) != 0 || !binary_io::read(in, version) ||
+      version != checkpoint_version || !binary_io::read(in, num_cameras) || num_cameras != state->_options.num_cameras) {
+    PRINT_ERROR(RED "[CHECKPOINT]: %s is not a version %u checkpoint with %d cameras\n" RESET, path.c_str(), checkpoint_version,
+                state->_options.num_cameras);
+    return false;
+  }
+
+  // Read everything
+  // NOTE: the feature databases are only appended to once they have been fully read
+  // NOTE: but the state and propagator will be partially set if they fail, thus the manager should not be used
+  bool initialized;
+  double startup_time_new, timelastupdate_new, distance_new;
+  bool did_zupt_update_new, has_moved_since_zupt_new, has_zupt, has_aruco;
+  if (!binary_io::read(in, initialized) || !binary_io::read(in, startup_time_new) || !binary_io::read(in, timelastupdate_new) ||
+      !binary_io::read(in, distance_new) || !binary_io::read(in, did_zupt_update_new) || !binary_io::read(in, has_moved_since_zupt_new) ||
+      !StateHelper::load_checkpoint(state, in) || !propagator->load_checkpoint(in) || !binary_io::read(in, has_zupt) ||
+      has_zupt != (updaterZUPT != nullptr) || (has_zupt && !updaterZUPT->load_checkpoint(in)) ||
+      !trackFEATS->get_feature_database()->load_checkpoint(in) || !binary_io::read(in, has_aruco) ||
+      has_aruco != (trackARUCO != nullptr) || (has_aruco && !trackARUCO->get_feature_database()->load_checkpoint(in))) {
+    PRINT_ERROR(RED "[CHECKPOINT]: failed to read %s, was it saved with a different config?\n" RESET, path.c_str());
+    return false;
+  }
+  startup_time = startup_time_new;
+  timelastupdate = timelastupdate_new;
+  distance = distance_new;
+  did_zupt_update = did_zupt_update_new;
+  has_moved_since_zupt = has_moved_since_zupt_new;
+
+  // New features should not re-use the ids of the ones we have restored
+  // Also increase the number of features to the desired amount during estimation (as we do after initializing)
+  size_t max_id = 0;
+  for (const auto &feat : trackFEATS->get_feature_database()->get_internal_data()) {
+    max_id = std::max(max_id, feat.first);
+  }
+  for (const auto &feat : state->_features_SLAM) {
+    max_id = std::max(max_id, feat.first);
+  }
+  trackFEATS->reserve_feature_ids(max_id);
+  if (initialized) {
+    trackFEATS->set_num_features(std::floor((double)params.num_pts / (double)params.state_options.num_cameras));
+    is_initialized_vio = true;
+  }
+  PRINT_INFO(GREEN "[CHECKPOINT]: restored state at %.4f with %zu clones and %zu SLAM features\n" RESET, state->_timestamp,
+             state->_clones_IMU.size(), state->_features_SLAM.size());
+  return true;
+}
+
+struct VioManager::RetriFrame {
+
+  /// Timestamp of the frame (and clone) we re-triangulate the tracks in
+  double timestamp;
+
+  /// Active tracks drawn by the tracker at this frame (cropped to cam0)
+  cv::Mat image;
+
+  /// Pose, calibration and active tracks of each camera at this frame
+  struct Camera {
+    size_t cam_id;
+    Eigen::Matrix3d R_GtoC;
+    Eigen::Vector3d p_CinG;
+    Eigen::MatrixXd intrinsics;
+    bool fisheye;
+    int width, height;
+    std::vector<size_t> ids;
+    std::vector<cv::Point2f> uvs;
+  };
+  std::vector<Camera> cameras;
+
+  /// SLAM features in the global frame (the state estimate takes priority, so these are not triangulated)
+  std::unordered_map<size_t, Eigen::Vector3d> slam_posinG;
+};
+
 void VioManager::retriangulate_active_tracks(const ov_core::CameraData &message) {
 
   // Start timing
-  boost::posix_time::ptime retri_rT1, retri_rT2, retri_rT3;
-  retri_rT1 = boost::posix_time::microsec_clock::local_time();
+  TraceScope trace_snapshot("re-tri snapshot");
 
-  // Clear old active track data
+  // Image of the active tracks
   assert(state->_clones_IMU.find(message.timestamp) != state->_clones_IMU.end());
-  active_tracks_time = message.timestamp;
-  active_image = cv::Mat();
-  trackFEATS->display_active(active_image, 255, 255, 255, 255, 255, 255, " ");
-  if (!active_image.empty()) {
-    active_image = active_image(cv::Rect(0, 0, message.images.at(0).cols, message.images.at(0).rows));
+  auto frame = std::make_shared<RetriFrame>();
+  frame->timestamp = message.timestamp;
+  trackFEATS->display_active(frame->image, 255, 255, 255, 255, 255, 255, " ");
+  if (!frame->image.empty()) {
+    frame->image = frame->image(cv::Rect(0, 0, message.images.at(0).cols, message.images.at(0).rows));
   }
-  active_tracks_posinG.clear();
-  active_tracks_uvd.clear();
 
   // Current active tracks in our frontend
+  // If pipelined the tracker could already be on a newer frame, so use the ones handed-off with this message
   // TODO: should probably assert here that these are at the message time...
-  auto last_obs = trackFEATS->get_last_obs();
-  auto last_ids = trackFEATS->get_last_ids();
+  auto last_obs = (pipeline_started) ? pipeline_last_obs : trackFEATS->get_last_obs();
+  auto last_ids = (pipeline_started) ? pipeline_last_ids : trackFEATS->get_last_ids();
 
-  // New set of linear systems that only contain the latest track info
-  std::map<size_t, Eigen::Matrix3d> active_feat_linsys_A_new;
-  std::map<size_t, Eigen::Vector3d> active_feat_linsys_b_new;
-  std::map<size_t, int> active_feat_linsys_count_new;
-  std::unordered_map<size_t, Eigen::Vector3d> active_tracks_posinG_new;
+  // IMU historical clone
+  Eigen::Matrix3d R_GtoI = state->_clones_IMU.at(message.timestamp)->Rot();
+  Eigen::Vector3d p_IinG = state->_clones_IMU.at(message.timestamp)->pos();
 
-  // Append our new observations for each camera
-  std::map<size_t, cv::Point2f> feat_uvs_in_cam0;
+  // Record the pose, calibration and tracks of each camera
   for (auto const &cam_id : message.sensor_ids) {
+    assert(last_obs.find(cam_id) != last_obs.end());
+    assert(last_ids.find(cam_id) != last_ids.end());
+    RetriFrame::Camera camera;
+    camera.cam_id = (size_t)cam_id;
 
-    // IMU historical clone
-    Eigen::Matrix3d R_GtoI = state->_clones_IMU.at(active_tracks_time)->Rot();
-    Eigen::Vector3d p_IinG = state->_clones_IMU.at(active_tracks_time)->pos();
-
-    // Calibration for this cam_id
+    // Convert current CAMERA position relative to global
     Eigen::Matrix3d R_ItoC = state->_calib_IMUtoCAM.at(cam_id)->Rot();
     Eigen::Vector3d p_IinC = state->_calib_IMUtoCAM.at(cam_id)->pos();
+    camera.R_GtoC = R_ItoC * R_GtoI;
+    camera.p_CinG = p_IinG - camera.R_GtoC.transpose() * p_IinC;
+
+    // Intrinsics (these could be calibrated while we triangulate, thus copy them)
+    std::shared_ptr<CamBase> model = state->_cam_intrinsics_cameras.at(cam_id);
+    camera.intrinsics = model->get_value();
+    camera.fisheye = (std::dynamic_pointer_cast<CamEqui>(model) != nullptr);
+    camera.width = model->w();
+    camera.height = model->h();
+
+    // Active tracks
+    camera.ids = last_ids.at(cam_id);
+    camera.uvs.reserve(last_obs.at(cam_id).size());
+    for (const auto &kpt : last_obs.at(cam_id)) {
+      camera.uvs.push_back(kpt.pt);
+    }
+    frame->cameras.push_back(camera);
+  }
 
-    // Convert current CAMERA position relative to global
-    Eigen::Matrix3d R_GtoCi = R_ItoC * R_GtoI;
-    Eigen::Vector3d p_CiinG = p_IinG - R_GtoCi.transpose() * p_IinC;
+  // Append our SLAM features we have
+  for (const auto &feat : state->_features_SLAM) {
+    Eigen::Vector3d p_FinG = feat.second->get_xyz(false);
+    if (LandmarkRepresentation::is_relative_representation(feat.second->_feat_representation)) {
+      // Assert that we have an anchor pose for this feature
+      assert(feat.second->_anchor_cam_id != -1);
+      // Get calibration for our anchor camera
+      Eigen::Matrix3d R_ItoC = state->_calib_IMUtoCAM.at(feat.second->_anchor_cam_id)->Rot();
+      Eigen::Vector3d p_IinC = state->_calib_IMUtoCAM.at(feat.second->_anchor_cam_id)->pos();
+      // Anchor pose orientation and position
+      Eigen::Matrix3d R_GtoIa = state->_clones_IMU.at(feat.second->_anchor_clone_timestamp)->Rot();
+      Eigen::Vector3d p_IainG = state->_clones_IMU.at(feat.second->_anchor_clone_timestamp)->pos();
+      // Feature in the global frame
+      p_FinG = R_GtoIa.transpose() * R_ItoC.transpose() * (feat.second->get_xyz(false) - p_IinC) + p_IainG;
+    }
+    frame->slam_posinG[feat.second->_featid] = p_FinG;
+  }
+  trace_snapshot.stop();
+
+  // Triangulate now if we are not threading our publishing (e.g. for repeatability)
+  if (!params.use_multi_threading_pubs) {
+    retriangulate_frame(frame);
+    return;
+  }
+
+  // Otherwise hand it off to our thread, if it has not started on the last snapshot yet, then that one is dropped
+  {
+    std::lock_guard<std::mutex> lck(retri_mtx);
+    retri_pending = frame;
+    if (!retri_thread.joinable()) {
+      retri_thread = std::thread(&VioManager::retriangulate_loop, this);
+    }
+  }
+  retri_cv.notify_one();
+}
+
+void VioManager::retriangulate_loop() {
+  Printer::setThreadContext(print_context);
+  Trace::setThreadContext(trace_context);
+  while (true) {
+    std::shared_ptr<RetriFrame> frame;
+    {
+      std::unique_lock<std::mutex> lck(retri_mtx);
+      retri_cv.wait(lck, [&] { return retri_pending != nullptr || retri_stop; });
+      if (retri_stop)
+        return;
+      frame = retri_pending;
+      retri_pending = nullptr;
+    }
+    retriangulate_frame(frame);
+  }
+}
+
+void VioManager::retriangulate_frame(const std::shared_ptr<RetriFrame> &frame) {
+
+  // Start timing
+  TraceScope trace_retri("re-triangulation");
+  TraceScope trace_tri("re-tri triangulation");
+
+  // We fill the back buffer, nobody reads it until we swap it to the front
+  // NOTE: we are the only ones which change the front, thus can read it without locking
+  ActiveTracks &tracks = active_tracks[1 - active_tracks_front];
+  tracks.time = frame->timestamp;
+  tracks.image = frame->image;
+  tracks.posinG.clear();
+  tracks.uvd.clear();
+
+  // New set of linear systems that only contain the latest track info
+  std::unordered_map<size_t, ActiveFeatLinsys> active_feat_linsys_new;
+  active_feat_linsys_new.reserve(active_feat_linsys.size());
+
+  // Append our new observations for each camera
+  std::unordered_map<size_t, cv::Point2f> feat_uvs_in_cam0;
+  const RetriFrame::Camera *cam0 = nullptr;
+  for (const auto &camera : frame->cameras) {
+
+    // Camera model with the calibration at this frame
+    std::shared_ptr<CamBase> &model = retri_cameras[camera.cam_id];
+    if (model == nullptr) {
+      if (camera.fisheye) {
+        model = std::make_shared<CamEqui>(camera.width, camera.height);
+      } else {
+        model = std::make_shared<CamRadtan>(camera.width, camera.height);
+      }
+    }
+    model->set_value(camera.intrinsics);
+    if (camera.cam_id == 0) {
+      cam0 = &camera;
+    }
 
     // Loop through each measurement
-    assert(last_obs.find(cam_id) != last_obs.end());
-    assert(last_ids.find(cam_id) != last_ids.end());
-    for (size_t i = 0; i < last_obs.at(cam_id).size(); i++) {
+    for (size_t i = 0; i < camera.ids.size(); i++) {
 
       // Record this feature uv if is seen from cam0
-      size_t featid = last_ids.at(cam_id).at(i);
-      cv::Point2f pt_d = last_obs.at(cam_id).at(i).pt;
-      if (cam_id == 0) {
+      size_t featid = camera.ids.at(i);
+      cv::Point2f pt_d = camera.uvs.at(i);
+      if (camera.cam_id == 0) {
         feat_uvs_in_cam0[featid] = pt_d;
       }
 
       // Skip this feature if it is a SLAM feature (the state estimate takes priority)
-      if (state->_features_SLAM.find(featid) != state->_features_SLAM.end()) {
+      if (frame->slam_posinG.find(featid) != frame->slam_posinG.end()) {
         continue;
       }
 
       // Get the UV coordinate normal
-      cv::Point2f pt_n = state->_cam_intrinsics_cameras.at(cam_id)->undistort_cv(pt_d);
+      cv::Point2f pt_n = model->undistort_cv(pt_d);
       Eigen::Matrix<double, 3, 1> b_i;
       b_i << pt_n.x, pt_n.y, 1;
-      b_i = R_GtoCi.transpose() * b_i;
+      b_i = camera.R_GtoC.transpose() * b_i;
       b_i = b_i / b_i.norm();
       Eigen::Matrix3d Bperp = skew_x(b_i);
 
       // Append to our linear system
       Eigen::Matrix3d Ai = Bperp.transpose() * Bperp;
-      Eigen::Vector3d bi = Ai * p_CiinG;
-      if (active_feat_linsys_A.find(featid) == active_feat_linsys_A.end()) {
-        active_feat_linsys_A_new.insert({featid, Ai});
-        active_feat_linsys_b_new.insert({featid, bi});
-        active_feat_linsys_count_new.insert({featid, 1});
+      Eigen::Vector3d bi = Ai * camera.p_CinG;
+      auto it_old = active_feat_linsys.find(featid);
+      if (it_old == active_feat_linsys.end()) {
+        active_feat_linsys_new.insert({featid, ActiveFeatLinsys{Ai, bi, 1}});
       } else {
-        active_feat_linsys_A_new[featid] = Ai + active_feat_linsys_A[featid];
-        active_feat_linsys_b_new[featid] = bi + active_feat_linsys_b[featid];
-        active_feat_linsys_count_new[featid] = 1 + active_feat_linsys_count[featid];
+        active_feat_linsys_new[featid] = ActiveFeatLinsys{Ai + it_old->second.A, bi + it_old->second.b, 1 + it_old->second.count};
       }
 
       // For this feature, recover its 3d position if we have enough observations!
-      if (active_feat_linsys_count_new.at(featid) > 3) {
+      const ActiveFeatLinsys &linsys = active_feat_linsys_new.at(featid);
+      if (linsys.count > 3) {
 
         // Recover feature estimate
-        Eigen::Matrix3d A = active_feat_linsys_A_new[featid];
-        Eigen::Vector3d b = active_feat_linsys_b_new[featid];
-        Eigen::MatrixXd p_FinG = A.colPivHouseholderQr().solve(b);
-        Eigen::MatrixXd p_FinCi = R_GtoCi * (p_FinG - p_CiinG);
+        Eigen::Vector3d p_FinG = linsys.A.colPivHouseholderQr().solve(linsys.b);
+        Eigen::Vector3d p_FinCi = camera.R_GtoC * (p_FinG - camera.p_CinG);
 
         // Check A and p_FinCi
-        Eigen::JacobiSVD<Eigen::Matrix3d> svd(A);
-        Eigen::MatrixXd singularValues;
-        singularValues.resize(svd.singularValues().rows(), 1);
-        singularValues = svd.singularValues();
-        double condA = singularValues(0, 0) / singularValues(singularValues.rows() - 1, 0);
+        Eigen::JacobiSVD<Eigen::Matrix3d> svd(linsys.A);
+        Eigen::Vector3d singularValues = svd.singularValues();
+        double condA = singularValues(0) / singularValues(2);
 
         // If we have a bad condition number, or it is too close
         // Then set the flag for bad (i.e. set z-axis to nan)
-        if (std::abs(condA) <= params.featinit_options.max_cond_number && p_FinCi(2, 0) >= params.featinit_options.min_dist &&
-            p_FinCi(2, 0) <= params.featinit_options.max_dist && !std::isnan(p_FinCi.norm())) {
-          active_tracks_posinG_new[featid] = p_FinG;
+        if (std::abs(condA) <= params.featinit_options.max_cond_number && p_FinCi(2) >= params.featinit_options.min_dist &&
+            p_FinCi(2) <= params.featinit_options.max_dist && !std::isnan(p_FinCi.norm())) {
+          tracks.posinG[featid] = p_FinG;
         }
       }
     }
   }
-  size_t total_triangulated = active_tracks_posinG.size();
+  size_t total_triangulated = tracks.posinG.size();
 
   // Update active set of linear systems
-  active_feat_linsys_A = active_feat_linsys_A_new;
-  active_feat_linsys_b = active_feat_linsys_b_new;
-  active_feat_linsys_count = active_feat_linsys_count_new;
-  active_tracks_posinG = active_tracks_posinG_new;
-  retri_rT2 = boost::posix_time::microsec_clock::local_time();
-
-  // Return if no features
-  if (active_tracks_posinG.empty() && state->_features_SLAM.empty())
-    return;
+  active_feat_linsys = std::move(active_feat_linsys_new);
+  double time_tri = trace_tri.stop();
+  TraceScope trace_reproj("re-tri re-projection");
 
   // Append our SLAM features we have
-  for (const auto &feat : state->_features_SLAM) {
-    Eigen::Vector3d p_FinG = feat.second->get_xyz(false);
-    if (LandmarkRepresentation::is_relative_representation(feat.second->_feat_representation)) {
-      // Assert that we have an anchor pose for this feature
-      assert(feat.second->_anchor_cam_id != -1);
-      // Get calibration for our anchor camera
-      Eigen::Matrix3d R_ItoC = state->_calib_IMUtoCAM.at(feat.second->_anchor_cam_id)->Rot();
-      Eigen::Vector3d p_IinC = state->_calib_IMUtoCAM.at(feat.second->_anchor_cam_id)->pos();
-      // Anchor pose orientation and position
-      Eigen::Matrix3d R_GtoI = state->_clones_IMU.at(feat.second->_anchor_clone_timestamp)->Rot();
-      Eigen::Vector3d p_IinG = state->_clones_IMU.at(feat.second->_anchor_clone_timestamp)->pos();
-      // Feature in the global frame
-      p_FinG = R_GtoI.transpose() * R_ItoC.transpose() * (feat.second->get_xyz(false) - p_IinC) + p_IinG;
-    }
-    active_tracks_posinG[feat.second->_featid] = p_FinG;
+  for (const auto &feat : frame->slam_posinG) {
+    tracks.posinG[feat.first] = feat.second;
   }
 
-  // Calibration of the first camera (cam0)
-  std::shared_ptr<Vec> distortion = state->_cam_intrinsics.at(0);
-  std::shared_ptr<PoseJPL> calibration = state->_calib_IMUtoCAM.at(0);
-  Eigen::Matrix<double, 3, 3> R_ItoC = calibration->Rot();
-  Eigen::Matrix<double, 3, 1> p_IinC = calibration->pos();
-
-  // Get current IMU clone state
-  std::shared_ptr<PoseJPL> clone_Ii = state->_clones_IMU.at(active_tracks_time);
-  Eigen::Matrix3d R_GtoIi = clone_Ii->Rot();
-  Eigen::Vector3d p_IiinG = clone_Ii->pos();
-
-  // 4. Next we can update our variable with the global position
-  //    We also will project the features into the current frame
-  for (const auto &feat : active_tracks_posinG) {
+  // Next we project the features into the current frame
+  for (const auto &feat : tracks.posinG) {
 
     // For now skip features not seen from current frame
     // TODO: should we publish other features not tracked in cam0??
-    if (feat_uvs_in_cam0.find(feat.first) == feat_uvs_in_cam0.end())
+    auto it_uv = feat_uvs_in_cam0.find(feat.first);
+    if (cam0 == nullptr || it_uv == feat_uvs_in_cam0.end())
       continue;
 
     // Calculate the depth of the feature in the current frame
-    // Project SLAM feature and non-cam0 features into the current frame of reference
-    Eigen::Vector3d p_FinIi = R_GtoIi * (feat.second - p_IiinG);
-    Eigen::Vector3d p_FinCi = R_ItoC * p_FinIi + p_IinC;
+    Eigen::Vector3d p_FinCi = cam0->R_GtoC * (feat.second - cam0->p_CinG);
     double depth = p_FinCi(2);
     Eigen::Vector2d uv_dist;
-    if (feat_uvs_in_cam0.find(feat.first) != feat_uvs_in_cam0.end()) {
-      uv_dist << (double)feat_uvs_in_cam0.at(feat.first).x, (double)feat_uvs_in_cam0.at(feat.first).y;
-    } else {
-      Eigen::Vector2d uv_norm;
-      uv_norm << p_FinCi(0) / depth, p_FinCi(1) / depth;
-      uv_dist = state->_cam_intrinsics_cameras.at(0)->distort_d(uv_norm);
-    }
+    uv_dist << (double)it_uv->second.x, (double)it_uv->second.y;
 
     // Skip if not valid (i.e. negative depth, or outside of image)
     if (depth < 0.1) {
@@ -365,25 +651,29 @@ void VioManager::retriangulate_active_tracks(const ov_core::CameraData &message)
     }
 
     // Skip if not valid (i.e. negative depth, or outside of image)
-    int width = state->_cam_intrinsics_cameras.at(0)->w();
-    int height = state->_cam_intrinsics_cameras.at(0)->h();
-    if (uv_dist(0) < 0 || (int)uv_dist(0) >= width || uv_dist(1) < 0 || (int)uv_dist(1) >= height) {
-      // PRINT_DEBUG("feat %zu -> depth = %.2f | u_d = %.2f | v_d = %.2f\n",(*it2)->featid,depth,uv_dist(0),uv_dist(1));
+    if (uv_dist(0) < 0 || (int)uv_dist(0) >= cam0->width || uv_dist(1) < 0 || (int)uv_dist(1) >= cam0->height) {
       continue;
     }
 
     // Finally construct the uv and depth
     Eigen::Vector3d uvd;
     uvd << uv_dist, depth;
-    active_tracks_uvd.insert({feat.first, uvd});
+    tracks.uvd.insert({feat.first, uvd});
+  }
+
+  // Now the getters can use these
+  {
+    std::lock_guard<std::mutex> lck(active_tracks_mtx);
+    active_tracks_front = 1 - active_tracks_front;
   }
-  retri_rT3 = boost::posix_time::microsec_clock::local_time();
+  double time_reproj = trace_reproj.stop();
+  double time_retri = trace_retri.stop();
 
   // Timing information
-  PRINT_ALL(CYAN "[RETRI-TIME]: %.4f seconds for triangulation (%zu tri of %zu active)\n" RESET,
-            (retri_rT2 - retri_rT1).total_microseconds() * 1e-6, total_triangulated, active_feat_linsys_A.size());
-  PRINT_ALL(CYAN "[RETRI-TIME]: %.4f seconds for re-projection into current\n" RESET, (retri_rT3 - retri_rT2).total_microseconds() * 1e-6);
-  PRINT_ALL(CYAN "[RETRI-TIME]: %.4f seconds total\n" RESET, (retri_rT3 - retri_rT1).total_microseconds() * 1e-6);
+  PRINT_ALL(CYAN "[RETRI-TIME]: %.4f seconds for triangulation (%zu tri of %zu active)\n" RESET, time_tri, total_triangulated,
+            active_feat_linsys.size());
+  PRINT_ALL(CYAN "[RETRI-TIME]: %.4f seconds for re-projection into current\n" RESET, time_reproj);
+  PRINT_ALL(CYAN "[RETRI-TIME]: %.4f seconds total\n" RESET, time_retri);
 }
 
 cv::Mat VioManager::get_historical_viz_image() {
@@ -392,6 +682,10 @@ cv::Mat VioManager::get_historical_viz_image() {
   if (state == nullptr || trackFEATS == nullptr)
     return cv::Mat();
 
+  // Skip drawing if we are overloaded
+  if (overload != nullptr && overload->skip_visualization())
+    return cv::Mat();
+
   // Build an id-list of what features we should highlight (i.e. SLAM)
   std::vector<size_t> highlighted_ids;
   for (const auto &feat : state->_features_SLAM) {
@@ -415,47 +709,363 @@ cv::Mat VioManager::get_historical_viz_image() {
 }
 
 std::vector<Eigen::Vector3d> VioManager::get_features_SLAM() {
+  std::lock_guard<std::recursive_mutex> lck(state_mtx);
   std::vector<Eigen::Vector3d> slam_feats;
   for (auto &f : state->_features_SLAM) {
     if ((int)f.first <= 4 * state->_options.max_aruco_features)
       continue;
-    if (ov_type::LandmarkRepresentation::is_relative_representation(f.second->_feat_representation)) {
-      // Assert that we have an anchor pose for this feature
-      assert(f.second->_anchor_cam_id != -1);
-      // Get calibration for our anchor camera
-      Eigen::Matrix<double, 3, 3> R_ItoC = state->_calib_IMUtoCAM.at(f.second->_anchor_cam_id)->Rot();
-      Eigen::Matrix<double, 3, 1> p_IinC = state->_calib_IMUtoCAM.at(f.second->_anchor_cam_id)->pos();
-      // Anchor pose orientation and position
-      Eigen::Matrix<double, 3, 3> R_GtoI = state->_clones_IMU.at(f.second->_anchor_clone_timestamp)->Rot();
-      Eigen::Matrix<double, 3, 1> p_IinG = state->_clones_IMU.at(f.second->_anchor_clone_timestamp)->pos();
-      // Feature in the global frame
-      slam_feats.push_back(R_GtoI.transpose() * R_ItoC.transpose() * (f.second->get_xyz(false) - p_IinC) + p_IinG);
-    } else {
-      slam_feats.push_back(f.second->get_xyz(false));
-    }
+    slam_feats.push_back(get_feature_in_global(f.second));
   }
   return slam_feats;
 }
 
 std::vector<Eigen::Vector3d> VioManager::get_features_ARUCO() {
+  std::lock_guard<std::recursive_mutex> lck(state_mtx);
   std::vector<Eigen::Vector3d> aruco_feats;
   for (auto &f : state->_features_SLAM) {
     if ((int)f.first > 4 * state->_options.max_aruco_features)
       continue;
-    if (ov_type::LandmarkRepresentation::is_relative_representation(f.second->_feat_representation)) {
-      // Assert that we have an anchor pose for this feature
-      assert(f.second->_anchor_cam_id != -1);
-      // Get calibration for our anchor camera
-      Eigen::Matrix<double, 3, 3> R_ItoC = state->_calib_IMUtoCAM.at(f.second->_anchor_cam_id)->Rot();
-      Eigen::Matrix<double, 3, 1> p_IinC = state->_calib_IMUtoCAM.at(f.second->_anchor_cam_id)->pos();
-      // Anchor pose orientation and position
-      Eigen::Matrix<double, 3, 3> R_GtoI = state->_clones_IMU.at(f.second->_anchor_clone_timestamp)->Rot();
-      Eigen::Matrix<double, 3, 1> p_IinG = state->_clones_IMU.at(f.second->_anchor_clone_timestamp)->pos();
-      // Feature in the global frame
-      aruco_feats.push_back(R_GtoI.transpose() * R_ItoC.transpose() * (f.second->get_xyz(false) - p_IinC) + p_IinG);
-    } else {
-      aruco_feats.push_back(f.second->get_xyz(false));
-    }
+    aruco_feats.push_back(get_feature_in_global(f.second));
   }
   return aruco_feats;
 }
+
+Eigen::Vector3d VioManager::get_feature_in_global(const std::shared_ptr<Landmark> &landmark) {
+  if (!ov_type::LandmarkRepresentation::is_relative_representation(landmark->_feat_representation))
+    return landmark->get_xyz(false);
+  // Assert that we have an anchor pose for this feature
+  assert(landmark->_anchor_cam_id != -1);
+  // Get calibration for our anchor camera
+  Eigen::Matrix<double, 3, 3> R_ItoC = state->_calib_IMUtoCAM.at(landmark->_anchor_cam_id)->Rot();
+  Eigen::Matrix<double, 3, 1> p_IinC = state->_calib_IMUtoCAM.at(landmark->_anchor_cam_id)->pos();
+  // Anchor pose orientation and position
+  Eigen::Matrix<double, 3, 3> R_GtoI = state->_clones_IMU.at(landmark->_anchor_clone_timestamp)->Rot();
+  Eigen::Matrix<double, 3, 1> p_IinG = state->_clones_IMU.at(landmark->_anchor_clone_timestamp)->pos();
+  // Feature in the global frame
+  return R_GtoI.transpose() * R_ItoC.transpose() * (landmark->get_xyz(false) - p_IinC) + p_IinG;
+}
+
+void VioManager::update_landmark_map(const ov_core::CameraData &message) {
+
+  // Record the estimate of all our SLAM landmarks (aruco tags are not tracked by descriptors, so we skip them)
+  for (const auto &f : state->_features_SLAM) {
+    if ((int)f.first <= 4 * state->_options.max_aruco_features)
+      continue;
+    Eigen::MatrixXd cov = StateHelper::get_marginal_covariance(state, {f.second});
+    double sigma = std::sqrt(std::max(cov.trace() / (double)cov.rows(), 0.0));
+    landmark_map->update_landmark(f.first, get_feature_in_global(f.second), sigma, message.timestamp);
+  }
+
+  // Predict the landmarks the next image of each camera will see
+  // Landmarks in our state are still being tracked, so they do not need to be re-identified
+  Eigen::Matrix3d R_GtoI = state->_imu->Rot();
+  Eigen::Vector3d p_IinG = state->_imu->pos();
+  for (const auto &cam_id : message.sensor_ids) {
+    Eigen::Matrix3d R_GtoC = state->_calib_IMUtoCAM.at(cam_id)->Rot() * R_GtoI;
+    Eigen::Vector3d p_CinG = p_IinG - R_GtoC.transpose() * state->_calib_IMUtoCAM.at(cam_id)->pos();
+    std::vector<LandmarkMap::Visible> visible, visible_new;
+    landmark_map->get_in_frustum(R_GtoC, p_CinG, state->_cam_intrinsics_cameras.at(cam_id), params.featinit_options.max_dist, visible);
+    for (const auto &vis : visible) {
+      if (state->_features_SLAM.find(vis.id) == state->_features_SLAM.end())
+        visible_new.push_back(vis);
+    }
+    landmark_map->set_visible(cam_id, visible_new);
+  }
+}
+
+struct VioManager::PipelineFrame {
+
+  /// Camera message that was tracked
+  ov_core::CameraData message;
+
+  /// Feature measurements at this message time (the aruco ones are only set if we have an aruco tracker)
+  std::shared_ptr<FeatureDatabase> feats, feats_aruco;
+
+  /// Active tracks in this frame
+  std::unordered_map<size_t, std::vector<cv::KeyPoint>> last_obs;
+  std::unordered_map<size_t, std::vector<size_t>> last_ids;
+
+  /// How long tracking this message took (seconds) and when it finished (ns)
+  double time_track;
+  int64_t track_end_ns;
+};
+
+void VioManager::get_pipeline_stats(int &queue_depth, int &queue_depth_max, double &track_ms, double &wait_ms, double &update_ms) {
+  std::lock_guard<std::mutex> lck(pipeline_mtx);
+  queue_depth = (int)pipeline_queue.size();
+  queue_depth_max = pipeline_depth_max;
+  track_ms = pipeline_track_ms;
+  wait_ms = pipeline_wait_ms;
+  update_ms = pipeline_update_ms;
+}
+
+std::shared_ptr<FeatureDatabase> VioManager::feats_database() {
+  return (pipeline_db_feats != nullptr) ? pipeline_db_feats : trackFEATS->get_feature_database();
+}
+
+std::shared_ptr<FeatureDatabase> VioManager::aruco_database() {
+  return (pipeline_db_aruco != nullptr) ? pipeline_db_aruco : trackARUCO->get_feature_database();
+}
+
+void VioManager::pipeline_push(const ov_core::CameraData &message, double time_track_frame) {
+
+  // Copy the measurements at this time out of the tracker databases
+  // We only ever append to these on this thread, so it is safe to read the features directly
+  auto extract_measurements = [](const std::shared_ptr<FeatureDatabase> &db, double timestamp) {
+    std::shared_ptr<FeatureDatabase> db_new = std::make_shared<FeatureDatabase>();
+    for (const auto &feat : db->features_containing(timestamp, false, false)) {
+      for (const auto &pair : feat->timestamps) {
+        auto it = std::find(pair.second.begin(), pair.second.end(), timestamp);
+        if (it == pair.second.end())
+          continue;
+        size_t idx = (size_t)std::distance(pair.second.begin(), it);
+        const Eigen::Vector2f &uv = feat->uvs.at(pair.first).at(idx);
+        const Eigen::Vector2f &uv_n = feat->uvs_norm.at(pair.first).at(idx);
+        db_new->update_feature(feat->featid, timestamp, pair.first, uv(0), uv(1), uv_n(0), uv_n(1));
+      }
+    }
+    return db_new;
+  };
+  std::shared_ptr<PipelineFrame> frame = std::make_shared<PipelineFrame>();
+  frame->message = message;
+  frame->feats = extract_measurements(trackFEATS->get_feature_database(), message.timestamp);
+  if (trackARUCO != nullptr) {
+    frame->feats_aruco = extract_measurements(trackARUCO->get_feature_database(), message.timestamp);
+  }
+  frame->last_obs = trackFEATS->get_last_obs();
+  frame->last_ids = trackFEATS->get_last_ids();
+  frame->time_track = time_track_frame;
+  frame->track_end_ns = Trace::now_ns();
+  pipeline_last_time = message.timestamp;
+
+  // The tracker databases are now only used for visualization, so only keep the history the estimator still has
+  // NOTE: the marginalization time will be infinite if the estimator does not have any clones yet
+  double marg_time = pipeline_marg_time;
+  if (marg_time > 0 && marg_time <= pipeline_state_time) {
+    trackFEATS->get_feature_database()->cleanup_measurements(marg_time);
+    if (trackARUCO != nullptr) {
+      trackARUCO->get_feature_database()->cleanup_measurements(marg_time);
+    }
+  }
+
+  // Append to our queue, if it is full we wait for the estimator to catch up
+  // This keeps the tracker from getting unboundedly ahead of the state
+  {
+    std::unique_lock<std::mutex> lck(pipeline_mtx);
+    pipeline_cv_push.wait(lck, [&] { return (int)pipeline_queue.size() < std::max(params.pipeline_queue_size, 1) || pipeline_stop; });
+    if (pipeline_stop)
+      return;
+    pipeline_queue.push_back(frame);
+    pipeline_depth_max = std::max(pipeline_depth_max, (int)pipeline_queue.size());
+    double time_track_ms = 1e3 * time_track_frame;
+    pipeline_track_ms = (pipeline_track_ms == 0.0) ? time_track_ms : 0.9 * pipeline_track_ms + 0.1 * time_track_ms;
+  }
+  pipeline_cv_pop.notify_one();
+}
+
+void VioManager::pipeline_loop() {
+  Printer::setThreadContext(print_context);
+  Trace::setThreadContext(trace_context);
+  while (true) {
+
+    // Get the oldest tracked frame, we finish all queued frames before stopping
+    std::shared_ptr<PipelineFrame> frame;
+    {
+      std::unique_lock<std::mutex> lck(pipeline_mtx);
+      pipeline_cv_pop.wait(lck, [&] { return !pipeline_queue.empty() || pipeline_stop; });
+      if (pipeline_queue.empty())
+        return;
+      frame = pipeline_queue.front();
+      pipeline_queue.pop_front();
+      pipeline_busy = true;
+    }
+    pipeline_cv_push.notify_one();
+
+    // Update with it, then publish the times the tracker and imu feed need
+    // Readers of the state on other threads wait until we are done (see get_state())
+    {
+      std::lock_guard<std::recursive_mutex> lck_state(state_mtx);
+      pipeline_update(frame);
+      pipeline_state_time = state->_timestamp;
+      pipeline_marg_time = state->margtimestep();
+    }
+    {
+      std::lock_guard<std::mutex> lck(pipeline_mtx);
+      pipeline_busy = false;
+    }
+    pipeline_cv_push.notify_all();
+  }
+}
+
+void VioManager::pipeline_update(const std::shared_ptr<PipelineFrame> &frame) {
+
+  // Start timing
+  // We use the tracking time of this frame so the total does not include the queue wait
+  int64_t start_ns = Trace::now_ns();
+  time_track = frame->time_track;
+  double time_wait = 1e-6 * (double)(start_ns - frame->track_end_ns);
+  const ov_core::CameraData &message = frame->message;
+
+  // Append the new measurements into the databases the estimator owns
+  pipeline_db_feats->append_new_measurements(frame->feats);
+  if (pipeline_db_aruco != nullptr && frame->feats_aruco != nullptr) {
+    pipeline_db_aruco->append_new_measurements(frame->feats_aruco);
+  }
+  pipeline_last_obs = frame->last_obs;
+  pipeline_last_ids = frame->last_ids;
+
+  // Check if we should do zero-velocity, if so update the state with it
+  // Note that in the case that we only use in the beginning initialization phase
+  // If we have since moved, then we should never try to do a zero velocity update!
+  bool did_update = false;
+  if (updaterZUPT != nullptr && (!params.zupt_only_at_beginning || !has_moved_since_zupt)) {
+    updaterZUPT->feed_tracks(message.timestamp, frame->last_obs, frame->last_ids);
+    // If the same state time, use the previous timestep decision
+    if (state->_timestamp != message.timestamp) {
+      did_zupt_update = updaterZUPT->try_update(state, message.timestamp);
+    }
+    if (did_zupt_update) {
+      assert(state->_timestamp == message.timestamp);
+      propagator->clean_old_imu_measurements(message.timestamp + state->_calib_dt_CAMtoIMU->value()(0) - 0.10);
+      updaterZUPT->clean_old_imu_measurements(message.timestamp + state->_calib_dt_CAMtoIMU->value()(0) - 0.10);
+      propagator->invalidate_cache();
+      did_update = true;
+    }
+  }
+
+  // Call on our propagate and update function
+  if (!did_update) {
+    do_feature_propagate_update(message);
+  }
+  double time_update = 1e-6 * (double)(Trace::now_ns() - start_ns);
+
+  // Record our pipeline statistics
+  int queue_depth;
+  {
+    std::lock_guard<std::mutex> lck(pipeline_mtx);
+    pipeline_wait_ms = (pipeline_wait_ms == 0.0) ? time_wait : 0.9 * pipeline_wait_ms + 0.1 * time_wait;
+    pipeline_update_ms = (pipeline_update_ms == 0.0) ? time_update : 0.9 * pipeline_update_ms + 0.1 * time_update;
+    queue_depth = (int)pipeline_queue.size();
+  }
+  PRINT_DEBUG(BLUE "[TIME]: %.4f seconds waiting in pipeline (%d of %d queued)\n" RESET, time_wait * 1e-3, queue_depth,
+              params.pipeline_queue_size);
+}
+
+void VioManager::trace_flush() {
+  // Leave the events for whoever else enabled our tracing (e.g. replay_msckf) if we are not writing them
+  if (trace_timing == nullptr && trace_chrome == nullptr)
+    return;
+  std::vector<TraceEvent> events;
+  trace_context->collect(events);
+  if (events.empty())
+    return;
+  if (trace_timing != nullptr)
+    trace_timing->append(events);
+  if (trace_chrome != nullptr)
+    trace_chrome->append(events);
+}
+
+struct VioManager::MetricsHandles {
+
+  /// Per camera, number of features tracked from the last frame, lost since the last frame, and newly extracted
+  std::map<size_t, std::shared_ptr<MetricCounter>> feats_tracked, feats_lost, feats_new;
+
+  /// Ids of the features in the last frame of each camera
+  std::map<size_t, std::unordered_set<size_t>> last_ids;
+
+  /// Number of frames we have updated with
+  std::shared_ptr<MetricCounter> frames;
+
+  /// Current size of our state
+  std::shared_ptr<MetricGauge> initialized, clones, slam_features, covariance_dim, imu_backlog;
+
+  /// Usage of the feature database the estimator uses, and the tracks it has evicted
+  std::shared_ptr<MetricGauge> feat_db_tracks, feat_db_measurements, feat_db_bytes;
+  std::shared_ptr<MetricCounter> feat_db_evicted;
+  size_t feat_db_evicted_last = 0;
+
+  /// Latency of each of our stages (same order as the timing file, then the total)
+  std::vector<std::shared_ptr<MetricHistogram>> stages;
+
+  /// Last time (ns, steady clock) we have written the metrics file
+  int64_t last_dump_ns = 0;
+};
+
+void VioManager::metrics_register() {
+  metrics_handles = std::make_shared<MetricsHandles>();
+  for (int i = 0; i < state->_options.num_cameras; i++) {
+    std::string labels = "cam=\"" + std::to_string(i) + "\"";
+    metrics_handles->feats_tracked[i] = metrics->counter("ov_msckf_features_tracked_total", "Features tracked from the previous frame", labels);
+    metrics_handles->feats_lost[i] = metrics->counter("ov_msckf_features_lost_total", "Features lost since the previous frame", labels);
+    metrics_handles->feats_new[i] = metrics->counter("ov_msckf_features_new_total", "Features newly extracted", labels);
+  }
+  metrics_handles->frames = metrics->counter("ov_msckf_frames_total", "Frames the state has been propagated and updated with");
+  metrics_handles->initialized = metrics->gauge("ov_msckf_initialized", "If the estimator is initialized");
+  metrics_handles->clones = metrics->gauge("ov_msckf_clones", "Number of clones in the state");
+  metrics_handles->slam_features = metrics->gauge("ov_msckf_slam_features", "Number of SLAM landmarks in the state");
+  metrics_handles->covariance_dim = metrics->gauge("ov_msckf_covariance_dim", "Dimension of the state covariance");
+  metrics_handles->imu_backlog = metrics->gauge("ov_msckf_imu_backlog", "Number of IMU measurements held by the propagator");
+  metrics_handles->feat_db_tracks = metrics->gauge("ov_msckf_feature_db_tracks", "Number of tracks in the feature database");
+  metrics_handles->feat_db_measurements = metrics->gauge("ov_msckf_feature_db_measurements", "Number of measurements in the feature database");
+  metrics_handles->feat_db_bytes = metrics->gauge("ov_msckf_feature_db_bytes", "Approximate bytes used by the feature database");
+  metrics_handles->feat_db_evicted = metrics->counter("ov_msckf_feature_db_evicted_total", "Tracks evicted to stay within the feature database limits");
+  std::vector<double> bounds = {0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1.0};
+  for (const std::string &stage : {"tracking", "propagation", "msckf update", "slam update", "slam delayed", "re-tri & marg", "total"}) {
+    metrics_handles->stages.push_back(
+        metrics->histogram("ov_msckf_stage_seconds", "Time spent in each stage of a frame", bounds, "stage=\"" + stage + "\""));
+  }
+}
+
+void VioManager::metrics_feed_tracks() {
+  for (const auto &cam : trackFEATS->get_last_ids()) {
+    if (metrics_handles->feats_tracked.find(cam.first) == metrics_handles->feats_tracked.end())
+      continue;
+    std::unordered_set<size_t> &ids_old = metrics_handles->last_ids[cam.first];
+    std::unordered_set<size_t> ids_new(cam.second.begin(), cam.second.end());
+    size_t num_tracked = 0;
+    for (const auto &id : ids_new) {
+      if (ids_old.find(id) != ids_old.end())
+        num_tracked++;
+    }
+    metrics_handles->feats_tracked.at(cam.first)->add(num_tracked);
+    metrics_handles->feats_lost.at(cam.first)->add(ids_old.size() - num_tracked);
+    metrics_handles->feats_new.at(cam.first)->add(ids_new.size() - num_tracked);
+    ids_old = std::move(ids_new);
+  }
+
+  // Usage of our feature database (the evicted count restarts if the pipeline hands the database to the estimator)
+  FeatureDatabase::Usage usage = feats_database()->get_usage();
+  metrics_handles->feat_db_tracks->set((double)usage.num_features);
+  metrics_handles->feat_db_measurements->set((double)usage.num_measurements);
+  metrics_handles->feat_db_bytes->set((double)usage.bytes);
+  if (usage.num_evicted_features >= metrics_handles->feat_db_evicted_last)
+    metrics_handles->feat_db_evicted->add(usage.num_evicted_features - metrics_handles->feat_db_evicted_last);
+  metrics_handles->feat_db_evicted_last = usage.num_evicted_features;
+}
+
+void VioManager::metrics_feed_update(const std::vector<double> &stage_times) {
+
+  // Update our state and stage metrics
+  metrics_handles->frames->add();
+  metrics_handles->initialized->set((double)is_initialized_vio);
+  metrics_handles->clones->set((double)state->_clones_IMU.size());
+  metrics_handles->slam_features->set((double)state->_features_SLAM.size());
+  metrics_handles->covariance_dim->set((double)state->max_covariance_size());
+  metrics_handles->imu_backlog->set((double)propagator->num_imu_measurements());
+  for (size_t i = 0; i < stage_times.size() && i < metrics_handles->stages.size(); i++) {
+    metrics_handles->stages.at(i)->observe(stage_times.at(i));
+  }
+
+  // Dump to file if enough (wall) time has passed
+  if (params.record_metrics_filepath.empty())
+    return;
+  int64_t now_ns = Trace::now_ns();
+  if (1e-9 * (double)(now_ns - metrics_handles->last_dump_ns) < params.record_metrics_period)
+    return;
+  metrics_handles->last_dump_ns = now_ns;
+  if (!metrics->write_prometheus(params.record_metrics_filepath)) {
+    PRINT_WARNING(YELLOW "[METRICS]: unable to write %s\n" RESET, params.record_metrics_filepath.c_str());
+  }
+}
+
+std::map<std::string, double> VioManager::get_metrics() { return metrics->snapshot(); }
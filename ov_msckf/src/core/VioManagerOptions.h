@@ -29,7 +29,10 @@
 #include <string>
 #include <vector>
 
+#include "OverloadControllerOptions.h"
+
 #include "state/StateOptions.h"
+#include "update/FeatureSelectorOptions.h"
 #include "update/UpdaterOptions.h"
 #include "utils/NoiseManager.h"
 
@@ -37,6 +40,7 @@
 
 #include "cam/CamEqui.h"
 #include "cam/CamRadtan.h"
+#include "feat/FeatureDatabase.h"
 #include "feat/FeatureInitializerOptions.h"
 #include "track/TrackBase.h"
 #include "utils/colors.h"
@@ -76,6 +80,12 @@ struct VioManagerOptions {
   /// Our state initialization options (e.g. window size, num features, if we should get the calibration)
   ov_init::InertialInitializerOptions init_options;
 
+  /// Options for selecting which MSCKF features to update with (coverage, parallax, time budget)
+  FeatureSelectorOptions msckf_select_options;
+
+  /// Options for degrading the estimator when frames are predicted to miss their deadline
+  OverloadControllerOptions overload_options;
+
   /// Delay, in seconds, that we should wait from init before we start estimating SLAM features
   double dt_slam_delay = 2.0;
 
@@ -91,6 +101,12 @@ struct VioManagerOptions {
   /// Max disparity we will consider to try to do a zupt (i.e. if above this, don't do zupt)
   double zupt_max_disparity = 1.0;
 
+  /// Multiplier of the IMU noise above which the zupt pre-filter says we are moving (non-positive to only check velocity)
+  double zupt_prefilter_multiplier = -1.0;
+
+  /// Duration (sec) of the IMU window used by the zupt pre-filter
+  double zupt_prefilter_window = 0.1;
+
   /// If we should only use the zupt at the very beginning static initialization phase
   bool zupt_only_at_beginning = false;
 
@@ -100,6 +116,18 @@ struct VioManagerOptions {
   /// The path to the file we will record the timing information into
   std::string record_timing_filepath = "ov_msckf_timing.txt";
 
+  /// The path to the chrome trace event json of all traced scopes (empty to not record)
+  std::string record_trace_filepath = "";
+
+  /// The path to the Prometheus text file we periodically dump our runtime metrics into (empty to not record)
+  std::string record_metrics_filepath = "";
+
+  /// Period (sec, wall time) between dumps of the metrics file
+  double record_metrics_period = 1.0;
+
+  /// The path to the binary log of every input we are fed, which can be replayed with replay_msckf (empty to not record)
+  std::string record_inputs_filepath = "";
+
   /**
    * @brief This function will load print out all estimator settings loaded.
    * This allows for visual checking that everything was loaded properly from ROS/CMD parsers.
@@ -110,24 +138,38 @@ struct VioManagerOptions {
     PRINT_DEBUG("ESTIMATOR PARAMETERS:\n");
     state_options.print(parser);
     init_options.print_and_load(parser);
+    msckf_select_options.print(parser);
+    overload_options.print(parser);
     if (parser != nullptr) {
       parser->parse_config("dt_slam_delay", dt_slam_delay);
       parser->parse_config("try_zupt", try_zupt);
       parser->parse_config("zupt_max_velocity", zupt_max_velocity);
       parser->parse_config("zupt_noise_multiplier", zupt_noise_multiplier);
       parser->parse_config("zupt_max_disparity", zupt_max_disparity);
+      parser->parse_config("zupt_prefilter_multiplier", zupt_prefilter_multiplier, false);
+      parser->parse_config("zupt_prefilter_window", zupt_prefilter_window, false);
       parser->parse_config("zupt_only_at_beginning", zupt_only_at_beginning);
       parser->parse_config("record_timing_information", record_timing_information);
       parser->parse_config("record_timing_filepath", record_timing_filepath);
+      parser->parse_config("record_trace_filepath", record_trace_filepath, false);
+      parser->parse_config("record_metrics_filepath", record_metrics_filepath, false);
+      parser->parse_config("record_metrics_period", record_metrics_period, false);
+      parser->parse_config("record_inputs_filepath", record_inputs_filepath, false);
     }
     PRINT_DEBUG("  - dt_slam_delay: %.1f\n", dt_slam_delay);
     PRINT_DEBUG("  - zero_velocity_update: %d\n", try_zupt);
     PRINT_DEBUG("  - zupt_max_velocity: %.2f\n", zupt_max_velocity);
     PRINT_DEBUG("  - zupt_noise_multiplier: %.2f\n", zupt_noise_multiplier);
     PRINT_DEBUG("  - zupt_max_disparity: %.4f\n", zupt_max_disparity);
+    PRINT_DEBUG("  - zupt_prefilter_multiplier: %.2f\n", zupt_prefilter_multiplier);
+    PRINT_DEBUG("  - zupt_prefilter_window: %.3f\n", zupt_prefilter_window);
     PRINT_DEBUG("  - zupt_only_at_beginning?: %d\n", zupt_only_at_beginning);
     PRINT_DEBUG("  - record timing?: %d\n", (int)record_timing_information);
     PRINT_DEBUG("  - record timing filepath: %s\n", record_timing_filepath.c_str());
+    PRINT_DEBUG("  - record trace filepath: %s\n", record_trace_filepath.c_str());
+    PRINT_DEBUG("  - record metrics filepath: %s\n", record_metrics_filepath.c_str());
+    PRINT_DEBUG("  - record metrics period: %.2f\n", record_metrics_period);
+    PRINT_DEBUG("  - record inputs filepath: %s\n", record_inputs_filepath.c_str());
   }
 
   // NOISE / CHI2 ============================
@@ -419,6 +461,13 @@ struct VioManagerOptions {
   /// If our ROS subscriber callbacks should be async (if sim and serial then this should be no!)
   bool use_multi_threading_subs = false;
 
+  /// If tracking and the estimator update should run on separate threads (frame k+1 is tracked while frame k is updated)
+  /// The state then changes after feeding a camera returned, thus readers of it have to hold VioManager::lock_state()
+  bool use_pipeline = false;
+
+  /// Max number of tracked frames waiting for the estimator before the tracker blocks
+  int pipeline_queue_size = 2;
+
   /// The number of points we should extract and track in *each* image frame. This highly effects the computation required for tracking.
   int num_pts = 150;
 
@@ -443,6 +492,27 @@ struct VioManagerOptions {
   /// Frequency we want to track images at (higher freq ones will be dropped)
   double track_frequency = 20.0;
 
+  /// If we should keep a long-term map of SLAM landmarks and re-identify them when seen again (needs descriptor tracking)
+  bool use_landmark_map = false;
+
+  /// Side length of the voxels of the landmark map (meters)
+  double landmark_map_voxel_size = 1.0;
+
+  /// Max number of landmarks in the map, the ones estimated the longest time ago are removed first
+  int landmark_map_max_landmarks = 10000;
+
+  /// Max pixel distance between the predicted location of a landmark and a new feature matched to it
+  double landmark_map_match_px = 20.0;
+
+  /// Max descriptor (hamming) distance between a landmark and a new feature matched to it
+  int landmark_map_max_hamming = 50;
+
+  /// Max standard deviation (meters) of a landmark for a re-identified feature to warm start its triangulation from it
+  double landmark_map_max_sigma = 0.10;
+
+  /// Limits on the number of tracks and measurements in our feature database (zero is unlimited)
+  ov_core::FeatureDatabase::Limits feat_db_limits;
+
   /// Parameters used by our feature initialize / triangulator
   ov_core::FeatureInitializerOptions featinit_options;
 
@@ -462,6 +532,8 @@ struct VioManagerOptions {
       parser->parse_config("num_opencv_threads", num_opencv_threads);
       parser->parse_config("multi_threading_pubs", use_multi_threading_pubs, false);
       parser->parse_config("multi_threading_subs", use_multi_threading_subs, false);
+      parser->parse_config("use_pipeline", use_pipeline, false);
+      parser->parse_config("pipeline_queue_size", pipeline_queue_size, false);
       parser->parse_config("num_pts", num_pts);
       parser->parse_config("fast_threshold", fast_threshold);
       parser->parse_config("grid_x", grid_x);
@@ -484,6 +556,31 @@ struct VioManagerOptions {
       }
       parser->parse_config("knn_ratio", knn_ratio);
       parser->parse_config("track_frequency", track_frequency);
+      parser->parse_config("use_landmark_map", use_landmark_map, false);
+      parser->parse_config("landmark_map_voxel_size", landmark_map_voxel_size, false);
+      parser->parse_config("landmark_map_max_landmarks", landmark_map_max_landmarks, false);
+      parser->parse_config("landmark_map_match_px", landmark_map_match_px, false);
+      parser->parse_config("landmark_map_max_hamming", landmark_map_max_hamming, false);
+      parser->parse_config("landmark_map_max_sigma", landmark_map_max_sigma, false);
+      int feat_db_max_features = (int)feat_db_limits.max_features;
+      int feat_db_max_measurements = (int)feat_db_limits.max_measurements;
+      parser->parse_config("feat_db_max_features", feat_db_max_features, false);
+      parser->parse_config("feat_db_max_measurements", feat_db_max_measurements, false);
+      feat_db_limits.max_features = (size_t)std::max(feat_db_max_features, 0);
+      feat_db_limits.max_measurements = (size_t)std::max(feat_db_max_measurements, 0);
+      std::string feat_db_eviction_str = "OLDEST";
+      parser->parse_config("feat_db_eviction", feat_db_eviction_str, false);
+      if (feat_db_eviction_str == "OLDEST") {
+        feat_db_limits.policy = ov_core::FeatureDatabase::EVICT_OLDEST;
+      } else if (feat_db_eviction_str == "SHORTEST") {
+        feat_db_limits.policy = ov_core::FeatureDatabase::EVICT_SHORTEST;
+      } else {
+        printf(RED "VioManager(): invalid feature database eviction policy specified:\n" RESET);
+        printf(RED "\t- OLDEST\n" RESET);
+        printf(RED "\t- SHORTEST\n" RESET);
+        std::exit(EXIT_FAILURE);
+      }
+      parser->parse_config("feat_db_watermark", feat_db_limits.watermark, false);
     }
     PRINT_DEBUG("FEATURE TRACKING PARAMETERS:\n");
     PRINT_DEBUG("  - use_stereo: %d\n", use_stereo);
@@ -494,6 +591,8 @@ struct VioManagerOptions {
     PRINT_DEBUG("  - num opencv threads: %d\n", num_opencv_threads);
     PRINT_DEBUG("  - use multi-threading pubs: %d\n", use_multi_threading_pubs);
     PRINT_DEBUG("  - use multi-threading subs: %d\n", use_multi_threading_subs);
+    PRINT_DEBUG("  - use pipeline: %d\n", use_pipeline);
+    PRINT_DEBUG("  - pipeline queue size: %d\n", pipeline_queue_size);
     PRINT_DEBUG("  - num_pts: %d\n", num_pts);
     PRINT_DEBUG("  - fast threshold: %d\n", fast_threshold);
     PRINT_DEBUG("  - grid X by Y: %d by %d\n", grid_x, grid_y);
@@ -501,6 +600,16 @@ struct VioManagerOptions {
     PRINT_DEBUG("  - hist method: %d\n", (int)histogram_method);
     PRINT_DEBUG("  - knn ratio: %.3f\n", knn_ratio);
     PRINT_DEBUG("  - track frequency: %.1f\n", track_frequency);
+    PRINT_DEBUG("  - use landmark map: %d\n", use_landmark_map);
+    PRINT_DEBUG("  - landmark map voxel size: %.2f\n", landmark_map_voxel_size);
+    PRINT_DEBUG("  - landmark map max landmarks: %d\n", landmark_map_max_landmarks);
+    PRINT_DEBUG("  - landmark map match px: %.1f\n", landmark_map_match_px);
+    PRINT_DEBUG("  - landmark map max hamming: %d\n", landmark_map_max_hamming);
+    PRINT_DEBUG("  - landmark map max sigma: %.3f\n", landmark_map_max_sigma);
+    PRINT_DEBUG("  - feature db max features: %zu\n", feat_db_limits.max_features);
+    PRINT_DEBUG("  - feature db max measurements: %zu\n", feat_db_limits.max_measurements);
+    PRINT_DEBUG("  - feature db eviction: %d\n", (int)feat_db_limits.policy);
+    PRINT_DEBUG("  - feature db watermark: %.2f\n", feat_db_limits.watermark);
     featinit_options.print(parser);
   }
 
@@ -538,6 +647,12 @@ struct VioManagerOptions {
   /// Feature distance we generate features from (maximum)
   double sim_max_feature_gen_distance = 10;
 
+  /// Time (sec) after the first image at which we save a checkpoint and compare against a system restored from it (non-positive to disable)
+  double sim_checkpoint_time = -1;
+
+  /// Max difference of the IMU state of the restored system to the original one, above which the checkpoint check fails
+  double sim_checkpoint_tolerance = 1e-4;
+
   /**
    * @brief This function will load print out all simulated parameters.
    * This allows for visual checking that everything was loaded properly from ROS/CMD parsers.
@@ -556,6 +671,8 @@ struct VioManagerOptions {
       parser->parse_config("sim_freq_imu", sim_freq_imu);
       parser->parse_config("sim_min_feature_gen_dist", sim_min_feature_gen_distance);
       parser->parse_config("sim_max_feature_gen_dist", sim_max_feature_gen_distance);
+      parser->parse_config("sim_checkpoint_time", sim_checkpoint_time, false);
+      parser->parse_config("sim_checkpoint_tolerance", sim_checkpoint_tolerance, false);
     }
     PRINT_DEBUG("SIMULATION PARAMETERS:\n");
     PRINT_WARNING(BOLDRED "  - state init seed: %d \n" RESET, sim_seed_state_init);
@@ -568,6 +685,8 @@ struct VioManagerOptions {
     PRINT_DEBUG("  - imu feq: %.2f\n", sim_freq_imu);
     PRINT_DEBUG("  - min feat dist: %.2f\n", sim_min_feature_gen_distance);
     PRINT_DEBUG("  - max feat dist: %.2f\n", sim_max_feature_gen_distance);
+    PRINT_DEBUG("  - checkpoint time: %.2f\n", sim_checkpoint_time);
+    PRINT_DEBUG("  - checkpoint tolerance: %.2e\n", sim_checkpoint_tolerance);
   }
 };
 
@@ -0,0 +1,219 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/InputLog.h"
+#include "core/VioManager.h"
+#include "state/State.h"
+#include "types/IMU.h"
+#include "types/Vec.h"
+#include "utils/colors.h"
+#include "utils/print.h"
+#include "utils/sensor_data.h"
+#include "utils/trace.h"
+
+using namespace ov_msckf;
+
+// Define the function to be called when ctrl-c (SIGINT) is sent to process
+void signal_callback_handler(int signum) { std::exit(signum); }
+
+// Moves all traced scopes of the system into our per stage durations (in ms)
+void collect_durations(const std::shared_ptr<ov_core::TraceContext> &trace, std::map<std::string, std::vector<double>> &durations) {
+  std::vector<ov_core::TraceEvent> events;
+  trace->collect(events);
+  for (const auto &event : events) {
+    durations[event.name].push_back(1e-6 * (double)event.duration_ns);
+  }
+}
+
+// Value at the given percentile (0 to 1) of sorted values
+double percentile(const std::vector<double> &sorted, double p) {
+  size_t idx = (size_t)std::round(p * (double)(sorted.size() - 1));
+  return sorted.at(std::min(idx, sorted.size() - 1));
+}
+
+// Main function
+int main(int argc, char **argv) {
+
+  // Ensure we have a config and log, the trajectory output and threading mode are optional
+  if (argc < 3) {
+    PRINT_ERROR(RED "usage: replay_msckf <config.yaml> <inputs.bin> [trajectory.txt] [single|multi]\n" RESET);
+    PRINT_ERROR(RED "  single (default) disables all threading and wall time adaptation, so replays give the same trajectory\n" RESET);
+    PRINT_ERROR(RED "  multi uses the threading of the config (e.g. use_pipeline) to profile the multi-threaded system\n" RESET);
+    return EXIT_FAILURE;
+  }
+  std::string config_path = argv[1];
+  std::string log_path = argv[2];
+  std::string traj_path = (argc > 3) ? argv[3] : "";
+  bool multi_threaded = (argc > 4 && std::string(argv[4]) == "multi");
+
+  // Load the config
+  auto parser = std::make_shared<ov_core::YamlParser>(config_path);
+
+  // Verbosity
+  std::string verbosity = "INFO";
+  parser->parse_config("verbosity", verbosity);
+  ov_core::Printer::setPrintLevel(verbosity);
+
+  // Create our VIO system
+  // We collect the traced scopes ourselves, thus disable any recording of the system itself
+  VioManagerOptions params;
+  params.print_and_load(parser);
+  params.record_timing_information = false;
+  params.record_trace_filepath = "";
+  params.record_inputs_filepath = "";
+  if (!multi_threaded) {
+    params.num_opencv_threads = 0;
+    params.use_multi_threading_pubs = false;
+    params.use_multi_threading_subs = false;
+    params.use_pipeline = false;
+    params.overload_options.enabled = false;
+    params.msckf_select_options.budget_ms = -1.0;
+  }
+  auto sys = std::make_shared<VioManager>(params);
+
+  // Ensure we read in all parameters required
+  if (!parser->successful()) {
+    PRINT_ERROR(RED "unable to parse all parameters, please fix\n" RESET);
+    std::exit(EXIT_FAILURE);
+  }
+
+  // Open our log and trajectory file
+  InputLogReader reader(log_path);
+  if (!reader.is_open()) {
+    PRINT_ERROR(RED "[REPLAY]: %s is not a valid input log\n" RESET, log_path.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+  std::ofstream of_traj;
+  if (!traj_path.empty()) {
+    if (params.use_pipeline) {
+      PRINT_WARNING(YELLOW "[REPLAY]: the state is updated by the estimator thread, not recording a trajectory\n" RESET);
+    } else {
+      of_traj.open(traj_path, std::ofstream::out | std::ofstream::trunc);
+      of_traj << "# timestamp(s) tx ty tz qx qy qz qw" << std::endl;
+      of_traj.precision(9);
+      of_traj.setf(std::ios::fixed, std::ios::floatfield);
+    }
+  }
+
+  //===================================================================================
+  //===================================================================================
+  //===================================================================================
+
+  // Replay everything as fast as we can
+  // NOTE: we only time the feeding of the inputs, not reading them from disk
+  std::shared_ptr<ov_core::TraceContext> trace = sys->get_trace_context();
+  trace->set_enabled(true);
+  std::map<std::string, std::vector<double>> durations;
+  size_t num_imu = 0, num_frames = 0;
+  double time_first = -1, time_last = -1, time_last_traj = -1;
+  double time_feed = 0.0;
+  signal(SIGINT, signal_callback_handler);
+  InputLogEntry entry;
+  while (reader.next(entry)) {
+    int64_t start_ns = ov_core::Trace::now_ns();
+    double timestamp = -1;
+    if (entry.type == InputLogEntry::IMU) {
+      sys->feed_measurement_imu(entry.imu);
+      timestamp = entry.imu.timestamp;
+      num_imu++;
+    } else if (entry.type == InputLogEntry::CAMERA) {
+      sys->feed_measurement_camera(entry.camera);
+      timestamp = entry.camera.timestamp;
+      num_frames++;
+    } else if (entry.type == InputLogEntry::SIMULATION) {
+      sys->feed_measurement_simulation(entry.sim_timestamp, entry.sim_camids, entry.sim_feats);
+      timestamp = entry.sim_timestamp;
+      num_frames++;
+    } else if (entry.type == InputLogEntry::GROUNDTRUTH) {
+      sys->initialize_with_gt(entry.imustate);
+    }
+    time_feed += 1e-9 * (double)(ov_core::Trace::now_ns() - start_ns);
+    if (timestamp != -1) {
+      time_first = (time_first == -1) ? timestamp : time_first;
+      time_last = timestamp;
+    }
+
+    // Record the new state after each frame and collect the traced scopes before their buffers fill up
+    // We record in the IMU clock frame, thus add our estimated time offset to the state time (the last camera time)
+    if (entry.type == InputLogEntry::CAMERA || entry.type == InputLogEntry::SIMULATION) {
+      std::shared_ptr<State> state = sys->get_state();
+      std::unique_lock<std::recursive_mutex> lck_state = sys->lock_state();
+      if (of_traj.is_open() && sys->initialized() && state->_timestamp != time_last_traj) {
+        Eigen::Vector4d q = state->_imu->quat();
+        Eigen::Vector3d p = state->_imu->pos();
+        of_traj << state->_timestamp + state->_calib_dt_CAMtoIMU->value()(0) << " " << p(0) << " " << p(1) << " " << p(2) << " " << q(0) << " " << q(1) << " " << q(2) << " "
+                << q(3) << std::endl;
+        time_last_traj = state->_timestamp;
+      }
+      lck_state.unlock();
+      collect_durations(trace, durations);
+    }
+  }
+
+  // Finish the queued frames (if pipelined) before our final stats
+  int64_t start_ns = ov_core::Trace::now_ns();
+  sys.reset();
+  time_feed += 1e-9 * (double)(ov_core::Trace::now_ns() - start_ns);
+  collect_durations(trace, durations);
+
+  //===================================================================================
+  //===================================================================================
+  //===================================================================================
+
+  // Throughput compared to the rate the data was recorded at
+  double time_data = std::max(time_last - time_first, 0.0);
+  PRINT_INFO(BOLDCYAN "[REPLAY]: %zu frames and %zu imu in %.2f sec (%s threaded)\n" RESET, num_frames, num_imu, time_feed,
+             multi_threaded ? "multi" : "single");
+  PRINT_INFO(BOLDCYAN "[REPLAY]: %.1f frames/sec, %.1fx real-time\n" RESET, (double)num_frames / std::max(time_feed, 1e-9),
+             time_data / std::max(time_feed, 1e-9));
+  if (trace->num_dropped() > 0) {
+    PRINT_WARNING(YELLOW "[REPLAY]: %zu traced scopes were dropped, percentiles might be off\n" RESET, trace->num_dropped());
+  }
+
+  // Latency percentiles of each traced stage
+  PRINT_INFO("%-24s %8s %9s %9s %9s %9s %9s\n", "stage (ms)", "count", "mean", "p50", "p90", "p99", "max");
+  for (auto &stage : durations) {
+    std::vector<double> &times = stage.second;
+    if (times.empty())
+      continue;
+    std::sort(times.begin(), times.end());
+    double sum = 0.0;
+    for (const auto &time : times)
+      sum += time;
+    PRINT_INFO("%-24s %8zu %9.3f %9.3f %9.3f %9.3f %9.3f\n", stage.first.c_str(), times.size(), sum / (double)times.size(),
+               percentile(times, 0.50), percentile(times, 0.90), percentile(times, 0.99), times.back());
+  }
+  if (of_traj.is_open()) {
+    PRINT_INFO("[REPLAY]: trajectory saved to %s\n", traj_path.c_str());
+  }
+
+  // Done!
+  return EXIT_SUCCESS;
+}
@@ -35,6 +35,15 @@ using namespace ov_core;
 using namespace ov_type;
 using namespace ov_msckf;
 
+namespace {
+
+/// Keeps the cv_bridge image (and thus the ROS message it shares its data with) alive while the measurement is
+std::shared_ptr<const void> image_owner(const cv_bridge::CvImageConstPtr &cv_ptr) {
+  return std::shared_ptr<const void>(cv_ptr.get(), [cv_ptr](const void *) {});
+}
+
+} // namespace
+
 ROS1Visualizer::ROS1Visualizer(std::shared_ptr<ros::NodeHandle> nh, 
                                std::shared_ptr<VioManager> app, 
                                std::shared_ptr<Simulator> sim)
@@ -204,6 +213,9 @@ void ROS1Visualizer::setup_subscribers(std::shared_ptr<ov_core::YamlParser> pars
 
 void ROS1Visualizer::visualize() {
 
+  // The estimator thread could be changing the state (if pipelined), thus we hold its lock while we read it
+  std::unique_lock<std::recursive_mutex> lck_state = _app->lock_state();
+
   // Return if we have already visualized
   if (last_visualization_timestamp == _app->get_state()->_timestamp && _app->initialized())
     return;
@@ -257,9 +269,11 @@ void ROS1Visualizer::visualize_odometry(double timestamp) {
     return;
 
   // Get fast propagate state at the desired timestamp
+  // We hold the lock of the state while we read it, since the estimator thread could be changing it (if pipelined)
   std::shared_ptr<State> state = _app->get_state();
   Eigen::Matrix<double, 13, 1> state_plus = Eigen::Matrix<double, 13, 1>::Zero();
   Eigen::Matrix<double, 12, 12> cov_plus = Eigen::Matrix<double, 12, 12>::Zero();
+  std::unique_lock<std::recursive_mutex> lck_state = _app->lock_state();
   if (!_app->get_propagator()->fast_state_propagate(state, timestamp, state_plus, cov_plus))
     return;
 
@@ -358,6 +372,7 @@ void ROS1Visualizer::visualize_odometry(double timestamp) {
 }
 
 void ROS1Visualizer::visualize_final() {
+  std::unique_lock<std::recursive_mutex> lck_state = _app->lock_state();
 
   // Final time offset value
   if (_app->get_state()->_options.do_calib_camera_timeoffset) {
@@ -484,7 +499,11 @@ void ROS1Visualizer::callback_inertial(const sensor_msgs::Imu::ConstPtr &msg) {
     {
       // Loop through our queue and see if we are able to process any of our camera measurements
       // We are able to process if we have at least one IMU measurement greater than the camera time
-      double timestamp_imu_inC = message.timestamp - _app->get_state()->_calib_dt_CAMtoIMU->value()(0);
+      double timestamp_imu_inC;
+      {
+        std::unique_lock<std::recursive_mutex> lck_state = _app->lock_state();
+        timestamp_imu_inC = message.timestamp - _app->get_state()->_calib_dt_CAMtoIMU->value()(0);
+      }
       while (!camera_queue.empty() && camera_queue.at(0).timestamp < timestamp_imu_inC) {
         auto rT0_1 = boost::posix_time::microsec_clock::local_time();
         double update_dt = 100.0 * (timestamp_imu_inC - camera_queue.at(0).timestamp);
@@ -511,6 +530,15 @@ void ROS1Visualizer::callback_inertial(const sensor_msgs::Imu::ConstPtr &msg) {
   }
 }
 
+cv::Mat ROS1Visualizer::empty_mask(int cam_id, const cv::Size &size) {
+  // Masks are never written to, thus we can give every frame the same one
+  std::lock_guard<std::mutex> lck(camera_queue_mtx);
+  cv::Mat &mask = camera_masks_empty[cam_id];
+  if (mask.size() != size)
+    mask = cv::Mat::zeros(size, CV_8UC1);
+  return mask;
+}
+
 void ROS1Visualizer::callback_monocular(const sensor_msgs::ImageConstPtr &msg0, int cam_id0) {
 
   // Check if we should drop this image
@@ -534,14 +562,15 @@ void ROS1Visualizer::callback_monocular(const sensor_msgs::ImageConstPtr &msg0,
   ov_core::CameraData message;
   message.timestamp = cv_ptr->header.stamp.toSec();
   message.sensor_ids.push_back(cam_id0);
-  message.images.push_back(cv_ptr->image.clone());
+  message.images.push_back(cv_ptr->image);
+  message.owners.push_back(image_owner(cv_ptr));
 
   // Load the mask if we are using it, else it is empty
   // TODO: in the future we should get this from external pixel segmentation
   if (_app->get_params().use_mask) {
     message.masks.push_back(_app->get_params().masks.at(cam_id0));
   } else {
-    message.masks.push_back(cv::Mat::zeros(cv_ptr->image.rows, cv_ptr->image.cols, CV_8UC1));
+    message.masks.push_back(empty_mask(cam_id0, cv_ptr->image.size()));
   }
 
   // append it to our queue of images
@@ -584,8 +613,10 @@ void ROS1Visualizer::callback_stereo(const sensor_msgs::ImageConstPtr &msg0, con
   message.timestamp = cv_ptr0->header.stamp.toSec();
   message.sensor_ids.push_back(cam_id0);
   message.sensor_ids.push_back(cam_id1);
-  message.images.push_back(cv_ptr0->image.clone());
-  message.images.push_back(cv_ptr1->image.clone());
+  message.images.push_back(cv_ptr0->image);
+  message.images.push_back(cv_ptr1->image);
+  message.owners.push_back(image_owner(cv_ptr0));
+  message.owners.push_back(image_owner(cv_ptr1));
 
   // Load the mask if we are using it, else it is empty
   // TODO: in the future we should get this from external pixel segmentation
@@ -594,8 +625,8 @@ void ROS1Visualizer::callback_stereo(const sensor_msgs::ImageConstPtr &msg0, con
     message.masks.push_back(_app->get_params().masks.at(cam_id1));
   } else {
     // message.masks.push_back(cv::Mat(cv_ptr0->image.rows, cv_ptr0->image.cols, CV_8UC1, cv::Scalar(255)));
-    message.masks.push_back(cv::Mat::zeros(cv_ptr0->image.rows, cv_ptr0->image.cols, CV_8UC1));
-    message.masks.push_back(cv::Mat::zeros(cv_ptr1->image.rows, cv_ptr1->image.cols, CV_8UC1));
+    message.masks.push_back(empty_mask(cam_id0, cv_ptr0->image.size()));
+    message.masks.push_back(empty_mask(cam_id1, cv_ptr1->image.size()));
   }
 
   // append it to our queue of images
@@ -669,9 +700,12 @@ void ROS1Visualizer::publish_images() {
   // Return if we have already visualized
   if (_app->get_state() == nullptr)
     return;
-  if (last_visualization_timestamp_image == _app->get_state()->_timestamp && _app->initialized())
-    return;
-  last_visualization_timestamp_image = _app->get_state()->_timestamp;
+  {
+    std::unique_lock<std::recursive_mutex> lck_state = _app->lock_state();
+    if (last_visualization_timestamp_image == _app->get_state()->_timestamp && _app->initialized())
+      return;
+    last_visualization_timestamp_image = _app->get_state()->_timestamp;
+  }
 
   // Check if we have subscribers
   if (it_pub_tracks.getNumSubscribers() == 0)
@@ -133,6 +133,9 @@ protected:
   /// Publish loop-closure information of current pose and active track information
   void publish_loopclosure_information();
 
+  /// Zero tracking mask of the given size for a camera (shared between frames since masks are read-only)
+  cv::Mat empty_mask(int cam_id, const cv::Size &size);
+
   /// Global node handler
   std::shared_ptr<ros::NodeHandle> _nh;
 
@@ -185,6 +188,9 @@ protected:
   // Last camera message timestamps we have received (mapped by cam id)
   std::map<int, double> camera_last_timestamp;
 
+  // Empty (all zero) tracking mask we give each camera if we are not using masks (mapped by cam id)
+  std::map<int, cv::Mat> camera_masks_empty;
+
   // Last timestamp we visualized at
   double last_visualization_timestamp = 0;
   double last_visualization_timestamp_image = 0;
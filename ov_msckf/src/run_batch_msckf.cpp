@@ -0,0 +1,300 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "core/InputLog.h"
+#include "core/VioManager.h"
+#include "sim/Simulator.h"
+#include "state/State.h"
+#include "types/IMU.h"
+#include "types/Vec.h"
+#include "utils/colors.h"
+#include "utils/print.h"
+#include "utils/sensor_data.h"
+#include "utils/trace.h"
+
+using namespace ov_msckf;
+
+/**
+ * A single run of a dataset.
+ * If no input log is given we simulate the dataset using the simulation settings of the config.
+ * Each run of a simulated dataset uses a different measurement seed, while a replayed log is always the same.
+ */
+struct BatchJob {
+  std::string algorithm;
+  std::string dataset;
+  std::string config_path;
+  std::string inputs_path;
+  int run = 0;
+};
+
+// Define the function to be called when ctrl-c (SIGINT) is sent to process
+void signal_callback_handler(int signum) { std::exit(signum); }
+
+// Loads our jobs, each line is "algorithm dataset config_path num_runs [inputs_path]" (# starts a comment)
+bool load_jobs(const std::string &path, std::vector<BatchJob> &jobs) {
+  std::ifstream file(path);
+  if (!file.is_open())
+    return false;
+  std::string line;
+  while (std::getline(file, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream ss(line);
+    BatchJob job;
+    int num_runs = 0;
+    if (!(ss >> job.algorithm))
+      continue;
+    if (!(ss >> job.dataset >> job.config_path >> num_runs) || num_runs < 1) {
+      PRINT_ERROR(RED "[BATCH]: invalid job line: %s\n" RESET, line.c_str());
+      return false;
+    }
+    ss >> job.inputs_path;
+    for (int run = 0; run < (job.inputs_path.empty() ? num_runs : 1); run++) {
+      job.run = run;
+      jobs.push_back(job);
+    }
+  }
+  return true;
+}
+
+// Writes a pose in the format that ov_eval loads (timestamp(s) tx ty tz qx qy qz qw)
+void write_pose(std::ofstream &file, double timestamp, const Eigen::Vector4d &q, const Eigen::Vector3d &p) {
+  file.precision(5);
+  file.setf(std::ios::fixed, std::ios::floatfield);
+  file << timestamp << " ";
+  file.precision(6);
+  file << p(0) << " " << p(1) << " " << p(2) << " " << q(0) << " " << q(1) << " " << q(2) << " " << q(3) << std::endl;
+}
+
+// Runs a single job and writes its estimate (and groundtruth if simulated) into the output folder
+bool run_job(const BatchJob &job, const std::string &folder_output) {
+
+  // Load the config
+  auto parser = std::make_shared<ov_core::YamlParser>(job.config_path);
+  VioManagerOptions params;
+  params.print_and_load(parser);
+  if (job.inputs_path.empty()) {
+    params.print_and_load_simulation(parser);
+    params.sim_seed_measurements += job.run;
+  }
+  if (!parser->successful()) {
+    PRINT_ERROR(RED "unable to parse all parameters of %s, please fix\n" RESET, job.config_path.c_str());
+    return false;
+  }
+
+  // Each system runs on a single core, so our thread budget is the number of systems running at once
+  // Each system traces into its own context, thus the timing and trace files are written per job into the output folder
+  // The other file outputs would be shared by the runs, thus disable them
+  params.num_opencv_threads = 0;
+  params.use_multi_threading_pubs = false;
+  params.use_multi_threading_subs = false;
+  params.use_pipeline = false;
+  std::string name_run = std::to_string(job.run);
+  if (params.record_timing_information) {
+    boost::filesystem::path path = boost::filesystem::path(folder_output) / "timings" / job.algorithm / job.dataset / (name_run + "_timing.txt");
+    params.record_timing_filepath = path.string();
+  }
+  if (!params.record_trace_filepath.empty()) {
+    boost::filesystem::path path = boost::filesystem::path(folder_output) / "traces" / job.algorithm / job.dataset / (name_run + "_trace.json");
+    params.record_trace_filepath = path.string();
+  }
+  params.record_metrics_filepath = "";
+  params.record_inputs_filepath = "";
+  auto sys = std::make_shared<VioManager>(params);
+
+  // Open our estimate file, ov_eval expects algorithm/dataset/run.txt
+  boost::filesystem::path path_est = boost::filesystem::path(folder_output) / "algorithms" / job.algorithm / job.dataset;
+  boost::filesystem::create_directories(path_est);
+  path_est /= name_run + "_estimate.txt";
+  std::ofstream of_est(path_est.string(), std::ofstream::out | std::ofstream::trunc);
+  of_est << "# timestamp(s) tx ty tz qx qy qz qw" << std::endl;
+  double time_last_est = -1;
+
+  // Replay the recorded inputs
+  // We publish in the IMU clock frame, thus add our estimated time offset to the state time (the last camera time)
+  if (!job.inputs_path.empty()) {
+    InputLogReader reader(job.inputs_path);
+    if (!reader.is_open()) {
+      PRINT_ERROR(RED "[BATCH]: %s is not a valid input log\n" RESET, job.inputs_path.c_str());
+      return false;
+    }
+    InputLogEntry entry;
+    while (reader.next(entry)) {
+      if (entry.type == InputLogEntry::IMU) {
+        sys->feed_measurement_imu(entry.imu);
+        continue;
+      } else if (entry.type == InputLogEntry::CAMERA) {
+        sys->feed_measurement_camera(entry.camera);
+      } else if (entry.type == InputLogEntry::SIMULATION) {
+        sys->feed_measurement_simulation(entry.sim_timestamp, entry.sim_camids, entry.sim_feats);
+      } else if (entry.type == InputLogEntry::GROUNDTRUTH) {
+        sys->initialize_with_gt(entry.imustate);
+        continue;
+      }
+      std::shared_ptr<State> state = sys->get_state();
+      std::unique_lock<std::recursive_mutex> lck_state = sys->lock_state();
+      if (sys->initialized() && state->_timestamp != time_last_est) {
+        write_pose(of_est, state->_timestamp + state->_calib_dt_CAMtoIMU->value()(0), state->_imu->quat(), state->_imu->pos());
+        time_last_est = state->_timestamp;
+      }
+    }
+    return true;
+  }
+
+  // Otherwise simulate, the first run also writes the groundtruth
+  // We write to a temporary file first since other algorithms might be writing the same groundtruth
+  Simulator sim(params);
+  boost::filesystem::path path_gt = boost::filesystem::path(folder_output) / "truths";
+  boost::filesystem::create_directories(path_gt);
+  path_gt /= job.dataset + ".txt";
+  std::string path_gt_tmp = path_gt.string() + "." + job.algorithm + ".tmp";
+  std::ofstream of_gt;
+  if (job.run == 0) {
+    of_gt.open(path_gt_tmp, std::ofstream::out | std::ofstream::trunc);
+    of_gt << "# timestamp(s) tx ty tz qx qy qz qw" << std::endl;
+  }
+
+  // Initialize our filter with the groundtruth (at the next timestep so we get the first IMU message)
+  // Since the state time is in the camera frame of reference, subtract out the imu to camera time offset
+  double calib_camimu_dt = sim.get_true_parameters().calib_camimu_dt;
+  Eigen::Matrix<double, 17, 1> imustate;
+  if (!sim.get_state(sim.current_timestamp() + 1.0 / params.sim_freq_imu, imustate)) {
+    PRINT_ERROR(RED "[BATCH]: could not initialize the filter to the first state of %s\n" RESET, job.dataset.c_str());
+    return false;
+  }
+  imustate(0, 0) -= calib_camimu_dt;
+  sys->initialize_with_gt(imustate);
+
+  // Step through the simulation, the camera is buffered so we have the IMU up to its time
+  // NOTE: we record both the estimate and groundtruth with the same "true" timestamp if we are doing simulation
+  double buffer_timecam = -1;
+  std::vector<int> buffer_camids;
+  std::vector<std::vector<std::pair<size_t, Eigen::VectorXf>>> buffer_feats;
+  while (sim.ok()) {
+    ov_core::ImuData message_imu;
+    if (sim.get_next_imu(message_imu.timestamp, message_imu.wm, message_imu.am)) {
+      sys->feed_measurement_imu(message_imu);
+    }
+    double time_cam;
+    std::vector<int> camids;
+    std::vector<std::vector<std::pair<size_t, Eigen::VectorXf>>> feats;
+    if (sim.get_next_cam(time_cam, camids, feats)) {
+      if (buffer_timecam != -1) {
+        sys->feed_measurement_simulation(buffer_timecam, buffer_camids, buffer_feats);
+        std::shared_ptr<State> state = sys->get_state();
+        std::unique_lock<std::recursive_mutex> lck_state = sys->lock_state();
+        Eigen::Matrix<double, 17, 1> state_gt;
+        if (sys->initialized() && state->_timestamp != time_last_est && sim.get_state(state->_timestamp + calib_camimu_dt, state_gt)) {
+          write_pose(of_est, state->_timestamp + calib_camimu_dt, state->_imu->quat(), state->_imu->pos());
+          if (of_gt.is_open())
+            write_pose(of_gt, state->_timestamp + calib_camimu_dt, state_gt.block(1, 0, 4, 1), state_gt.block(5, 0, 3, 1));
+          time_last_est = state->_timestamp;
+        }
+      }
+      buffer_timecam = time_cam;
+      buffer_camids = camids;
+      buffer_feats = feats;
+    }
+  }
+  if (of_gt.is_open()) {
+    of_gt.close();
+    boost::filesystem::rename(path_gt_tmp, path_gt);
+  }
+  return true;
+}
+
+// Main function
+int main(int argc, char **argv) {
+
+  // Ensure we have our jobs and output folder
+  ov_core::Printer::setPrintLevel("INFO");
+  if (argc < 3) {
+    PRINT_ERROR(RED "usage: run_batch_msckf <jobs.txt> <folder_output> [max_threads] [verbosity]\n" RESET);
+    PRINT_ERROR(RED "  each line of jobs.txt is: algorithm dataset config_path num_runs [inputs_path]\n" RESET);
+    PRINT_ERROR(RED "  without an input log (see record_inputs_filepath) the dataset is simulated with the config's sim_* settings\n" RESET);
+    PRINT_ERROR(RED "  evaluate with: error_comparison posyaw <folder_output>/truths <folder_output>/algorithms\n" RESET);
+    PRINT_ERROR(RED "  timing and trace files (if enabled in the config) are written per job into <folder_output>/timings and traces\n" RESET);
+    return EXIT_FAILURE;
+  }
+  std::string folder_output = argv[2];
+  int max_threads = (argc > 3) ? std::stoi(argv[3]) : (int)std::thread::hardware_concurrency();
+  std::string verbosity = (argc > 4) ? argv[4] : "WARNING";
+  signal(SIGINT, signal_callback_handler);
+
+  // Load what we should run
+  std::vector<BatchJob> jobs;
+  if (!load_jobs(argv[1], jobs) || jobs.empty()) {
+    PRINT_ERROR(RED "[BATCH]: unable to load any jobs from %s\n" RESET, argv[1]);
+    return EXIT_FAILURE;
+  }
+  max_threads = std::max(1, std::min(max_threads, (int)jobs.size()));
+  PRINT_INFO(BOLDCYAN "[BATCH]: running %zu jobs on %d threads\n" RESET, jobs.size(), max_threads);
+
+  // The verbosity of each job, they prefix their output with the job name
+  ov_core::Printer::setPrintLevel(verbosity);
+  ov_core::Printer::PrintLevel level_jobs = ov_core::Printer::current_print_level;
+  ov_core::Printer::setPrintLevel(ov_core::Printer::PrintLevel::INFO);
+
+  // Each thread takes the next job until there are none left
+  std::atomic<size_t> next_job(0);
+  std::atomic<int> num_failed(0);
+  std::vector<std::thread> threads;
+  int64_t start_ns = ov_core::Trace::now_ns();
+  for (int i = 0; i < max_threads; i++) {
+    threads.emplace_back([&] {
+      size_t idx;
+      while ((idx = next_job.fetch_add(1)) < jobs.size()) {
+        const BatchJob &job = jobs.at(idx);
+        std::string name = job.algorithm + "/" + job.dataset + "/" + std::to_string(job.run);
+        ov_core::Printer::ThreadContext context;
+        context.level = (int)level_jobs;
+        context.prefix = "[" + name + "] ";
+        ov_core::Printer::setThreadContext(context);
+        int64_t job_start_ns = ov_core::Trace::now_ns();
+        bool success = run_job(job, folder_output);
+        num_failed += (success) ? 0 : 1;
+        ov_core::Printer::setThreadContext(ov_core::Printer::ThreadContext());
+        PRINT_INFO("[BATCH]: %s %s in %.2f sec (%zu of %zu)\n", name.c_str(), (success) ? "finished" : RED "failed" RESET,
+                   1e-9 * (double)(ov_core::Trace::now_ns() - job_start_ns), idx + 1, jobs.size());
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // Done!
+  PRINT_INFO(BOLDCYAN "[BATCH]: %zu jobs done in %.2f sec, %d failed\n" RESET, jobs.size(), 1e-9 * (double)(ov_core::Trace::now_ns() - start_ns),
+             num_failed.load());
+  PRINT_INFO("[BATCH]: evaluate with: error_comparison posyaw %s/truths %s/algorithms\n", folder_output.c_str(), folder_output.c_str());
+  return (num_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
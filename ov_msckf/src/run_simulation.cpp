@@ -24,6 +24,7 @@
 
 #include "core/VioManager.h"
 #include "sim/Simulator.h"
+#include "state/State.h"
 #include "utils/colors.h"
 #include "utils/dataset_reader.h"
 #include "utils/print.h"
@@ -139,6 +140,13 @@ int main(int argc, char **argv) {
   std::vector<int> buffer_camids;
   std::vector<std::vector<std::pair<size_t, Eigen::VectorXf>>> buffer_feats;
 
+  // If requested, we will save a checkpoint and restore it into a second system
+  // Both are then fed the same measurements and their IMU states should remain the same
+  std::shared_ptr<VioManager> sys_restored;
+  std::string checkpoint_path = (boost::filesystem::temp_directory_path() / "ov_msckf_sim_checkpoint.bin").string();
+  double time_first_cam = -1;
+  double max_restored_diff = 0.0;
+
   // Step through the rosbag
 #if ROS_AVAILABLE == 1
   while (sim->ok() && ros::ok()) {
@@ -154,6 +162,8 @@ int main(int argc, char **argv) {
     bool hasimu = sim->get_next_imu(message_imu.timestamp, message_imu.wm, message_imu.am);
     if (hasimu) {
       sys->feed_measurement_imu(message_imu);
+      if (sys_restored != nullptr)
+        sys_restored->feed_measurement_imu(message_imu);
 #if ROS_AVAILABLE == 1 || ROS_AVAILABLE == 2
       viz->visualize_odometry(message_imu.timestamp);
 #endif
@@ -170,6 +180,24 @@ int main(int argc, char **argv) {
 #if ROS_AVAILABLE == 1 || ROS_AVAILABLE == 2
         viz->visualize();
 #endif
+        if (sys_restored != nullptr) {
+          sys_restored->feed_measurement_simulation(buffer_timecam, buffer_camids, buffer_feats);
+          Eigen::VectorXd diff = sys->get_state()->_imu->value() - sys_restored->get_state()->_imu->value();
+          max_restored_diff = std::max(max_restored_diff, diff.cwiseAbs().maxCoeff());
+        }
+        time_first_cam = (time_first_cam == -1) ? buffer_timecam : time_first_cam;
+        if (params.sim_checkpoint_time > 0 && sys_restored == nullptr && buffer_timecam - time_first_cam >= params.sim_checkpoint_time) {
+          VioManagerOptions params_restored = params;
+          params_restored.record_timing_information = false;
+          params_restored.record_trace_filepath = "";
+          params_restored.record_metrics_filepath = "";
+          params_restored.record_inputs_filepath = "";
+          sys_restored = std::make_shared<VioManager>(params_restored);
+          if (!sys->save_checkpoint(checkpoint_path) || !sys_restored->load_checkpoint(checkpoint_path)) {
+            PRINT_ERROR(RED "[SIM]: unable to save and restore the checkpoint %s\n" RESET, checkpoint_path.c_str());
+            std::exit(EXIT_FAILURE);
+          }
+        }
       }
       buffer_timecam = time_cam;
       buffer_camids = camids;
@@ -177,6 +205,17 @@ int main(int argc, char **argv) {
     }
   }
 
+  // Report how close the restored system stayed to the original one, we fail if it diverged
+  bool restored_failed = false;
+  if (sys_restored != nullptr) {
+    PRINT_INFO("[SIM]: max difference of the restored system's IMU state = %.3e\n", max_restored_diff);
+    if (!(max_restored_diff <= params.sim_checkpoint_tolerance)) {
+      PRINT_ERROR(RED "[SIM]: restored system diverged from the original one (%.3e > %.3e)\n" RESET, max_restored_diff,
+                  params.sim_checkpoint_tolerance);
+      restored_failed = true;
+    }
+  }
+
   // Final visualization
 #if ROS_AVAILABLE == 1
   viz->visualize_final();
@@ -187,5 +226,5 @@ int main(int argc, char **argv) {
 #endif
 
   // Done!
-  return EXIT_SUCCESS;
+  return (restored_failed) ? EXIT_FAILURE : EXIT_SUCCESS;
 }
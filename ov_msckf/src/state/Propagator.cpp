@@ -23,8 +23,10 @@
 
 #include "state/State.h"
 #include "state/StateHelper.h"
+#include "utils/binary_io.h"
 #include "utils/print.h"
 #include "utils/quat_ops.h"
+#include "utils/trace.h"
 
 using namespace ov_core;
 using namespace ov_type;
@@ -32,6 +34,8 @@ using namespace ov_msckf;
 
 void Propagator::propagate_and_clone(std::shared_ptr<State> state, double timestamp) {
 
+  OV_TRACE_SCOPE("propagate and clone");
+
   // If the difference between the current update time and state is zero
   // We should crash, as this means we would have two clones at the same time!!!!
   /*
@@ -1094,4 +1098,45 @@ Eigen::MatrixXd Propagator::compute_H_Tg(std::shared_ptr<State> state, const Eig
   Eigen::MatrixXd H_Tg = Eigen::MatrixXd::Zero(3, 9);
   H_Tg << a_1 * I_3x3, a_2 * I_3x3, a_3 * I_3x3;
   return H_Tg;
-}
\ No newline at end of file
+}
+void Propagator::save_checkpoint(std::ostream &out) {
+  std::lock_guard<std::mutex> lck(imu_data_mtx);
+  binary_io::write(out, (uint64_t)imu_data.size());
+  for (const auto &data : imu_data) {
+    binary_io::write(out, data.timestamp);
+    binary_io::write_matrix(out, data.wm);
+    binary_io::write_matrix(out, data.am);
+  }
+  binary_io::write(out, have_last_prop_time_offset);
+  binary_io::write(out, last_prop_time_offset);
+  binary_io::write(out, (bool)cache_imu_valid);
+  if (cache_imu_valid) {
+    binary_io::write(out, cache_state_time);
+    binary_io::write(out, cache_t_off);
+    binary_io::write_matrix(out, cache_state_est);
+    binary_io::write_matrix(out, cache_state_covariance);
+  }
+}
+
+bool Propagator::load_checkpoint(std::istream &in) {
+  uint64_t num_imu;
+  if (!binary_io::read(in, num_imu))
+    return false;
+  std::vector<ov_core::ImuData> imu_data_new;
+  for (uint64_t i = 0; i < num_imu; i++) {
+    ov_core::ImuData data;
+    if (!binary_io::read(in, data.timestamp) || !binary_io::read_matrix(in, data.wm) || !binary_io::read_matrix(in, data.am))
+      return false;
+    imu_data_new.push_back(data);
+  }
+  bool cache_valid;
+  if (!binary_io::read(in, have_last_prop_time_offset) || !binary_io::read(in, last_prop_time_offset) || !binary_io::read(in, cache_valid))
+    return false;
+  if (cache_valid && (!binary_io::read(in, cache_state_time) || !binary_io::read(in, cache_t_off) ||
+                      !binary_io::read_matrix(in, cache_state_est) || !binary_io::read_matrix(in, cache_state_covariance)))
+    return false;
+  cache_imu_valid = cache_valid;
+  std::lock_guard<std::mutex> lck(imu_data_mtx);
+  imu_data = imu_data_new;
+  return true;
+}
@@ -23,8 +23,10 @@
 #define OV_MSCKF_STATE_PROPAGATOR_H
 
 #include <atomic>
+#include <istream>
 #include <memory>
 #include <mutex>
+#include <ostream>
 
 #include "utils/sensor_data.h"
 
@@ -73,6 +75,12 @@ public:
     clean_old_imu_measurements(oldest_time - 0.10);
   }
 
+  /// Number of IMU measurements we are currently holding onto
+  size_t num_imu_measurements() {
+    std::lock_guard<std::mutex> lck(imu_data_mtx);
+    return imu_data.size();
+  }
+
   /**
    * @brief This will remove any IMU measurements that are older then the given measurement time
    * @param oldest_time Time that we can discard measurements before (in IMU clock)
@@ -90,6 +98,19 @@ public:
     }
   }
 
+  /**
+   * @brief Writes our IMU history, last time offset and fast propagation cache in binary to the stream
+   * @param out Stream we will write to
+   */
+  void save_checkpoint(std::ostream &out);
+
+  /**
+   * @brief Restores what save_checkpoint() wrote (replacing our current IMU history)
+   * @param in Stream we will read from
+   * @return True if everything could be read
+   */
+  bool load_checkpoint(std::istream &in);
+
   /**
    * @brief Will invalidate the cache used for fast propagation
    *        将使用于快速传播的缓存无效化
@@ -24,8 +24,10 @@
 #include "state/State.h"
 
 #include "types/Landmark.h"
+#include "utils/binary_io.h"
 #include "utils/colors.h"
 #include "utils/print.h"
+#include "utils/trace.h"
 
 #include <boost/math/distributions/chi_squared.hpp>
 
@@ -46,14 +48,13 @@ void StateHelper::EKFPropagation(std::shared_ptr<State> state,
     std::exit(EXIT_FAILURE);
   }
 
-  // Loop through our Phi order and ensure that they are continuous in memory // todo 为什么要检查连续内存
+  // Loop through our Phi order and check if they are continuous in memory // todo 为什么要检查连续内存
+  // If they are not, we will need to scatter each variable back into the covariance one by one
+  bool contiguous_NEW = true;
   int size_order_NEW = order_NEW.at(0)->size();
   for (size_t i = 0; i < order_NEW.size() - 1; i++) { // code size-1 遍历到倒数第二个
     if (order_NEW.at(i)->id() + order_NEW.at(i)->size() != order_NEW.at(i + 1)->id()) {
-      PRINT_ERROR(RED "StateHelper::EKFPropagation() - Called with non-contiguous state elements!\n" RESET);
-      PRINT_ERROR(
-          RED "StateHelper::EKFPropagation() - This code only support a state transition which is in the same order as the state\n" RESET);
-      std::exit(EXIT_FAILURE);
+      contiguous_NEW = false;
     }
     size_order_NEW += order_NEW.at(i + 1)->size();
   }
@@ -112,13 +113,31 @@ void StateHelper::EKFPropagation(std::shared_ptr<State> state,
   }
 
   // We are good to go! 可以进行下一步！
-  int start_id = order_NEW.at(0)->id();
-  int phi_size = Phi.rows();
   int total_size = state->_Cov.rows();
-  // kernel 维护状态变量协方差矩阵
-  state->_Cov.block(start_id, 0, phi_size, total_size) = Cov_PhiT.transpose(); // todo 非对角矩阵块怎么是这个样子呢？ 怎么是GQG的一半？ // lhq ref.https://docs.openvins.com/update.html
-  state->_Cov.block(0, start_id, total_size, phi_size) = Cov_PhiT;
-  state->_Cov.block(start_id, start_id, phi_size, phi_size) = Phi_Cov_PhiT;
+  if (contiguous_NEW) {
+    int start_id = order_NEW.at(0)->id();
+    int phi_size = Phi.rows();
+    // kernel 维护状态变量协方差矩阵
+    state->_Cov.block(start_id, 0, phi_size, total_size) = Cov_PhiT.transpose(); // todo 非对角矩阵块怎么是这个样子呢？ 怎么是GQG的一半？ // lhq ref.https://docs.openvins.com/update.html
+    state->_Cov.block(0, start_id, total_size, phi_size) = Cov_PhiT;
+    state->_Cov.block(start_id, start_id, phi_size, phi_size) = Phi_Cov_PhiT;
+  } else {
+    // Scatter the rows and columns of each new variable, then the blocks between the new variables
+    std::vector<int> Phi_id_NEW;
+    int current_it_NEW = 0;
+    for (const auto &var : order_NEW) {
+      Phi_id_NEW.push_back(current_it_NEW);
+      state->_Cov.block(var->id(), 0, var->size(), total_size) = Cov_PhiT.block(0, current_it_NEW, total_size, var->size()).transpose();
+      state->_Cov.block(0, var->id(), total_size, var->size()) = Cov_PhiT.block(0, current_it_NEW, total_size, var->size());
+      current_it_NEW += var->size();
+    }
+    for (size_t i = 0; i < order_NEW.size(); i++) {
+      for (size_t j = 0; j < order_NEW.size(); j++) {
+        state->_Cov.block(order_NEW.at(i)->id(), order_NEW.at(j)->id(), order_NEW.at(i)->size(), order_NEW.at(j)->size()) =
+            Phi_Cov_PhiT.block(Phi_id_NEW.at(i), Phi_id_NEW.at(j), order_NEW.at(i)->size(), order_NEW.at(j)->size());
+      }
+    }
+  }
 
   // note 检查协方差矩阵的(半)正定性
   // We should check if we are not positive semi-definitate (i.e. negative diagionals is not s.p.d)
@@ -142,6 +161,8 @@ void StateHelper::EKFUpdate(std::shared_ptr<State> state,
                             const Eigen::MatrixXd &R) 
 {
 
+  OV_TRACE_SCOPE("ekf update");
+
   //==========================================================
   //==========================================================
   // ref.https://docs.openvins.com/update-compress.html
@@ -538,6 +559,186 @@ bool StateHelper::initialize(std::shared_ptr<State> state, std::shared_ptr<Type>
   return true;
 }
 
+std::vector<bool> StateHelper::initialize_batch(std::shared_ptr<State> state, const std::vector<std::shared_ptr<Type>> &new_variables,
+                                                const std::vector<std::vector<std::shared_ptr<Type>>> &H_orders,
+                                                std::vector<Eigen::MatrixXd> &H_Rs, std::vector<Eigen::MatrixXd> &H_Ls,
+                                                std::vector<Eigen::MatrixXd> &Rs, std::vector<Eigen::VectorXd> &ress,
+                                                const std::vector<double> &chi_2_mults) {
+
+  // Our return values
+  size_t num_vars = new_variables.size();
+  assert(H_orders.size() == num_vars);
+  assert(H_Rs.size() == num_vars && H_Ls.size() == num_vars);
+  assert(Rs.size() == num_vars && ress.size() == num_vars);
+  assert(chi_2_mults.size() == num_vars);
+  std::vector<bool> accepted(num_vars, false);
+  if (num_vars == 0)
+    return accepted;
+
+  //==========================================================
+  //==========================================================
+  // First we perform QR givens to seperate each system and chi2 test it against the current covariance
+  std::vector<Eigen::MatrixXd> Hxinits(num_vars), Hups(num_vars);
+  std::vector<Eigen::MatrixXd> H_finits(num_vars), Rinits(num_vars), Rups(num_vars);
+  std::vector<Eigen::VectorXd> resinits(num_vars), resups(num_vars);
+  for (size_t v = 0; v < num_vars; v++) {
+
+    // Check that this new variable is not already initialized
+    const std::shared_ptr<Type> &new_variable = new_variables.at(v);
+    if (std::find(state->_variables.begin(), state->_variables.end(), new_variable) != state->_variables.end()) {
+      PRINT_ERROR("StateHelper::initialize_batch() - Called on variable that is already in the state\n");
+      PRINT_ERROR("StateHelper::initialize_batch() - Found this variable at %d in covariance\n", new_variable->id());
+      std::exit(EXIT_FAILURE);
+    }
+
+    // Check that we have isotropic noise (i.e. is diagonal and all the same value)
+    Eigen::MatrixXd &R = Rs.at(v);
+    assert(R.rows() == R.cols());
+    assert(R.rows() > 0);
+    if (!R.isApprox(R(0, 0) * Eigen::MatrixXd::Identity(R.rows(), R.cols()))) {
+      PRINT_ERROR(RED "StateHelper::initialize_batch() - Your noise is not isotropic and diagonal!\n" RESET);
+      std::exit(EXIT_FAILURE);
+    }
+
+    // Givens to separate into the initializing and updating systems
+    Eigen::MatrixXd &H_L = H_Ls.at(v);
+    Eigen::MatrixXd &H_R = H_Rs.at(v);
+    Eigen::VectorXd &res = ress.at(v);
+    size_t new_var_size = new_variable->size();
+    assert((int)new_var_size == H_L.cols());
+    Eigen::JacobiRotation<double> tempHo_GR;
+    for (int n = 0; n < H_L.cols(); ++n) {
+      for (int m = (int)H_L.rows() - 1; m > n; m--) {
+        tempHo_GR.makeGivens(H_L(m - 1, n), H_L(m, n));
+        (H_L.block(m - 1, n, 2, H_L.cols() - n)).applyOnTheLeft(0, 1, tempHo_GR.adjoint());
+        (res.block(m - 1, 0, 2, 1)).applyOnTheLeft(0, 1, tempHo_GR.adjoint());
+        (H_R.block(m - 1, 0, 2, H_R.cols())).applyOnTheLeft(0, 1, tempHo_GR.adjoint());
+      }
+    }
+    Hxinits.at(v) = H_R.block(0, 0, new_var_size, H_R.cols());
+    H_finits.at(v) = H_L.block(0, 0, new_var_size, new_var_size);
+    resinits.at(v) = res.block(0, 0, new_var_size, 1);
+    Rinits.at(v) = R.block(0, 0, new_var_size, new_var_size);
+    Hups.at(v) = H_R.block(new_var_size, 0, H_R.rows() - new_var_size, H_R.cols());
+    resups.at(v) = res.block(new_var_size, 0, res.rows() - new_var_size, 1);
+    Rups.at(v) = R.block(new_var_size, new_var_size, R.rows() - new_var_size, R.rows() - new_var_size);
+
+    // Do mahalanobis distance testing
+    Eigen::MatrixXd P_up = get_marginal_covariance(state, H_orders.at(v));
+    assert(Rups.at(v).rows() == Hups.at(v).rows());
+    assert(Hups.at(v).cols() == P_up.cols());
+    Eigen::MatrixXd S = Hups.at(v) * P_up * Hups.at(v).transpose() + Rups.at(v);
+    double chi2 = resups.at(v).dot(S.llt().solve(resups.at(v)));
+    boost::math::chi_squared chi_squared_dist(res.rows());
+    double chi2_check = boost::math::quantile(chi_squared_dist, 0.95);
+    accepted.at(v) = (chi2 <= chi_2_mults.at(v) * chi2_check);
+  }
+
+  //==========================================================
+  //==========================================================
+  // Build the union of all state variables the accepted systems depend on
+  // Along with the location of each accepted system in the stacked one
+  std::vector<std::shared_ptr<Type>> H_order_big;
+  std::vector<int> H_id_big;
+  int total_vars = 0;
+  int total_new = 0;
+  int total_up = 0;
+  for (size_t v = 0; v < num_vars; v++) {
+    if (!accepted.at(v))
+      continue;
+    for (const auto &var : H_orders.at(v)) {
+      if (std::find(H_order_big.begin(), H_order_big.end(), var) == H_order_big.end()) {
+        H_order_big.push_back(var);
+        H_id_big.push_back(total_vars);
+        total_vars += var->size();
+      }
+    }
+    total_new += new_variables.at(v)->size();
+    total_up += Hups.at(v).rows();
+  }
+  if (total_new == 0)
+    return accepted;
+
+  // Stack the invertible initializing systems and the updating systems
+  // The new variables only depend on themselves, thus the stacked H_L is block diagonal
+  Eigen::MatrixXd H_R_big = Eigen::MatrixXd::Zero(total_new, total_vars);
+  Eigen::MatrixXd H_Linv_big = Eigen::MatrixXd::Zero(total_new, total_new);
+  Eigen::MatrixXd R_big = Eigen::MatrixXd::Zero(total_new, total_new);
+  Eigen::VectorXd res_big = Eigen::VectorXd::Zero(total_new);
+  Eigen::MatrixXd Hup_big = Eigen::MatrixXd::Zero(total_up, total_vars);
+  Eigen::MatrixXd Rup_big = Eigen::MatrixXd::Zero(total_up, total_up);
+  Eigen::VectorXd resup_big = Eigen::VectorXd::Zero(total_up);
+  std::vector<int> new_ids(num_vars, -1);
+  int ct_new = 0;
+  int ct_up = 0;
+  for (size_t v = 0; v < num_vars; v++) {
+    if (!accepted.at(v))
+      continue;
+    int var_size = new_variables.at(v)->size();
+    int up_size = Hups.at(v).rows();
+    int ct_col = 0;
+    for (const auto &var : H_orders.at(v)) {
+      size_t idx = std::find(H_order_big.begin(), H_order_big.end(), var) - H_order_big.begin();
+      H_R_big.block(ct_new, H_id_big.at(idx), var_size, var->size()) = Hxinits.at(v).block(0, ct_col, var_size, var->size());
+      Hup_big.block(ct_up, H_id_big.at(idx), up_size, var->size()) = Hups.at(v).block(0, ct_col, up_size, var->size());
+      ct_col += var->size();
+    }
+    assert(H_finits.at(v).rows() == H_finits.at(v).cols());
+    H_Linv_big.block(ct_new, ct_new, var_size, var_size) = H_finits.at(v).inverse();
+    R_big.block(ct_new, ct_new, var_size, var_size) = Rinits.at(v);
+    res_big.segment(ct_new, var_size) = resinits.at(v);
+    Rup_big.block(ct_up, ct_up, up_size, up_size) = Rups.at(v);
+    resup_big.segment(ct_up, up_size) = resups.at(v);
+    new_ids.at(v) = ct_new;
+    ct_new += var_size;
+    ct_up += up_size;
+  }
+
+  //==========================================================
+  //==========================================================
+  // For each active variable find its M = P*H^T for all new variables at once
+  Eigen::MatrixXd M_a = Eigen::MatrixXd::Zero(state->_Cov.rows(), total_new);
+  for (const auto &var : state->_variables) {
+    Eigen::MatrixXd M_i = Eigen::MatrixXd::Zero(var->size(), total_new);
+    for (size_t i = 0; i < H_order_big.size(); i++) {
+      std::shared_ptr<Type> meas_var = H_order_big.at(i);
+      M_i += state->_Cov.block(var->id(), meas_var->id(), var->size(), meas_var->size()) *
+             H_R_big.block(0, H_id_big[i], total_new, meas_var->size()).transpose();
+    }
+    M_a.block(var->id(), 0, var->size(), total_new) = M_i;
+  }
+
+  // M = H_R*Cov*H_R' + R, this also contains the correlations between the new variables
+  Eigen::MatrixXd P_small = StateHelper::get_marginal_covariance(state, H_order_big);
+  Eigen::MatrixXd M(total_new, total_new);
+  M.triangularView<Eigen::Upper>() = H_R_big * P_small * H_R_big.transpose();
+  M.triangularView<Eigen::Upper>() += R_big;
+  Eigen::MatrixXd P_LL = H_Linv_big * M.selfadjointView<Eigen::Upper>() * H_Linv_big.transpose();
+
+  // Augment the covariance matrix a single time
+  size_t oldSize = state->_Cov.rows();
+  state->_Cov.conservativeResizeLike(Eigen::MatrixXd::Zero(oldSize + total_new, oldSize + total_new));
+  state->_Cov.block(0, oldSize, oldSize, total_new).noalias() = -M_a * H_Linv_big.transpose();
+  state->_Cov.block(oldSize, 0, total_new, oldSize) = state->_Cov.block(0, oldSize, oldSize, total_new).transpose();
+  state->_Cov.block(oldSize, oldSize, total_new, total_new) = P_LL;
+
+  // Update the new variables and add them to the state variables
+  for (size_t v = 0; v < num_vars; v++) {
+    if (!accepted.at(v))
+      continue;
+    int var_size = new_variables.at(v)->size();
+    new_variables.at(v)->update(H_Linv_big.block(new_ids.at(v), new_ids.at(v), var_size, var_size) * res_big.segment(new_ids.at(v), var_size));
+    new_variables.at(v)->set_local_id(oldSize + new_ids.at(v));
+    state->_variables.push_back(new_variables.at(v));
+  }
+
+  // Update with all updating portions at once
+  if (Hup_big.rows() > 0) {
+    StateHelper::EKFUpdate(state, H_order_big, Hup_big, resup_big, Rup_big);
+  }
+  return accepted;
+}
+
 void StateHelper::initialize_invertible(std::shared_ptr<State> state, std::shared_ptr<Type> new_variable,
                                         const std::vector<std::shared_ptr<Type>> &H_order, const Eigen::MatrixXd &H_R,
                                         const Eigen::MatrixXd &H_L, const Eigen::MatrixXd &R, const Eigen::VectorXd &res) {
@@ -637,6 +838,8 @@ void StateHelper::augment_clone(std::shared_ptr<State> state,
                                 Eigen::Matrix<double, 3, 1> last_w) 
 {
 
+  OV_TRACE_SCOPE("augment clone");
+
   // We can't insert a clone that occured at the same timestamp!
   if (state->_clones_IMU.find(state->_timestamp) != state->_clones_IMU.end()) {
     PRINT_ERROR(RED "TRIED TO INSERT A CLONE AT THE SAME TIME AS AN EXISTING CLONE, EXITING!#!@#!@#\n" RESET);
@@ -683,6 +886,7 @@ void StateHelper::augment_clone(std::shared_ptr<State> state,
 }
 
 void StateHelper::marginalize_old_clone(std::shared_ptr<State> state) {
+  OV_TRACE_SCOPE("marginalize old clone");
   if ((int)state->_clones_IMU.size() > state->_options.max_clone_size) {
     double marginal_time = state->margtimestep();
     // Lock the mutex to avoid deleting any elements from _clones_IMU while accessing it from other threads
@@ -696,6 +900,7 @@ void StateHelper::marginalize_old_clone(std::shared_ptr<State> state) {
 }
 
 void StateHelper::marginalize_slam(std::shared_ptr<State> state) {
+  OV_TRACE_SCOPE("marginalize slam");
   // Remove SLAM features that have their marginalization flag set
   // We also check that we do not remove any aruoctag landmarks
   int ct_marginalized = 0;
@@ -709,4 +914,163 @@ void StateHelper::marginalize_slam(std::shared_ptr<State> state) {
       it0++;
     }
   }
-}
\ No newline at end of file
+}
+void StateHelper::save_checkpoint(std::shared_ptr<State> state, std::ostream &out) {
+
+  // Find which of our variables are clones and SLAM features
+  std::map<std::shared_ptr<Type>, double> clone_times;
+  for (const auto &clone : state->_clones_IMU) {
+    clone_times.insert({clone.second, clone.first});
+  }
+  std::map<std::shared_ptr<Type>, std::shared_ptr<Landmark>> landmarks;
+  for (const auto &feat : state->_features_SLAM) {
+    landmarks.insert({feat.second, feat.second});
+  }
+
+  // Write each variable in order, the type tells us if it was a base variable (0), clone (1) or SLAM feature (2)
+  binary_io::write(out, state->_timestamp);
+  binary_io::write(out, (uint64_t)state->_variables.size());
+  for (const auto &var : state->_variables) {
+    if (clone_times.find(var) != clone_times.end()) {
+      binary_io::write(out, (uint8_t)1);
+      binary_io::write(out, clone_times.at(var));
+    } else if (landmarks.find(var) != landmarks.end()) {
+      std::shared_ptr<Landmark> landmark = landmarks.at(var);
+      binary_io::write(out, (uint8_t)2);
+      binary_io::write(out, (uint64_t)landmark->_featid);
+      binary_io::write(out, (int32_t)landmark->_unique_camera_id);
+      binary_io::write(out, (int32_t)landmark->_anchor_cam_id);
+      binary_io::write(out, landmark->_anchor_clone_timestamp);
+      binary_io::write(out, landmark->has_had_anchor_change);
+      binary_io::write(out, landmark->should_marg);
+      binary_io::write(out, (int32_t)landmark->update_fail_count);
+      binary_io::write_matrix(out, landmark->uv_norm_zero);
+      binary_io::write_matrix(out, landmark->uv_norm_zero_fej);
+      binary_io::write(out, (int32_t)landmark->_feat_representation);
+    } else {
+      binary_io::write(out, (uint8_t)0);
+    }
+    binary_io::write(out, (int32_t)var->id());
+    binary_io::write(out, (int32_t)var->size());
+    binary_io::write_matrix(out, var->value());
+    binary_io::write_matrix(out, var->fej());
+  }
+
+  // Finally the upper triangular of the covariance
+  int size = (int)state->_Cov.rows();
+  binary_io::write(out, (int32_t)size);
+  for (int r = 0; r < size; r++) {
+    out.write(reinterpret_cast<const char *>(state->_Cov.col(r).data()), (std::streamsize)(sizeof(double) * (r + 1)));
+  }
+}
+
+bool StateHelper::load_checkpoint(std::shared_ptr<State> state, std::istream &in) {
+
+  // We should have a fresh state, whose variables are the base ones we will find first
+  if (!state->_clones_IMU.empty() || !state->_features_SLAM.empty()) {
+    PRINT_ERROR(RED "[CHECKPOINT]: can only load into a state without clones or SLAM features\n" RESET);
+    return false;
+  }
+  size_t num_base = state->_variables.size();
+
+  // Read each of our variables
+  double timestamp;
+  uint64_t num_vars;
+  if (!binary_io::read(in, timestamp) || !binary_io::read(in, num_vars) || num_vars < num_base)
+    return false;
+  std::map<double, std::shared_ptr<PoseJPL>> clones;
+  std::unordered_map<size_t, std::shared_ptr<Landmark>> features;
+  std::vector<std::shared_ptr<Type>> variables;
+  std::vector<Eigen::MatrixXd> values, fejs;
+  int size_total = 0;
+  for (uint64_t i = 0; i < num_vars; i++) {
+    uint8_t type;
+    if (!binary_io::read(in, type))
+      return false;
+    std::shared_ptr<Type> var;
+    double clone_time = -1;
+    if (type == 0 && i < num_base) {
+      var = state->_variables.at(i);
+    } else if (type == 1 && i >= num_base) {
+      if (!binary_io::read(in, clone_time))
+        return false;
+      var = std::make_shared<PoseJPL>();
+    } else if (type == 2 && i >= num_base) {
+      uint64_t featid;
+      int32_t unique_camera_id, anchor_cam_id, update_fail_count, representation;
+      Eigen::Vector3d uv_norm_zero, uv_norm_zero_fej;
+      bool has_had_anchor_change, should_marg;
+      double anchor_clone_timestamp;
+      if (!binary_io::read(in, featid) || !binary_io::read(in, unique_camera_id) || !binary_io::read(in, anchor_cam_id) ||
+          !binary_io::read(in, anchor_clone_timestamp) || !binary_io::read(in, has_had_anchor_change) || !binary_io::read(in, should_marg) ||
+          !binary_io::read(in, update_fail_count) || !binary_io::read_matrix(in, uv_norm_zero) ||
+          !binary_io::read_matrix(in, uv_norm_zero_fej) || !binary_io::read(in, representation))
+        return false;
+      auto rep = (LandmarkRepresentation::Representation)representation;
+      auto landmark = std::make_shared<Landmark>((rep == LandmarkRepresentation::Representation::ANCHORED_INVERSE_DEPTH_SINGLE) ? 1 : 3);
+      landmark->_featid = (size_t)featid;
+      landmark->_unique_camera_id = unique_camera_id;
+      landmark->_anchor_cam_id = anchor_cam_id;
+      landmark->_anchor_clone_timestamp = anchor_clone_timestamp;
+      landmark->has_had_anchor_change = has_had_anchor_change;
+      landmark->should_marg = should_marg;
+      landmark->update_fail_count = update_fail_count;
+      landmark->uv_norm_zero = uv_norm_zero;
+      landmark->uv_norm_zero_fej = uv_norm_zero_fej;
+      landmark->_feat_representation = rep;
+      features.insert({landmark->_featid, landmark});
+      var = landmark;
+    } else {
+      PRINT_ERROR(RED "[CHECKPOINT]: variable %d has type %d which does not match our state\n" RESET, (int)i, (int)type);
+      return false;
+    }
+    int32_t id, size;
+    Eigen::MatrixXd value, fej;
+    if (!binary_io::read(in, id) || !binary_io::read(in, size) || !binary_io::read_matrix(in, value) || !binary_io::read_matrix(in, fej))
+      return false;
+    if (size != var->size() || id != size_total || value.rows() != var->value().rows() || fej.rows() != var->fej().rows()) {
+      PRINT_ERROR(RED "[CHECKPOINT]: variable %d has size %d (expected %d), was it saved with different options?\n" RESET, (int)i, (int)size,
+                  var->size());
+      return false;
+    }
+    if (clone_time >= 0) {
+      clones.insert({clone_time, std::dynamic_pointer_cast<PoseJPL>(var)});
+    }
+    variables.push_back(var);
+    values.push_back(value);
+    fejs.push_back(fej);
+    size_total += size;
+  }
+
+  // Read the covariance, and fill in the lower triangular
+  int32_t size;
+  if (!binary_io::read(in, size) || size != size_total)
+    return false;
+  Eigen::MatrixXd Cov = Eigen::MatrixXd::Zero(size, size);
+  for (int r = 0; r < size; r++) {
+    in.read(reinterpret_cast<char *>(Cov.col(r).data()), (std::streamsize)(sizeof(double) * (r + 1)));
+  }
+  if (!in.good())
+    return false;
+  Cov = Cov.selfadjointView<Eigen::Upper>();
+
+  // Everything has been read, so we can now set our state
+  // NOTE: our camera models need to be updated with the intrinsics we have loaded
+  std::lock_guard<std::mutex> lock(state->_mutex_state);
+  int ct = 0;
+  for (size_t i = 0; i < variables.size(); i++) {
+    variables.at(i)->set_local_id(ct);
+    variables.at(i)->set_value(values.at(i));
+    variables.at(i)->set_fej(fejs.at(i));
+    ct += variables.at(i)->size();
+  }
+  state->_timestamp = timestamp;
+  state->_variables = variables;
+  state->_clones_IMU = clones;
+  state->_features_SLAM = features;
+  state->_Cov = Cov;
+  for (const auto &cam : state->_cam_intrinsics) {
+    state->_cam_intrinsics_cameras.at(cam.first)->set_value(cam.second->value());
+  }
+  return true;
+}
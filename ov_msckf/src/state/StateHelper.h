@@ -23,7 +23,9 @@
 #define OV_MSCKF_STATE_HELPER_H
 
 #include <Eigen/Eigen>
+#include <istream>
 #include <memory>
+#include <ostream>
 
 namespace ov_type {
 class Type;
@@ -49,7 +51,8 @@ public:
    * @brief Performs EKF propagation of the state covariance.
    *
    * The mean of the state should already have been propagated, thus just moves the covariance forward in time.
-   * The new states that we are propagating the old covariance into, should be **contiguous** in memory.
+   * The new states that we are propagating the old covariance into are typically **contiguous** in memory (e.g. the IMU).
+   * Non-contiguous new states are also supported (e.g. a batch of landmarks), which are then written back one by one.
    * The user only needs to specify the sub-variables that this block is a function of.
    * \f[
    * \tilde{\mathbf{x}}' =
@@ -68,7 +71,7 @@ public:
    * \f]
    * 
    * @param state Pointer to state
-   * @param order_NEW Contiguous variables that have evolved according to this state transition
+   * @param order_NEW Variables that have evolved according to this state transition
    * @param order_OLD Variable ordering used in the state transition
    * @param Phi Variable ordering used in the state transition
    * @param Q Additive state propagation noise matrix (size order_NEW by size order_NEW)
@@ -171,6 +174,30 @@ public:
                          const std::vector<std::shared_ptr<ov_type::Type>> &H_order, Eigen::MatrixXd &H_R, Eigen::MatrixXd &H_L,
                          Eigen::MatrixXd &R, Eigen::VectorXd &res, double chi_2_mult);
 
+  /**
+   * @brief Initializes a batch of new variables into covariance.
+   *
+   * Same as calling initialize() for each variable, but all systems are first separated with Givens and chi2 gated
+   * against the current covariance. The accepted variables are then appended in a single covariance growth and their
+   * cross terms are computed together, followed by a single update with all of the nullspace projected updating systems.
+   * Each H_L needs to be in respect to its own variable only (i.e. the new variables are independent of each other).
+   *
+   * @param state Pointer to state
+   * @param new_variables Pointers to variables to be initialized
+   * @param H_orders Vector of pointers in order they are contained in the condensed state Jacobian of each system
+   * @param H_Rs Jacobians of initializing measurements wrt variables in H_order
+   * @param H_Ls Jacobians of initializing measurements wrt each new variable
+   * @param Rs Covariance of initializing measurements (isotropic)
+   * @param ress Residuals of initializing measurements
+   * @param chi_2_mults Value we should multiply the chi2 threshold by for each system
+   * @return If each new variable passed the chi2 test and was initialized
+   */
+  static std::vector<bool> initialize_batch(std::shared_ptr<State> state, const std::vector<std::shared_ptr<ov_type::Type>> &new_variables,
+                                            const std::vector<std::vector<std::shared_ptr<ov_type::Type>>> &H_orders,
+                                            std::vector<Eigen::MatrixXd> &H_Rs, std::vector<Eigen::MatrixXd> &H_Ls,
+                                            std::vector<Eigen::MatrixXd> &Rs, std::vector<Eigen::VectorXd> &ress,
+                                            const std::vector<double> &chi_2_mults);
+
   /**
    * @brief Initializes new variable into covariance (H_L must be invertible)
    *
@@ -234,6 +261,31 @@ public:
    */
   static void marginalize_slam(std::shared_ptr<State> state);
 
+  /**
+   * @brief Writes the full state (all variables, their first estimates and the covariance) in binary to the stream
+   *
+   * Variables are written in the order they are in the covariance.
+   * For clones we also write their timestamp and for SLAM features all of their landmark information.
+   * Only the upper triangular of the covariance is written since it is symmetric.
+   *
+   * @param state Pointer to state
+   * @param out Stream we will write to
+   */
+  static void save_checkpoint(std::shared_ptr<State> state, std::ostream &out);
+
+  /**
+   * @brief Restores a state that was written with save_checkpoint()
+   *
+   * The state should have just been constructed with the same options as the one that was saved.
+   * Thus its variables (imu and calibration) will be the same as the first ones in the file.
+   * The clones and SLAM features are then re-created, and the covariance is set.
+   *
+   * @param state Pointer to state
+   * @param in Stream we will read from
+   * @return True if the state could be restored (the state should not be used if false)
+   */
+  static bool load_checkpoint(std::shared_ptr<State> state, std::istream &in);
+
 private:
   /**
    * All function in this class should be static.
@@ -0,0 +1,167 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FeatureSelector.h"
+
+#include "cam/CamBase.h"
+#include "feat/Feature.h"
+#include "state/State.h"
+#include "types/PoseJPL.h"
+#include "utils/print.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+
+using namespace ov_core;
+using namespace ov_type;
+using namespace ov_msckf;
+
+FeatureSelector::FeatureSelector(const FeatureSelectorOptions &options) : _options(options) {
+  _budget_ms = _options.budget_ms;
+  _cost_per_row_ms = _options.cost_per_row_ms;
+}
+
+size_t FeatureSelector::select(std::shared_ptr<State> state, std::vector<std::shared_ptr<Feature>> &feature_vec, int max_features) {
+
+  // Return if no features
+  if (feature_vec.empty() || max_features <= 0) {
+    feature_vec.clear();
+    return 0;
+  }
+
+  // Bearing of a normalized measurement in the global frame (rotation only)
+  // If we do not have the clone we will just return the bearing in the camera frame
+  auto bearing_in_global = [&](size_t cam_id, double timestamp, const Eigen::Vector2f &uv_norm) -> Eigen::Vector3d {
+    Eigen::Vector3d b_inC;
+    b_inC << (double)uv_norm(0), (double)uv_norm(1), 1.0;
+    b_inC.normalize();
+    auto it_clone = state->_clones_IMU.find(timestamp);
+    if (it_clone == state->_clones_IMU.end())
+      return b_inC;
+    Eigen::Matrix3d R_GtoC = state->_calib_IMUtoCAM.at(cam_id)->Rot() * it_clone->second->Rot();
+    return R_GtoC.transpose() * b_inC;
+  };
+
+  // Compute the base score and grid cell of each feature
+  // Information is the number of rows after the nullspace projection, and the parallax weight saturates at one
+  const double parallax_ref = std::max(_options.parallax_ref_deg, 1e-3) * M_PI / 180.0;
+  const int grid_x = std::max(_options.grid_x, 1);
+  const int grid_y = std::max(_options.grid_y, 1);
+  std::vector<double> scores(feature_vec.size(), 0.0);
+  std::vector<size_t> rows(feature_vec.size(), 0);
+  std::vector<size_t> cells(feature_vec.size(), 0);
+  for (size_t i = 0; i < feature_vec.size(); i++) {
+    const std::shared_ptr<Feature> &feat = feature_vec.at(i);
+    size_t num_meas = 0;
+    double parallax = 0.0;
+    double newest_time = -1;
+    size_t newest_cam = 0;
+    Eigen::Vector2f newest_uv;
+    for (const auto &pair : feat->timestamps) {
+      size_t cam_id = pair.first;
+      const std::vector<double> &times = pair.second;
+      num_meas += times.size();
+      if (times.empty())
+        continue;
+      const std::vector<Eigen::Vector2f> &uvs_norm = feat->uvs_norm.at(cam_id);
+      Eigen::Vector3d b0 = bearing_in_global(cam_id, times.front(), uvs_norm.front());
+      Eigen::Vector3d b1 = bearing_in_global(cam_id, times.back(), uvs_norm.back());
+      parallax = std::max(parallax, std::acos(std::min(1.0, std::max(-1.0, b0.dot(b1)))));
+      if (times.back() > newest_time) {
+        newest_time = times.back();
+        newest_cam = cam_id;
+        newest_uv = feat->uvs.at(cam_id).back();
+      }
+    }
+    rows.at(i) = (num_meas > 1) ? 2 * num_meas - 3 : 0;
+    scores.at(i) = (double)rows.at(i) * parallax / (parallax + parallax_ref);
+
+    // Grid cell of the newest observation, each camera has its own grid
+    size_t cell = newest_cam * (size_t)(grid_x * grid_y);
+    if (newest_time != -1 && state->_cam_intrinsics_cameras.find(newest_cam) != state->_cam_intrinsics_cameras.end()) {
+      std::shared_ptr<CamBase> cam = state->_cam_intrinsics_cameras.at(newest_cam);
+      int x = (int)std::floor((double)newest_uv(0) / std::max(cam->w(), 1) * grid_x);
+      int y = (int)std::floor((double)newest_uv(1) / std::max(cam->h(), 1) * grid_y);
+      x = std::min(std::max(x, 0), grid_x - 1);
+      y = std::min(std::max(y, 0), grid_y - 1);
+      cell += (size_t)(y * grid_x + x);
+    }
+    cells.at(i) = cell;
+  }
+
+  // Lazy greedy selection, the score of a feature can only decrease as its cell fills up
+  // Thus we only need to re-score the top of the queue if its cell has changed since it was last scored
+  // Ties are broken by the feature id so the selection is deterministic
+  struct Candidate {
+    double score;
+    size_t idx;
+    size_t cell_count;
+  };
+  auto compare = [&](const Candidate &a, const Candidate &b) -> bool {
+    if (a.score != b.score)
+      return a.score < b.score;
+    return feature_vec.at(a.idx)->featid > feature_vec.at(b.idx)->featid;
+  };
+  std::priority_queue<Candidate, std::vector<Candidate>, decltype(compare)> queue(compare);
+  for (size_t i = 0; i < feature_vec.size(); i++) {
+    queue.push({scores.at(i), i, 0});
+  }
+  std::unordered_map<size_t, size_t> cell_counts;
+  std::vector<std::shared_ptr<Feature>> selected;
+  size_t selected_rows = 0;
+  bool hit_budget = false;
+  while (!queue.empty() && (int)selected.size() < max_features) {
+    Candidate top = queue.top();
+    queue.pop();
+    auto it_cell = cell_counts.find(cells.at(top.idx));
+    size_t count = (it_cell == cell_counts.end()) ? 0 : it_cell->second;
+    if (count != top.cell_count) {
+      top.score = scores.at(top.idx) * std::pow(_options.coverage_decay, (double)count);
+      top.cell_count = count;
+      queue.push(top);
+      continue;
+    }
+    // Always allow at least one feature, otherwise stop once we would be over budget
+    if (_budget_ms > 0 && !selected.empty() && predict_cost_ms(selected_rows + rows.at(top.idx)) > _budget_ms) {
+      hit_budget = true;
+      break;
+    }
+    selected.push_back(feature_vec.at(top.idx));
+    selected_rows += rows.at(top.idx);
+    cell_counts[cells.at(top.idx)]++;
+  }
+
+  // Debug print
+  PRINT_ALL("[SELECT]: %d of %d features selected in %d cells (%d rows, %.2f ms predicted%s)\n", (int)selected.size(),
+            (int)feature_vec.size(), (int)cell_counts.size(), (int)selected_rows, predict_cost_ms(selected_rows),
+            (hit_budget) ? ", budget limited" : "");
+  feature_vec = selected;
+  return selected_rows;
+}
+
+void FeatureSelector::update_latency_model(size_t num_rows, double elapsed_ms) {
+  if (num_rows == 0 || _options.cost_learning_rate <= 0)
+    return;
+  double per_row = std::max(0.0, elapsed_ms - _options.cost_base_ms) / (double)num_rows;
+  _cost_per_row_ms = (1.0 - _options.cost_learning_rate) * _cost_per_row_ms + _options.cost_learning_rate * per_row;
+}
@@ -0,0 +1,96 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_MSCKF_FEATURE_SELECTOR_H
+#define OV_MSCKF_FEATURE_SELECTOR_H
+
+#include <Eigen/Eigen>
+#include <memory>
+#include <vector>
+
+#include "FeatureSelectorOptions.h"
+
+namespace ov_core {
+class Feature;
+} // namespace ov_core
+
+namespace ov_msckf {
+
+class State;
+
+/**
+ * @brief Selects the subset of MSCKF features that should be used in an update.
+ *
+ * Each candidate is given a score that combines the expected information (number of measurement rows after the
+ * nullspace projection) with its rotation-compensated parallax. A greedy selection then penalizes features that
+ * fall into image grid cells which already have selected features, which favours an even distribution in the FOV.
+ * Selection stops once either the maximum number of features is reached or a simple latency model predicts that
+ * the update will exceed the configured per-frame time budget. The latency model is refined online from the
+ * measured update times reported through update_latency_model().
+ */
+class FeatureSelector {
+
+public:
+  /**
+   * @brief Default constructor
+   * @param options Selection options (grid size, budget, latency model)
+   */
+  FeatureSelector(const FeatureSelectorOptions &options);
+
+  /**
+   * @brief Selects the features we should update with, features not selected are removed from the vector
+   * @param state State of the filter (used for clone poses and camera resolution)
+   * @param feature_vec Candidate features, will be replaced by the selected subset
+   * @param max_features Hard maximum number of features to select
+   * @return Number of measurement rows we expect the selected features to contribute
+   */
+  size_t select(std::shared_ptr<State> state, std::vector<std::shared_ptr<ov_core::Feature>> &feature_vec, int max_features);
+
+  /**
+   * @brief Refines the latency model given how long the last update took
+   * @param num_rows Number of measurement rows returned by the last select() call
+   * @param elapsed_ms Measured time of the update in milliseconds
+   */
+  void update_latency_model(size_t num_rows, double elapsed_ms);
+
+  /// Predicted cost in milliseconds of an update with the given number of rows
+  double predict_cost_ms(size_t num_rows) const { return _options.cost_base_ms + _cost_per_row_ms * (double)num_rows; }
+
+  /// Override the per-frame time budget (non-positive disables it)
+  void set_budget_ms(double budget_ms) { _budget_ms = budget_ms; }
+
+  /// Current per-frame time budget in milliseconds
+  double get_budget_ms() const { return _budget_ms; }
+
+protected:
+  /// Options used for selection
+  FeatureSelectorOptions _options;
+
+  /// Current time budget in milliseconds
+  double _budget_ms;
+
+  /// Current estimate of the cost of a single measurement row
+  double _cost_per_row_ms;
+};
+
+} // namespace ov_msckf
+
+#endif // OV_MSCKF_FEATURE_SELECTOR_H
@@ -0,0 +1,85 @@
+/*
+ * OpenVINS: An Open Platform for Visual-Inertial Research
+ * Copyright (C) 2018-2023 Patrick Geneva
+ * Copyright (C) 2018-2023 Guoquan Huang
+ * Copyright (C) 2018-2023 OpenVINS Contributors
+ * Copyright (C) 2018-2019 Kevin Eckenhoff
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OV_MSCKF_FEATURE_SELECTOR_OPTIONS_H
+#define OV_MSCKF_FEATURE_SELECTOR_OPTIONS_H
+
+#include <memory>
+
+#include "utils/opencv_yaml_parse.h"
+#include "utils/print.h"
+
+namespace ov_msckf {
+
+/**
+ * @brief Struct which stores options for selecting which MSCKF features to update with
+ */
+struct FeatureSelectorOptions {
+
+  /// Time budget in milliseconds for the MSCKF update each frame (non-positive disables the budget)
+  double budget_ms = -1.0;
+
+  /// Number of grid cells in the x-direction used to reward image coverage
+  int grid_x = 8;
+
+  /// Number of grid cells in the y-direction used to reward image coverage
+  int grid_y = 6;
+
+  /// Multiplicative score decay applied for every feature already selected in the same grid cell
+  double coverage_decay = 0.5;
+
+  /// Parallax angle (degrees) at which a feature gets half of its parallax weight
+  double parallax_ref_deg = 1.0;
+
+  /// Fixed cost (ms) of an MSCKF update regardless of the number of features
+  double cost_base_ms = 0.5;
+
+  /// Initial cost (ms) of a single measurement row (refined online from measured update times)
+  double cost_per_row_ms = 0.002;
+
+  /// Smoothing factor of the online latency model refinement (zero disables learning)
+  double cost_learning_rate = 0.1;
+
+  /// Nice print function of what parameters we have loaded
+  void print(const std::shared_ptr<ov_core::YamlParser> &parser = nullptr) {
+    if (parser != nullptr) {
+      parser->parse_config("msckf_select_budget_ms", budget_ms, false);
+      parser->parse_config("msckf_select_grid_x", grid_x, false);
+      parser->parse_config("msckf_select_grid_y", grid_y, false);
+      parser->parse_config("msckf_select_coverage_decay", coverage_decay, false);
+      parser->parse_config("msckf_select_parallax_ref_deg", parallax_ref_deg, false);
+      parser->parse_config("msckf_select_cost_base_ms", cost_base_ms, false);
+      parser->parse_config("msckf_select_cost_per_row_ms", cost_per_row_ms, false);
+      parser->parse_config("msckf_select_cost_learning_rate", cost_learning_rate, false);
+    }
+    PRINT_DEBUG("  - msckf_select_budget_ms: %.2f\n", budget_ms);
+    PRINT_DEBUG("  - msckf_select_grid: %d x %d\n", grid_x, grid_y);
+    PRINT_DEBUG("  - msckf_select_coverage_decay: %.2f\n", coverage_decay);
+    PRINT_DEBUG("  - msckf_select_parallax_ref_deg: %.2f\n", parallax_ref_deg);
+    PRINT_DEBUG("  - msckf_select_cost_base_ms: %.3f\n", cost_base_ms);
+    PRINT_DEBUG("  - msckf_select_cost_per_row_ms: %.4f\n", cost_per_row_ms);
+    PRINT_DEBUG("  - msckf_select_cost_learning_rate: %.2f\n", cost_learning_rate);
+  }
+};
+
+} // namespace ov_msckf
+
+#endif // OV_MSCKF_FEATURE_SELECTOR_OPTIONS_H
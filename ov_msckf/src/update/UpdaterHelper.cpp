@@ -486,3 +486,32 @@ void UpdaterHelper::measurement_compress_inplace(Eigen::MatrixXd &H_x, Eigen::Ve
   H_x.conservativeResize(r, H_x.cols());
   res.conservativeResize(r, res.cols());
 }
+
+void UpdaterHelper::get_clone_poses(std::shared_ptr<State> state, ov_core::FeatureInitializer::ClonePoseTable &clones_cam) {
+
+  // Cameras and clone times of our table (clones are ordered by time)
+  std::vector<size_t> cam_ids;
+  for (const auto &clone_calib : state->_calib_IMUtoCAM)
+    cam_ids.push_back(clone_calib.first);
+  std::vector<double> clone_times;
+  for (const auto &clone_imu : state->_clones_IMU)
+    clone_times.push_back(clone_imu.first);
+  clones_cam.reset(cam_ids, clone_times);
+
+  // For each camera, set the camera poses
+  size_t cam_idx = 0;
+  for (const auto &clone_calib : state->_calib_IMUtoCAM) {
+    size_t clone_idx = 0;
+    for (const auto &clone_imu : state->_clones_IMU) {
+
+      // Get current camera pose
+      Eigen::Matrix<double, 3, 3> R_GtoCi = clone_calib.second->Rot() * clone_imu.second->Rot();
+      Eigen::Matrix<double, 3, 1> p_CioinG = clone_imu.second->pos() - R_GtoCi.transpose() * clone_calib.second->pos();
+
+      // Append to our table
+      clones_cam.at(cam_idx, clone_idx) = ov_core::FeatureInitializer::ClonePose(R_GtoCi, p_CioinG);
+      clone_idx++;
+    }
+    cam_idx++;
+  }
+}
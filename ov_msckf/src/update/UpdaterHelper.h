@@ -26,6 +26,8 @@
 #include <memory>
 #include <unordered_map>
 
+#include "feat/Feature.h"
+#include "feat/FeatureInitializer.h"
 #include "types/LandmarkRepresentation.h"
 
 namespace ov_type {
@@ -57,13 +59,13 @@ public:
     size_t featid;
 
     /// UV coordinates that this feature has been seen from (mapped by camera ID)
-    std::unordered_map<size_t, std::vector<Eigen::VectorXf>> uvs;
+    ov_core::CameraMap<Eigen::Vector2f> uvs;
 
     // UV normalized coordinates that this feature has been seen from (mapped by camera ID)
-    std::unordered_map<size_t, std::vector<Eigen::VectorXf>> uvs_norm;
+    ov_core::CameraMap<Eigen::Vector2f> uvs_norm;
 
     /// Timestamps of each UV measurement (mapped by camera ID)
-    std::unordered_map<size_t, std::vector<double>> timestamps;
+    ov_core::CameraMap<double> timestamps;
 
     /// What representation our feature is in
     ov_type::LandmarkRepresentation::Representation feat_representation;
@@ -135,6 +137,16 @@ public:
    * @param res Measurement residual
    */
   static void measurement_compress_inplace(Eigen::MatrixXd &H_x, Eigen::VectorXd &res);
+
+  /**
+   * @brief Gets the pose of each camera at each of our clone timesteps
+   *
+   * This should be called once per update, then all features are triangulated using this table.
+   *
+   * @param state State of the filter system
+   * @param clones_cam Table of camera poses (rotation from global to camera, position of camera in global frame)
+   */
+  static void get_clone_poses(std::shared_ptr<State> state, ov_core::FeatureInitializer::ClonePoseTable &clones_cam);
 };
 
 } // namespace ov_msckf
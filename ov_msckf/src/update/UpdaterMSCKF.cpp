@@ -29,10 +29,11 @@
 #include "state/StateHelper.h"
 #include "types/LandmarkRepresentation.h"
 #include "utils/colors.h"
+#include "utils/metrics.h"
 #include "utils/print.h"
 #include "utils/quat_ops.h"
+#include "utils/trace.h"
 
-#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/math/distributions/chi_squared.hpp>
 
 using namespace ov_core;
@@ -55,6 +56,13 @@ UpdaterMSCKF::UpdaterMSCKF(UpdaterOptions &options, ov_core::FeatureInitializerO
   }
 }
 
+void UpdaterMSCKF::set_metrics(const std::shared_ptr<ov_core::MetricsRegistry> &metrics) {
+  metric_accepted = metrics->counter("ov_msckf_msckf_features_accepted_total", "MSCKF features which passed chi2 and where used in the update");
+  metric_failed_triangulation =
+      metrics->counter("ov_msckf_msckf_features_failed_triangulation_total", "MSCKF features which failed to triangulate");
+  metric_rejected_chi2 = metrics->counter("ov_msckf_msckf_features_rejected_chi2_total", "MSCKF features rejected by the chi2 test");
+}
+
 void UpdaterMSCKF::update(std::shared_ptr<State> state, std::vector<std::shared_ptr<Feature>> &feature_vec) {
 
   // Return if no features
@@ -62,8 +70,7 @@ void UpdaterMSCKF::update(std::shared_ptr<State> state, std::vector<std::shared_
     return;
 
   // Start timing
-  boost::posix_time::ptime rT0, rT1, rT2, rT3, rT4, rT5;
-  rT0 = boost::posix_time::microsec_clock::local_time();
+  TraceScope trace_clean("msckf clean");
 
   // 0. Get all timestamps our clones are at (and thus valid measurement times)
   std::vector<double> clonetimes;
@@ -92,35 +99,31 @@ void UpdaterMSCKF::update(std::shared_ptr<State> state, std::vector<std::shared_
       it0++;
     }
   }
-  rT1 = boost::posix_time::microsec_clock::local_time();
-
-  // 2. Create vector of cloned *CAMERA* poses at each of our clone timesteps
-  std::unordered_map<size_t, std::unordered_map<double, FeatureInitializer::ClonePose>> clones_cam;
-  for (const auto &clone_calib : state->_calib_IMUtoCAM) {
-
-    // For this camera, create the vector of camera poses
-    std::unordered_map<double, FeatureInitializer::ClonePose> clones_cami;
-    for (const auto &clone_imu : state->_clones_IMU) {
-
-      // Get current camera pose
-      Eigen::Matrix<double, 3, 3> R_GtoCi = clone_calib.second->Rot() * clone_imu.second->Rot();
-      Eigen::Matrix<double, 3, 1> p_CioinG = clone_imu.second->pos() - R_GtoCi.transpose() * clone_calib.second->pos();
+  double time_clean = trace_clean.stop();
+  TraceScope trace_tri("msckf triangulate");
 
-      // Append to our map
-      clones_cami.insert({clone_imu.first, FeatureInitializer::ClonePose(R_GtoCi, p_CioinG)});
-    }
-
-    // Append to our map
-    clones_cam.insert({clone_calib.first, clones_cami});
-  }
+  // 2. Create table of cloned *CAMERA* poses at each of our clone timesteps
+  FeatureInitializer::ClonePoseTable clones_cam;
+  UpdaterHelper::get_clone_poses(state, clones_cam);
 
   // 3. Try to triangulate all MSCKF or new SLAM features that have measurements
+  size_t num_before_tri = feature_vec.size();
+  // If enabled, we triangulate and refine all features together
+  std::vector<bool> success_batch;
+  if (initializer_feat->config().batch_features) {
+    initializer_feat->batch_triangulation(feature_vec, clones_cam, success_batch);
+  }
+  size_t idx_batch = 0;
   auto it1 = feature_vec.begin();
   while (it1 != feature_vec.end()) {
 
     // Triangulate the feature and remove if it fails
     bool success_tri = true;
-    if (initializer_feat->config().triangulate_1d) {
+    if (initializer_feat->config().batch_features) {
+      success_tri = success_batch.at(idx_batch++);
+    } else if (initializer_feat->warm_start(*it1, clones_cam)) {
+      success_tri = true;
+    } else if (initializer_feat->config().triangulate_1d) {
       success_tri = initializer_feat->single_triangulation_1d(*it1, clones_cam);
     } else {
       success_tri = initializer_feat->single_triangulation(*it1, clones_cam);
@@ -128,7 +131,7 @@ void UpdaterMSCKF::update(std::shared_ptr<State> state, std::vector<std::shared_
 
     // Gauss-newton refine the feature
     bool success_refine = true;
-    if (initializer_feat->config().refine_features) {
+    if (initializer_feat->config().refine_features && !initializer_feat->config().batch_features) {
       success_refine = initializer_feat->single_gaussnewton(*it1, clones_cam);
     }
 
@@ -140,7 +143,10 @@ void UpdaterMSCKF::update(std::shared_ptr<State> state, std::vector<std::shared_
     }
     it1++;
   }
-  rT2 = boost::posix_time::microsec_clock::local_time();
+  if (metric_failed_triangulation != nullptr)
+    metric_failed_triangulation->add(num_before_tri - feature_vec.size());
+  double time_tri = trace_tri.stop();
+  TraceScope trace_system("msckf create system");
 
   // Calculate the max possible measurement size
   size_t max_meas_size = 0;
@@ -166,6 +172,7 @@ void UpdaterMSCKF::update(std::shared_ptr<State> state, std::vector<std::shared_
   size_t ct_meas = 0;
 
   // 4. Compute linear system for each feature, nullspace project, and reject
+  size_t num_before_chi2 = feature_vec.size();
   auto it2 = feature_vec.begin();
   while (it2 != feature_vec.end()) {
 
@@ -254,7 +261,12 @@ void UpdaterMSCKF::update(std::shared_ptr<State> state, std::vector<std::shared_
     ct_meas += res.rows();
     it2++;
   }
-  rT3 = boost::posix_time::microsec_clock::local_time();
+  if (metric_accepted != nullptr && metric_rejected_chi2 != nullptr) {
+    metric_accepted->add(feature_vec.size());
+    metric_rejected_chi2->add(num_before_chi2 - feature_vec.size());
+  }
+  double time_system = trace_system.stop();
+  TraceScope trace_compress("msckf compress system");
 
   // We have appended all features to our Hx_big, res_big
   // Delete it so we do not reuse information
@@ -276,20 +288,21 @@ void UpdaterMSCKF::update(std::shared_ptr<State> state, std::vector<std::shared_
   if (Hx_big.rows() < 1) {
     return;
   }
-  rT4 = boost::posix_time::microsec_clock::local_time();
+  double time_compress = trace_compress.stop();
+  TraceScope trace_ekf("msckf update state");
 
   // Our noise is isotropic, so make it here after our compression
   Eigen::MatrixXd R_big = _options.sigma_pix_sq * Eigen::MatrixXd::Identity(res_big.rows(), res_big.rows());
 
   // 6. With all good features update the state
   StateHelper::EKFUpdate(state, Hx_order_big, Hx_big, res_big, R_big);
-  rT5 = boost::posix_time::microsec_clock::local_time();
+  double time_ekf = trace_ekf.stop();
 
   // Debug print timing information
-  PRINT_ALL("[MSCKF-UP]: %.4f seconds to clean\n", (rT1 - rT0).total_microseconds() * 1e-6);
-  PRINT_ALL("[MSCKF-UP]: %.4f seconds to triangulate\n", (rT2 - rT1).total_microseconds() * 1e-6);
-  PRINT_ALL("[MSCKF-UP]: %.4f seconds create system (%d features)\n", (rT3 - rT2).total_microseconds() * 1e-6, (int)feature_vec.size());
-  PRINT_ALL("[MSCKF-UP]: %.4f seconds compress system\n", (rT4 - rT3).total_microseconds() * 1e-6);
-  PRINT_ALL("[MSCKF-UP]: %.4f seconds update state (%d size)\n", (rT5 - rT4).total_microseconds() * 1e-6, (int)res_big.rows());
-  PRINT_ALL("[MSCKF-UP]: %.4f seconds total\n", (rT5 - rT1).total_microseconds() * 1e-6);
+  PRINT_ALL("[MSCKF-UP]: %.4f seconds to clean\n", time_clean);
+  PRINT_ALL("[MSCKF-UP]: %.4f seconds to triangulate\n", time_tri);
+  PRINT_ALL("[MSCKF-UP]: %.4f seconds create system (%d features)\n", time_system, (int)feature_vec.size());
+  PRINT_ALL("[MSCKF-UP]: %.4f seconds compress system\n", time_compress);
+  PRINT_ALL("[MSCKF-UP]: %.4f seconds update state (%d size)\n", time_ekf, (int)res_big.rows());
+  PRINT_ALL("[MSCKF-UP]: %.4f seconds total\n", time_tri + time_system + time_compress + time_ekf);
 }
@@ -32,6 +32,8 @@
 namespace ov_core {
 class Feature;
 class FeatureInitializer;
+class MetricCounter;
+class MetricsRegistry;
 } // namespace ov_core
 
 namespace ov_msckf {
@@ -67,6 +69,12 @@ public:
    */
   void update(std::shared_ptr<State> state, std::vector<std::shared_ptr<ov_core::Feature>> &feature_vec);
 
+  /**
+   * @brief Registers our counters of how many features pass or fail each step of the update
+   * @param metrics Registry we will count into
+   */
+  void set_metrics(const std::shared_ptr<ov_core::MetricsRegistry> &metrics);
+
 protected:
   /// Options used during update
   UpdaterOptions _options;
@@ -76,6 +84,9 @@ protected:
 
   /// Chi squared 95th percentile table (lookup would be size of residual)
   std::map<int, double> chi_squared_table;
+
+  /// Counters of the features we have used, failed to triangulate, and rejected by chi2 (null if not counting)
+  std::shared_ptr<ov_core::MetricCounter> metric_accepted, metric_failed_triangulation, metric_rejected_chi2;
 };
 
 } // namespace ov_msckf
@@ -32,8 +32,8 @@
 #include "utils/colors.h"
 #include "utils/print.h"
 #include "utils/quat_ops.h"
+#include "utils/trace.h"
 
-#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/math/distributions/chi_squared.hpp>
 
 using namespace ov_core;
@@ -65,8 +65,7 @@ void UpdaterSLAM::delayed_init(std::shared_ptr<State> state, std::vector<std::sh
     return;
 
   // Start timing
-  boost::posix_time::ptime rT0, rT1, rT2, rT3;
-  rT0 = boost::posix_time::microsec_clock::local_time();
+  TraceScope trace_clean("slam delayed clean");
 
   // 0. Get all timestamps our clones are at (and thus valid measurement times)
   std::vector<double> clonetimes;
@@ -95,35 +94,30 @@ void UpdaterSLAM::delayed_init(std::shared_ptr<State> state, std::vector<std::sh
       it0++;
     }
   }
-  rT1 = boost::posix_time::microsec_clock::local_time();
+  double time_clean = trace_clean.stop();
+  TraceScope trace_tri("slam delayed triangulate");
 
-  // 2. Create vector of cloned *CAMERA* poses at each of our clone timesteps
-  std::unordered_map<size_t, std::unordered_map<double, FeatureInitializer::ClonePose>> clones_cam;
-  for (const auto &clone_calib : state->_calib_IMUtoCAM) {
-
-    // For this camera, create the vector of camera poses
-    std::unordered_map<double, FeatureInitializer::ClonePose> clones_cami;
-    for (const auto &clone_imu : state->_clones_IMU) {
-
-      // Get current camera pose
-      Eigen::Matrix<double, 3, 3> R_GtoCi = clone_calib.second->Rot() * clone_imu.second->Rot();
-      Eigen::Matrix<double, 3, 1> p_CioinG = clone_imu.second->pos() - R_GtoCi.transpose() * clone_calib.second->pos();
-
-      // Append to our map
-      clones_cami.insert({clone_imu.first, FeatureInitializer::ClonePose(R_GtoCi, p_CioinG)});
-    }
-
-    // Append to our map
-    clones_cam.insert({clone_calib.first, clones_cami});
-  }
+  // 2. Create table of cloned *CAMERA* poses at each of our clone timesteps
+  FeatureInitializer::ClonePoseTable clones_cam;
+  UpdaterHelper::get_clone_poses(state, clones_cam);
 
   // 3. Try to triangulate all MSCKF or new SLAM features that have measurements
+  // If enabled, we triangulate and refine all features together
+  std::vector<bool> success_batch;
+  if (initializer_feat->config().batch_features) {
+    initializer_feat->batch_triangulation(feature_vec, clones_cam, success_batch);
+  }
+  size_t idx_batch = 0;
   auto it1 = feature_vec.begin();
   while (it1 != feature_vec.end()) {
 
     // Triangulate the feature and remove if it fails
     bool success_tri = true;
-    if (initializer_feat->config().triangulate_1d) {
+    if (initializer_feat->config().batch_features) {
+      success_tri = success_batch.at(idx_batch++);
+    } else if (initializer_feat->warm_start(*it1, clones_cam)) {
+      success_tri = true;
+    } else if (initializer_feat->config().triangulate_1d) {
       success_tri = initializer_feat->single_triangulation_1d(*it1, clones_cam);
     } else {
       success_tri = initializer_feat->single_triangulation(*it1, clones_cam);
@@ -131,7 +125,7 @@ void UpdaterSLAM::delayed_init(std::shared_ptr<State> state, std::vector<std::sh
 
     // Gauss-newton refine the feature
     bool success_refine = true;
-    if (initializer_feat->config().refine_features) {
+    if (initializer_feat->config().refine_features && !initializer_feat->config().batch_features) {
       success_refine = initializer_feat->single_gaussnewton(*it1, clones_cam);
     }
 
@@ -143,9 +137,17 @@ void UpdaterSLAM::delayed_init(std::shared_ptr<State> state, std::vector<std::sh
     }
     it1++;
   }
-  rT2 = boost::posix_time::microsec_clock::local_time();
+  double time_tri = trace_tri.stop();
+  TraceScope trace_init("slam delayed initialize");
 
   // 4. Compute linear system for each feature, nullspace project, and reject
+  // NOTE: we collect the systems of all features so they can be gated and initialized together
+  // NOTE: this grows the covariance only a single time instead of once for each new landmark
+  std::vector<std::shared_ptr<Type>> init_landmarks;
+  std::vector<std::vector<std::shared_ptr<Type>>> init_Hx_orders;
+  std::vector<Eigen::MatrixXd> init_H_xs, init_H_fs, init_Rs;
+  std::vector<Eigen::VectorXd> init_ress;
+  std::vector<double> init_chi2_multiplers;
   auto it2 = feature_vec.begin();
   while (it2 != feature_vec.end()) {
 
@@ -227,26 +229,40 @@ void UpdaterSLAM::delayed_init(std::shared_ptr<State> state, std::vector<std::sh
         ((int)feat.featid < state->_options.max_aruco_features) ? _options_aruco.sigma_pix_sq : _options_slam.sigma_pix_sq;
     Eigen::MatrixXd R = sigma_pix_sq * Eigen::MatrixXd::Identity(res.rows(), res.rows());
 
-    // Try to initialize, delete new pointer if we failed
+    // Append to our batch of systems we will try to initialize
     double chi2_multipler =
         ((int)feat.featid < state->_options.max_aruco_features) ? _options_aruco.chi2_multipler : _options_slam.chi2_multipler;
-    if (StateHelper::initialize(state, landmark, Hx_order, H_x, H_f, R, res, chi2_multipler)) {
-      state->_features_SLAM.insert({(*it2)->featid, landmark});
-      (*it2)->to_delete = true;
-      it2++;
-    } else {
-      (*it2)->to_delete = true;
-      it2 = feature_vec.erase(it2);
+    init_landmarks.push_back(landmark);
+    init_Hx_orders.push_back(Hx_order);
+    init_H_xs.push_back(H_x);
+    init_H_fs.push_back(H_f);
+    init_Rs.push_back(R);
+    init_ress.push_back(res);
+    init_chi2_multiplers.push_back(chi2_multipler);
+    it2++;
+  }
+
+  // Try to initialize all features, remove the ones that failed
+  std::vector<bool> initialized =
+      StateHelper::initialize_batch(state, init_landmarks, init_Hx_orders, init_H_xs, init_H_fs, init_Rs, init_ress, init_chi2_multiplers);
+  assert(initialized.size() == feature_vec.size());
+  std::vector<std::shared_ptr<Feature>> feature_vec_initialized;
+  for (size_t i = 0; i < feature_vec.size(); i++) {
+    feature_vec.at(i)->to_delete = true;
+    if (initialized.at(i)) {
+      state->_features_SLAM.insert({feature_vec.at(i)->featid, std::dynamic_pointer_cast<Landmark>(init_landmarks.at(i))});
+      feature_vec_initialized.push_back(feature_vec.at(i));
     }
   }
-  rT3 = boost::posix_time::microsec_clock::local_time();
+  feature_vec = feature_vec_initialized;
+  double time_init = trace_init.stop();
 
   // Debug print timing information
   if (!feature_vec.empty()) {
-    PRINT_ALL("[SLAM-DELAY]: %.4f seconds to clean\n", (rT1 - rT0).total_microseconds() * 1e-6);
-    PRINT_ALL("[SLAM-DELAY]: %.4f seconds to triangulate\n", (rT2 - rT1).total_microseconds() * 1e-6);
-    PRINT_ALL("[SLAM-DELAY]: %.4f seconds initialize (%d features)\n", (rT3 - rT2).total_microseconds() * 1e-6, (int)feature_vec.size());
-    PRINT_ALL("[SLAM-DELAY]: %.4f seconds total\n", (rT3 - rT1).total_microseconds() * 1e-6);
+    PRINT_ALL("[SLAM-DELAY]: %.4f seconds to clean\n", time_clean);
+    PRINT_ALL("[SLAM-DELAY]: %.4f seconds to triangulate\n", time_tri);
+    PRINT_ALL("[SLAM-DELAY]: %.4f seconds initialize (%d features)\n", time_init, (int)feature_vec.size());
+    PRINT_ALL("[SLAM-DELAY]: %.4f seconds total\n", time_tri + time_init);
   }
 }
 
@@ -257,8 +273,7 @@ void UpdaterSLAM::update(std::shared_ptr<State> state, std::vector<std::shared_p
     return;
 
   // Start timing
-  boost::posix_time::ptime rT0, rT1, rT2, rT3;
-  rT0 = boost::posix_time::microsec_clock::local_time();
+  TraceScope trace_clean("slam clean");
 
   // 0. Get all timestamps our clones are at (and thus valid measurement times)
   std::vector<double> clonetimes;
@@ -295,7 +310,8 @@ void UpdaterSLAM::update(std::shared_ptr<State> state, std::vector<std::shared_p
       it0++;
     }
   }
-  rT1 = boost::posix_time::microsec_clock::local_time();
+  double time_clean = trace_clean.stop();
+  TraceScope trace_system("slam create system");
 
   // Calculate the max possible measurement size
   size_t max_meas_size = 0;
@@ -448,7 +464,8 @@ void UpdaterSLAM::update(std::shared_ptr<State> state, std::vector<std::shared_p
     ct_meas += res.rows();
     it2++;
   }
-  rT2 = boost::posix_time::microsec_clock::local_time();
+  double time_system = trace_system.stop();
+  TraceScope trace_ekf("slam update state");
 
   // We have appended all features to our Hx_big, res_big
   // Delete it so we do not reuse information
@@ -468,14 +485,13 @@ void UpdaterSLAM::update(std::shared_ptr<State> state, std::vector<std::shared_p
 
   // 5. With all good SLAM features update the state
   StateHelper::EKFUpdate(state, Hx_order_big, Hx_big, res_big, R_big);
-  rT3 = boost::posix_time::microsec_clock::local_time();
+  double time_ekf = trace_ekf.stop();
 
   // Debug print timing information
-  PRINT_ALL("[SLAM-UP]: %.4f seconds to clean\n", (rT1 - rT0).total_microseconds() * 1e-6);
-  PRINT_ALL("[SLAM-UP]: %.4f seconds creating linear system\n", (rT2 - rT1).total_microseconds() * 1e-6);
-  PRINT_ALL("[SLAM-UP]: %.4f seconds to update (%d feats of %d size)\n", (rT3 - rT2).total_microseconds() * 1e-6, (int)feature_vec.size(),
-            (int)Hx_big.rows());
-  PRINT_ALL("[SLAM-UP]: %.4f seconds total\n", (rT3 - rT1).total_microseconds() * 1e-6);
+  PRINT_ALL("[SLAM-UP]: %.4f seconds to clean\n", time_clean);
+  PRINT_ALL("[SLAM-UP]: %.4f seconds creating linear system\n", time_system);
+  PRINT_ALL("[SLAM-UP]: %.4f seconds to update (%d feats of %d size)\n", time_ekf, (int)feature_vec.size(), (int)Hx_big.rows());
+  PRINT_ALL("[SLAM-UP]: %.4f seconds total\n", time_system + time_ekf);
 }
 
 void UpdaterSLAM::change_anchors(std::shared_ptr<State> state) {
@@ -488,7 +504,10 @@ void UpdaterSLAM::change_anchors(std::shared_ptr<State> state) {
   // Get the marginalization timestep, and change the anchor for any feature seen from it
   // NOTE: for now we have anchor the feature in the same camera as it is before
   // NOTE: this also does not change the representation of the feature at all right now
+  // NOTE: all landmarks that need to be changed are done together in a single covariance propagation
   double marg_timestep = state->margtimestep();
+  std::vector<std::shared_ptr<Landmark>> landmarks;
+  std::vector<size_t> new_cam_ids;
   for (auto &f : state->_features_SLAM) {
     // Skip any features that are in the global frame
     if (f.second->_feat_representation == LandmarkRepresentation::Representation::GLOBAL_3D ||
@@ -497,151 +516,193 @@ void UpdaterSLAM::change_anchors(std::shared_ptr<State> state) {
     // Else lets see if it is anchored in the clone that will be marginalized
     assert(marg_timestep <= f.second->_anchor_clone_timestamp);
     if (f.second->_anchor_clone_timestamp == marg_timestep) {
-      perform_anchor_change(state, f.second, state->_timestamp, f.second->_anchor_cam_id);
+      landmarks.push_back(f.second);
+      new_cam_ids.push_back(f.second->_anchor_cam_id);
     }
   }
+  perform_anchor_change(state, landmarks, state->_timestamp, new_cam_ids);
 }
 
-void UpdaterSLAM::perform_anchor_change(std::shared_ptr<State> state, std::shared_ptr<Landmark> landmark, double new_anchor_timestamp,
-                                        size_t new_cam_id) {
-
-  // Assert that this is an anchored representation
-  assert(LandmarkRepresentation::is_relative_representation(landmark->_feat_representation));
-  assert(landmark->_anchor_cam_id != -1);
-
-  // Create current feature representation
-  UpdaterHelper::UpdaterHelperFeature old_feat;
-  old_feat.featid = landmark->_featid;
-  old_feat.feat_representation = landmark->_feat_representation;
-  old_feat.anchor_cam_id = landmark->_anchor_cam_id;
-  old_feat.anchor_clone_timestamp = landmark->_anchor_clone_timestamp;
-  old_feat.p_FinA = landmark->get_xyz(false);
-  old_feat.p_FinA_fej = landmark->get_xyz(true);
-
-  // Get Jacobians of p_FinG wrt old representation
-  Eigen::MatrixXd H_f_old;
-  std::vector<Eigen::MatrixXd> H_x_old;
-  std::vector<std::shared_ptr<Type>> x_order_old;
-  UpdaterHelper::get_feature_jacobian_representation(state, old_feat, H_f_old, H_x_old, x_order_old);
-
-  // Create future feature representation
-  UpdaterHelper::UpdaterHelperFeature new_feat;
-  new_feat.featid = landmark->_featid;
-  new_feat.feat_representation = landmark->_feat_representation;
-  new_feat.anchor_cam_id = new_cam_id;
-  new_feat.anchor_clone_timestamp = new_anchor_timestamp;
-
-  //==========================================================================
-  //==========================================================================
-
-  // OLD: anchor camera position and orientation
-  Eigen::Matrix<double, 3, 3> R_GtoIOLD = state->_clones_IMU.at(old_feat.anchor_clone_timestamp)->Rot();
-  Eigen::Matrix<double, 3, 3> R_GtoOLD = state->_calib_IMUtoCAM.at(old_feat.anchor_cam_id)->Rot() * R_GtoIOLD;
-  Eigen::Matrix<double, 3, 1> p_OLDinG = state->_clones_IMU.at(old_feat.anchor_clone_timestamp)->pos() -
-                                         R_GtoOLD.transpose() * state->_calib_IMUtoCAM.at(old_feat.anchor_cam_id)->pos();
+void UpdaterSLAM::perform_anchor_change(std::shared_ptr<State> state, const std::vector<std::shared_ptr<Landmark>> &landmarks,
+                                        double new_anchor_timestamp, const std::vector<size_t> &new_cam_ids) {
 
-  // NEW: anchor camera position and orientation
-  Eigen::Matrix<double, 3, 3> R_GtoINEW = state->_clones_IMU.at(new_feat.anchor_clone_timestamp)->Rot();
-  Eigen::Matrix<double, 3, 3> R_GtoNEW = state->_calib_IMUtoCAM.at(new_feat.anchor_cam_id)->Rot() * R_GtoINEW;
-  Eigen::Matrix<double, 3, 1> p_NEWinG = state->_clones_IMU.at(new_feat.anchor_clone_timestamp)->pos() -
-                                         R_GtoNEW.transpose() * state->_calib_IMUtoCAM.at(new_feat.anchor_cam_id)->pos();
-
-  // Calculate transform between the old anchor and new one
-  Eigen::Matrix<double, 3, 3> R_OLDtoNEW = R_GtoNEW * R_GtoOLD.transpose();
-  Eigen::Matrix<double, 3, 1> p_OLDinNEW = R_GtoNEW * (p_OLDinG - p_NEWinG);
-  new_feat.p_FinA = R_OLDtoNEW * landmark->get_xyz(false) + p_OLDinNEW;
+  // Return if we have nothing to change
+  assert(landmarks.size() == new_cam_ids.size());
+  if (landmarks.empty())
+    return;
 
-  //==========================================================================
-  //==========================================================================
+  // Loop through each landmark and compute the Jacobians of its new representation
+  // These are in respect to the old feature, the old anchor and the new anchor
+  std::vector<UpdaterHelper::UpdaterHelperFeature> new_feats;
+  std::vector<Eigen::MatrixXd> H_f_olds, H_f_new_invs;
+  std::vector<std::vector<Eigen::MatrixXd>> H_x_olds, H_x_news;
+  std::vector<std::vector<std::shared_ptr<Type>>> x_order_olds, x_order_news;
+  for (size_t l = 0; l < landmarks.size(); l++) {
+
+    // Assert that this is an anchored representation
+    std::shared_ptr<Landmark> landmark = landmarks.at(l);
+    assert(LandmarkRepresentation::is_relative_representation(landmark->_feat_representation));
+    assert(landmark->_anchor_cam_id != -1);
+
+    // Create current feature representation
+    UpdaterHelper::UpdaterHelperFeature old_feat;
+    old_feat.featid = landmark->_featid;
+    old_feat.feat_representation = landmark->_feat_representation;
+    old_feat.anchor_cam_id = landmark->_anchor_cam_id;
+    old_feat.anchor_clone_timestamp = landmark->_anchor_clone_timestamp;
+    old_feat.p_FinA = landmark->get_xyz(false);
+    old_feat.p_FinA_fej = landmark->get_xyz(true);
+
+    // Get Jacobians of p_FinG wrt old representation
+    Eigen::MatrixXd H_f_old;
+    std::vector<Eigen::MatrixXd> H_x_old;
+    std::vector<std::shared_ptr<Type>> x_order_old;
+    UpdaterHelper::get_feature_jacobian_representation(state, old_feat, H_f_old, H_x_old, x_order_old);
+
+    // Create future feature representation
+    UpdaterHelper::UpdaterHelperFeature new_feat;
+    new_feat.featid = landmark->_featid;
+    new_feat.feat_representation = landmark->_feat_representation;
+    new_feat.anchor_cam_id = new_cam_ids.at(l);
+    new_feat.anchor_clone_timestamp = new_anchor_timestamp;
+
+    //==========================================================================
+    //==========================================================================
+
+    // OLD: anchor camera position and orientation
+    Eigen::Matrix<double, 3, 3> R_GtoIOLD = state->_clones_IMU.at(old_feat.anchor_clone_timestamp)->Rot();
+    Eigen::Matrix<double, 3, 3> R_GtoOLD = state->_calib_IMUtoCAM.at(old_feat.anchor_cam_id)->Rot() * R_GtoIOLD;
+    Eigen::Matrix<double, 3, 1> p_OLDinG = state->_clones_IMU.at(old_feat.anchor_clone_timestamp)->pos() -
+                                           R_GtoOLD.transpose() * state->_calib_IMUtoCAM.at(old_feat.anchor_cam_id)->pos();
+
+    // NEW: anchor camera position and orientation
+    Eigen::Matrix<double, 3, 3> R_GtoINEW = state->_clones_IMU.at(new_feat.anchor_clone_timestamp)->Rot();
+    Eigen::Matrix<double, 3, 3> R_GtoNEW = state->_calib_IMUtoCAM.at(new_feat.anchor_cam_id)->Rot() * R_GtoINEW;
+    Eigen::Matrix<double, 3, 1> p_NEWinG = state->_clones_IMU.at(new_feat.anchor_clone_timestamp)->pos() -
+                                           R_GtoNEW.transpose() * state->_calib_IMUtoCAM.at(new_feat.anchor_cam_id)->pos();
+
+    // Calculate transform between the old anchor and new one
+    Eigen::Matrix<double, 3, 3> R_OLDtoNEW = R_GtoNEW * R_GtoOLD.transpose();
+    Eigen::Matrix<double, 3, 1> p_OLDinNEW = R_GtoNEW * (p_OLDinG - p_NEWinG);
+    new_feat.p_FinA = R_OLDtoNEW * landmark->get_xyz(false) + p_OLDinNEW;
+
+    //==========================================================================
+    //==========================================================================
+
+    // OLD: anchor camera position and orientation
+    Eigen::Matrix<double, 3, 3> R_GtoIOLD_fej = state->_clones_IMU.at(old_feat.anchor_clone_timestamp)->Rot_fej();
+    Eigen::Matrix<double, 3, 3> R_GtoOLD_fej = state->_calib_IMUtoCAM.at(old_feat.anchor_cam_id)->Rot() * R_GtoIOLD_fej;
+    Eigen::Matrix<double, 3, 1> p_OLDinG_fej = state->_clones_IMU.at(old_feat.anchor_clone_timestamp)->pos_fej() -
+                                               R_GtoOLD_fej.transpose() * state->_calib_IMUtoCAM.at(old_feat.anchor_cam_id)->pos();
+
+    // NEW: anchor camera position and orientation
+    Eigen::Matrix<double, 3, 3> R_GtoINEW_fej = state->_clones_IMU.at(new_feat.anchor_clone_timestamp)->Rot_fej();
+    Eigen::Matrix<double, 3, 3> R_GtoNEW_fej = state->_calib_IMUtoCAM.at(new_feat.anchor_cam_id)->Rot() * R_GtoINEW_fej;
+    Eigen::Matrix<double, 3, 1> p_NEWinG_fej = state->_clones_IMU.at(new_feat.anchor_clone_timestamp)->pos_fej() -
+                                               R_GtoNEW_fej.transpose() * state->_calib_IMUtoCAM.at(new_feat.anchor_cam_id)->pos();
+
+    // Calculate transform between the old anchor and new one
+    Eigen::Matrix<double, 3, 3> R_OLDtoNEW_fej = R_GtoNEW_fej * R_GtoOLD_fej.transpose();
+    Eigen::Matrix<double, 3, 1> p_OLDinNEW_fej = R_GtoNEW_fej * (p_OLDinG_fej - p_NEWinG_fej);
+    new_feat.p_FinA_fej = R_OLDtoNEW_fej * landmark->get_xyz(true) + p_OLDinNEW_fej;
+
+    // Get Jacobians of p_FinG wrt new representation
+    Eigen::MatrixXd H_f_new;
+    std::vector<Eigen::MatrixXd> H_x_new;
+    std::vector<std::shared_ptr<Type>> x_order_new;
+    UpdaterHelper::get_feature_jacobian_representation(state, new_feat, H_f_new, H_x_new, x_order_new);
+
+    // Inverse of our new representation
+    // pf_new_error = Hfnew^{-1}*(Hfold*pf_olderror+Hxold*x_olderror-Hxnew*x_newerror)
+    Eigen::MatrixXd H_f_new_inv;
+    if (new_feat.feat_representation == LandmarkRepresentation::Representation::ANCHORED_INVERSE_DEPTH_SINGLE) {
+      H_f_new_inv = 1.0 / H_f_new.squaredNorm() * H_f_new.transpose();
+    } else {
+      H_f_new_inv = H_f_new.colPivHouseholderQr().solve(Eigen::Matrix<double, 3, 3>::Identity());
+    }
 
-  // OLD: anchor camera position and orientation
-  Eigen::Matrix<double, 3, 3> R_GtoIOLD_fej = state->_clones_IMU.at(old_feat.anchor_clone_timestamp)->Rot_fej();
-  Eigen::Matrix<double, 3, 3> R_GtoOLD_fej = state->_calib_IMUtoCAM.at(old_feat.anchor_cam_id)->Rot() * R_GtoIOLD_fej;
-  Eigen::Matrix<double, 3, 1> p_OLDinG_fej = state->_clones_IMU.at(old_feat.anchor_clone_timestamp)->pos_fej() -
-                                             R_GtoOLD_fej.transpose() * state->_calib_IMUtoCAM.at(old_feat.anchor_cam_id)->pos();
-
-  // NEW: anchor camera position and orientation
-  Eigen::Matrix<double, 3, 3> R_GtoINEW_fej = state->_clones_IMU.at(new_feat.anchor_clone_timestamp)->Rot_fej();
-  Eigen::Matrix<double, 3, 3> R_GtoNEW_fej = state->_calib_IMUtoCAM.at(new_feat.anchor_cam_id)->Rot() * R_GtoINEW_fej;
-  Eigen::Matrix<double, 3, 1> p_NEWinG_fej = state->_clones_IMU.at(new_feat.anchor_clone_timestamp)->pos_fej() -
-                                             R_GtoNEW_fej.transpose() * state->_calib_IMUtoCAM.at(new_feat.anchor_cam_id)->pos();
-
-  // Calculate transform between the old anchor and new one
-  Eigen::Matrix<double, 3, 3> R_OLDtoNEW_fej = R_GtoNEW_fej * R_GtoOLD_fej.transpose();
-  Eigen::Matrix<double, 3, 1> p_OLDinNEW_fej = R_GtoNEW_fej * (p_OLDinG_fej - p_NEWinG_fej);
-  new_feat.p_FinA_fej = R_OLDtoNEW_fej * landmark->get_xyz(true) + p_OLDinNEW_fej;
-
-  // Get Jacobians of p_FinG wrt new representation
-  Eigen::MatrixXd H_f_new;
-  std::vector<Eigen::MatrixXd> H_x_new;
-  std::vector<std::shared_ptr<Type>> x_order_new;
-  UpdaterHelper::get_feature_jacobian_representation(state, new_feat, H_f_new, H_x_new, x_order_new);
+    // Append to our batch
+    new_feats.push_back(new_feat);
+    H_f_olds.push_back(H_f_old);
+    H_f_new_invs.push_back(H_f_new_inv);
+    H_x_olds.push_back(H_x_old);
+    H_x_news.push_back(H_x_new);
+    x_order_olds.push_back(x_order_old);
+    x_order_news.push_back(x_order_new);
+  }
 
   //==========================================================================
   //==========================================================================
 
-  // New phi order is just the landmark
+  // New phi order is all the landmarks
+  // These do not need to be contiguous in the covariance
   std::vector<std::shared_ptr<Type>> phi_order_NEW;
-  phi_order_NEW.push_back(landmark);
+  std::vector<int> Phi_row_ids;
+  int phi_rows = 0;
+  for (const auto &landmark : landmarks) {
+    phi_order_NEW.push_back(landmark);
+    Phi_row_ids.push_back(phi_rows);
+    phi_rows += landmark->size();
+  }
 
   // Loop through all our orders and append them
+  // Many landmarks share the same old and new anchor, so these will only be appended once
   std::vector<std::shared_ptr<Type>> phi_order_OLD;
   int current_it = 0;
   std::map<std::shared_ptr<Type>, int> Phi_id_map;
-  for (const auto &var : x_order_old) {
-    if (Phi_id_map.find(var) == Phi_id_map.end()) {
-      Phi_id_map.insert({var, current_it});
-      phi_order_OLD.push_back(var);
-      current_it += var->size();
-    }
-  }
-  for (const auto &var : x_order_new) {
+  auto append_var = [&](const std::shared_ptr<Type> &var) {
     if (Phi_id_map.find(var) == Phi_id_map.end()) {
       Phi_id_map.insert({var, current_it});
       phi_order_OLD.push_back(var);
       current_it += var->size();
     }
+  };
+  for (size_t l = 0; l < landmarks.size(); l++) {
+    for (const auto &var : x_order_olds.at(l))
+      append_var(var);
+    for (const auto &var : x_order_news.at(l))
+      append_var(var);
   }
-  Phi_id_map.insert({landmark, current_it});
-  phi_order_OLD.push_back(landmark);
-  current_it += landmark->size();
-
-  // Anchor change Jacobian
-  int phisize = (new_feat.feat_representation != LandmarkRepresentation::Representation::ANCHORED_INVERSE_DEPTH_SINGLE) ? 3 : 1;
-  Eigen::MatrixXd Phi = Eigen::MatrixXd::Zero(phisize, current_it);
-  Eigen::MatrixXd Q = Eigen::MatrixXd::Zero(phisize, phisize);
-
-  // Inverse of our new representation
-  // pf_new_error = Hfnew^{-1}*(Hfold*pf_olderror+Hxold*x_olderror-Hxnew*x_newerror)
-  Eigen::MatrixXd H_f_new_inv;
-  if (phisize == 1) {
-    H_f_new_inv = 1.0 / H_f_new.squaredNorm() * H_f_new.transpose();
-  } else {
-    H_f_new_inv = H_f_new.colPivHouseholderQr().solve(Eigen::Matrix<double, 3, 3>::Identity());
+  for (const auto &landmark : landmarks) {
+    append_var(landmark);
   }
 
-  // Place Jacobians for old anchor
-  for (size_t i = 0; i < H_x_old.size(); i++) {
-    Phi.block(0, Phi_id_map.at(x_order_old[i]), phisize, x_order_old[i]->size()).noalias() += H_f_new_inv * H_x_old[i];
-  }
+  // Anchor change Jacobian, each landmark is a block row that is only a function of itself and the anchors
+  Eigen::MatrixXd Phi = Eigen::MatrixXd::Zero(phi_rows, current_it);
+  Eigen::MatrixXd Q = Eigen::MatrixXd::Zero(phi_rows, phi_rows);
+  for (size_t l = 0; l < landmarks.size(); l++) {
+    int phisize = landmarks.at(l)->size();
+    int row = Phi_row_ids.at(l);
+
+    // Place Jacobians for old anchor
+    for (size_t i = 0; i < H_x_olds.at(l).size(); i++) {
+      std::shared_ptr<Type> var = x_order_olds.at(l).at(i);
+      Phi.block(row, Phi_id_map.at(var), phisize, var->size()).noalias() += H_f_new_invs.at(l) * H_x_olds.at(l).at(i);
+    }
 
-  // Place Jacobians for old feat
-  Phi.block(0, Phi_id_map.at(landmark), phisize, phisize) = H_f_new_inv * H_f_old;
+    // Place Jacobians for old feat
+    Phi.block(row, Phi_id_map.at(landmarks.at(l)), phisize, phisize) = H_f_new_invs.at(l) * H_f_olds.at(l);
 
-  // Place Jacobians for new anchor
-  for (size_t i = 0; i < H_x_new.size(); i++) {
-    Phi.block(0, Phi_id_map.at(x_order_new[i]), phisize, x_order_new[i]->size()).noalias() -= H_f_new_inv * H_x_new[i];
+    // Place Jacobians for new anchor
+    for (size_t i = 0; i < H_x_news.at(l).size(); i++) {
+      std::shared_ptr<Type> var = x_order_news.at(l).at(i);
+      Phi.block(row, Phi_id_map.at(var), phisize, var->size()).noalias() -= H_f_new_invs.at(l) * H_x_news.at(l).at(i);
+    }
   }
 
   // Perform covariance propagation
   StateHelper::EKFPropagation(state, phi_order_NEW, phi_order_OLD, Phi, Q);
 
   // Set state from new feature
-  landmark->_featid = new_feat.featid;
-  landmark->_feat_representation = new_feat.feat_representation;
-  landmark->_anchor_cam_id = new_feat.anchor_cam_id;
-  landmark->_anchor_clone_timestamp = new_feat.anchor_clone_timestamp;
-  landmark->set_from_xyz(new_feat.p_FinA, false);
-  landmark->set_from_xyz(new_feat.p_FinA_fej, true);
-  landmark->has_had_anchor_change = true;
+  for (size_t l = 0; l < landmarks.size(); l++) {
+    std::shared_ptr<Landmark> landmark = landmarks.at(l);
+    const UpdaterHelper::UpdaterHelperFeature &new_feat = new_feats.at(l);
+    landmark->_featid = new_feat.featid;
+    landmark->_feat_representation = new_feat.feat_representation;
+    landmark->_anchor_cam_id = new_feat.anchor_cam_id;
+    landmark->_anchor_clone_timestamp = new_feat.anchor_clone_timestamp;
+    landmark->set_from_xyz(new_feat.p_FinA, false);
+    landmark->set_from_xyz(new_feat.p_FinA_fej, true);
+    landmark->has_had_anchor_change = true;
+  }
 }
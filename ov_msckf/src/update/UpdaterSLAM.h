@@ -90,14 +90,18 @@ public:
 
 protected:
   /**
-   * @brief Shifts landmark anchor to new clone
+   * @brief Shifts landmark anchors to new clone
+   *
+   * All landmarks are changed together using a single block-sparse state transition and covariance propagation.
+   * Each landmark is only a function of itself and its old and new anchor, which are typically shared.
+   *
    * @param state State of filter
-   * @param landmark landmark whose anchor is being shifter
+   * @param landmarks landmarks whose anchor is being shifted
    * @param new_anchor_timestamp Clone timestamp we want to move to
-   * @param new_cam_id Which camera frame we want to move to
+   * @param new_cam_ids Which camera frame we want to move to for each landmark
    */
-  void perform_anchor_change(std::shared_ptr<State> state, std::shared_ptr<ov_type::Landmark> landmark, double new_anchor_timestamp,
-                             size_t new_cam_id);
+  void perform_anchor_change(std::shared_ptr<State> state, const std::vector<std::shared_ptr<ov_type::Landmark>> &landmarks,
+                             double new_anchor_timestamp, const std::vector<size_t> &new_cam_ids);
 
   /// Options used during update for slam features
   UpdaterOptions _options_slam;
@@ -28,9 +28,11 @@
 #include "state/Propagator.h"
 #include "state/State.h"
 #include "state/StateHelper.h"
+#include "utils/binary_io.h"
 #include "utils/colors.h"
 #include "utils/print.h"
 #include "utils/quat_ops.h"
+#include "utils/trace.h"
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/math/distributions/chi_squared.hpp>
@@ -46,9 +48,12 @@ UpdaterZeroVelocity::UpdaterZeroVelocity(UpdaterOptions &options,
                                          double gravity_mag, 
                                          double zupt_max_velocity,
                                          double zupt_noise_multiplier, 
-                                         double zupt_max_disparity)
+                                         double zupt_max_disparity,
+                                         double zupt_prefilter_multiplier,
+                                         double zupt_prefilter_window)
     : _options(options), _noises(noises), _db(db), _prop(prop), _zupt_max_velocity(zupt_max_velocity),
-      _zupt_noise_multiplier(zupt_noise_multiplier), _zupt_max_disparity(zupt_max_disparity) 
+      _zupt_noise_multiplier(zupt_noise_multiplier), _zupt_max_disparity(zupt_max_disparity),
+      _zupt_prefilter_multiplier(zupt_prefilter_multiplier), _zupt_prefilter_window(zupt_prefilter_window) 
 {
   // Gravity
   _gravity << 0.0, 0.0, gravity_mag;
@@ -67,10 +72,53 @@ UpdaterZeroVelocity::UpdaterZeroVelocity(UpdaterOptions &options,
   }
 }
 
+void UpdaterZeroVelocity::feed_tracks(double timestamp, const std::unordered_map<size_t, std::vector<cv::KeyPoint>> &pts,
+                                      const std::unordered_map<size_t, std::vector<size_t>> &ids) {
+
+  // Compute the average disparity to the last frame for all features seen in both
+  double disp_sum = 0.0;
+  int disp_count = 0;
+  std::unordered_map<size_t, std::unordered_map<size_t, Eigen::Vector2f>> uvs_new;
+  for (const auto &cam_pts : pts) {
+    size_t cam_id = cam_pts.first;
+    if (ids.find(cam_id) == ids.end())
+      continue;
+    const std::vector<size_t> &cam_ids = ids.at(cam_id);
+    auto it_last = disp_last_uvs.find(cam_id);
+    std::unordered_map<size_t, Eigen::Vector2f> &cam_uvs = uvs_new[cam_id];
+    cam_uvs.reserve(cam_pts.second.size());
+    for (size_t i = 0; i < cam_pts.second.size() && i < cam_ids.size(); i++) {
+      Eigen::Vector2f uv(cam_pts.second.at(i).pt.x, cam_pts.second.at(i).pt.y);
+      cam_uvs.insert({cam_ids.at(i), uv});
+      if (it_last == disp_last_uvs.end())
+        continue;
+      auto it_uv = it_last->second.find(cam_ids.at(i));
+      if (it_uv != it_last->second.end()) {
+        disp_sum += (uv - it_uv->second).norm();
+        disp_count++;
+      }
+    }
+  }
+
+  // Move forward in time
+  disp_time0 = disp_time1;
+  disp_time1 = timestamp;
+  disp_avg = (disp_count > 0) ? disp_sum / (double)disp_count : -1;
+  disp_num = disp_count;
+  disp_last_uvs = std::move(uvs_new);
+}
+
 bool UpdaterZeroVelocity::try_update(std::shared_ptr<State> state, double timestamp) {
 
+  OV_TRACE_SCOPE("zupt");
+
   // Return if we don't have any imu data yet
-  if (imu_data.empty()) {
+  bool imu_empty;
+  {
+    std::lock_guard<std::mutex> lck(imu_data_mtx);
+    imu_empty = imu_data.empty();
+  }
+  if (imu_empty) {
     last_zupt_state_timestamp = 0.0; // 最后的一个zupt的时间戳，复位
     return false;
   }
@@ -99,19 +147,9 @@ bool UpdaterZeroVelocity::try_update(std::shared_ptr<State> state, double timest
   double time0 = state->_timestamp + last_prop_time_offset;
   double time1 = timestamp + t_off_new;
 
-  // Select bounding inertial measurements
-  std::vector<ov_core::ImuData> imu_recent = Propagator::select_imu_readings(imu_data, time0, time1); // 获取time0~time1之间的imu数据
-
   // Move forward in time
   last_prop_time_offset = t_off_new; // 维护时间偏移量
 
-  // Check that we have at least one measurement to propagate with
-  if (imu_recent.size() < 2) {
-    PRINT_WARNING(RED "[ZUPT]: There are no IMU data to check for zero velocity with!!\n" RESET);
-    last_zupt_state_timestamp = 0.0;
-    return false;
-  }
-
   // If we should integrate the acceleration and say the velocity should be zero
   // Also if we should still inflate the bias based on their random walk noises
   /*
@@ -126,6 +164,83 @@ bool UpdaterZeroVelocity::try_update(std::shared_ptr<State> state, double timest
   bool override_with_disparity_check = true;
   bool explicitly_enforce_zero_motion = false;
 
+  // note 基于视差的zupt检测
+  // Check if the image disparity
+  bool disparity_passed = false; // 标识图像视差检查是否通过
+  if (override_with_disparity_check) {
+
+    // Get the disparity statistics from this image to the previous
+    double time0_cam = state->_timestamp;
+    double time1_cam = timestamp; // Next camera timestamp we want to see if we should propagate to
+    int num_features = 0;
+    double disp_avg = 0.0;
+    double disp_var = 0.0;
+    // 出参：计算视差均值、方差、个数
+    // NOTE: if our incremental estimate is between these two frames we can use it directly
+    if (disp_time0 == time0_cam && disp_time1 == time1_cam) {
+      disp_avg = this->disp_avg;
+      num_features = disp_num;
+    } else {
+      FeatureHelper::compute_disparity(_db, time0_cam, time1_cam, disp_avg, disp_var, num_features);
+    }
+
+    // Check if this disparity is enough to be classified as moving
+    disparity_passed = (disp_avg < _zupt_max_disparity && num_features > 20); // note 基于视差的zupt检测阈值
+    if (disparity_passed) {
+      PRINT_INFO(CYAN "[ZUPT]: passed disparity (%.3f < %.3f, %d features)\n" RESET, disp_avg, _zupt_max_disparity, (int)num_features);
+    } 
+    else {
+      PRINT_DEBUG(YELLOW "[ZUPT]: failed disparity (%.3f > %.3f, %d features)\n" RESET, disp_avg, _zupt_max_disparity, (int)num_features);
+    }
+  }
+  // --- end 基于视差的zupt检测
+
+  // Cheap pre-filter before we construct the full system
+  // If we are obviously moving we can reject right away without any linear algebra
+  // This uses the velocity estimate and the running statistics of the IMU window (gyro energy and accel variance)
+  if (!disparity_passed) {
+    double gyro_energy = 0.0, gyro_thresh = 0.0, accel_var = 0.0, accel_thresh = 0.0;
+    bool imu_moving = false;
+    std::unique_lock<std::mutex> lck(imu_data_mtx);
+    if (_zupt_prefilter_multiplier > 0 && prefilter_imu.size() > 1) {
+      double n = (double)prefilter_imu.size();
+      double dt = (prefilter_imu.back().timestamp - prefilter_imu.front().timestamp) / (n - 1.0);
+      if (dt > 0) {
+        Eigen::Vector3d bg = state->_imu->bias_g();
+        Eigen::Vector3d mean_a = prefilter_sum_a / n;
+        gyro_energy = prefilter_sum_w2 / n - 2.0 * bg.dot(prefilter_sum_w) / n + bg.squaredNorm();
+        accel_var = prefilter_sum_a2 / n - mean_a.squaredNorm();
+        gyro_thresh = 3.0 * std::pow(_zupt_prefilter_multiplier, 2) * _noises.sigma_w_2 / dt;
+        accel_thresh = 3.0 * std::pow(_zupt_prefilter_multiplier, 2) * _noises.sigma_a_2 / dt;
+        imu_moving = (gyro_energy > gyro_thresh || accel_var > accel_thresh);
+      }
+    }
+    lck.unlock();
+    if (state->_imu->vel().norm() > _zupt_max_velocity || imu_moving) {
+      last_zupt_state_timestamp = 0.0;
+      last_zupt_count = 0;
+      count_prefilter_rejected++;
+      PRINT_DEBUG(YELLOW "[ZUPT]: pre-filter rejected |v_IinG| = %.3f, gyro %.2e > %.2e or accel %.2e > %.2e\n" RESET,
+                  state->_imu->vel().norm(), gyro_energy, gyro_thresh, accel_var, accel_thresh);
+      return false;
+    }
+  }
+  count_full_checks++;
+
+  // Select bounding inertial measurements
+  std::vector<ov_core::ImuData> imu_recent;
+  {
+    std::lock_guard<std::mutex> lck(imu_data_mtx);
+    imu_recent = Propagator::select_imu_readings(imu_data, time0, time1); // 获取time0~time1之间的imu数据
+  }
+
+  // Check that we have at least one measurement to propagate with
+  if (imu_recent.size() < 2) {
+    PRINT_WARNING(RED "[ZUPT]: There are no IMU data to check for zero velocity with!!\n" RESET);
+    last_zupt_state_timestamp = 0.0;
+    return false;
+  }
+
   // Order of our Jacobian
   std::vector<std::shared_ptr<Type>> Hx_order; // 存放状态变量的指针
   Hx_order.push_back(state->_imu->q());
@@ -271,31 +386,6 @@ bool UpdaterZeroVelocity::try_update(std::shared_ptr<State> state, double timest
   }
   // --- end 基于惯性的zupt检测
 
-  // note 基于视差的zupt检测
-  // Check if the image disparity
-  bool disparity_passed = false; // 标识图像视差检查是否通过
-  if (override_with_disparity_check) {
-
-    // Get the disparity statistics from this image to the previous
-    double time0_cam = state->_timestamp;
-    double time1_cam = timestamp; // Next camera timestamp we want to see if we should propagate to
-    int num_features = 0;
-    double disp_avg = 0.0;
-    double disp_var = 0.0;
-    // 出参：计算视差均值、方差、个数
-    FeatureHelper::compute_disparity(_db, time0_cam, time1_cam, disp_avg, disp_var, num_features);
-
-    // Check if this disparity is enough to be classified as moving
-    disparity_passed = (disp_avg < _zupt_max_disparity && num_features > 20); // note 基于视差的zupt检测阈值
-    if (disparity_passed) {
-      PRINT_INFO(CYAN "[ZUPT]: passed disparity (%.3f < %.3f, %d features)\n" RESET, disp_avg, _zupt_max_disparity, (int)num_features);
-    } 
-    else {
-      PRINT_DEBUG(YELLOW "[ZUPT]: failed disparity (%.3f > %.3f, %d features)\n" RESET, disp_avg, _zupt_max_disparity, (int)num_features);
-    }
-  }
-  // --- end 基于视差的zupt检测
-
   // Check if we are currently zero velocity
   // We need to pass the chi2 and not be above our velocity threshold
   if (!disparity_passed && 
@@ -437,5 +527,65 @@ bool UpdaterZeroVelocity::try_update(std::shared_ptr<State> state, double timest
   // Finally return
   last_zupt_state_timestamp = timestamp;
   last_zupt_count++;
+  count_accepted++;
   return true;
-}
\ No newline at end of file
+}
+void UpdaterZeroVelocity::save_checkpoint(std::ostream &out) {
+  std::lock_guard<std::mutex> lck(imu_data_mtx);
+  binary_io::write(out, (uint64_t)imu_data.size());
+  for (const auto &data : imu_data) {
+    binary_io::write(out, data.timestamp);
+    binary_io::write_matrix(out, data.wm);
+    binary_io::write_matrix(out, data.am);
+  }
+  binary_io::write(out, (uint64_t)prefilter_imu.size());
+  for (const auto &data : prefilter_imu) {
+    binary_io::write(out, data.timestamp);
+    binary_io::write_matrix(out, data.wm);
+    binary_io::write_matrix(out, data.am);
+  }
+  binary_io::write(out, have_last_prop_time_offset);
+  binary_io::write(out, last_prop_time_offset);
+  binary_io::write(out, last_zupt_state_timestamp);
+  binary_io::write(out, (int32_t)last_zupt_count);
+}
+
+bool UpdaterZeroVelocity::load_checkpoint(std::istream &in) {
+  std::vector<ov_core::ImuData> imu_data_new;
+  std::deque<ov_core::ImuData> prefilter_imu_new;
+  for (int i = 0; i < 2; i++) {
+    uint64_t num_imu;
+    if (!binary_io::read(in, num_imu))
+      return false;
+    for (uint64_t j = 0; j < num_imu; j++) {
+      ov_core::ImuData data;
+      if (!binary_io::read(in, data.timestamp) || !binary_io::read_matrix(in, data.wm) || !binary_io::read_matrix(in, data.am))
+        return false;
+      if (i == 0)
+        imu_data_new.push_back(data);
+      else
+        prefilter_imu_new.push_back(data);
+    }
+  }
+  int32_t zupt_count;
+  if (!binary_io::read(in, have_last_prop_time_offset) || !binary_io::read(in, last_prop_time_offset) ||
+      !binary_io::read(in, last_zupt_state_timestamp) || !binary_io::read(in, zupt_count))
+    return false;
+  last_zupt_count = zupt_count;
+
+  // The running sums of the pre-filter are recomputed from its window
+  std::lock_guard<std::mutex> lck(imu_data_mtx);
+  imu_data = imu_data_new;
+  prefilter_imu = prefilter_imu_new;
+  prefilter_sum_w.setZero();
+  prefilter_sum_a.setZero();
+  prefilter_sum_w2 = 0.0;
+  prefilter_sum_a2 = 0.0;
+  for (const auto &data : prefilter_imu) {
+    prefilter_sum_w += data.wm;
+    prefilter_sum_a += data.am;
+    prefilter_sum_w2 += data.wm.squaredNorm();
+    prefilter_sum_a2 += data.am.squaredNorm();
+  }
+  return true;
+}
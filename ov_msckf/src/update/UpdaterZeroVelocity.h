@@ -22,7 +22,12 @@
 #ifndef OV_MSCKF_UPDATER_ZEROVELOCITY_H
 #define OV_MSCKF_UPDATER_ZEROVELOCITY_H
 
+#include <deque>
+#include <istream>
 #include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
 
 #include "utils/sensor_data.h"
 
@@ -64,6 +69,8 @@ public:
    * @param zupt_max_velocity Max velocity we should consider to do a update with
    * @param zupt_noise_multiplier Multiplier of our IMU noise matrix (default should be 1.0)
    * @param zupt_max_disparity Max disparity we should consider to do a update with
+   * @param zupt_prefilter_multiplier Multiplier of the IMU noise above which the pre-filter says we are moving (non-positive disables)
+   * @param zupt_prefilter_window Duration in seconds of the IMU window the pre-filter statistics are computed over
    */
   UpdaterZeroVelocity(UpdaterOptions &options, 
                       NoiseManager &noises, 
@@ -72,18 +79,38 @@ public:
                       double gravity_mag,
                       double zupt_max_velocity, 
                       double zupt_noise_multiplier,
-                      double zupt_max_disparity);
+                      double zupt_max_disparity,
+                      double zupt_prefilter_multiplier,
+                      double zupt_prefilter_window);
 
   /**
    * @brief Feed function for inertial data
    * @param message Contains our timestamp and inertial information
    * @param oldest_time Time that we can discard measurements before
+   *
+   * This can be called from a different thread than try_update() (e.g. if we pipeline the estimator).
    */
   void feed_imu(const ov_core::ImuData &message, double oldest_time = -1) {
 
     // Append it to our vector
+    std::lock_guard<std::mutex> lck(imu_data_mtx);
     imu_data.emplace_back(message);
 
+    // Update the running statistics of our pre-filter window
+    // We add the new measurement and remove any which have fallen out of the window
+    prefilter_imu.push_back(message);
+    prefilter_sum_w += message.wm;
+    prefilter_sum_a += message.am;
+    prefilter_sum_w2 += message.wm.squaredNorm();
+    prefilter_sum_a2 += message.am.squaredNorm();
+    while (!prefilter_imu.empty() && prefilter_imu.front().timestamp < message.timestamp - _zupt_prefilter_window) {
+      prefilter_sum_w -= prefilter_imu.front().wm;
+      prefilter_sum_a -= prefilter_imu.front().am;
+      prefilter_sum_w2 -= prefilter_imu.front().wm.squaredNorm();
+      prefilter_sum_a2 -= prefilter_imu.front().am.squaredNorm();
+      prefilter_imu.pop_front();
+    }
+
     // Sort our imu data (handles any out of order measurements)
     // std::sort(imu_data.begin(), imu_data.end(), [](const IMUDATA i, const IMUDATA j) {
     //    return i.timestamp < j.timestamp;
@@ -91,7 +118,7 @@ public:
 
     // Clean old measurements
     // std::cout << "ZVUPT: imu_data.size() " << imu_data.size() << std::endl;
-    clean_old_imu_measurements(oldest_time - 0.10);
+    clean_old_imu_measurements_locked(oldest_time - 0.10);
   }
 
   /**
@@ -99,6 +126,63 @@ public:
    * @param oldest_time Time that we can discard measurements before (in IMU clock)
    */
   void clean_old_imu_measurements(double oldest_time) {
+    std::lock_guard<std::mutex> lck(imu_data_mtx);
+    clean_old_imu_measurements_locked(oldest_time);
+  }
+
+  /**
+   * @brief Feed function for the tracked features of the newest frame
+   *
+   * We use this to incrementally maintain the average disparity between the last two frames.
+   * This is then used instead of computing it from the feature database if the frames match the ones we will check.
+   *
+   * @param timestamp Timestamp of the tracked frame
+   * @param pts Tracked raw feature locations for each camera
+   * @param ids Ids of the tracked features for each camera
+   */
+  void feed_tracks(double timestamp, const std::unordered_map<size_t, std::vector<cv::KeyPoint>> &pts,
+                   const std::unordered_map<size_t, std::vector<size_t>> &ids);
+
+  /**
+   * @brief Get how many times each zero velocity decision has been made
+   * @param num_prefilter_rejected Number of times the pre-filter rejected without building the full system
+   * @param num_full_checks Number of times we needed the full chi2 check
+   * @param num_accepted Number of times we detected zero velocity and did an update
+   */
+  void get_decision_counts(int &num_prefilter_rejected, int &num_full_checks, int &num_accepted) const {
+    num_prefilter_rejected = count_prefilter_rejected;
+    num_full_checks = count_full_checks;
+    num_accepted = count_accepted;
+  }
+
+  /**
+   * @brief Writes our IMU history, pre-filter window and the time of our last update in binary to the stream
+   *
+   * The incremental disparity of the last tracked frames is not saved (it is tracker state).
+   * Until two frames have been fed again, we will compute the disparity from the feature database.
+   *
+   * @param out Stream we will write to
+   */
+  void save_checkpoint(std::ostream &out);
+
+  /**
+   * @brief Restores what save_checkpoint() wrote (replacing our current IMU history)
+   * @param in Stream we will read from
+   * @return True if everything could be read
+   */
+  bool load_checkpoint(std::istream &in);
+
+  /**
+   * @brief Will first detect if the system is zero velocity, then will update.
+   * @param state State of the filter
+   * @param timestamp Next camera timestamp we want to see if we should propagate to.
+   * @return True if the system is currently at zero velocity
+   */
+  bool try_update(std::shared_ptr<State> state, double timestamp);
+
+protected:
+  /// Removes IMU measurements older than the given time (the mutex should be locked)
+  void clean_old_imu_measurements_locked(double oldest_time) {
     if (oldest_time < 0)
       return;
     auto it0 = imu_data.begin();
@@ -111,15 +195,6 @@ public:
     }
   }
 
-  /**
-   * @brief Will first detect if the system is zero velocity, then will update.
-   * @param state State of the filter
-   * @param timestamp Next camera timestamp we want to see if we should propagate to.
-   * @return True if the system is currently at zero velocity
-   */
-  bool try_update(std::shared_ptr<State> state, double timestamp);
-
-protected:
   /// Options used during update (chi2 multiplier)
   UpdaterOptions _options;
 
@@ -144,6 +219,36 @@ protected:
   /// Max disparity (pixels) that we should consider a zupt with
   double _zupt_max_disparity = 1.0;
 
+  /// Multiplier of the discrete IMU noise above which the pre-filter considers us moving
+  double _zupt_prefilter_multiplier = -1.0;
+
+  /// Duration (sec) of the pre-filter IMU window
+  double _zupt_prefilter_window = 0.1;
+
+  /// Mutex for our IMU measurements and pre-filter window (they are fed by another thread if pipelined)
+  std::mutex imu_data_mtx;
+
+  /// IMU measurements in the pre-filter window and their running sums
+  std::deque<ov_core::ImuData> prefilter_imu;
+  Eigen::Vector3d prefilter_sum_w = Eigen::Vector3d::Zero();
+  Eigen::Vector3d prefilter_sum_a = Eigen::Vector3d::Zero();
+  double prefilter_sum_w2 = 0.0;
+  double prefilter_sum_a2 = 0.0;
+
+  /// Raw feature locations of the last tracked frame for each camera (used for the incremental disparity)
+  std::unordered_map<size_t, std::unordered_map<size_t, Eigen::Vector2f>> disp_last_uvs;
+
+  /// Incremental disparity between the last two tracked frames (time0 to time1)
+  double disp_time0 = -1;
+  double disp_time1 = -1;
+  double disp_avg = -1;
+  int disp_num = 0;
+
+  /// Counts of the decisions we have made
+  int count_prefilter_rejected = 0;
+  int count_full_checks = 0;
+  int count_accepted = 0;
+
   /// Chi squared 95th percentile table (lookup would be size of residual)
   std::map<int, double> chi_squared_table;
 